@@ -0,0 +1,213 @@
+// Cost of getting command buffers for a frame: allocating and freeing them
+// every frame, versus reusing them through CommandPoolManager.
+// Buffers are empty, so recording and submission barely add to what is measured.
+//
+// Usage: CorEngineCommandPoolBench [frames] [buffers_per_frame]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "vulkan_bench_context.hpp"
+
+namespace
+{
+	constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+
+	void recordEmpty(VkCommandBuffer buffer)
+	{
+		VkCommandBufferBeginInfo begin_info{};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		ensureVkSuccess(vkBeginCommandBuffer(buffer, &begin_info), "Failed to begin command buffer.");
+		ensureVkSuccess(vkEndCommandBuffer(buffer), "Failed to end command buffer.");
+	}
+
+	void submit(bench::VulkanContext& context, const vec<VkCommandBuffer>& buffers, VkFence fence)
+	{
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = static_cast<uint32_t>(buffers.size());
+		submit_info.pCommandBuffers = buffers.data();
+		ensureVkSuccess(vkQueueSubmit(context.queue, 1, &submit_info, fence), "Failed to submit.");
+	}
+
+	struct FrameFences
+	{
+		VkDevice device;
+		arr<VkFence, FRAMES_IN_FLIGHT> fences{};
+
+		explicit FrameFences(VkDevice device) : device(device)
+		{
+			VkFenceCreateInfo fence_info{};
+			fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+			for (VkFence& fence : fences)
+			{
+				ensureVkSuccess(vkCreateFence(device, &fence_info, nullptr, &fence), "Failed to create fence.");
+			}
+		}
+
+		~FrameFences()
+		{
+			vkDeviceWaitIdle(device);
+			for (VkFence fence : fences)
+			{
+				vkDestroyFence(device, fence, nullptr);
+			}
+		}
+	};
+
+	// The usual naive approach: a buffer is allocated for every draw list and freed once the GPU is done with it.
+	double runAllocateFree(bench::VulkanContext& context, int frames, uint32_t buffer_count)
+	{
+		const VkDevice device = context.p_device->vk_handle;
+		CorE::CommandPool pool(context.p_device.get(), context.p_queue_family,
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, nullptr);
+		FrameFences fences(device);
+		arr<vec<VkCommandBuffer>, FRAMES_IN_FLIGHT> in_flight;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			const uint32_t slot = frame % FRAMES_IN_FLIGHT;
+			ensureVkSuccess(vkWaitForFences(device, 1, &fences.fences[slot], VK_TRUE, UINT64_MAX), "Failed to wait.");
+			ensureVkSuccess(vkResetFences(device, 1, &fences.fences[slot]), "Failed to reset fence.");
+			if (!in_flight[slot].empty())
+			{
+				vkFreeCommandBuffers(device, pool.vk_handle, static_cast<uint32_t>(in_flight[slot].size()), in_flight[slot].data());
+			}
+
+			in_flight[slot].resize(buffer_count);
+			VkCommandBufferAllocateInfo alloc_info{};
+			alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			alloc_info.commandPool = pool.vk_handle;
+			alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			for (uint32_t i = 0; i < buffer_count; i++)
+			{
+				alloc_info.commandBufferCount = 1;
+				ensureVkSuccess(vkAllocateCommandBuffers(device, &alloc_info, &in_flight[slot][i]), "Failed to allocate.");
+				recordEmpty(in_flight[slot][i]);
+			}
+			submit(context, in_flight[slot], fences.fences[slot]);
+		}
+		vkDeviceWaitIdle(device);
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::micro>(end - start).count() / frames;
+	}
+
+	// Records the frame on thread_count threads, each with pools of its own.
+	double runManager(bench::VulkanContext& context, int frames, uint32_t buffer_count, unsigned int thread_count, size_t* p_allocated)
+	{
+		const VkDevice device = context.p_device->vk_handle;
+		CorE::CommandPoolManager manager(context.p_device.get(), context.p_queue_family, FRAMES_IN_FLIGHT, nullptr);
+		FrameFences fences(device);
+		vec<VkCommandBuffer> buffers(buffer_count);
+
+		auto record = [&](uint32_t first, uint32_t last)
+		{
+			for (uint32_t i = first; i < last; i++)
+			{
+				CorE::CommandBuffer* p_buffer = manager.acquireBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+				recordEmpty(p_buffer->vk_handle);
+				buffers[i] = p_buffer->vk_handle;
+			}
+		};
+
+		// Recording threads are kept for the whole run, as pools belong to the thread that created them.
+		vec<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable condition;
+		int started_frame = -1;
+		unsigned int finished = 0;
+		bool stopping = false;
+		for (unsigned int t = 1; t < thread_count; t++)
+		{
+			threads.emplace_back([&, t]()
+			{
+				for (int seen = -1;;)
+				{
+					{
+						std::unique_lock<std::mutex> lock(mutex);
+						condition.wait(lock, [&]() { return stopping || started_frame != seen; });
+						if (stopping)
+						{
+							return;
+						}
+						seen = started_frame;
+					}
+					record(buffer_count * t / thread_count, buffer_count * (t + 1) / thread_count);
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						finished++;
+					}
+					condition.notify_all();
+				}
+			});
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			manager.beginFrame();
+			const VkFence fence = fences.fences[manager.getFrameIndex()];
+			ensureVkSuccess(vkResetFences(device, 1, &fence), "Failed to reset fence.");
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				started_frame = frame;
+				finished = 0;
+			}
+			condition.notify_all();
+			record(0, buffer_count / thread_count);
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [&]() { return finished == thread_count - 1; });
+			}
+
+			submit(context, buffers, fence);
+			manager.endFrame(fence);
+		}
+		vkDeviceWaitIdle(device);
+		auto end = std::chrono::steady_clock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		*p_allocated = manager.getAllocatedCount();
+		return std::chrono::duration<double, std::micro>(end - start).count() / frames;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int frames = argc > 1 ? std::atoi(argv[1]) : 2000;
+	const uint32_t buffer_count = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 64;
+	const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	bench::VulkanContext context;
+	std::printf("%d frames, %u command buffers per frame, %u frames in flight\n", frames, buffer_count, FRAMES_IN_FLIGHT);
+
+	const double allocate_us = runAllocateFree(context, frames, buffer_count);
+	std::printf("allocate/free         %9.2f us/frame  %8.3f us/buffer  %zu allocations\n",
+		allocate_us, allocate_us / buffer_count, static_cast<size_t>(frames) * buffer_count);
+
+	for (unsigned int threads = 1; threads <= max_threads; threads *= 2)
+	{
+		size_t allocated = 0;
+		const double manager_us = runManager(context, frames, buffer_count, threads, &allocated);
+		std::printf("manager, %2u thread(s) %9.2f us/frame  %8.3f us/buffer  %zu allocations  %5.2fx\n",
+			threads, manager_us, manager_us / buffer_count, allocated, allocate_us / manager_us);
+	}
+	return 0;
+}
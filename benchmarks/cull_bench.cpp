@@ -0,0 +1,255 @@
+// GPU-driven culling with IndirectCuller, validated against the CPU reference cullObjects().
+// Objects are scattered around a camera, so that a part of them is in view. The draws the GPU
+// wrote are read back and compared with the reference, draw by draw, then both are timed.
+// Exits with 1 if validation fails, so it doubles as a check on lavapipe.
+//
+// Usage: CorEngineCullBench [object_count] [frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "CorE/gpu_culling.hpp"
+#include "vulkan_bench_context.hpp"
+
+namespace
+{
+	// Objects closer to a plane than this may be culled differently by the GPU, which may fuse operations.
+	constexpr float PLANE_TOLERANCE = 1e-3f;
+
+	// Distance of an object to the cull test of the plane it is closest to, the same math as isVisible().
+	float getPlaneMargin(const CorE::Graphics::CullObject& object, const CorE::Graphics::Frustum& frustum)
+	{
+		float center[3];
+		float scale_sq = 0.0f;
+		for (int i = 0; i < 3; i++)
+		{
+			center[i] = object.rows[i][0] * object.sphere[0] + object.rows[i][1] * object.sphere[1]
+				+ object.rows[i][2] * object.sphere[2] + object.rows[i][3];
+			scale_sq = std::max(scale_sq, object.rows[0][i] * object.rows[0][i] + object.rows[1][i] * object.rows[1][i]
+				+ object.rows[2][i] * object.rows[2][i]);
+		}
+		const float radius = object.sphere[3] * std::sqrt(scale_sq);
+
+		float margin = INFINITY;
+		for (const float(&plane)[4] : frustum.planes)
+		{
+			const float distance = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] + radius;
+			margin = std::min(margin, std::abs(distance));
+		}
+		return margin;
+	}
+
+	// Records a command buffer with record, submits it and waits until it is done. Returns milliseconds until then.
+	template <typename Record>
+	double submitAndWait(bench::VulkanContext& context, CorE::CommandPoolManager& pools, VkFence fence, Record record)
+	{
+		pools.beginFrame();
+		ensureVkSuccess(vkResetFences(context.p_device->vk_handle, 1, &fence), "Failed to reset fence.");
+		auto start = std::chrono::steady_clock::now();
+		CorE::CommandBuffer* p_buffer = pools.acquireBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+		p_buffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr);
+		record(p_buffer);
+		p_buffer->end();
+
+		VkSubmitInfo submit_info{};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &p_buffer->vk_handle;
+		ensureVkSuccess(vkQueueSubmit(context.queue, 1, &submit_info, fence), "Failed to submit.");
+		ensureVkSuccess(vkWaitForFences(context.p_device->vk_handle, 1, &fence, VK_TRUE, UINT64_MAX),
+			"Failed to wait for fence.");
+		auto end = std::chrono::steady_clock::now();
+		pools.endFrame(fence);
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t object_count = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1000000;
+	const int frames = argc > 2 ? std::atoi(argv[2]) : 20;
+
+	bench::VulkanContext context(true);
+	CorE::DeviceMemoryAllocator memory(context.p_device.get());
+	CorE::Graphics::Descriptor::BindlessHeap heap(context.p_device.get());
+	CorE::Graphics::MappedShaderCode cull_shader = CorE::Graphics::loadShaderCached(
+		CORENGINE_SHADER_DIR "/cull.slang", "cullMain", CORENGINE_SHADER_CACHE_DIR);
+	CorE::Graphics::IndirectCuller culler(context.p_device.get(), &memory, &heap, cull_shader, object_count);
+	CorE::CommandPoolManager pools(context.p_device.get(), context.p_queue_family, 1, nullptr);
+
+	VkFence fence;
+	VkFenceCreateInfo fence_info{};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	ensureVkSuccess(vkCreateFence(context.p_device->vk_handle, &fence_info, nullptr, &fence), "Failed to create fence.");
+
+	// Objects all around a camera at the origin looking down -Z, so that only a part of them is in view.
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> position_dist(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> angle_dist(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> scale_dist(0.5f, 2.0f);
+	vec<CorE::Graphics::CullObject> objects(object_count);
+	for (uint32_t i = 0; i < object_count; i++)
+	{
+		CorE::Graphics::CullObject& object = objects[i];
+		const float scale = scale_dist(rng);
+		object.setTransform(CorE::math::Mat4x4::transformation({ scale, scale * scale_dist(rng), scale },
+			{ angle_dist(rng), angle_dist(rng), angle_dist(rng) }, { position_dist(rng), position_dist(rng), position_dist(rng) }));
+		object.sphere[0] = 0.0f;
+		object.sphere[1] = 0.5f;
+		object.sphere[2] = 0.0f;
+		object.sphere[3] = scale_dist(rng);
+		object.index_count = 3 * (1 + i % 500);
+		object.first_index = i * 3;
+		object.vertex_offset = static_cast<int32_t>(i % 1000);
+		object.reserved = 0;
+	}
+	culler.setObjects(0, objects);
+
+	const CorE::math::Mat4x4 projection = CorE::math::Mat4x4::projection(1.0471976f, 16.0f / 9.0f, 0.1f, 150.0f);
+	const CorE::Graphics::Frustum frustum = CorE::Graphics::Frustum::fromMatrix(projection);
+
+	// Read back through a host visible buffer, as the culler keeps its own in device local memory.
+	const VkDeviceSize commands_size = sizeof(VkDrawIndexedIndirectCommand) * VkDeviceSize(object_count);
+	VkBufferCreateInfo readback_info{};
+	readback_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	readback_info.size = sizeof(uint32_t) + commands_size;
+	readback_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	readback_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	CorE::DeviceAllocation* p_readback_allocation;
+	const VkBuffer readback = memory.createBuffer(readback_info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &p_readback_allocation);
+
+	submitAndWait(context, pools, fence, [&](CorE::CommandBuffer* p_buffer)
+	{
+		culler.cull(p_buffer, frustum, object_count);
+
+		VkMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+		// Chains onto the barrier cull() ends with, which made the draws available.
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+		VkDependencyInfo dependency{};
+		dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependency.memoryBarrierCount = 1;
+		dependency.pMemoryBarriers = &barrier;
+		vkCmdPipelineBarrier2(p_buffer->vk_handle, &dependency);
+
+		const VkBufferCopy count_region{ 0, 0, sizeof(uint32_t) };
+		vkCmdCopyBuffer(p_buffer->vk_handle, culler.getCountBuffer(), readback, 1, &count_region);
+		const VkBufferCopy commands_region{ 0, sizeof(uint32_t), commands_size };
+		vkCmdCopyBuffer(p_buffer->vk_handle, culler.getCommandBuffer(), readback, 1, &commands_region);
+
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+		vkCmdPipelineBarrier2(p_buffer->vk_handle, &dependency);
+	});
+	memory.invalidate(p_readback_allocation, 0, readback_info.size);
+
+	const char* p_readback = static_cast<const char*>(p_readback_allocation->p_mapped);
+	uint32_t gpu_count;
+	std::memcpy(&gpu_count, p_readback, sizeof(gpu_count));
+	gpu_count = std::min(gpu_count, object_count);
+	vec<VkDrawIndexedIndirectCommand> gpu_commands(gpu_count);
+	std::memcpy(gpu_commands.data(), p_readback + sizeof(uint32_t), sizeof(VkDrawIndexedIndirectCommand) * gpu_count);
+	// The GPU appends draws in any order, the reference in object order.
+	std::sort(gpu_commands.begin(), gpu_commands.end(),
+		[](const VkDrawIndexedIndirectCommand& lhs, const VkDrawIndexedIndirectCommand& rhs)
+	{
+		return lhs.firstInstance < rhs.firstInstance;
+	});
+
+	vec<VkDrawIndexedIndirectCommand> cpu_commands;
+	const uint32_t cpu_count = CorE::Graphics::cullObjects(objects, frustum, cpu_commands);
+
+	// Every object must be drawn once at most.
+	uint32_t mismatches = 0;
+	for (size_t i = 0; i < gpu_commands.size(); i++)
+	{
+		if (gpu_commands[i].firstInstance >= object_count
+			|| (i > 0 && gpu_commands[i - 1].firstInstance == gpu_commands[i].firstInstance))
+		{
+			mismatches++;
+		}
+	}
+
+	// Walks both sorted lists, an object only in one of them is a mismatch unless it touches a plane.
+	size_t gpu_i = 0;
+	size_t cpu_i = 0;
+	uint32_t borderline = 0;
+	while (mismatches == 0 && (gpu_i < gpu_commands.size() || cpu_i < cpu_commands.size()))
+	{
+		const uint32_t gpu_object = gpu_i < gpu_commands.size() ? gpu_commands[gpu_i].firstInstance : UINT32_MAX;
+		const uint32_t cpu_object = cpu_i < cpu_commands.size() ? cpu_commands[cpu_i].firstInstance : UINT32_MAX;
+		if (gpu_object == cpu_object)
+		{
+			if (std::memcmp(&gpu_commands[gpu_i], &cpu_commands[cpu_i], sizeof(VkDrawIndexedIndirectCommand)) != 0)
+			{
+				mismatches++;
+			}
+			gpu_i++;
+			cpu_i++;
+			continue;
+		}
+		const uint32_t object = std::min(gpu_object, cpu_object);
+		if (getPlaneMargin(objects[object], frustum) <= PLANE_TOLERANCE * (1.0f + objects[object].sphere[3]))
+		{
+			borderline++;
+		}
+		else
+		{
+			mismatches++;
+		}
+		(gpu_object < cpu_object ? gpu_i : cpu_i)++;
+	}
+
+	std::printf("%u objects, %u visible on the GPU, %u on the CPU, %u borderline, %u mismatches\n",
+		object_count, gpu_count, cpu_count, borderline, mismatches);
+	if (mismatches != 0)
+	{
+		std::printf("validation FAILED\n");
+		vkDeviceWaitIdle(context.p_device->vk_handle);
+		memory.destroyBuffer(readback, p_readback_allocation);
+		vkDestroyFence(context.p_device->vk_handle, fence, nullptr);
+		return 1;
+	}
+	std::printf("validation passed\n\n");
+
+	double gpu_ms = 0.0;
+	double record_ms = 0.0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		gpu_ms += submitAndWait(context, pools, fence, [&](CorE::CommandBuffer* p_buffer)
+		{
+			auto start = std::chrono::steady_clock::now();
+			culler.cull(p_buffer, frustum, object_count);
+			auto end = std::chrono::steady_clock::now();
+			record_ms += std::chrono::duration<double, std::milli>(end - start).count();
+		});
+	}
+
+	double cpu_ms = 0.0;
+	for (int frame = 0; frame < frames; frame++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		CorE::Graphics::cullObjects(objects, frustum, cpu_commands);
+		auto end = std::chrono::steady_clock::now();
+		cpu_ms += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	std::printf("GPU cull, submitted and waited for  %8.3f ms/frame\n", gpu_ms / frames);
+	std::printf("GPU cull, recording only            %8.3f ms/frame\n", record_ms / frames);
+	std::printf("CPU reference                       %8.3f ms/frame\n", cpu_ms / frames);
+
+	vkDeviceWaitIdle(context.p_device->vk_handle);
+	memory.destroyBuffer(readback, p_readback_allocation);
+	vkDestroyFence(context.p_device->vk_handle, fence, nullptr);
+	return 0;
+}
@@ -0,0 +1,119 @@
+// Sorting of draw packets by their keys: DrawList::sort() on 1..N threads, against
+// std::sort of the same keys, and the state transitions recording would make
+// before and after sorting. Packets come in random order, as from a scene traversal.
+// Nothing is recorded, so no device is needed.
+//
+// Usage: CorEngineDrawSortBench [packet_count]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+
+#include "CorE/draw_list.hpp"
+
+namespace
+{
+	constexpr uint32_t SHADER_GROUPS = 64;
+	constexpr uint32_t RENDER_STATES = 16;
+	constexpr uint32_t MATERIALS = 4096;
+	constexpr int REPEATS = 10;
+
+	void printStats(const char* name, const CorE::Graphics::DrawList::Stats& stats)
+	{
+		std::printf("%-10s %10llu shader binds %10llu state changes %10llu material binds %10llu draws\n", name,
+			static_cast<unsigned long long>(stats.shader_binds), static_cast<unsigned long long>(stats.state_changes),
+			static_cast<unsigned long long>(stats.material_binds), static_cast<unsigned long long>(stats.draws));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t packet_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> depth_dist(0.0f, 1.0f);
+
+	CorE::Graphics::DrawList list;
+	for (uint32_t i = 0; i < SHADER_GROUPS; i++)
+	{
+		list.addShaderGroup(nullptr);
+	}
+	for (uint32_t i = 0; i < RENDER_STATES; i++)
+	{
+		list.addRenderState({});
+	}
+	for (uint32_t i = 0; i < MATERIALS; i++)
+	{
+		list.addMaterial({});
+	}
+
+	// Materials belong to a shader group, and most groups use a single render state, as in a real scene.
+	vec<CorE::Graphics::DrawPacket> packets(packet_count);
+	for (CorE::Graphics::DrawPacket& packet : packets)
+	{
+		const uint32_t material = rng() % MATERIALS;
+		packet.shader_group = static_cast<uint16_t>(material % SHADER_GROUPS);
+		packet.render_state = static_cast<uint16_t>((packet.shader_group + (rng() % 8 == 0)) % RENDER_STATES);
+		packet.material = material;
+		packet.count = 3 * (1 + rng() % 1000);
+		packet.key = CorE::Graphics::makeDrawKey(0, packet.shader_group, packet.render_state, packet.material,
+			CorE::Graphics::quantizeDepth(depth_dist(rng)));
+	}
+
+	auto refill = [&]()
+	{
+		list.clear();
+		for (const CorE::Graphics::DrawPacket& packet : packets)
+		{
+			list.add(packet);
+		}
+	};
+
+	std::printf("%zu packets, %u shader groups, %u render states, %u materials\n\n",
+		packet_count, SHADER_GROUPS, RENDER_STATES, MATERIALS);
+	refill();
+	printStats("unsorted", list.countTransitions());
+	list.sort();
+	printStats("sorted", list.countTransitions());
+
+	// Reference: a comparison sort of the same key/index pairs DrawList sorts.
+	vec<std::pair<uint64_t, uint64_t>> pairs(packet_count);
+	double std_sort_ms = 0.0;
+	for (int r = 0; r < REPEATS; r++)
+	{
+		for (size_t i = 0; i < packet_count; i++)
+		{
+			pairs[i] = { packets[i].key, i };
+		}
+		auto start = std::chrono::steady_clock::now();
+		std::sort(pairs.begin(), pairs.end());
+		auto end = std::chrono::steady_clock::now();
+		std_sort_ms += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+	std_sort_ms /= REPEATS;
+	std::printf("\n%-10s %8.3f ms\n", "std::sort", std_sort_ms);
+
+	for (unsigned int threads = 1; threads <= max_threads; threads++)
+	{
+		// The calling thread runs jobs too, so it counts as one. A single thread sorts without jobs.
+		uptr<CorE::JobSystem> p_jobs = threads > 1 ? std::make_unique<CorE::JobSystem>(threads - 1) : nullptr;
+		double sort_ms = 0.0;
+		for (int r = 0; r < REPEATS; r++)
+		{
+			refill();
+			auto start = std::chrono::steady_clock::now();
+			list.sort(p_jobs.get());
+			auto end = std::chrono::steady_clock::now();
+			sort_ms += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+		sort_ms /= REPEATS;
+		std::printf("radix %2u threads %8.3f ms  %5.2fx of std::sort\n", threads, sort_ms, std_sort_ms / sort_ms);
+	}
+	return 0;
+}
@@ -0,0 +1,196 @@
+// Host allocations the way a driver makes them while recording: many small, short-lived
+// blocks per thread. Callbacks over plain malloc versus HostAllocator on 1..N threads,
+// then the per-scope stats HostAllocator gathers for a device that records real frames.
+//
+// Usage: CorEngineHostAllocatorBench [operations_per_thread]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "vulkan_bench_context.hpp"
+
+namespace
+{
+	// Sits right before every aligned block, and keeps the pointer malloc returned and the block size.
+	struct MallocHeader
+	{
+		void* p_raw;
+		size_t size;
+	};
+
+	void* VKAPI_PTR mallocAllocation(void*, size_t size, size_t alignment, VkSystemAllocationScope)
+	{
+		alignment = std::max(alignment, alignof(MallocHeader));
+		char* p_raw = static_cast<char*>(std::malloc(size + alignment + sizeof(MallocHeader)));
+		if (!p_raw)
+		{
+			return nullptr;
+		}
+		const uintptr_t first = reinterpret_cast<uintptr_t>(p_raw) + sizeof(MallocHeader);
+		char* p_block = reinterpret_cast<char*>((first + alignment - 1) & ~(uintptr_t(alignment) - 1));
+		reinterpret_cast<MallocHeader*>(p_block)[-1] = { p_raw, size };
+		return p_block;
+	}
+
+	void VKAPI_PTR mallocFree(void*, void* p_memory)
+	{
+		if (p_memory)
+		{
+			std::free(static_cast<MallocHeader*>(p_memory)[-1].p_raw);
+		}
+	}
+
+	void* VKAPI_PTR mallocReallocation(void* p_user_data, void* p_original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		if (!p_original)
+		{
+			return mallocAllocation(p_user_data, size, alignment, scope);
+		}
+		if (size == 0)
+		{
+			mallocFree(p_user_data, p_original);
+			return nullptr;
+		}
+		void* p_memory = mallocAllocation(p_user_data, size, alignment, scope);
+		if (p_memory)
+		{
+			std::memcpy(p_memory, p_original, std::min(size, static_cast<MallocHeader*>(p_original)[-1].size));
+			mallocFree(p_user_data, p_original);
+		}
+		return p_memory;
+	}
+
+	// Keeps a window of live blocks, replacing a random one per operation, and resizes some of them.
+	void churn(const VkAllocationCallbacks* p_callbacks, int operations, uint32_t seed)
+	{
+		constexpr size_t WINDOW = 256;
+		std::mt19937 rng(seed);
+		arr<void*, WINDOW> blocks{};
+		for (int i = 0; i < operations; i++)
+		{
+			void*& p_block = blocks[rng() % WINDOW];
+			const size_t size = 16 + rng() % 1024;
+			if (p_block && rng() % 4 == 0)
+			{
+				p_block = p_callbacks->pfnReallocation(p_callbacks->pUserData, p_block, size, 16,
+					VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+				continue;
+			}
+			p_callbacks->pfnFree(p_callbacks->pUserData, p_block);
+			p_block = p_callbacks->pfnAllocation(p_callbacks->pUserData, size, 16, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND);
+			if (p_block)
+			{
+				std::memset(p_block, 0, 16);
+			}
+		}
+		for (void* p_block : blocks)
+		{
+			p_callbacks->pfnFree(p_callbacks->pUserData, p_block);
+		}
+	}
+
+	double runThreads(const VkAllocationCallbacks* p_callbacks, unsigned int thread_count, int operations)
+	{
+		vec<std::thread> threads;
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned int t = 0; t < thread_count; t++)
+		{
+			threads.emplace_back(churn, p_callbacks, operations, t + 1);
+		}
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(end - start).count() / (static_cast<double>(operations) * thread_count);
+	}
+
+	void printStats(CorE::HostAllocator& allocator)
+	{
+		static const char* scope_names[CorE::HostAllocator::SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
+		std::printf("scope     allocs  reallocs     frees   alloc KiB    live KiB  large  internal KiB\n");
+		for (uint32_t scope = 0; scope < CorE::HostAllocator::SCOPE_COUNT; scope++)
+		{
+			const CorE::HostAllocator::ScopeStats stats = allocator.getStats(static_cast<VkSystemAllocationScope>(scope));
+			std::printf("%-8s %7llu %9llu %9llu %11.1f %11.1f %6llu %13.1f\n", scope_names[scope],
+				static_cast<unsigned long long>(stats.allocations), static_cast<unsigned long long>(stats.reallocations),
+				static_cast<unsigned long long>(stats.frees), stats.allocated_bytes / 1024.0,
+				(static_cast<double>(stats.allocated_bytes) - static_cast<double>(stats.freed_bytes)) / 1024.0,
+				static_cast<unsigned long long>(stats.large_allocations), stats.internal_bytes / 1024.0);
+		}
+	}
+
+	// Records and submits a few frames, to show which scopes the driver allocates in per frame.
+	void recordFrames(bench::VulkanContext& context, int frames)
+	{
+		const VkDevice device = context.p_device->vk_handle;
+		CorE::CommandPoolManager pools(context.p_device.get(), context.p_queue_family, 2, context.p_device->getAllocator());
+		VkFenceCreateInfo fence_info{};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		arr<VkFence, 2> fences{};
+		for (VkFence& fence : fences)
+		{
+			ensureVkSuccess(vkCreateFence(device, &fence_info, context.p_device->getAllocator(), &fence), "Failed to create fence.");
+		}
+
+		for (int frame = 0; frame < frames; frame++)
+		{
+			pools.beginFrame();
+			const VkFence fence = fences[pools.getFrameIndex()];
+			ensureVkSuccess(vkResetFences(device, 1, &fence), "Failed to reset fence.");
+			CorE::CommandBuffer* p_buffer = pools.acquireBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+			p_buffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr);
+			for (int i = 0; i < 1000; i++)
+			{
+				vkCmdSetDepthBias(p_buffer->vk_handle, static_cast<float>(i), 0.0f, 1.0f);
+			}
+			p_buffer->end();
+			VkSubmitInfo submit_info{};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &p_buffer->vk_handle;
+			ensureVkSuccess(vkQueueSubmit(context.queue, 1, &submit_info, fence), "Failed to submit.");
+			pools.endFrame(fence);
+		}
+
+		vkDeviceWaitIdle(device);
+		for (VkFence fence : fences)
+		{
+			vkDestroyFence(device, fence, context.p_device->getAllocator());
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int operations = argc > 1 ? std::atoi(argv[1]) : 2000000;
+	const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	VkAllocationCallbacks malloc_callbacks{};
+	malloc_callbacks.pfnAllocation = mallocAllocation;
+	malloc_callbacks.pfnReallocation = mallocReallocation;
+	malloc_callbacks.pfnFree = mallocFree;
+
+	std::printf("%d operations per thread, sizes 16..1040 bytes\n", operations);
+	for (unsigned int threads = 1; threads <= max_threads; threads *= 2)
+	{
+		CorE::HostAllocator allocator;
+		const double malloc_ns = runThreads(&malloc_callbacks, threads, operations);
+		const double pooled_ns = runThreads(allocator.getCallbacks(), threads, operations);
+		std::printf("%2u thread(s)  malloc %7.2f ns/op  HostAllocator %7.2f ns/op  %5.2fx  slabs %zu KiB\n",
+			threads, malloc_ns, pooled_ns, malloc_ns / pooled_ns, allocator.getSlabBytes() / 1024);
+	}
+
+	bench::VulkanContext context;
+	std::printf("\nAfter device creation:\n");
+	printStats(context.host_allocator);
+	context.host_allocator.resetStats();
+	recordFrames(context, 100);
+	std::printf("\n100 recorded frames:\n");
+	printStats(context.host_allocator);
+	return 0;
+}
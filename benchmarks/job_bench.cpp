@@ -0,0 +1,106 @@
+// Scaling of JobSystem::parallelFor from 1 to N threads,
+// on a synthetic update of a million entities.
+//
+// Usage: CorEngineJobBench [entity_count]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "CorE/job_system.hpp"
+
+namespace
+{
+	struct Entities
+	{
+		vec<float> x, y, z;
+		vec<float> vx, vy, vz;
+
+		explicit Entities(size_t count) :
+			x(count), y(count), z(count), vx(count, 1.0f), vy(count, 0.5f), vz(count, -0.25f)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				x[i] = static_cast<float>(i % 1000);
+				y[i] = static_cast<float>(i / 1000);
+			}
+		}
+	};
+
+	// Integrates motion with a little steering, a few dozen flops per entity.
+	void updateRange(Entities& entities, size_t first, size_t last, float dt)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			const float distance = std::sqrt(entities.x[i] * entities.x[i] + entities.z[i] * entities.z[i]) + 1.0f;
+			entities.vx[i] += -entities.x[i] / distance * dt;
+			entities.vz[i] += -entities.z[i] / distance * dt;
+			entities.vy[i] = std::sin(entities.y[i] * 0.01f) * 0.5f;
+			entities.x[i] += entities.vx[i] * dt;
+			entities.y[i] += entities.vy[i] * dt;
+			entities.z[i] += entities.vz[i] * dt;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t entity_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+	constexpr int FRAMES = 50;
+	constexpr size_t GRAIN = 4096;
+
+	Entities entities(entity_count);
+	std::printf("%zu entities, %d frames, grain %zu\n", entity_count, FRAMES, GRAIN);
+
+	auto measure = [&entities](auto update)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			update();
+		}
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / FRAMES;
+	};
+
+	// Plain loop, the baseline.
+	const double single_thread_ms = measure([&]() { updateRange(entities, 0, entity_count, 1.0f / 60.0f); });
+	std::printf("%2u threads %8.3f ms/frame  %5.2fx\n", 1u, single_thread_ms, 1.0);
+
+	for (unsigned int threads = 2; threads <= max_threads; threads++)
+	{
+		// The calling thread runs jobs too, so it counts as one.
+		CorE::JobSystem jobs(threads - 1);
+		const double frame_ms = measure([&]()
+		{
+			jobs.parallelFor(0, entity_count, GRAIN, [&entities](size_t first, size_t last)
+			{
+				updateRange(entities, first, last, 1.0f / 60.0f);
+			});
+		});
+		std::printf("%2u threads %8.3f ms/frame  %5.2fx\n", threads, frame_ms, single_thread_ms / frame_ms);
+	}
+
+	// Far more ranges than the job ring of a thread holds, which must neither throw nor lose ranges.
+	{
+		CorE::JobSystem jobs(max_threads - 1);
+		const size_t range_count = CorE::JobSystem::MAX_JOBS_PER_THREAD * 16;
+		std::atomic<size_t> covered = 0;
+		jobs.parallelFor(0, range_count, 1, [&covered](size_t first, size_t last)
+		{
+			covered.fetch_add(last - first, std::memory_order_relaxed);
+		});
+		if (covered.load() != range_count)
+		{
+			std::printf("validation FAILED, grain 1 over %zu ranges covered %zu\n", range_count, covered.load());
+			return 1;
+		}
+		std::printf("grain 1 over %zu ranges passed\n", range_count);
+	}
+	return 0;
+}
@@ -0,0 +1,90 @@
+// Micro-benchmark of 4x4 matrix kernels, scalar against every
+// vector instruction set supported by current CPU.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include "CorE/simd.hpp"
+#include "CorE/short_type.hpp"
+
+namespace
+{
+	using CorE::math::simd::InstructionSet;
+	using CorE::math::simd::Kernels;
+
+	constexpr size_t MATRIX_COUNT = 1024;
+	constexpr size_t ROUNDS = 2000;
+
+	struct alignas(16) Matrix
+	{
+		float val[16];
+	};
+
+	struct alignas(16) Vector
+	{
+		float val[4];
+	};
+
+	// Runs op over the whole data set ROUNDS times and returns nanoseconds per call.
+	template <typename Op>
+	double measure(Op op)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (size_t round = 0; round < ROUNDS; round++)
+		{
+			for (size_t i = 0; i < MATRIX_COUNT; i++)
+			{
+				op(i);
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		double nanos = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		return nanos / static_cast<double>(ROUNDS * MATRIX_COUNT);
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	vec<Matrix> lhs(MATRIX_COUNT), rhs(MATRIX_COUNT), out(MATRIX_COUNT);
+	vec<Vector> vectors(MATRIX_COUNT), vec_out(MATRIX_COUNT);
+	for (size_t i = 0; i < MATRIX_COUNT; i++)
+	{
+		for (float& f : lhs[i].val) f = dist(rng);
+		for (float& f : rhs[i].val) f = dist(rng);
+		for (float& f : vectors[i].val) f = dist(rng);
+		// Keeps matrices well-conditioned for inversion.
+		for (int d = 0; d < 4; d++) lhs[i].val[d * 5] += 4.0f;
+	}
+
+	std::printf("%-8s %12s %12s %12s %12s\n", "ISA", "mul ns", "transpose ns", "mulVec ns", "inverse ns");
+
+	const InstructionSet sets[] = { InstructionSet::Scalar, InstructionSet::SSE2,
+		InstructionSet::AVX2, InstructionSet::NEON };
+	float checksum = 0.0f;
+	for (InstructionSet set : sets)
+	{
+		if (!CorE::math::simd::isSupported(set))
+		{
+			continue;
+		}
+		const Kernels& k = CorE::math::simd::getKernels(set);
+
+		double mul = measure([&](size_t i) { k.mul(lhs[i].val, rhs[i].val, out[i].val); });
+		checksum += out[MATRIX_COUNT / 2].val[5];
+		double transpose = measure([&](size_t i) { k.transpose(lhs[i].val, out[i].val); });
+		checksum += out[MATRIX_COUNT / 2].val[5];
+		double mul_vec = measure([&](size_t i) { k.mulVec(lhs[i].val, vectors[i].val, vec_out[i].val); });
+		checksum += vec_out[MATRIX_COUNT / 2].val[1];
+		double inverse = measure([&](size_t i) { k.inverse(lhs[i].val, out[i].val); });
+		checksum += out[MATRIX_COUNT / 2].val[5];
+
+		std::printf("%-8s %12.2f %12.2f %12.2f %12.2f\n", k.name, mul, transpose, mul_vec, inverse);
+	}
+
+	std::printf("active: %s (checksum %f)\n", CorE::math::simd::active().name, checksum);
+	return 0;
+}
@@ -0,0 +1,153 @@
+// Creation and destruction of a scene worth of buffers: a vkAllocateMemory for every buffer,
+// versus sub-allocation from blocks by DeviceMemoryAllocator.
+// Buffers are created in random sizes and destroyed in random order, as streaming would.
+//
+// Usage: CorEngineMemoryBench [buffers] [rounds]
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "CorE/device_memory.hpp"
+#include "vulkan_bench_context.hpp"
+
+namespace
+{
+	VkBufferCreateInfo makeBufferInfo(VkDeviceSize size)
+	{
+		VkBufferCreateInfo info{};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		info.size = size;
+		info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		return info;
+	}
+
+	uint32_t findMemoryType(bench::VulkanContext& context, uint32_t type_bits)
+	{
+		VkPhysicalDeviceMemoryProperties memory_props;
+		vkGetPhysicalDeviceMemoryProperties(context.p_physical_device->vk_handle, &memory_props);
+		for (uint32_t i = 0; i < memory_props.memoryTypeCount; i++)
+		{
+			if ((type_bits & (1u << i)) && (memory_props.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			{
+				return i;
+			}
+		}
+		return static_cast<uint32_t>(std::countr_zero(type_bits));
+	}
+
+	// Sizes from 256 bytes to 1 MiB, skewed to small ones, as meshes of a scene are.
+	vec<VkDeviceSize> makeSizes(size_t count)
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<double> exponent(8.0, 20.0);
+		vec<VkDeviceSize> sizes(count);
+		for (VkDeviceSize& size : sizes)
+		{
+			size = static_cast<VkDeviceSize>(std::pow(2.0, exponent(rng)));
+		}
+		return sizes;
+	}
+
+	double runDirect(bench::VulkanContext& context, const vec<VkDeviceSize>& sizes, int rounds)
+	{
+		const VkDevice device = context.p_device->vk_handle;
+		vec<VkBuffer> buffers(sizes.size());
+		vec<VkDeviceMemory> memories(sizes.size());
+		std::mt19937 rng(11);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int round = 0; round < rounds; round++)
+		{
+			for (size_t i = 0; i < sizes.size(); i++)
+			{
+				const VkBufferCreateInfo info = makeBufferInfo(sizes[i]);
+				ensureVkSuccess(vkCreateBuffer(device, &info, nullptr, &buffers[i]), "Failed to create buffer.");
+				VkMemoryRequirements requirements;
+				vkGetBufferMemoryRequirements(device, buffers[i], &requirements);
+				VkMemoryAllocateInfo alloc_info{};
+				alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+				alloc_info.allocationSize = requirements.size;
+				alloc_info.memoryTypeIndex = findMemoryType(context, requirements.memoryTypeBits);
+				ensureVkSuccess(vkAllocateMemory(device, &alloc_info, nullptr, &memories[i]), "Failed to allocate memory.");
+				ensureVkSuccess(vkBindBufferMemory(device, buffers[i], memories[i], 0), "Failed to bind memory.");
+			}
+
+			vec<size_t> order(sizes.size());
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				order[i] = i;
+			}
+			std::shuffle(order.begin(), order.end(), rng);
+			for (size_t i : order)
+			{
+				vkDestroyBuffer(device, buffers[i], nullptr);
+				vkFreeMemory(device, memories[i], nullptr);
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::micro>(end - start).count() / (rounds * sizes.size());
+	}
+
+	double runAllocator(bench::VulkanContext& context, const vec<VkDeviceSize>& sizes, int rounds, size_t* p_block_count)
+	{
+		CorE::DeviceMemoryAllocator allocator(context.p_device.get());
+		vec<VkBuffer> buffers(sizes.size());
+		vec<CorE::DeviceAllocation*> allocations(sizes.size());
+		std::mt19937 rng(11);
+
+		auto start = std::chrono::steady_clock::now();
+		for (int round = 0; round < rounds; round++)
+		{
+			for (size_t i = 0; i < sizes.size(); i++)
+			{
+				buffers[i] = allocator.createBuffer(makeBufferInfo(sizes[i]), 0,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocations[i]);
+			}
+			*p_block_count = allocator.getBlockCount();
+
+			vec<size_t> order(sizes.size());
+			for (size_t i = 0; i < order.size(); i++)
+			{
+				order[i] = i;
+			}
+			std::shuffle(order.begin(), order.end(), rng);
+			for (size_t i : order)
+			{
+				allocator.destroyBuffer(buffers[i], allocations[i]);
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::micro>(end - start).count() / (rounds * sizes.size());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const size_t buffer_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000;
+	const int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+
+	bench::VulkanContext context;
+	std::printf("%zu buffers, %d rounds, maxMemoryAllocationCount %u\n",
+		buffer_count, rounds, context.properties.limits.maxMemoryAllocationCount);
+	if (buffer_count > context.properties.limits.maxMemoryAllocationCount)
+	{
+		std::printf("More buffers than the device allows allocations, lower the count.\n");
+		return 1;
+	}
+	const vec<VkDeviceSize> sizes = makeSizes(buffer_count);
+
+	const double direct_us = runDirect(context, sizes, rounds);
+	std::printf("vkAllocateMemory per buffer  %8.3f us/buffer  %zu allocations\n", direct_us, buffer_count);
+
+	size_t block_count = 0;
+	const double allocator_us = runAllocator(context, sizes, rounds, &block_count);
+	std::printf("DeviceMemoryAllocator        %8.3f us/buffer  %zu allocations  %5.2fx\n",
+		allocator_us, block_count, direct_us / allocator_us);
+	return 0;
+}
@@ -0,0 +1,96 @@
+// Vertex cache efficiency and speed of optimizeModel, on a single model
+// and on a batch of copies of it spread over all hardware threads.
+//
+// Usage: CorEngineMeshOptBench [file.obj]
+// Without arguments a grid mesh with shuffled triangles is generated in memory.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include "CorE/loaders.hpp"
+#include "CorE/mesh_processing.hpp"
+
+namespace
+{
+	Dim3::Model_3D makeShuffledGrid(int side)
+	{
+		Dim3::Model_3D model;
+		for (int y = 0; y <= side; y++)
+		{
+			for (int x = 0; x <= side; x++)
+			{
+				Dim3::Vertex_3D vertex{};
+				vertex.coord = { x * 0.01f, y * 0.01f, (x ^ y) * 0.001f };
+				model.vertices.push_back(vertex);
+			}
+		}
+
+		vec<arr<uint32_t, 3>> triangles;
+		for (int y = 0; y < side; y++)
+		{
+			for (int x = 0; x < side; x++)
+			{
+				const uint32_t a = y * (side + 1) + x;
+				const uint32_t c = a + side + 1;
+				triangles.push_back({ a, a + 1, c });
+				triangles.push_back({ a + 1, c + 1, c });
+			}
+		}
+		// Fixed seed, so that runs are comparable.
+		std::shuffle(triangles.begin(), triangles.end(), std::mt19937(42));
+
+		for (const arr<uint32_t, 3>& triangle : triangles)
+		{
+			model.indices.indices_32.insert(model.indices.indices_32.end(), triangle.begin(), triangle.end());
+		}
+		return model;
+	}
+
+	void print(const char* name, const MeshOptimizationReport& report, double seconds)
+	{
+		std::printf("%-22s ACMR %.3f -> %.3f  ATVR %.3f -> %.3f  (%.3f s)\n", name,
+			report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr, seconds);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Dim3::Model_3D source;
+	if (argc < 2)
+	{
+		source = makeShuffledGrid(500);
+	}
+	else
+	{
+		source = loadModelOBJ(argv[1]);
+		indexModel(source);
+	}
+	std::printf("%zu vertices, %zu triangles\n", source.vertices.size(), source.indices.size() / 3);
+
+	for (bool overdraw : { false, true })
+	{
+		MeshOptimizationProperties properties;
+		properties.optimize_overdraw = overdraw;
+
+		Dim3::Model_3D model = source;
+		auto start = std::chrono::steady_clock::now();
+		MeshOptimizationReport report = optimizeModel(model, properties);
+		auto end = std::chrono::steady_clock::now();
+		print(overdraw ? "cache + overdraw" : "cache", report, std::chrono::duration<double>(end - start).count());
+	}
+
+	constexpr size_t BATCH_SIZE = 16;
+	vec<Dim3::Model_3D> batch(BATCH_SIZE, source);
+	vec<Dim3::Model_3D*> pointers;
+	for (Dim3::Model_3D& model : batch)
+	{
+		pointers.push_back(&model);
+	}
+	auto start = std::chrono::steady_clock::now();
+	vec<MeshOptimizationReport> reports = optimizeModels(pointers);
+	auto end = std::chrono::steady_clock::now();
+	print("batch of 16, parallel", reports[0], std::chrono::duration<double>(end - start).count());
+	return 0;
+}
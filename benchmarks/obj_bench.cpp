@@ -0,0 +1,133 @@
+// Throughput of loadModelOBJ in MB/s, against a line-by-line
+// std::getline + std::stof loader like the one it replaced.
+//
+// Usage: CorEngineObjBench [file.obj]
+// Without arguments a synthetic grid mesh of about 200 MB is written to the temp directory.
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "CorE/loaders.hpp"
+
+namespace
+{
+	// Reference loader: one heap-allocated token vector per line, std::stof/stoi per token.
+	Dim3::Model_3D loadModelOBJLineByLine(const char* file_path)
+	{
+		Dim3::Model_3D model;
+		std::ifstream stream(file_path);
+		std::string line;
+		while (std::getline(stream, line))
+		{
+			std::istringstream tokens(line);
+			vec<str> parts;
+			str part;
+			while (tokens >> part)
+			{
+				parts.push_back(part);
+			}
+			if (parts.empty())
+			{
+				continue;
+			}
+			if (parts[0] == "v")
+			{
+				model.positions.push_back({ std::stof(parts[1]), std::stof(parts[2]), std::stof(parts[3]) });
+			}
+			else if (parts[0] == "vt")
+			{
+				model.tex_coords.push_back({ std::stof(parts[1]), std::stof(parts[2]) });
+			}
+			else if (parts[0] == "vn")
+			{
+				model.normals.push_back({ std::stof(parts[1]), std::stof(parts[2]), std::stof(parts[3]) });
+			}
+			else if (parts[0] == "f")
+			{
+				for (size_t i = 1; i < parts.size(); i++)
+				{
+					arr<int, 3> corner{ -1, -1, -1 };
+					size_t first = parts[i].find('/');
+					size_t second = parts[i].find('/', first + 1);
+					corner[0] = std::stoi(parts[i].substr(0, first)) - 1;
+					corner[1] = std::stoi(parts[i].substr(first + 1, second - first - 1)) - 1;
+					corner[2] = std::stoi(parts[i].substr(second + 1)) - 1;
+					model.faces.push_back(corner);
+				}
+			}
+		}
+		return model;
+	}
+
+	void writeGrid(const std::filesystem::path& path, int side)
+	{
+		std::ofstream out(path);
+		char line[128];
+		for (int y = 0; y <= side; y++)
+		{
+			for (int x = 0; x <= side; x++)
+			{
+				std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x * 0.01f, y * 0.01f, (x ^ y) * 0.001f);
+				out << line;
+				std::snprintf(line, sizeof(line), "vt %.6f %.6f\n", x / float(side), y / float(side));
+				out << line;
+			}
+		}
+		out << "vn 0.0000 0.0000 1.0000\n";
+		for (int y = 0; y < side; y++)
+		{
+			for (int x = 0; x < side; x++)
+			{
+				int a = y * (side + 1) + x + 1;
+				int b = a + 1;
+				int c = a + side + 1;
+				int d = c + 1;
+				std::snprintf(line, sizeof(line), "f %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b, d, d);
+				out << line;
+				std::snprintf(line, sizeof(line), "f %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, d, d, c, c);
+				out << line;
+			}
+		}
+	}
+
+	template <typename Load>
+	void measure(const char* name, const std::filesystem::path& path, Load load)
+	{
+		double megabytes = static_cast<double>(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+		auto start = std::chrono::steady_clock::now();
+		Dim3::Model_3D model = load(path.string().c_str());
+		auto end = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+		std::printf("%-14s %10.1f MB/s  (%zu positions, %zu triangles, %.2f s)\n", name, megabytes / seconds,
+			model.positions.size(), model.faces.size() / 3, seconds);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path path;
+	bool generated = argc < 2;
+	if (generated)
+	{
+		path = std::filesystem::temp_directory_path() / "corengine_obj_bench.obj";
+		writeGrid(path, 1200);
+	}
+	else
+	{
+		path = argv[1];
+	}
+
+	measure("line-by-line", path, loadModelOBJLineByLine);
+	measure("mmap, 1 thread", path, [](const char* p) { return loadModelOBJ(p, 1); });
+	measure("mmap, parallel", path, [](const char* p) { return loadModelOBJ(p); });
+
+	if (generated)
+	{
+		std::filesystem::remove(path);
+	}
+	return 0;
+}
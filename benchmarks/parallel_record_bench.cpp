@@ -0,0 +1,122 @@
+// Recording of a frame with many draws: straight into the primary command buffer,
+// versus split into secondary buffers by CommandBuffer::recordParallel on 1..N threads.
+// Every draw sets the state a real draw would, without drawing, so that no pipeline is needed.
+//
+// Usage: CorEngineParallelRecordBench [frames] [draws_per_frame] [grain]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "CorE/job_system.hpp"
+#include "vulkan_bench_context.hpp"
+
+namespace
+{
+	constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+
+	void recordDraws(VkCommandBuffer buffer, size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			const VkViewport viewport{ static_cast<float>(i % 64), 0.0f, 64.0f, 64.0f, 0.0f, 1.0f };
+			const VkRect2D scissor{ { 0, 0 }, { 64, 64 } };
+			vkCmdSetViewportWithCount(buffer, 1, &viewport);
+			vkCmdSetScissorWithCount(buffer, 1, &scissor);
+			vkCmdSetCullMode(buffer, (i & 1) ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE);
+			vkCmdSetDepthBias(buffer, static_cast<float>(i % 7), 0.0f, 1.0f);
+			vkCmdSetDepthCompareOp(buffer, VK_COMPARE_OP_LESS_OR_EQUAL);
+		}
+	}
+
+	double runFrames(bench::VulkanContext& context, int frames, unsigned int thread_count, size_t draw_count, size_t grain, bool parallel)
+	{
+		const VkDevice device = context.p_device->vk_handle;
+		CorE::JobSystem jobs(thread_count - 1);
+		CorE::CommandPoolManager pools(context.p_device.get(), context.p_queue_family, FRAMES_IN_FLIGHT, nullptr);
+
+		arr<VkFence, FRAMES_IN_FLIGHT> fences{};
+		VkFenceCreateInfo fence_info{};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		for (VkFence& fence : fences)
+		{
+			ensureVkSuccess(vkCreateFence(device, &fence_info, nullptr, &fence), "Failed to create fence.");
+		}
+
+		// Rendering without attachments, which is enough to execute secondaries in.
+		VkRenderingInfo rendering{};
+		rendering.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		rendering.flags = parallel ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0;
+		rendering.renderArea = { { 0, 0 }, { 64, 64 } };
+		rendering.layerCount = 1;
+		VkCommandBufferInheritanceRenderingInfo inherit_rendering{};
+		inherit_rendering.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+		inherit_rendering.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		double record_ms = 0.0;
+		for (int frame = 0; frame < frames; frame++)
+		{
+			pools.beginFrame();
+			const VkFence fence = fences[pools.getFrameIndex()];
+			ensureVkSuccess(vkResetFences(device, 1, &fence), "Failed to reset fence.");
+
+			auto start = std::chrono::steady_clock::now();
+			CorE::CommandBuffer* p_primary = pools.acquireBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+			p_primary->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr);
+			p_primary->beginRenderPass(&rendering);
+			if (parallel)
+			{
+				p_primary->recordParallel(&pools, &jobs, inherit_rendering, draw_count, grain,
+					[](CorE::CommandBuffer* p_buffer, size_t first, size_t last)
+				{
+					recordDraws(p_buffer->vk_handle, first, last);
+				});
+			}
+			else
+			{
+				recordDraws(p_primary->vk_handle, 0, draw_count);
+			}
+			p_primary->endRenderPass();
+			p_primary->end();
+			auto end = std::chrono::steady_clock::now();
+			record_ms += std::chrono::duration<double, std::milli>(end - start).count();
+
+			VkSubmitInfo submit_info{};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &p_primary->vk_handle;
+			ensureVkSuccess(vkQueueSubmit(context.queue, 1, &submit_info, fence), "Failed to submit.");
+			pools.endFrame(fence);
+		}
+
+		vkDeviceWaitIdle(device);
+		for (VkFence fence : fences)
+		{
+			vkDestroyFence(device, fence, nullptr);
+		}
+		return record_ms / frames;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int frames = argc > 1 ? std::atoi(argv[1]) : 200;
+	const size_t draw_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+	const size_t grain = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1024;
+	const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	bench::VulkanContext context;
+	std::printf("%d frames, %zu draws per frame, grain %zu\n", frames, draw_count, grain);
+
+	const double inline_ms = runFrames(context, frames, 1, draw_count, grain, false);
+	std::printf("primary only          %8.3f ms recording/frame\n", inline_ms);
+
+	for (unsigned int threads = 1; threads <= max_threads; threads++)
+	{
+		const double parallel_ms = runFrames(context, frames, threads, draw_count, grain, true);
+		std::printf("secondaries, %2u thr.  %8.3f ms recording/frame  %5.2fx\n",
+			threads, parallel_ms, inline_ms / parallel_ms);
+	}
+	return 0;
+}
@@ -0,0 +1,141 @@
+// Compilation of a frame render graph: G-buffer, lighting and post passes, plus a
+// debug pass nothing reads. Checks culling, barrier and batch counts and transient
+// aliasing against what the graph should give, then times RenderGraph::compile().
+// Memory requirements come from a fake query, so no device is needed.
+//
+// Usage: CorEngineRenderGraphBench [compiles]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "CorE/render_graph.hpp"
+
+namespace
+{
+	using namespace CorE::Graphics;
+
+	constexpr VkExtent2D EXTENT = { 1920, 1080 };
+
+	// Tightly packed texels in 64 KiB pages, which is about what desktop GPUs report.
+	VkMemoryRequirements queryMemory(const VkImageCreateInfo* p_image_info, const VkBufferCreateInfo* p_buffer_info)
+	{
+		constexpr VkDeviceSize PAGE = 65536;
+		if (p_buffer_info)
+		{
+			return { p_buffer_info->size, 256, 0x1 };
+		}
+		VkDeviceSize texel_size = 4;
+		if (p_image_info->format == VK_FORMAT_R16G16B16A16_SFLOAT)
+		{
+			texel_size = 8;
+		}
+		const VkDeviceSize size = VkDeviceSize(p_image_info->extent.width) * p_image_info->extent.height * texel_size;
+		return { (size + PAGE - 1) / PAGE * PAGE, PAGE, 0x1 };
+	}
+
+	struct FrameGraph
+	{
+		RenderGraph graph;
+		uint32_t debug_pass;
+	};
+
+	void buildFrame(FrameGraph& frame)
+	{
+		RenderGraph& graph = frame.graph;
+		const RenderImageDesc rgba8{ VK_FORMAT_R8G8B8A8_UNORM, EXTENT };
+		const RenderImageDesc rgba16f{ VK_FORMAT_R16G16B16A16_SFLOAT, EXTENT };
+		const RenderImageDesc depth32{ VK_FORMAT_D32_SFLOAT, EXTENT };
+
+		const uint32_t albedo = graph.createImage("albedo", rgba8);
+		const uint32_t normal = graph.createImage("normal", rgba8);
+		const uint32_t depth = graph.createImage("depth", depth32);
+		const uint32_t debug = graph.createImage("debug", rgba8);
+		const uint32_t hdr = graph.createImage("hdr", rgba16f);
+		const uint32_t bloom = graph.createImage("bloom", rgba16f);
+		// Acquired with a semaphore waited for in the color attachment output stage.
+		const uint32_t swapchain = graph.importImage("swapchain", VK_NULL_HANDLE, VK_NULL_HANDLE,
+			{ VK_FORMAT_B8G8R8A8_UNORM, EXTENT },
+			{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED },
+			{ VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR });
+		const VkClearValue clear{};
+
+		const uint32_t gbuffer = graph.addPass("gbuffer", nullptr);
+		graph.write(gbuffer, albedo, RenderAccess::ColorAttachment, &clear);
+		graph.write(gbuffer, normal, RenderAccess::ColorAttachment, &clear);
+		graph.write(gbuffer, depth, RenderAccess::DepthAttachment, &clear);
+
+		frame.debug_pass = graph.addPass("debug", nullptr);
+		graph.read(frame.debug_pass, depth, RenderAccess::DepthRead);
+		graph.write(frame.debug_pass, debug, RenderAccess::ColorAttachment, &clear);
+
+		const uint32_t lighting = graph.addPass("lighting", nullptr);
+		graph.read(lighting, albedo, RenderAccess::SampledGraphics);
+		graph.read(lighting, normal, RenderAccess::SampledGraphics);
+		graph.read(lighting, depth, RenderAccess::SampledGraphics);
+		graph.write(lighting, hdr, RenderAccess::ColorAttachment, &clear);
+
+		const uint32_t bloom_pass = graph.addPass("bloom", nullptr);
+		graph.read(bloom_pass, hdr, RenderAccess::SampledCompute);
+		graph.write(bloom_pass, bloom, RenderAccess::StorageWriteCompute);
+
+		const uint32_t composite = graph.addPass("composite", nullptr);
+		graph.read(composite, hdr, RenderAccess::SampledGraphics);
+		graph.read(composite, bloom, RenderAccess::SampledGraphics);
+		graph.write(composite, swapchain, RenderAccess::ColorAttachment);
+	}
+
+	bool check(const char* what, size_t value, size_t expected)
+	{
+		if (value != expected)
+		{
+			std::printf("validation FAILED, %s is %zu, expected %zu\n", what, value, expected);
+			return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int compiles = argc > 1 ? std::atoi(argv[1]) : 10000;
+
+	FrameGraph frame;
+	buildFrame(frame);
+	frame.graph.compile(queryMemory);
+	const CompiledGraph& compiled = frame.graph.getCompiled();
+
+	std::printf("%zu passes, %zu culled, %zu barriers in %zu batches\n", compiled.passes.size(),
+		compiled.culled_passes.size(), compiled.getBarrierCount(), compiled.getBatchCount());
+	std::printf("transient memory %.1f MiB, %.1f MiB without aliasing\n",
+		compiled.transient_size / 1048576.0, compiled.unaliased_size / 1048576.0);
+
+	// gbuffer: 3 transitions from undefined, plus the wait on the previous frame.
+	// lighting: 3 G-buffer transitions to sampled, hdr from undefined, plus the wait on the previous frame.
+	// bloom: hdr to sampled for compute and composite, bloom from undefined over G-buffer memory.
+	// composite: bloom to sampled, swapchain from undefined. Final: swapchain to present.
+	bool valid = check("culled pass count", compiled.culled_passes.size(), 1)
+		&& check("culled pass", compiled.culled_passes[0], frame.debug_pass)
+		&& check("pass count", compiled.passes.size(), 4)
+		&& check("barrier count", compiled.getBarrierCount(), 15)
+		&& check("batch count", compiled.getBatchCount(), 5);
+	if (valid && compiled.transient_size >= compiled.unaliased_size)
+	{
+		std::printf("validation FAILED, bloom does not share memory with the G-buffer\n");
+		valid = false;
+	}
+	if (!valid)
+	{
+		return 1;
+	}
+	std::printf("validation passed\n\n");
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < compiles; i++)
+	{
+		frame.graph.compile(queryMemory);
+	}
+	auto end = std::chrono::steady_clock::now();
+	std::printf("compile %8.2f us\n", std::chrono::duration<double, std::micro>(end - start).count() / compiles);
+	return 0;
+}
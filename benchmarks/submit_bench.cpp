@@ -0,0 +1,92 @@
+// Queue submission of a frame made of many passes: every pass submitted and
+// signaled on its own, versus all of them gathered by Queue and flushed at once.
+// Both track frames in flight on a timeline semaphore, without fences.
+//
+// Usage: CorEngineSubmitBench [frames] [passes_per_frame]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "vulkan_bench_context.hpp"
+
+namespace
+{
+	constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+
+	struct Result
+	{
+		double frame_us;
+		CorE::Queue::Stats stats;
+	};
+
+	Result runFrames(bench::VulkanContext& context, int frames, uint32_t pass_count, bool batched)
+	{
+		CorE::Queue* p_queue = context.p_queue;
+		CorE::Queue::Semaphore timeline(context.p_device.get(), VK_SEMAPHORE_TYPE_TIMELINE, 0);
+		CorE::CommandPoolManager pools(context.p_device.get(), context.p_queue_family, FRAMES_IN_FLIGHT, nullptr);
+		uint64_t timeline_value = 0;
+		p_queue->resetStats();
+
+		auto start = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			// Waits on the timeline, for the frame that used this slot last.
+			pools.beginFrame();
+			for (uint32_t pass = 0; pass < pass_count; pass++)
+			{
+				CorE::CommandBuffer* p_buffer = pools.acquireBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+				p_buffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr);
+				p_buffer->end();
+				p_queue->submitBuffers({ p_buffer });
+				if (!batched)
+				{
+					// As an engine that tracks every submit on its own would.
+					p_queue->signal(&timeline, ++timeline_value);
+					p_queue->flush();
+				}
+			}
+			if (batched)
+			{
+				p_queue->signal(&timeline, ++timeline_value);
+				p_queue->flush();
+			}
+			pools.endFrame(&timeline, timeline_value);
+		}
+		timeline.wait(timeline_value);
+		auto end = std::chrono::steady_clock::now();
+
+		vkDestroySemaphore(context.p_device->vk_handle, timeline.vk_handle, nullptr);
+		return { std::chrono::duration<double, std::micro>(end - start).count() / frames, p_queue->getStats() };
+	}
+
+	void print(const char* name, const Result& result, int frames)
+	{
+		std::printf("%-10s %9.2f us/frame  %7.2f submit calls/frame  %7.2f batches/frame  %7.2f buffers/frame\n",
+			name, result.frame_us,
+			static_cast<double>(result.stats.submit_calls) / frames,
+			static_cast<double>(result.stats.batches) / frames,
+			static_cast<double>(result.stats.command_buffers) / frames);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const int frames = argc > 1 ? std::atoi(argv[1]) : 2000;
+	const uint32_t pass_count = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 16;
+
+	bench::VulkanContext context;
+	std::printf("%d frames, %u passes per frame\n", frames, pass_count);
+
+	const Result separate = runFrames(context, frames, pass_count, false);
+	print("separate", separate, frames);
+	const Result batched = runFrames(context, frames, pass_count, true);
+	print("batched", batched, frames);
+	if (batched.stats.submit_calls >= separate.stats.submit_calls)
+	{
+		std::printf("validation FAILED, batching did not cut vkQueueSubmit2 calls\n");
+		return 1;
+	}
+	std::printf("batched is %.2fx faster\n", separate.frame_us / batched.frame_us);
+	return 0;
+}
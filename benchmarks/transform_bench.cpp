@@ -0,0 +1,116 @@
+// Throughput of batched transforms: positions held as x/y/z/w streams
+// transformed by one matrix, and pairwise products of matrix arrays.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include "CorE/batch.hpp"
+#include "CorE/simd.hpp"
+#include "CorE/short_type.hpp"
+
+namespace
+{
+	using CorE::math::simd::InstructionSet;
+	using CorE::math::simd::Kernels;
+
+	// Total work per measurement, so small batches are repeated enough times to be timed.
+	constexpr size_t WORK_PER_MEASURE = 50'000'000;
+
+	template <typename Op>
+	double transformsPerSecond(size_t count, Op op)
+	{
+		size_t repeats = WORK_PER_MEASURE / count;
+		if (repeats == 0)
+		{
+			repeats = 1;
+		}
+		auto start = std::chrono::steady_clock::now();
+		for (size_t r = 0; r < repeats; r++)
+		{
+			op();
+		}
+		auto end = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+		return static_cast<double>(count * repeats) / seconds;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	CorE::math::Mat4x4 mat;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			mat[i][j] = dist(rng);
+		}
+	}
+
+	const InstructionSet sets[] = { InstructionSet::Scalar, InstructionSet::SSE2,
+		InstructionSet::AVX2, InstructionSet::NEON };
+	float checksum = 0.0f;
+
+	std::printf("SoA vector transforms\n%-8s %12s %16s\n", "ISA", "count", "transforms/s");
+	for (size_t count : { size_t(1'000), size_t(100'000), size_t(10'000'000) })
+	{
+		vec<float> x(count), y(count), z(count), w(count, 1.0f);
+		for (size_t i = 0; i < count; i++)
+		{
+			x[i] = dist(rng);
+			y[i] = dist(rng);
+			z[i] = dist(rng);
+		}
+		vec<float> ox(count), oy(count), oz(count), ow(count);
+		const float* in[4] = { x.data(), y.data(), z.data(), w.data() };
+		float* out[4] = { ox.data(), oy.data(), oz.data(), ow.data() };
+
+		for (InstructionSet set : sets)
+		{
+			if (!CorE::math::simd::isSupported(set))
+			{
+				continue;
+			}
+			const Kernels& k = CorE::math::simd::getKernels(set);
+			double rate = transformsPerSecond(count, [&]() { k.transformStreams(&mat.val[0][0], in, out, count); });
+			checksum += ox[count / 2];
+			std::printf("%-8s %12zu %16.3e\n", k.name, count, rate);
+		}
+	}
+
+	// 10M matrix pairs would take almost 2 GB, so matrix batches stop at 1M.
+	std::printf("\nMatrix x matrix batches\n%-8s %12s %16s\n", "ISA", "count", "products/s");
+	for (size_t count : { size_t(1'000), size_t(100'000), size_t(1'000'000) })
+	{
+		vec<CorE::math::Mat4x4> lhs(count), rhs(count), out(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					lhs[i][r][c] = dist(rng);
+					rhs[i][r][c] = dist(rng);
+				}
+			}
+		}
+
+		for (InstructionSet set : sets)
+		{
+			if (!CorE::math::simd::isSupported(set))
+			{
+				continue;
+			}
+			const Kernels& k = CorE::math::simd::getKernels(set);
+			double rate = transformsPerSecond(count, [&]() { k.mulBatch(&lhs[0].val[0][0], &rhs[0].val[0][0], &out[0].val[0][0], count); });
+			checksum += out[count / 2][1][1];
+			std::printf("%-8s %12zu %16.3e\n", k.name, count, rate);
+		}
+	}
+
+	std::printf("\nactive: %s (checksum %f)\n", CorE::math::simd::active().name, checksum);
+	return 0;
+}
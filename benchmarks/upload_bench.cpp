@@ -0,0 +1,130 @@
+// Streaming through StagingUploader: the same amount of data as many small uploads
+// versus a few large ones, timed until the GPU finished the last copy.
+// Uploads use a dedicated transfer family where the device has one, the graphics queue otherwise.
+// After every submit, a graphics frame acquires the batches completed so far, and the
+// benchmark fails unless all uploads were acquired at the end.
+//
+// Usage: CorEngineUploadBench [total_mib] [ring_mib]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "CorE/staging.hpp"
+#include "vulkan_bench_context.hpp"
+
+namespace
+{
+	constexpr VkDeviceSize DESTINATION_SIZE = VkDeviceSize(64) << 20;
+	// Uploads submitted together, as a loader would submit a batch of assets.
+	constexpr VkDeviceSize BYTES_PER_SUBMIT = VkDeviceSize(4) << 20;
+	constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+
+	struct Result
+	{
+		double mib_per_second;
+		CorE::StagingUploader::Stats stats;
+		bool all_acquired;
+	};
+
+	Result run(bench::VulkanContext& context, CorE::DeviceMemoryAllocator& memory, VkBuffer destination,
+		const vec<char>& source, VkDeviceSize total_size, VkDeviceSize upload_size, VkDeviceSize ring_size)
+	{
+		CorE::StagingProperties props;
+		props.ring_size = ring_size;
+		CorE::StagingUploader uploader(context.p_device.get(), &memory, context.p_transfer_queue, context.p_queue, props);
+		CorE::Queue::Semaphore frame_timeline(context.p_device.get(), VK_SEMAPHORE_TYPE_TIMELINE, 0);
+		CorE::CommandPoolManager pools(context.p_device.get(), context.p_queue_family, FRAMES_IN_FLIGHT, nullptr);
+		uint64_t frame_value = 0;
+
+		// Graphics frame taking over completed batches, with queue family acquire barriers if families differ.
+		auto acquire_frame = [&]()
+		{
+			pools.beginFrame();
+			CorE::CommandBuffer* p_buffer = pools.acquireBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+			p_buffer->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr);
+			uploader.acquire(p_buffer);
+			p_buffer->end();
+			context.p_queue->submitBuffers({ p_buffer });
+			context.p_queue->signal(&frame_timeline, ++frame_value);
+			context.p_queue->flush();
+			pools.endFrame(&frame_timeline, frame_value);
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		VkDeviceSize since_submit = 0;
+		for (VkDeviceSize uploaded = 0; uploaded < total_size; uploaded += upload_size)
+		{
+			uploader.uploadBuffer(destination, uploaded % DESTINATION_SIZE, source.data(), upload_size);
+			since_submit += upload_size;
+			if (since_submit >= BYTES_PER_SUBMIT)
+			{
+				uploader.submit();
+				context.p_transfer_queue->flush();
+				acquire_frame();
+				since_submit = 0;
+			}
+		}
+		const uint64_t last = uploader.submit();
+		context.p_transfer_queue->flush();
+		uploader.getTimeline()->wait(last);
+		acquire_frame();
+		frame_timeline.wait(frame_value);
+		auto end = std::chrono::steady_clock::now();
+
+		vkDestroySemaphore(context.p_device->vk_handle, frame_timeline.vk_handle, nullptr);
+		const double seconds = std::chrono::duration<double>(end - start).count();
+		return { total_size / (1024.0 * 1024.0) / seconds, uploader.getStats(), uploader.isAcquired(last) };
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const VkDeviceSize total_size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 512) << 20;
+	const VkDeviceSize ring_size = (argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 32) << 20;
+
+	bench::VulkanContext context;
+	if (context.p_transfer_queue != context.p_queue)
+	{
+		std::printf("Uploads on transfer family %u, acquired by graphics family %u\n",
+			context.p_transfer_family->index, context.p_queue_family->index);
+	}
+	else
+	{
+		std::printf("Device has no transfer-only family, uploads on the graphics queue\n");
+	}
+	CorE::DeviceMemoryAllocator memory(context.p_device.get());
+
+	VkBufferCreateInfo buffer_info{};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = DESTINATION_SIZE;
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	CorE::DeviceAllocation* p_allocation;
+	const VkBuffer destination = memory.createBuffer(buffer_info, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &p_allocation);
+
+	const vec<VkDeviceSize> upload_sizes{ 4 << 10, 64 << 10, 1 << 20, 16 << 20 };
+	vec<char> source(upload_sizes.back(), 1);
+
+	std::printf("%llu MiB in total, %llu MiB ring\n",
+		static_cast<unsigned long long>(total_size >> 20), static_cast<unsigned long long>(ring_size >> 20));
+	for (VkDeviceSize upload_size : upload_sizes)
+	{
+		const Result result = run(context, memory, destination, source, total_size, upload_size, ring_size);
+		std::printf("%8llu KiB uploads  %9.1f MiB/s  %7llu uploads  %5llu batches  %5llu stalls\n",
+			static_cast<unsigned long long>(upload_size >> 10), result.mib_per_second,
+			static_cast<unsigned long long>(result.stats.uploads), static_cast<unsigned long long>(result.stats.batches),
+			static_cast<unsigned long long>(result.stats.stalls));
+		if (!result.all_acquired)
+		{
+			std::printf("validation FAILED, uploads were not acquired by the graphics queue\n");
+			vkDeviceWaitIdle(context.p_device->vk_handle);
+			memory.destroyBuffer(destination, p_allocation);
+			return 1;
+		}
+	}
+
+	vkDeviceWaitIdle(context.p_device->vk_handle);
+	memory.destroyBuffer(destination, p_allocation);
+	return 0;
+}
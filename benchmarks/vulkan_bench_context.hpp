@@ -0,0 +1,144 @@
+// Vulkan setup shared by benchmarks that need a device.
+// Runs on any Vulkan 1.3 driver, including lavapipe on machines without a GPU
+// (point VK_DRIVER_FILES to lvp_icd.x86_64.json to force it).
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+#include "CorE/core_manager.hpp"
+#include "CorE/host_allocator.hpp"
+
+namespace bench
+{
+	/*
+	 * Instance, first physical device and a logical device with a graphics queue, plus
+	 * a queue of a transfer-only family if the device has one.
+	 * Every Vulkan 1.2 and 1.3 feature the device supports is enabled,
+	 * and VK_EXT_shader_object if asked for.
+	 * Host memory of the device comes from host_allocator.
+	 */
+	struct VulkanContext
+	{
+		// Declared first, so that it outlives the device.
+		CorE::HostAllocator host_allocator;
+		CorE::PhysicalDevice* p_physical_device = nullptr;
+		uptr<CorE::LogicalDevice> p_device;
+		CorE::QueueFamily* p_queue_family = nullptr;
+		CorE::Queue* p_queue = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		// Queue of a transfer-only family, p_queue if the device has none.
+		CorE::QueueFamily* p_transfer_family = nullptr;
+		CorE::Queue* p_transfer_queue = nullptr;
+		VkPhysicalDeviceProperties properties{};
+
+		// shader_objects - Whether to enable VK_EXT_shader_object, for benchmarks that create shaders.
+		explicit VulkanContext(bool shader_objects = false)
+		{
+			VkApplicationInfo app_info{};
+			app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+			app_info.pApplicationName = "CorEngine benchmark";
+			app_info.pEngineName = "CorEngine";
+			app_info.apiVersion = VK_API_VERSION_1_3;
+			VkInstanceCreateInfo instance_info{};
+			instance_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+			instance_info.pApplicationInfo = &app_info;
+			ensureVkSuccess(vkCreateInstance(&instance_info, nullptr, &CorE::Application::instance),
+				"Failed to create instance.");
+			CorE::PhysicalDevice::enumerateAll();
+
+			p_physical_device = &CorE::Application::phys_devices[0];
+			vkGetPhysicalDeviceProperties(p_physical_device->vk_handle, &properties);
+			if (properties.apiVersion < VK_API_VERSION_1_3)
+			{
+				throw std::runtime_error("Benchmarks need a Vulkan 1.3 device.");
+			}
+
+			uint32_t family_index = UINT32_MAX;
+			for (CorE::QueueFamily& family : p_physical_device->queue_families)
+			{
+				if (family.props.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+				{
+					family_index = family.index;
+					break;
+				}
+			}
+			if (family_index == UINT32_MAX)
+			{
+				throw std::runtime_error("Device has no graphics queue.");
+			}
+			uint32_t transfer_index = family_index;
+			for (CorE::QueueFamily& family : p_physical_device->queue_families)
+			{
+				const VkQueueFlags flags = family.props.queueFlags;
+				if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+				{
+					transfer_index = family.index;
+					break;
+				}
+			}
+
+			VkPhysicalDeviceShaderObjectFeaturesEXT shader_object_features{};
+			shader_object_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT;
+			VkPhysicalDeviceVulkan13Features features_13{};
+			features_13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+			features_13.pNext = shader_objects ? &shader_object_features : nullptr;
+			VkPhysicalDeviceVulkan12Features features_12{};
+			features_12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+			features_12.pNext = &features_13;
+			VkPhysicalDeviceFeatures2 features{};
+			features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features.pNext = &features_12;
+			vkGetPhysicalDeviceFeatures2(p_physical_device->vk_handle, &features);
+			if (shader_objects && !shader_object_features.shaderObject)
+			{
+				throw std::runtime_error("Device does not support shader objects.");
+			}
+
+			const float priority = 1.0f;
+			VkDeviceQueueCreateInfo queue_infos[2]{};
+			for (VkDeviceQueueCreateInfo& queue_info : queue_infos)
+			{
+				queue_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+				queue_info.queueCount = 1;
+				queue_info.pQueuePriorities = &priority;
+			}
+			queue_infos[0].queueFamilyIndex = family_index;
+			queue_infos[1].queueFamilyIndex = transfer_index;
+			VkDeviceCreateInfo device_info{};
+			device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+			device_info.pNext = &features;
+			device_info.queueCreateInfoCount = transfer_index != family_index ? 2 : 1;
+			device_info.pQueueCreateInfos = queue_infos;
+			const char* shader_object_extension = VK_EXT_SHADER_OBJECT_EXTENSION_NAME;
+			if (shader_objects)
+			{
+				device_info.enabledExtensionCount = 1;
+				device_info.ppEnabledExtensionNames = &shader_object_extension;
+			}
+
+			p_device = std::make_unique<CorE::LogicalDevice>(p_physical_device, device_info, *host_allocator.getCallbacks());
+
+			// Taken after the device, which enumerates queue families again.
+			p_queue_family = &p_physical_device->queue_families[family_index];
+			p_queue = &p_queue_family->queues[0];
+			queue = p_queue->vk_handle;
+			p_transfer_family = &p_physical_device->queue_families[transfer_index];
+			p_transfer_queue = &p_transfer_family->queues[0];
+
+			std::printf("Device: %s\n", properties.deviceName);
+		}
+
+		~VulkanContext()
+		{
+			vkDeviceWaitIdle(p_device->vk_handle);
+			vkDestroyDevice(p_device->vk_handle, p_device->getAllocator());
+		}
+
+		VulkanContext(const VulkanContext&) = delete;
+		VulkanContext& operator=(const VulkanContext&) = delete;
+	};
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+
+#include "CorE/matrix.hpp"
+
+namespace CorE
+{
+	namespace math
+	{
+
+		/**
+		* Non-owning view of count 4-dimensional vectors stored as
+		* structure of arrays, i.e. as four separate x/y/z/w streams.
+		* Streams do not need to be aligned, but 32-byte aligned ones load faster.
+		*/
+		struct Vec4Streams
+		{
+			float* p_x = nullptr;
+			float* p_y = nullptr;
+			float* p_z = nullptr;
+			float* p_w = nullptr;
+
+			size_t count = 0;
+		};
+
+		/**
+		* Transforms every vector of the input streams by a single matrix.
+		* Processes 8 vectors per instruction on AVX2, 4 on SSE2/NEON.
+		*
+		* @param const Mat4x4& mat - Matrix to transform by.
+		* @param const Vec4Streams& in - Vectors to transform.
+		* @param const Vec4Streams& out - Receives transformed vectors. May be the same as in.
+		* Must hold at least in.count vectors.
+		*/
+		void transformBatch(const Mat4x4& mat, const Vec4Streams& in, const Vec4Streams& out);
+
+		/**
+		* Multiplies count pairs of matrices: p_out[i] = p_lhs[i] * p_rhs[i].
+		*
+		* @param const Mat4x4* p_lhs - Left-hand matrices.
+		* @param const Mat4x4* p_rhs - Right-hand matrices.
+		* @param Mat4x4* p_out - Receives products. May be the same as any of the inputs.
+		* @param size_t count - Number of matrices in every array.
+		*/
+		void multiplyBatch(const Mat4x4* p_lhs, const Mat4x4* p_rhs, Mat4x4* p_out, size_t count);
+
+	}
+}
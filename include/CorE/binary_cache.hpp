@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "CorE/file_mapping.hpp"
+#include "CorE/graphics.hpp"
+#include "CorE/short_type.hpp"
+
+///
+/// Device specific binaries on disk: shader object binaries of shader groups,
+/// and the pipeline cache. They are only valid for the exact device and driver
+/// they were saved on, which every file records and is checked against on load.
+///
+/// Layout (little-endian):
+///   BinaryFileHeader
+///   BinaryFileHeader::record_count BinaryRecord
+///   data blocks - one per record, 16-byte aligned
+///
+
+namespace CorE
+{
+	namespace Graphics
+	{
+		struct BinaryFileHeader
+		{
+			static constexpr char MAGIC[4] = { 'C', 'B', 'I', 'N' };
+			static constexpr uint32_t VERSION = 1;
+
+			char magic[4];
+			uint32_t version;
+
+			uint32_t vendor_id;
+			uint32_t device_id;
+			uint32_t driver_version;
+			// shaderBinaryVersion for shader binaries, 0 for the pipeline cache.
+			uint32_t binary_version;
+			uint8_t device_uuid[VK_UUID_SIZE];
+			uint8_t driver_uuid[VK_UUID_SIZE];
+			// shaderBinaryUUID for shader binaries, pipelineCacheUUID for the pipeline cache.
+			uint8_t binary_uuid[VK_UUID_SIZE];
+
+			// Key of the contents, e.g. of a shader group.
+			uint64_t key;
+			uint32_t record_count;
+			uint32_t reserved;
+			// Hash of all data blocks, to catch files damaged on disk, which drivers may not.
+			uint64_t data_hash;
+		};
+
+		// Data block of a file, e.g. binary of one stage.
+		struct BinaryRecord
+		{
+			// VkShaderStageFlagBits for shader binaries, 0 for the pipeline cache.
+			uint32_t stage;
+			uint32_t reserved;
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		/*
+		 * Persistent cache of device specific binaries of a device.
+		 *
+		 * Shader groups are created from SPIR-V once, after which binaries of their
+		 * stages are saved, and created as VK_SHADER_CODE_TYPE_BINARY_EXT on later runs,
+		 * which skips compilation in the driver. Groups are keyed by code, entry points,
+		 * specialization constants, flags and push constant ranges of their stages.
+		 * Set layouts are not part of the key, and must not change for the same code.
+		 *
+		 * The pipeline cache is loaded on creation, and should be handed to every pipeline
+		 * created on the device, then written back with savePipelineCache().
+		 *
+		 * Files of other devices or drivers, or damaged ones, are ignored and replaced.
+		 * Files are written aside and renamed over their target, so readers never see half of one.
+		 *
+		 * Thread-safe, except for savePipelineCache(), which must not run concurrently with itself.
+		 */
+		class BinaryCache
+		{
+		public:
+
+			// Counters of shader groups created since the cache was.
+			struct Stats
+			{
+				// Created from saved binaries.
+				uint64_t hits = 0;
+				// Created from code, then saved.
+				uint64_t misses = 0;
+				// Saved binaries the driver did not accept, e.g. after an update not changing its version.
+				uint64_t rejected = 0;
+			};
+
+			/**
+			* @param LogicalDevice* p_device - Device binaries are for.
+			* @param const char* cache_dir - Directory of cached binaries. Created if missing.
+			*/
+			BinaryCache(LogicalDevice* p_device, const char* cache_dir);
+			// Destroys the pipeline cache, without saving it.
+			~BinaryCache();
+
+			BinaryCache(const BinaryCache&) = delete;
+			BinaryCache& operator=(const BinaryCache&) = delete;
+
+			/**
+			* Creates a shader group, from saved binaries of its stages if there are any.
+			* Arguments are the ones of the ShaderGroup constructor. Stages that are binaries
+			* already are created as they are.
+			*/
+			uptr<ShaderGroup> createShaderGroup(const vec<ShaderGroup::Stage>& stages,
+				const vec<VkDescriptorSetLayout>& desc_set_layouts, const vec<VkPushConstantRange>& push_constant_ranges,
+				VkShaderCreateFlagsEXT flags = 0);
+
+			// Gets the pipeline cache, to create pipelines with.
+			VkPipelineCache getPipelineCache() const { return pipeline_cache; }
+			// Writes the pipeline cache to disk.
+			void savePipelineCache();
+
+			Stats getStats() const;
+
+		private:
+
+			// Fills a header of a file of this device.
+			BinaryFileHeader makeHeader(uint64_t key, const uint8_t* binary_uuid, uint32_t binary_version) const;
+			// Maps a file and checks it was written on this device for a key. Empty mapping if not.
+			MappedFile mapFile(const str& file_path, const BinaryFileHeader& expected, vec<BinaryRecord>& records) const;
+			void writeFile(const str& file_path, const BinaryFileHeader& header, const vec<BinaryRecord>& records,
+				const vec<const void*>& data) const;
+			// Gets path of a file keyed by its contents and this device.
+			str getPath(uint64_t key, const char* extension) const;
+
+			LogicalDevice* p_device;
+			str cache_dir;
+
+			VkPhysicalDeviceProperties device_props;
+			VkPhysicalDeviceIDProperties id_props;
+			VkPhysicalDeviceShaderObjectPropertiesEXT shader_object_props;
+			// Hash of everything identifying the device and driver.
+			uint64_t device_key;
+
+			VkPipelineCache pipeline_cache;
+
+			std::atomic<uint64_t> hits = 0;
+			std::atomic<uint64_t> misses = 0;
+			std::atomic<uint64_t> rejected = 0;
+		};
+	}
+}
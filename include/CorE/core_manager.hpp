@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
 #include <thread>
 
 #include "CorE/corengine.hpp"
@@ -26,12 +31,14 @@ namespace CorE
 	struct Queue;
 	struct Display;
 	struct CommandPool;
+	struct CommandPoolManager;
 	struct Semaphore;
 	struct PhysicalDevice;
 
 	namespace Graphics
 	{
 		struct Shader;
+		struct ShaderGroup;
 	}
 
 
@@ -104,8 +111,13 @@ namespace CorE
 		CommandPool(LogicalDevice* p_parent, QueueFamily* p_queue_family,
 			VkCommandPoolCreateFlagBits flags_bitmask, const VkAllocationCallbacks* p_allocator);
 
+		// Destroys the pool, and with it all of its command buffers.
 		~CommandPool();
 
+		// Owns a Vulkan handle and is registered in its device by address.
+		CommandPool(const CommandPool&) = delete;
+		CommandPool& operator=(const CommandPool&) = delete;
+
 		// Gets queue family of this pool.
 		QueueFamily getQueueFamily();
 
@@ -124,6 +136,8 @@ namespace CorE
 
 		// Flags specifying behavior of the pool and its buffers.
 		VkCommandPoolCreateFlags flags;
+		// Allocator the pool was created with, it must be destroyed with the same one.
+		const VkAllocationCallbacks* p_allocator;
 
 		// Pointer to a thread which owns this command pool.
 		std::thread::id thread_id;
@@ -145,19 +159,26 @@ namespace CorE
 		*
 		* @param PhysicalDevice* p_parent - A device to which create a connection.
 		* @param VkDeviceCreateInfo info - General info about device creation.
-		* @param VkAllocationCallbacks allocator - Allocator.
+		* @param VkAllocationCallbacks allocator - Allocator, e.g. from HostAllocator::getCallbacks().
+		* Zero-initialized callbacks select the allocator of the driver.
 		*
 		*/
 		LogicalDevice(PhysicalDevice* p_parent, VkDeviceCreateInfo info, VkAllocationCallbacks allocator);
 
+		// Gets callbacks the device was created with, nullptr for the allocator of the driver.
+		// Objects of the device should be created and destroyed with them too.
+		const VkAllocationCallbacks* getAllocator() const;
+
 
 		// Pointer to a parent struct.
 		PhysicalDevice* p_parent;
 		// Vulkan handle of this wrap.
 		VkDevice vk_handle;
+		// Kept by value, as devices are copied into PhysicalDevice::logical_devices.
+		VkAllocationCallbacks allocator;
 
-		// Command pools created with usage of this device.
-		vec<CommandPool> command_pools{};
+		// Command pools created with usage of this device, which are alive.
+		vec<CommandPool*> command_pools{};
 
 	}; // struct LogicalDevice
 
@@ -186,17 +207,66 @@ namespace CorE
 			// Gets the type of this semaphore.
 			VkSemaphoreType getType();
 
+			// Timeline only. Blocks until the value of this semaphore is at least value.
+			void wait(uint64_t value);
+			// Timeline only. Gets the current value, i.e. the last value the GPU signaled.
+			uint64_t getValue();
+
 			VkSemaphoreType type;
+			LogicalDevice* p_device;
 
 		};
 
+		// Counters of work a queue submitted, since the last resetStats().
+		struct Stats
+		{
+			// vkQueueSubmit2 calls.
+			uint64_t submit_calls = 0;
+			// Batches, i.e. VkSubmitInfo2 structs, over all calls.
+			uint64_t batches = 0;
+			uint64_t command_buffers = 0;
+		};
+
 		// Gets family of this queue.
 		QueueFamily getQueueFamily();
 		// Gets index of this queue in a family.
 		uint32_t getIndex();
 
-		// Submits command buffers to this queue.
-		void submitBuffers(std::vector<CommandBuffer> buffers, std::vector<VkSubmitFlags> flags); // TODO
+		/*
+		 * Work is not submitted right away. Buffers, waits and signals added over a frame are
+		 * gathered, and flush() hands them to the device with a single vkQueueSubmit2 call.
+		 * A batch only ends where it has to: before a wait that follows buffers, and after a signal.
+		 * Needs synchronization2, and timelineSemaphore for timeline semaphores.
+		 *
+		 * Like the Vulkan queue itself, none of it may be called from several threads at once.
+		 */
+
+		// Adds command buffers to be submitted by the next flush(), in the given order.
+		void submitBuffers(const std::vector<CommandBuffer*>& buffers);
+
+		/**
+		* Makes buffers added from now on wait for a semaphore.
+		*
+		* @param Semaphore* p_semaphore - Semaphore to wait for.
+		* @param uint64_t value - Value to wait for, ignored for binary semaphores.
+		* @param VkPipelineStageFlags2 stages - Stages that wait, earlier stages of the buffers may run before.
+		*/
+		void waitFor(Semaphore* p_semaphore, uint64_t value, VkPipelineStageFlags2 stages);
+
+		/**
+		* Signals a semaphore once buffers added so far are done.
+		*
+		* @param Semaphore* p_semaphore - Semaphore to signal.
+		* @param uint64_t value - Value to set, ignored for binary semaphores.
+		* @param VkPipelineStageFlags2 stages - Stages that must be done before the signal.
+		*/
+		void signal(Semaphore* p_semaphore, uint64_t value, VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+
+		// Submits everything added since the last flush. Does nothing if nothing was added.
+		void flush();
+
+		Stats getStats();
+		void resetStats();
 
 		// Pointer to a parent struct.
 		QueueFamily* p_parent;
@@ -211,6 +281,23 @@ namespace CorE
 
 		Queue(QueueFamily* p_parent);
 
+		// Work of a single VkSubmitInfo2, gathered until flush().
+		struct Batch
+		{
+			vec<VkSemaphoreSubmitInfo> waits;
+			vec<VkCommandBufferSubmitInfo> buffers;
+			vec<VkSemaphoreSubmitInfo> signals;
+		};
+
+		// Starts a new batch, reusing memory of an old one.
+		void startBatch();
+
+		vec<Batch> pending_batches;
+		// Batches beyond this one are left allocated, so that steady frames do not allocate.
+		size_t pending_count = 0;
+		vec<VkSubmitInfo2> submit_infos;
+		Stats stats;
+
 	}; // struct Queue
 
 
@@ -335,32 +422,77 @@ namespace CorE
 
 		// Begins render pass instance for this command buffer.
 		void beginRenderPass(VkRenderingInfo* p_info);
+		// Ends render pass instance of this command buffer.
+		void endRenderPass();
 
 		// Binds shaders to this command buffer.
 		void bindShader(Graphics::Shader* p_shader, VkShaderStageFlagBits stage);
+		// Binds all stages of a program with one command, unbinding stages it lacks.
+		void bindShaders(Graphics::ShaderGroup* p_group);
 
-		// Begins recording of a command buffer.
+		// Begins recording of a command buffer. Starts a new chain, as the old one was reset along with the buffer.
 		void begin(VkCommandBufferUsageFlags flags, VkCommandBufferInheritanceInfo* p_inherit_info);
 		// Ends recording of a command buffer.
 		void end();
 
-		// Adds one or more secondary command buffers.
+		// Adds one or more secondary command buffers to the end of the chain.
+		// They are executed in the given order, by a single command.
 		void chain(std::vector<CommandBuffer*> buffers);
 
+		/**
+		* Splits draws [0, draw_count) into ranges, records each range into a secondary command buffer
+		* on a job, then chains all of them to this buffer in range order.
+		* Range i always covers the same draws and always runs i-th, whichever thread recorded it,
+		* so the frame comes out the same no matter how jobs were scheduled.
+		*
+		* Must be called inside a render pass instance begun with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT.
+		* Secondary buffers inherit no state, so record must bind shaders and set dynamic state itself.
+		*
+		* @param CommandPoolManager* p_pools - Manager the secondary buffers are taken from, in its current frame.
+		* @param JobSystem* p_jobs - Job system to record on.
+		* @param const VkCommandBufferInheritanceRenderingInfo& rendering - Attachment formats and flags of the render pass instance.
+		* @param size_t draw_count - Number of draws.
+		* @param size_t grain - Largest number of draws in one secondary buffer. 0 for a buffer per thread.
+		* @param const std::function<...>& record - Records draws [first, last) into p_buffer, which is already begun.
+		* Called concurrently from several threads, must not throw.
+		*/
+		void recordParallel(CommandPoolManager* p_pools, JobSystem* p_jobs,
+			const VkCommandBufferInheritanceRenderingInfo& rendering, size_t draw_count, size_t grain,
+			const std::function<void(CommandBuffer* p_buffer, size_t first, size_t last)>& record);
+
 		CommandBuffer(VkCommandBuffer vk_handle, CommandPool* p_parent, uint32_t index);
 
 
-		void setViewportCounts(std::vector<VkViewport> viewports);
-		void setScissorCounts(std::vector<VkRect2D> scissors);
+		// Counters of dynamic state setters since the buffer was last begun.
+		struct StateStats
+		{
+			// Calls recorded into the buffer.
+			uint64_t emitted = 0;
+			// Calls dropped, as they set the state the buffer already had.
+			uint64_t elided = 0;
+		};
+
+		// Gets counters of dynamic state setters since the last begin().
+		StateStats getStateStats() const { return state_stats; }
+
+		// Forgets the dynamic state the buffer is known to have, so that every following setter is recorded.
+		// Needed after setting state or executing secondary buffers through raw Vulkan calls on vk_handle.
+		void invalidateState() { state_known = 0; }
+
+		// Dynamic state setters. Each one is only recorded if it changes the state
+		// last set in this buffer, since begin() or the last secondary buffers executed.
+		void setViewportCounts(std::span<const VkViewport> viewports);
+		void setScissorCounts(std::span<const VkRect2D> scissors);
 		void setRasterizerDiscardEnable(VkBool32 rasterizer_discard_enable);
-		void setVertexInput(std::vector<VkVertexInputBindingDescription2EXT> vertex_input_bindings,
-			std::vector<VkVertexInputAttributeDescription2EXT> vertex_input_attrib_descriptions);
+		void setVertexInput(std::span<const VkVertexInputBindingDescription2EXT> vertex_input_bindings,
+			std::span<const VkVertexInputAttributeDescription2EXT> vertex_input_attrib_descriptions);
 		void setPrimitiveTopology(VkPrimitiveTopology topology);
 		void setPrimitiveRestartEnable(VkBool32 primitive_restart_enable);
 		void setPatchControlPoints(uint32_t patch_control_points);
 		void setTessellationDomainOrigin(VkTessellationDomainOrigin domain_origin);
 		void setRasterizationSamples(VkSampleCountFlagBits rasterization_samples);
-		void setSampleMask(VkSampleCountFlagBits samples, std::vector<VkSampleMask> sample_masks);
+		// sample_masks holds one word per 32 samples.
+		void setSampleMask(VkSampleCountFlagBits samples, std::span<const VkSampleMask> sample_masks);
 		void setAlphaToCoverage(VkBool32 atc_enable);
 		void setAlphaToOne(VkBool32 ato_enable);
 		void setPolygonMode(VkPolygonMode mode);
@@ -374,6 +506,171 @@ namespace CorE
 		void setDepthBounds(float min_depth_bounds, float max_depth_bounds);
 		void setDepthBiasEnable(VkBool32 depth_bias_enable);
 		void setDepthBias(float depth_bias_constant, float depth_bias_clamp, float depth_bias_slope);
+
+	private:
+
+		// Bit of every piece of dynamic state in state_known.
+		enum StateBit : uint32_t
+		{
+			STATE_VIEWPORTS = 1u << 0,
+			STATE_SCISSORS = 1u << 1,
+			STATE_RASTERIZER_DISCARD = 1u << 2,
+			STATE_VERTEX_INPUT = 1u << 3,
+			STATE_PRIMITIVE_TOPOLOGY = 1u << 4,
+			STATE_PRIMITIVE_RESTART = 1u << 5,
+			STATE_PATCH_CONTROL_POINTS = 1u << 6,
+			STATE_DOMAIN_ORIGIN = 1u << 7,
+			STATE_RASTERIZATION_SAMPLES = 1u << 8,
+			STATE_SAMPLE_MASK = 1u << 9,
+			STATE_ALPHA_TO_COVERAGE = 1u << 10,
+			STATE_ALPHA_TO_ONE = 1u << 11,
+			STATE_POLYGON_MODE = 1u << 12,
+			STATE_LINE_WIDTH = 1u << 13,
+			STATE_CULL_MODE = 1u << 14,
+			STATE_FRONT_FACE = 1u << 15,
+			STATE_DEPTH_TEST = 1u << 16,
+			STATE_DEPTH_COMPARE_OP = 1u << 17,
+			STATE_DEPTH_WRITE = 1u << 18,
+			STATE_DEPTH_BOUNDS_TEST = 1u << 19,
+			STATE_DEPTH_BOUNDS = 1u << 20,
+			STATE_DEPTH_BIAS_ENABLE = 1u << 21,
+			STATE_DEPTH_BIAS = 1u << 22
+		};
+
+		// Last values set, only meaningful for the bits set in state_known.
+		struct ShadowState
+		{
+			vec<VkViewport> viewports;
+			vec<VkRect2D> scissors;
+			vec<VkVertexInputBindingDescription2EXT> vertex_bindings;
+			vec<VkVertexInputAttributeDescription2EXT> vertex_attribs;
+			VkSampleCountFlagBits mask_samples;
+			vec<VkSampleMask> sample_masks;
+			VkSampleCountFlagBits rasterization_samples;
+			VkPrimitiveTopology primitive_topology;
+			VkTessellationDomainOrigin domain_origin;
+			VkPolygonMode polygon_mode;
+			VkCullModeFlags cull_mode;
+			VkFrontFace front_face;
+			VkCompareOp depth_compare_op;
+			uint32_t patch_control_points;
+			VkBool32 rasterizer_discard;
+			VkBool32 primitive_restart;
+			VkBool32 alpha_to_coverage;
+			VkBool32 alpha_to_one;
+			VkBool32 depth_test;
+			VkBool32 depth_write;
+			VkBool32 depth_bounds_test;
+			VkBool32 depth_bias_enable;
+			float line_width;
+			arr<float, 2> depth_bounds;
+			arr<float, 3> depth_bias;
+		};
+
+		// Records value into shadow. Returns false, and counts the call as elided, if the buffer already has it.
+		template<typename T>
+		bool updateState(StateBit bit, T& shadow, const T& value);
+		// Same for state given as an array, compared bytewise. Shadows keep their capacity, so only grow once.
+		template<typename T>
+		bool updateState(StateBit bit, vec<T>& shadow, std::span<const T> values);
+
+		ShadowState shadow{};
+		uint32_t state_known = 0;
+		StateStats state_stats;
+	};
+
+	/*
+	 * Gives every recording thread a command pool of its own for each frame in flight,
+	 * so that threads never share a pool and never wait for each other to record.
+	 *
+	 * Pools of a frame slot are reset as a whole, once the fence or timeline value the
+	 * slot was last ended with is reached, and their command buffers are then handed out
+	 * again. Nothing is freed or allocated per frame once the pools warmed up.
+	 *
+	 * beginFrame() and endFrame() must be called from a single thread,
+	 * acquireBuffer() from any thread in between.
+	 * The device must be idle when the manager is destroyed.
+	 */
+	struct CommandPoolManager
+	{
+		/**
+		* @param LogicalDevice* p_device - Device to create pools on.
+		* @param QueueFamily* p_queue_family - Family all the buffers will be submitted to.
+		* @param uint32_t frames_in_flight - Number of frames that may be recorded or executed at once.
+		* @param const VkAllocationCallbacks* p_allocator - Custom memory allocator, may be nullptr.
+		*/
+		CommandPoolManager(LogicalDevice* p_device, QueueFamily* p_queue_family,
+			uint32_t frames_in_flight, const VkAllocationCallbacks* p_allocator);
+
+		CommandPoolManager(const CommandPoolManager&) = delete;
+		CommandPoolManager& operator=(const CommandPoolManager&) = delete;
+
+		// Starts a frame in the next slot. Waits until the GPU is done with what
+		// was last submitted from that slot, then resets all of its pools.
+		void beginFrame();
+
+		/**
+		* Gets a command buffer of the calling thread for the current frame.
+		* The buffer is not begun, and stays valid until the slot comes around again.
+		*
+		* @param VkCommandBufferLevel level - Primary or secondary.
+		*/
+		CommandBuffer* acquireBuffer(VkCommandBufferLevel level);
+
+		// Ends the current frame, which is retired once fence is signaled.
+		// The fence is only waited for, resetting it is left to the caller.
+		void endFrame(VkFence fence);
+		// Ends the current frame, which is retired once p_timeline reaches value.
+		void endFrame(Queue::Semaphore* p_timeline, uint64_t value);
+
+		// Gets slot of the current frame.
+		uint32_t getFrameIndex();
+		uint32_t getFramesInFlight();
+		// Gets number of command buffers allocated so far, over all threads and slots.
+		size_t getAllocatedCount();
+
+		// Pool of one thread for one frame slot, with buffers that are handed out in order.
+		struct FramePool
+		{
+			uptr<CommandPool> p_pool;
+			// Deques, so that buffers handed out keep their address when more are allocated.
+			std::deque<CommandBuffer> primaries;
+			std::deque<CommandBuffer> secondaries;
+			size_t used_primaries = 0;
+			size_t used_secondaries = 0;
+		};
+
+		struct ThreadPools
+		{
+			std::thread::id thread_id;
+			vec<FramePool> frames;
+		};
+
+		// What the GPU signals once it is done with a frame slot.
+		struct Retirement
+		{
+			VkFence fence = VK_NULL_HANDLE;
+			VkSemaphore timeline = VK_NULL_HANDLE;
+			uint64_t value = 0;
+		};
+
+		// Gets pools of the calling thread, created on first use.
+		ThreadPools* getThreadPools();
+
+		LogicalDevice* p_device;
+		QueueFamily* p_queue_family;
+		const VkAllocationCallbacks* p_allocator;
+
+		uint32_t frames_in_flight;
+		// Frames ended so far. The current frame uses slot frame_count % frames_in_flight.
+		uint64_t frame_count = 0;
+		vec<Retirement> retirements;
+
+		// Distinguishes managers in caches of threads, even if one is created where another was.
+		uint64_t id;
+		std::mutex threads_mutex;
+		vec<uptr<ThreadPools>> threads;
+		std::atomic<size_t> allocated_count = 0;
 	};
 
 	/**
@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include "CorE/short_type.hpp"
 
 namespace Dim2
@@ -21,12 +23,43 @@ namespace Dim3
 		arr<float, 2> tex_coord{};
 	};
 
+	// Index buffer of a triangulated model, three indices per triangle.
+	// Holds 16-bit indices if every index fits into them, 32-bit ones otherwise.
+	struct IndexBuffer_3D
+	{
+		vec<uint16_t> indices_16;
+		vec<uint32_t> indices_32;
+
+		// Checks whether indices are stored as 32-bit values.
+		bool isWide() const { return !indices_32.empty(); }
+		// Gets number of indices.
+		size_t size() const { return isWide() ? indices_32.size() : indices_16.size(); }
+		// Gets size of a single index in bytes.
+		size_t getStride() const { return isWide() ? sizeof(uint32_t) : sizeof(uint16_t); }
+		// Gets pointer to the raw index data.
+		const void* getData() const { return isWide() ? static_cast<const void*>(indices_32.data()) : indices_16.data(); }
+
+		uint32_t operator[](size_t i) const { return isWide() ? indices_32[i] : indices_16[i]; }
+	};
+
 	// 3-dimensional triangulated model.
 	struct Model_3D
 	{
+		// Interleaved unique vertices, ready to be uploaded.
+		// Loaders only fill raw attribute streams below, indexModel() builds these.
 		vec<Vertex_3D> vertices;
+		// Indices into vertices, built together with them.
+		IndexBuffer_3D indices;
+		// Triangle corners as zero-based (position, tex_coord, normal)
+		// index triplets, three corners per triangle.
+		// Attributes absent in the source are -1.
 		vec<arr<int, 3>> faces;
 
+		// Raw attribute streams, in the order of the source file.
+		vec<arr<float, 3>> positions;
+		vec<arr<float, 2>> tex_coords;
+		vec<arr<float, 3>> normals;
+
 		vec<Dim2::Texture_2D> textures;
 	};
 	
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "CorE/core_manager.hpp"
+#include "CorE/short_type.hpp"
+
+namespace CorE
+{
+
+	namespace detail
+	{
+		/*
+		 * Two-level segregated fit allocator of ranges [0, size).
+		 * Only offsets are handed out, memory itself is never touched, so it suits device memory.
+		 * Allocation and freeing are O(1): free ranges are binned by size, first by power of two,
+		 * then linearly into SL_COUNT bins per power, and a pair of bitmaps finds a fitting bin.
+		 * Neighbouring free ranges are merged as soon as they appear.
+		 *
+		 * Not thread-safe.
+		 */
+		class TlsfHeap
+		{
+		public:
+
+			static constexpr uint32_t INVALID_NODE = UINT32_MAX;
+
+			struct Allocation
+			{
+				VkDeviceSize offset;
+				// Identifies the range when freeing it.
+				uint32_t node;
+			};
+
+			explicit TlsfHeap(VkDeviceSize size);
+
+			// Returns an allocation with node INVALID_NODE if no free range fits.
+			Allocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+			void free(uint32_t node);
+
+			VkDeviceSize getSize() const { return size; }
+			VkDeviceSize getUsedSize() const { return used_size; }
+			// Gets size of the range node stands for.
+			VkDeviceSize getNodeSize(uint32_t node) const { return nodes[node].size; }
+			bool isEmpty() const { return used_size == 0; }
+
+		private:
+
+			static constexpr uint32_t SL_SHIFT = 5;
+			static constexpr uint32_t SL_COUNT = 1u << SL_SHIFT;
+			// Ranges below SL_COUNT bytes all go to the first level, one bin per size.
+			static constexpr uint32_t FL_COUNT = 64 - SL_SHIFT + 1;
+
+			// A range of the heap, free or used. Physical links order all ranges by offset,
+			// free links chain free ranges of the same bin.
+			struct Node
+			{
+				VkDeviceSize offset;
+				VkDeviceSize size;
+				uint32_t prev_physical = INVALID_NODE;
+				uint32_t next_physical = INVALID_NODE;
+				uint32_t prev_free = INVALID_NODE;
+				uint32_t next_free = INVALID_NODE;
+				bool is_free = false;
+			};
+
+			static void mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl);
+			uint32_t findFree(VkDeviceSize size);
+			void insertFree(uint32_t node);
+			void removeFree(uint32_t node);
+			// Cuts [offset, offset + size) of node off into a node of its own, which is returned.
+			uint32_t split(uint32_t node, VkDeviceSize size);
+			uint32_t createNode();
+			void releaseNode(uint32_t node);
+
+			VkDeviceSize size;
+			VkDeviceSize used_size = 0;
+
+			vec<Node> nodes;
+			// Nodes of nodes that are not in use, reused before nodes grows.
+			vec<uint32_t> spare_nodes;
+
+			uint64_t fl_bitmap = 0;
+			arr<uint32_t, FL_COUNT> sl_bitmaps{};
+			arr<arr<uint32_t, SL_COUNT>, FL_COUNT> free_heads;
+		};
+
+		struct MemoryBlock;
+		struct MemoryTypePool;
+	}
+
+	/*
+	 * Range of device memory handed out by DeviceMemoryAllocator.
+	 * The allocator owns it, pointers to it stay valid until it is freed,
+	 * even if defragmentation moves it to other memory.
+	 */
+	struct DeviceAllocation
+	{
+		VkDeviceMemory memory;
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint32_t memory_type;
+		// First byte of the allocation, if its memory is host visible. Blocks stay mapped all their life.
+		void* p_mapped;
+		// Left to the owner, e.g. to find the resource bound to the allocation when it is moved.
+		void* p_user_data = nullptr;
+
+		detail::MemoryBlock* p_block;
+		uint32_t heap_node;
+		// Position in the allocation list of the block.
+		uint32_t block_index;
+		// Alignment the allocation was made with, kept for moving it.
+		VkDeviceSize alignment;
+	};
+
+	/**
+	* Declares a set of properties to be used while creating a DeviceMemoryAllocator object.
+	*/
+	struct DeviceMemoryProperties
+	{
+		// Size of VkDeviceMemory blocks resources are sub-allocated from.
+		// Heaps smaller than 1 GiB get blocks of an eighth of their size, if that is less.
+		VkDeviceSize block_size = VkDeviceSize(64) << 20;
+		// Larger resources get a VkDeviceMemory of their own. 0 for half of block_size.
+		VkDeviceSize dedicated_threshold = 0;
+		// Set if the device supports VK_EXT_memory_budget. Otherwise budgets are estimated.
+		bool use_memory_budget = false;
+		// Set if the bufferDeviceAddress feature is enabled, so that blocks may back buffers used by address.
+		bool buffer_device_address = false;
+		// Custom host memory allocator for the driver, may be nullptr.
+		const VkAllocationCallbacks* p_allocator = nullptr;
+	};
+
+	// What a resource needs from its memory.
+	struct DeviceAllocationInfo
+	{
+		VkMemoryRequirements requirements;
+		// Flags the memory type must have.
+		VkMemoryPropertyFlags required_flags = 0;
+		// Flags the memory type should have. Types with more of them are tried first.
+		VkMemoryPropertyFlags preferred_flags = 0;
+		// Set for images with optimal tiling, which may not share a bufferImageGranularity page with linear resources.
+		bool optimal_image = false;
+		// Gives the resource a VkDeviceMemory of its own, as drivers prefer for e.g. large render targets.
+		bool dedicated = false;
+	};
+
+	// Memory use of a heap, in bytes.
+	struct HeapBudget
+	{
+		// VkDeviceMemory held by this allocator.
+		VkDeviceSize block_bytes = 0;
+		// Part of block_bytes handed out to resources.
+		VkDeviceSize allocation_bytes = 0;
+		// Memory used by the whole process, as the driver reports. block_bytes without VK_EXT_memory_budget.
+		VkDeviceSize usage = 0;
+		// Memory the process may use. 80% of the heap without VK_EXT_memory_budget.
+		VkDeviceSize budget = 0;
+	};
+
+	// An allocation that defragmentation moves, see DeviceMemoryAllocator::beginDefragmentation().
+	struct DefragmentationMove
+	{
+		DeviceAllocation* p_allocation;
+		// Where the contents go. Reserved until endDefragmentation().
+		VkDeviceMemory dst_memory;
+		VkDeviceSize dst_offset;
+		void* p_dst_mapped;
+
+		detail::MemoryBlock* p_dst_block;
+		uint32_t dst_node;
+	};
+
+	/*
+	 * Sub-allocates buffers and images from large VkDeviceMemory blocks, so that a scene
+	 * takes a few dozen vkAllocateMemory calls instead of one per resource, far below
+	 * maxMemoryAllocationCount. Every memory type has blocks of its own, each managed by a TlsfHeap.
+	 *
+	 * Images with optimal tiling are aligned and padded to bufferImageGranularity, so they
+	 * never share a granularity page with a linear resource, whatever their neighbours are.
+	 *
+	 * All methods are thread-safe. Memory types are locked separately.
+	 * The device must be idle when the allocator is destroyed.
+	 */
+	class DeviceMemoryAllocator
+	{
+	public:
+
+		DeviceMemoryAllocator(LogicalDevice* p_device, const DeviceMemoryProperties& props = {});
+
+		// Releases all blocks. Allocations still alive are released too.
+		~DeviceMemoryAllocator();
+
+		DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+		DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+		/**
+		* Allocates memory for a resource, from the first memory type with the required flags that has room,
+		* preferring types with more of the preferred flags and heaps within their budget.
+		*/
+		DeviceAllocation* allocate(const DeviceAllocationInfo& info);
+		void free(DeviceAllocation* p_allocation);
+
+		/**
+		* Creates a buffer and binds memory to it.
+		*
+		* @param const VkBufferCreateInfo& info - Creation info of the buffer.
+		* @param VkMemoryPropertyFlags required_flags - Flags the memory must have.
+		* @param VkMemoryPropertyFlags preferred_flags - Flags the memory should have.
+		* @param DeviceAllocation** pp_allocation - Receives the memory of the buffer.
+		*/
+		VkBuffer createBuffer(const VkBufferCreateInfo& info, VkMemoryPropertyFlags required_flags,
+			VkMemoryPropertyFlags preferred_flags, DeviceAllocation** pp_allocation);
+		// Creates an image and binds memory to it. See createBuffer().
+		VkImage createImage(const VkImageCreateInfo& info, VkMemoryPropertyFlags required_flags,
+			VkMemoryPropertyFlags preferred_flags, DeviceAllocation** pp_allocation);
+		void destroyBuffer(VkBuffer buffer, DeviceAllocation* p_allocation);
+		void destroyImage(VkImage image, DeviceAllocation* p_allocation);
+
+		// Makes host writes to [offset, offset + size) of an allocation visible to the device.
+		// Only needed for memory without VK_MEMORY_PROPERTY_HOST_COHERENT_BIT.
+		void flush(DeviceAllocation* p_allocation, VkDeviceSize offset, VkDeviceSize size);
+		// Makes device writes to [offset, offset + size) of an allocation visible to the host.
+		void invalidate(DeviceAllocation* p_allocation, VkDeviceSize offset, VkDeviceSize size);
+
+		HeapBudget getBudget(uint32_t heap_index);
+		// Gets number of VkDeviceMemory objects held.
+		size_t getBlockCount();
+
+		/**
+		* Plans moves of allocations out of the least used blocks into free room of fuller ones,
+		* so that the emptied blocks can be released. Destinations are reserved right away.
+		*
+		* To carry the moves out, copy the contents of every resource to its destination
+		* (e.g. with vkCmdCopyBuffer to a new resource bound there), then wait until the GPU
+		* is done with the old resources and call endDefragmentation().
+		* Moved allocations must not be freed before that.
+		*
+		* @param VkDeviceSize max_bytes - Largest number of bytes to move, to spread the work over frames.
+		*/
+		vec<DefragmentationMove> beginDefragmentation(VkDeviceSize max_bytes);
+		// Frees sources of the moves, points allocations to their destinations and releases empty blocks.
+		void endDefragmentation(const vec<DefragmentationMove>& moves);
+
+	private:
+
+		// Tries blocks of a memory type, creating one if none fits. Returns nullptr on failure.
+		DeviceAllocation* allocateFromType(uint32_t memory_type, VkDeviceSize size, VkDeviceSize alignment, bool dedicated);
+		detail::MemoryBlock* createBlock(detail::MemoryTypePool& pool, VkDeviceSize size, bool dedicated);
+		void destroyBlock(detail::MemoryTypePool& pool, detail::MemoryBlock* p_block);
+		// Releases empty blocks of a pool, keeping one to avoid churn.
+		void trimPool(detail::MemoryTypePool& pool);
+		void unlinkAllocation(DeviceAllocation* p_allocation);
+		VkMappedMemoryRange createAtomRange(DeviceAllocation* p_allocation, VkDeviceSize offset, VkDeviceSize size);
+
+		LogicalDevice* p_device;
+		DeviceMemoryProperties props;
+		VkPhysicalDeviceMemoryProperties memory_props;
+		VkDeviceSize buffer_image_granularity;
+		VkDeviceSize non_coherent_atom_size;
+
+		vec<uptr<detail::MemoryTypePool>> pools;
+
+		std::mutex heaps_mutex;
+		vec<HeapBudget> heap_budgets;
+	};
+
+}
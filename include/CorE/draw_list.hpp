@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "CorE/core_manager.hpp"
+#include "CorE/graphics.hpp"
+#include "CorE/job_system.hpp"
+#include "CorE/short_type.hpp"
+
+///
+/// Draw packets, sorted by 64-bit keys before they are recorded, so that
+/// packets sharing shaders, state and materials end up next to each other.
+///
+/// Layout of keys made by makeDrawKey(), from the most significant bit:
+///   layer 4 | shader group 12 | render state 8 | material 16 | depth 24
+///
+/// Layers are drawn in order, and within a layer the most expensive changes
+/// happen least often. makeDepthFirstDrawKey() moves depth right below the
+/// layer, for layers that must be drawn back to front, e.g. blended ones.
+///
+
+namespace CorE
+{
+	namespace Graphics
+	{
+		constexpr uint32_t DRAW_KEY_LAYER_BITS = 4;
+		constexpr uint32_t DRAW_KEY_SHADER_BITS = 12;
+		constexpr uint32_t DRAW_KEY_STATE_BITS = 8;
+		constexpr uint32_t DRAW_KEY_MATERIAL_BITS = 16;
+		constexpr uint32_t DRAW_KEY_DEPTH_BITS = 24;
+
+		/**
+		* Makes a key sorting by shader group, render state and material, then front to back.
+		* Fields are cut to their bits.
+		*
+		* @param uint32_t layer - Layer of the draw, lower layers are drawn first.
+		* @param uint32_t shader_group - ID of the shader group in the DrawList.
+		* @param uint32_t render_state - ID of the render state in the DrawList.
+		* @param uint32_t material - ID of the material in the DrawList.
+		* @param uint32_t depth - Depth quantized by quantizeDepth().
+		*/
+		constexpr uint64_t makeDrawKey(uint32_t layer, uint32_t shader_group, uint32_t render_state,
+			uint32_t material, uint32_t depth)
+		{
+			uint64_t key = layer & ((1u << DRAW_KEY_LAYER_BITS) - 1);
+			key = (key << DRAW_KEY_SHADER_BITS) | (shader_group & ((1u << DRAW_KEY_SHADER_BITS) - 1));
+			key = (key << DRAW_KEY_STATE_BITS) | (render_state & ((1u << DRAW_KEY_STATE_BITS) - 1));
+			key = (key << DRAW_KEY_MATERIAL_BITS) | (material & ((1u << DRAW_KEY_MATERIAL_BITS) - 1));
+			return (key << DRAW_KEY_DEPTH_BITS) | (depth & ((1u << DRAW_KEY_DEPTH_BITS) - 1));
+		}
+
+		// Same as makeDrawKey(), but sorting by depth first within the layer.
+		constexpr uint64_t makeDepthFirstDrawKey(uint32_t layer, uint32_t shader_group, uint32_t render_state,
+			uint32_t material, uint32_t depth)
+		{
+			uint64_t key = layer & ((1u << DRAW_KEY_LAYER_BITS) - 1);
+			key = (key << DRAW_KEY_DEPTH_BITS) | (depth & ((1u << DRAW_KEY_DEPTH_BITS) - 1));
+			key = (key << DRAW_KEY_SHADER_BITS) | (shader_group & ((1u << DRAW_KEY_SHADER_BITS) - 1));
+			key = (key << DRAW_KEY_STATE_BITS) | (render_state & ((1u << DRAW_KEY_STATE_BITS) - 1));
+			return (key << DRAW_KEY_MATERIAL_BITS) | (material & ((1u << DRAW_KEY_MATERIAL_BITS) - 1));
+		}
+
+		/**
+		* Quantizes a depth into DRAW_KEY_DEPTH_BITS, so that keys sort by it.
+		*
+		* @param float depth - Depth between 0 and 1, e.g. view depth divided by the far plane. Clamped.
+		* @param bool back_to_front - Whether far draws sort first.
+		*/
+		uint32_t quantizeDepth(float depth, bool back_to_front = false);
+
+		// Fixed-function state of draws, set with the dynamic state setters of CommandBuffer.
+		// State not in here, e.g. viewports, is left to the caller to set once.
+		struct RenderState
+		{
+			VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+			VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+			VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+			VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+			VkBool32 depth_test = VK_TRUE;
+			VkBool32 depth_write = VK_TRUE;
+			VkCompareOp depth_compare_op = VK_COMPARE_OP_LESS_OR_EQUAL;
+		};
+
+		// Resources bound for draws. Everything is optional.
+		struct Material
+		{
+			VkPipelineLayout layout = VK_NULL_HANDLE;
+			// Bound at first_set of layout, if not VK_NULL_HANDLE.
+			VkDescriptorSet set = VK_NULL_HANDLE;
+			uint32_t first_set = 0;
+			// Pushed at offset 0 of layout, if push_size is not 0. E.g. indices into a BindlessHeap.
+			VkShaderStageFlags push_stages = 0;
+			uint32_t push_size = 0;
+			arr<uint32_t, 4> push_data{};
+			// Bound if not VK_NULL_HANDLE, for indexed draws.
+			VkBuffer index_buffer = VK_NULL_HANDLE;
+			VkDeviceSize index_offset = 0;
+			VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+		};
+
+		// One draw, with IDs of what it is drawn with, as returned by DrawList.
+		struct DrawPacket
+		{
+			// Sort key, e.g. of makeDrawKey() with the IDs below.
+			uint64_t key;
+			uint16_t shader_group;
+			uint16_t render_state;
+			uint32_t material;
+
+			// Vertices, or indices if indexed.
+			uint32_t count;
+			uint32_t instance_count = 1;
+			// First vertex, or first index if indexed.
+			uint32_t first = 0;
+			// Added to indices, if indexed.
+			int32_t vertex_offset = 0;
+			uint32_t first_instance = 0;
+			VkBool32 indexed = VK_FALSE;
+		};
+
+		/*
+		 * List of draw packets, recorded in the order of their keys.
+		 *
+		 * Shader groups, render states and materials are registered once and referred to by ID.
+		 * While recording, shader groups and materials are only bound when their ID changes
+		 * from the previous packet. Render states go through the dynamic state setters of
+		 * CommandBuffer, which drop the pieces of state that did not change.
+		 *
+		 * sort() is a stable LSD radix sort, run on a JobSystem for large lists, so
+		 * packets with equal keys are recorded in the order they were added.
+		 *
+		 * Not thread-safe.
+		 */
+		class DrawList
+		{
+		public:
+
+			// Counts of what recording the list does, or would do.
+			struct Stats
+			{
+				uint64_t shader_binds = 0;
+				uint64_t state_changes = 0;
+				uint64_t material_binds = 0;
+				uint64_t draws = 0;
+			};
+
+			// Registers a shader group, returns its ID. Throws if the key has no room for more.
+			uint16_t addShaderGroup(ShaderGroup* p_group);
+			// Registers a render state, returns its ID. Throws if the key has no room for more.
+			uint16_t addRenderState(const RenderState& state);
+			// Registers a material, returns its ID. Throws if the key has no room for more.
+			uint32_t addMaterial(const Material& material);
+
+			// Adds a packet. It is recorded after the packets added before it, until sort() orders it by its key.
+			void add(const DrawPacket& packet);
+			// Removes all packets, keeping shader groups, render states and materials.
+			void clear();
+
+			/**
+			* Sorts packets by their keys.
+			*
+			* @param JobSystem* p_jobs - Job system to sort on, nullptr to sort on the calling thread.
+			*/
+			void sort(JobSystem* p_jobs = nullptr);
+
+			/**
+			* Records packets [first, last) of the sorted order into a command buffer inside a render pass instance,
+			* e.g. in the record function of CommandBuffer::recordParallel().
+			* Viewports, scissors and other state not in RenderState must be set beforehand.
+			*/
+			Stats record(CommandBuffer* p_buffer, size_t first, size_t last);
+			Stats record(CommandBuffer* p_buffer) { return record(p_buffer, 0, order.size()); }
+
+			// Counts what recording the list in its current order would do, without recording.
+			Stats countTransitions() const;
+
+			size_t size() const { return packets.size(); }
+
+		private:
+
+			// Packets are sorted by index, so that sorting moves 16 bytes per packet instead of a whole one.
+			struct SortEntry
+			{
+				uint64_t key;
+				uint64_t index;
+			};
+
+			vec<ShaderGroup*> shader_groups;
+			vec<RenderState> render_states;
+			vec<Material> materials;
+
+			vec<DrawPacket> packets;
+			// Indices of packets in the order they are recorded in.
+			vec<SortEntry> order;
+			vec<SortEntry> scratch;
+		};
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+
+namespace CorE
+{
+	/*
+	 * Read-only memory mapping of a whole file.
+	 * Pages are loaded by the OS on first access, nothing is copied.
+	 */
+	struct MappedFile
+	{
+		/**
+		* Maps a file into memory. Throws std::runtime_error if the file can not be opened or mapped.
+		*
+		* @param const char* file_path - Path of the file to map.
+		*/
+		MappedFile(const char* file_path);
+		// Constructs an empty mapping.
+		MappedFile() = default;
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		// Gets pointer to the first byte of the file. Is nullptr for empty files.
+		const char* getData() const;
+		// Gets size of the file in bytes.
+		size_t getSize() const;
+
+	private:
+
+		void close();
+
+		const char* p_data = nullptr;
+		size_t size = 0;
+
+		// Native handles, kept opaque so that system headers stay out of this header.
+		#if defined(_WIN32)
+		void* p_file_handle = nullptr;
+		void* p_mapping_handle = nullptr;
+		#else
+		int file_descriptor = -1;
+		#endif
+	};
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "CorE/core_manager.hpp"
+#include "CorE/device_memory.hpp"
+#include "CorE/graphics.hpp"
+#include "CorE/matrix.hpp"
+#include "CorE/shader_cache.hpp"
+#include "CorE/short_type.hpp"
+
+///
+/// GPU-driven drawing: objects live in a storage buffer, a compute shader
+/// (shaders/cull.slang) culls them against the view frustum and writes an
+/// indexed indirect draw per visible object, which vkCmdDrawIndexedIndirectCount
+/// then draws. Recording a frame costs the same whatever the number of objects.
+///
+/// cullObjects() is the CPU reference of the shader, doing the same math.
+///
+
+namespace CorE
+{
+	namespace Graphics
+	{
+		/*
+		 * Object as the cull shader reads it, 80 bytes with the layout of CullObject in cull.slang.
+		 * Draws of visible objects get firstInstance set to the index of their object,
+		 * so that vertex shaders can find their transform.
+		 */
+		struct CullObject
+		{
+			// Object to world transform, the first three rows of a row-major Mat4x4.
+			float rows[3][4];
+			// Bounding sphere in object space: center x, y, z and radius.
+			float sphere[4];
+
+			uint32_t index_count;
+			uint32_t first_index;
+			int32_t vertex_offset;
+			uint32_t reserved;
+
+			void setTransform(const math::Mat4x4& transform);
+		};
+
+		/*
+		 * Six planes (normal x, y, z, distance) with normals pointing inside:
+		 * left, right, bottom, top, near, far.
+		 */
+		struct Frustum
+		{
+			float planes[6][4];
+
+			// Extracts the planes of a view projection matrix, mapping to Vulkan clip space.
+			static Frustum fromMatrix(const math::Mat4x4& view_projection);
+		};
+
+		// Checks whether the bounding sphere of an object intersects a frustum, as the cull shader does.
+		bool isVisible(const CullObject& object, const Frustum& frustum);
+
+		/**
+		* CPU reference of the cull shader. Writes a draw per visible object, in object order.
+		*
+		* @param std::span<const CullObject> objects - Objects to cull.
+		* @param const Frustum& frustum - Frustum to cull against.
+		* @param vec<VkDrawIndexedIndirectCommand>& commands - Receives the draws. Cleared first.
+		* @returns Number of draws.
+		*/
+		uint32_t cullObjects(std::span<const CullObject> objects, const Frustum& frustum,
+			vec<VkDrawIndexedIndirectCommand>& commands);
+
+		/*
+		 * Culls objects on the GPU and draws the visible ones with a single indirect command.
+		 *
+		 * Objects are written into a host visible buffer with setObjects(), only when they change.
+		 * Every frame, cull() records the cull dispatch outside a render pass instance, and
+		 * draw() the draws inside one. Draws come in no particular order.
+		 *
+		 * Buffers are added to a BindlessHeap, whose set and push constants the shader uses,
+		 * so the heap needs at least 112 bytes of push constants visible to compute shaders.
+		 * The device needs the shaderObject, drawIndirectCount and drawIndirectFirstInstance features.
+		 *
+		 * cull() waits for draws of earlier frames on the same queue, so one culler serves
+		 * every frame. Objects are written by the host though, so setObjects() must not
+		 * change objects that a pending frame culls.
+		 *
+		 * Not thread-safe. The device must be idle when the culler is destroyed.
+		 */
+		class IndirectCuller
+		{
+		public:
+
+			// Threads of a workgroup of the cull shader.
+			static constexpr uint32_t GROUP_SIZE = 64;
+
+			/**
+			* @param LogicalDevice* p_device - Device to cull on.
+			* @param DeviceMemoryAllocator* p_memory - Allocator buffers are taken from.
+			* @param Descriptor::BindlessHeap* p_heap - Heap buffers are added to.
+			* @param const MappedShaderCode& cull_shader - Entry point cullMain of cull.slang, e.g. of loadShaderCached().
+			* @param uint32_t max_objects - Largest number of objects.
+			*/
+			IndirectCuller(LogicalDevice* p_device, DeviceMemoryAllocator* p_memory, Descriptor::BindlessHeap* p_heap,
+				const MappedShaderCode& cull_shader, uint32_t max_objects);
+			~IndirectCuller();
+
+			IndirectCuller(const IndirectCuller&) = delete;
+			IndirectCuller& operator=(const IndirectCuller&) = delete;
+
+			/**
+			* Writes objects into the object buffer. Command buffers pending must not cull them.
+			*
+			* @param uint32_t first - Index of the first object to write.
+			* @param std::span<const CullObject> objects - Objects to write.
+			*/
+			void setObjects(uint32_t first, std::span<const CullObject> objects);
+
+			/**
+			* Records culling of objects [0, object_count) into draws. Must be recorded outside a
+			* render pass instance. Binds the compute shader, and the heap for compute.
+			*
+			* @param CommandBuffer* p_buffer - Buffer being recorded.
+			* @param const Frustum& frustum - Frustum to cull against.
+			* @param uint32_t object_count - Number of objects to cull.
+			*/
+			void cull(CommandBuffer* p_buffer, const Frustum& frustum, uint32_t object_count);
+
+			// Records the draws of the last cull(). Graphics shaders, index buffer and state must be bound.
+			void draw(CommandBuffer* p_buffer);
+
+			// Buffer of VkDrawIndexedIndirectCommand, max_objects of them.
+			VkBuffer getCommandBuffer() const { return command_buffer; }
+			// Buffer of a single uint32_t, the number of draws.
+			VkBuffer getCountBuffer() const { return count_buffer; }
+			VkBuffer getObjectBuffer() const { return object_buffer; }
+			uint32_t getMaxObjects() const { return max_objects; }
+
+		private:
+
+			// Push constants of cull.slang.
+			struct CullConstants
+			{
+				Frustum frustum;
+				uint32_t object_count;
+				uint32_t objects_index;
+				uint32_t commands_index;
+				uint32_t count_index;
+			};
+
+			LogicalDevice* p_device;
+			DeviceMemoryAllocator* p_memory;
+			Descriptor::BindlessHeap* p_heap;
+			uint32_t max_objects;
+
+			uptr<ShaderGroup> p_shader;
+
+			VkBuffer object_buffer;
+			DeviceAllocation* p_object_allocation;
+			VkBuffer command_buffer;
+			DeviceAllocation* p_command_allocation;
+			VkBuffer count_buffer;
+			DeviceAllocation* p_count_allocation;
+
+			// Indices of the buffers in the storage buffer array of the heap.
+			uint32_t objects_index;
+			uint32_t commands_index;
+			uint32_t count_index;
+		};
+	}
+}
@@ -1,6 +1,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
 #include "CorE/core_manager.hpp"
 
 namespace CorE
@@ -8,6 +12,9 @@ namespace CorE
 	namespace Graphics
 	{
 
+		class LayoutCache;
+		struct MappedShaderCode;
+
 		/*
 		* A shader object specifies programmable operations that execute for each vertex,
 		* control point, tessellated vertex, primitive, fragment, or workgroup in the
@@ -20,6 +27,19 @@ namespace CorE
 				VkShaderStageFlags next_stage, VkShaderCodeTypeEXT code_type, size_t code_size,
 				const char* p_code, std::string name, std::vector<VkDescriptorSetLayout> desc_set_layouts,
 				std::vector<VkPushConstantRange> push_constant_ranges, VkSpecializationInfo p_spec_info);
+			/**
+			* Creates a shader from SPIR-V of the shader cache, e.g. of loadShaderCached().
+			*
+			* @param LogicalDevice* p_device - Device to create the shader on.
+			* @param const MappedShaderCode& code - Code, stage and entry point of the shader.
+			* @param VkShaderStageFlags next_stage - Stages that may follow this one.
+			* @param std::vector<VkDescriptorSetLayout> desc_set_layouts - Set layouts, e.g. of a LayoutCache.
+			* @param std::vector<VkPushConstantRange> push_constant_ranges - Push constant ranges.
+			* @param VkSpecializationInfo p_spec_info - Specialization constants.
+			*/
+			Shader(LogicalDevice* p_device, const MappedShaderCode& code, VkShaderStageFlags next_stage,
+				std::vector<VkDescriptorSetLayout> desc_set_layouts, std::vector<VkPushConstantRange> push_constant_ranges,
+				VkSpecializationInfo p_spec_info = {});
 			~Shader();
 
 			VkShaderEXT vk_handle;
@@ -29,6 +49,58 @@ namespace CorE
 
 		};
 
+		/*
+		 * All stages of one program, created by a single call and bound by a single command.
+		 *
+		 * Graphics stages of one code type are linked, which lets drivers optimize across them.
+		 * Binding a group binds every stage of its bind point, with the stages it lacks unbound,
+		 * so no stage of a previously bound program is left behind.
+		 *
+		 * Creating distinct groups is thread-safe, so programs may be created on worker threads.
+		 */
+		struct ShaderGroup
+		{
+
+			// Code of one stage of a group.
+			struct Stage
+			{
+				Stage() = default;
+				// Takes code of the shader cache, which must outlive creation of the group.
+				Stage(const MappedShaderCode& code, const VkSpecializationInfo* p_spec_info = nullptr);
+
+				VkShaderStageFlagBits stage;
+				VkShaderCodeTypeEXT code_type = VK_SHADER_CODE_TYPE_SPIRV_EXT;
+				const void* p_code;
+				size_t code_size;
+				str entry_point;
+				const VkSpecializationInfo* p_spec_info = nullptr;
+			};
+
+			/**
+			* @param LogicalDevice* p_device - Device to create the shaders on.
+			* @param const vec<Stage>& stages - Stages, either one compute stage or graphics ones, in any order.
+			* @param const vec<VkDescriptorSetLayout>& desc_set_layouts - Set layouts, shared by all stages.
+			* @param const vec<VkPushConstantRange>& push_constant_ranges - Push constant ranges, shared by all stages.
+			* @param VkShaderCreateFlagsEXT flags - Flags of all stages, on top of the link one.
+			*/
+			ShaderGroup(LogicalDevice* p_device, const vec<Stage>& stages, const vec<VkDescriptorSetLayout>& desc_set_layouts,
+				const vec<VkPushConstantRange>& push_constant_ranges, VkShaderCreateFlagsEXT flags = 0);
+			~ShaderGroup();
+
+			ShaderGroup(const ShaderGroup&) = delete;
+			ShaderGroup& operator=(const ShaderGroup&) = delete;
+
+			// Gets shader of a stage, VK_NULL_HANDLE if the group has none.
+			VkShaderEXT getShader(VkShaderStageFlagBits stage) const;
+
+			// Stages bound by the group, all of its bind point, in pipeline order.
+			vec<VkShaderStageFlagBits> stages;
+			// Shaders of stages, VK_NULL_HANDLE for those the group lacks.
+			vec<VkShaderEXT> vk_handles;
+			LogicalDevice* p_device;
+
+		};
+
 		/*
 		 * A descriptor is an opaque data structure representing a shader
 		 * resource such as a buffer, buffer view, image view, sampler, or 
@@ -50,14 +122,36 @@ namespace CorE
 			struct DescriptorSet
 			{
 
-				DescriptorSet(VkDescriptorSetLayoutCreateFlags flags, 
-					std::vector<VkDescriptorSetLayoutBinding> bindings);
-
-
+				/**
+				* @param LogicalDevice* p_device - Device to create the layout on.
+				* @param VkDescriptorSetLayoutCreateFlags flags - Flags of the layout.
+				* @param std::vector<VkDescriptorSetLayoutBinding> bindings - Bindings of the layout.
+				* @param std::vector<VkDescriptorBindingFlags> binding_flags - Flags of every binding, or empty for none.
+				*/
+				DescriptorSet(LogicalDevice* p_device, VkDescriptorSetLayoutCreateFlags flags, 
+					std::vector<VkDescriptorSetLayoutBinding> bindings,
+					std::vector<VkDescriptorBindingFlags> binding_flags = {});
+				/**
+				* Takes the layout from a cache, which keeps it, instead of creating one.
+				*
+				* @param LayoutCache* p_cache - Cache to look the layout up in.
+				* @param VkDescriptorSetLayoutCreateFlags flags - Flags of the layout.
+				* @param const std::vector<VkDescriptorSetLayoutBinding>& bindings - Bindings of the layout.
+				* @param const std::vector<VkDescriptorBindingFlags>& binding_flags - Flags of every binding, or empty for none.
+				*/
+				DescriptorSet(LayoutCache* p_cache, VkDescriptorSetLayoutCreateFlags flags,
+					const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+					const std::vector<VkDescriptorBindingFlags>& binding_flags = {});
+				~DescriptorSet();
+
+				DescriptorSet(const DescriptorSet&) = delete;
+				DescriptorSet& operator=(const DescriptorSet&) = delete;
 
 				std::vector<IDescriptor> descriptors;
 				VkDescriptorSetLayout vk_handle;
 				CorE::LogicalDevice* p_device;
+				// Cache owning vk_handle, nullptr if the set owns it.
+				LayoutCache* p_cache = nullptr;
 			};
 
 
@@ -74,6 +168,8 @@ namespace CorE
 			{
 				static constexpr VkDescriptorType type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 				
+				VkImageView image_view;
+				VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL;
 			};
 
 			/*
@@ -82,8 +178,9 @@ namespace CorE
 			*/
 			struct Sampler : IDescriptor
 			{
-				static constexpr VkDescriptorType type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				static constexpr VkDescriptorType type = VK_DESCRIPTOR_TYPE_SAMPLER;
 
+				VkSampler sampler;
 			};
 
 			/*
@@ -98,8 +195,10 @@ namespace CorE
 			*/
 			struct SampledImage : IDescriptor
 			{
-				static constexpr VkDescriptorType type = VK_DESCRIPTOR_TYPE_SAMPLER;
+				static constexpr VkDescriptorType type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
 
+				VkImageView image_view;
+				VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 			};
 
 			/*
@@ -163,6 +262,9 @@ namespace CorE
 			{
 				static constexpr VkDescriptorType type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 
+				VkBuffer buffer;
+				VkDeviceSize offset = 0;
+				VkDeviceSize range = VK_WHOLE_SIZE;
 			};
 
 			/*
@@ -174,6 +276,9 @@ namespace CorE
 			{
 				static constexpr VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 
+				VkBuffer buffer;
+				VkDeviceSize offset = 0;
+				VkDeviceSize range = VK_WHOLE_SIZE;
 			};
 
 			/*
@@ -272,6 +377,147 @@ namespace CorE
 
 			};
 
+			/**
+			* Declares a set of properties to be used while creating a BindlessHeap object.
+			* Counts are clamped to the update-after-bind limits of the device.
+			*/
+			struct BindlessProperties
+			{
+				uint32_t sampled_image_count = 1u << 16;
+				uint32_t storage_buffer_count = 1u << 16;
+				uint32_t sampler_count = 1u << 10;
+				// Stages the arrays and push constants are visible to.
+				VkShaderStageFlags stages = VK_SHADER_STAGE_ALL;
+				// Bytes of push constants of the pipeline layout, e.g. for indices of a draw.
+				uint32_t push_constant_size = 128;
+			};
+
+			/*
+			 * One descriptor set of large arrays of sampled images, storage buffers and samplers,
+			 * which every shader indexes into, in place of a set per draw.
+			 *
+			 * Descriptors are added once, when a resource is created, and keep their index in
+			 * the array until removed. The set is bound once per command buffer with bind(), draws
+			 * then only push indices of their resources, which makes recording a draw O(1).
+			 *
+			 * Arrays live in the bindings SAMPLED_IMAGE_BINDING, STORAGE_BUFFER_BINDING and
+			 * SAMPLER_BINDING of the set, shaders declare them as unsized arrays.
+			 * The set is update-after-bind, so descriptors may be added and updated while
+			 * command buffers it is bound in are pending, as long as they do not use them.
+			 *
+			 * The device must have been created with descriptor indexing enabled: runtime
+			 * descriptor arrays, partially bound descriptors, and update-after-bind of sampled
+			 * images, storage buffers, samplers and unused descriptors while pending.
+			 *
+			 * Thread-safe. The device must be idle when the heap is destroyed.
+			 */
+			class BindlessHeap
+			{
+			public:
+
+				static constexpr uint32_t SAMPLED_IMAGE_BINDING = 0;
+				static constexpr uint32_t STORAGE_BUFFER_BINDING = 1;
+				static constexpr uint32_t SAMPLER_BINDING = 2;
+
+				/**
+				* @param LogicalDevice* p_device - Device to create the heap on.
+				* @param const BindlessProperties& props - Properties of the heap.
+				*/
+				BindlessHeap(LogicalDevice* p_device, const BindlessProperties& props = {});
+				~BindlessHeap();
+
+				BindlessHeap(const BindlessHeap&) = delete;
+				BindlessHeap& operator=(const BindlessHeap&) = delete;
+
+				// Writes a descriptor into a free element of its array. Returns the index of it.
+				uint32_t add(const SampledImage& desc);
+				uint32_t add(const StorageBuffer& desc);
+				uint32_t add(const Sampler& desc);
+
+				// Overwrites a descriptor added before. Command buffers pending must not use it.
+				void update(uint32_t index, const SampledImage& desc);
+				void update(uint32_t index, const StorageBuffer& desc);
+				void update(uint32_t index, const Sampler& desc);
+
+				/**
+				* Frees an element of an array. It is handed out again only once the GPU is done with it.
+				*
+				* @param VkDescriptorType type - Type of the array, i.e. SampledImage::type, StorageBuffer::type or Sampler::type.
+				* @param uint32_t index - Index returned by add().
+				* @param uint64_t retire_value - Value passed to reclaim() once command buffers using
+				* the descriptor completed, e.g. of a frame timeline. 0 frees it at once.
+				*/
+				void remove(VkDescriptorType type, uint32_t index, uint64_t retire_value = 0);
+
+				// Frees elements removed with a retire value up to completed_value.
+				void reclaim(uint64_t completed_value);
+
+				/**
+				* Binds the set. Pipelines and shaders must be created with getPipelineLayout(),
+				* or with getSetLayout() as their first set and the same push constant range.
+				*
+				* @param CommandBuffer* p_buffer - Command buffer being recorded.
+				* @param VkPipelineBindPoint bind_point - Graphics or compute.
+				*/
+				void bind(CommandBuffer* p_buffer, VkPipelineBindPoint bind_point);
+
+				// Records push constants of the pipeline layout, e.g. indices of resources of the next draw.
+				void pushConstants(CommandBuffer* p_buffer, uint32_t offset, uint32_t size, const void* p_values);
+
+				VkDescriptorSetLayout getSetLayout() const { return p_layout->vk_handle; }
+				VkPipelineLayout getPipelineLayout() const { return pipeline_layout; }
+				VkPushConstantRange getPushConstantRange() const { return push_constant_range; }
+				// Gets number of elements of an array, after clamping to the limits of the device.
+				uint32_t getCapacity(VkDescriptorType type);
+				// Gets number of elements of an array in use, removed ones not reclaimed yet included.
+				uint32_t getUsedCount(VkDescriptorType type);
+
+			private:
+
+				// Free list of the elements of one binding.
+				struct IndexArray
+				{
+					uint32_t binding;
+					VkDescriptorType type;
+					uint32_t capacity;
+					// Elements from here on were never handed out.
+					uint32_t next_index = 0;
+					vec<uint32_t> free_indices;
+					// Whether each element handed out is in use, i.e. added and not removed since.
+					vec<bool> in_use;
+				};
+
+				// Element removed while command buffers may still use it.
+				struct Retirement
+				{
+					uint64_t value;
+					IndexArray* p_array;
+					uint32_t index;
+				};
+
+				IndexArray* getArray(VkDescriptorType type);
+				// Takes a free element of an array. Mutex must be locked.
+				uint32_t allocateIndex(IndexArray* p_array);
+				// Writes an element. Mutex must be locked, as the set is updated.
+				void write(IndexArray* p_array, uint32_t index, const VkDescriptorImageInfo* p_image_info,
+					const VkDescriptorBufferInfo* p_buffer_info);
+				// Throws if an element is not in use.
+				void checkIndex(IndexArray* p_array, uint32_t index);
+
+				LogicalDevice* p_device;
+				uptr<DescriptorSet> p_layout;
+				VkDescriptorPool pool;
+				VkDescriptorSet vk_set;
+				VkPushConstantRange push_constant_range;
+				VkPipelineLayout pipeline_layout;
+
+				std::mutex mutex;
+				IndexArray sampled_images;
+				IndexArray storage_buffers;
+				IndexArray samplers;
+				vec<Retirement> retirements;
+			};
+
 			/*  // Weidr thingy, by somewhat reason does not exist.
 			struct StorageTensor
 			{
@@ -284,5 +530,107 @@ namespace CorE
 
 		} // namespace Descriptor
 
+		namespace detail
+		{
+			/*
+			 * Open addressing hash table of layouts, keyed by their create infos packed into words.
+			 *
+			 * Lookups take no lock: entries are never changed once published, and tables replaced
+			 * by a larger one are kept until the table is destroyed, so readers may still probe them.
+			 * Inserts must be serialized by the owner.
+			 */
+			template<typename Handle>
+			class LayoutTable
+			{
+			public:
+
+				struct Entry
+				{
+					uint64_t hash;
+					vec<uint32_t> key;
+					Handle handle;
+				};
+
+				LayoutTable();
+
+				// Finds the handle of a key. VK_NULL_HANDLE if it was not inserted.
+				Handle find(uint64_t hash, const vec<uint32_t>& key) const;
+				// Inserts a key that is not in the table, growing it past half full.
+				void insert(uint64_t hash, const vec<uint32_t>& key, Handle handle);
+
+				const vec<uptr<Entry>>& getEntries() const { return entries; }
+
+			private:
+
+				struct Slots
+				{
+					size_t mask;
+					uptr<std::atomic<Entry*>[]> p_slots;
+				};
+
+				void place(Slots* p_table, Entry* p_entry);
+
+				std::atomic<Slots*> p_current;
+				vec<uptr<Slots>> tables;
+				vec<uptr<Entry>> entries;
+			};
+		} // namespace detail
+
+		/*
+		 * Creates descriptor set layouts and pipeline layouts once per distinct create info,
+		 * and hands the same handle to everyone asking for an identical one.
+		 *
+		 * As handles are unique per content, layouts compare equal exactly if their handles do,
+		 * e.g. to sort draws by them. Pipeline layouts are keyed by the handles of their set
+		 * layouts, which should come from the same cache for them to be shared.
+		 *
+		 * Thread-safe. Lookups of layouts created before take no lock, only creation does.
+		 * Layouts live until the cache is destroyed, which must happen once the device no longer uses them.
+		 */
+		class LayoutCache
+		{
+		public:
+
+			LayoutCache(LogicalDevice* p_device);
+			// Destroys all layouts.
+			~LayoutCache();
+
+			LayoutCache(const LayoutCache&) = delete;
+			LayoutCache& operator=(const LayoutCache&) = delete;
+
+			/**
+			* Gets a descriptor set layout, created on first request.
+			*
+			* @param VkDescriptorSetLayoutCreateFlags flags - Flags of the layout.
+			* @param const vec<VkDescriptorSetLayoutBinding>& bindings - Bindings, in any order.
+			* @param const vec<VkDescriptorBindingFlags>& binding_flags - Flags of every binding, or empty for none.
+			*/
+			VkDescriptorSetLayout getSetLayout(VkDescriptorSetLayoutCreateFlags flags,
+				const vec<VkDescriptorSetLayoutBinding>& bindings, const vec<VkDescriptorBindingFlags>& binding_flags = {});
+
+			/**
+			* Gets a pipeline layout, created on first request.
+			*
+			* @param const vec<VkDescriptorSetLayout>& set_layouts - Set layouts, in set order.
+			* @param const vec<VkPushConstantRange>& push_constant_ranges - Push constant ranges, in any order.
+			*/
+			VkPipelineLayout getPipelineLayout(const vec<VkDescriptorSetLayout>& set_layouts,
+				const vec<VkPushConstantRange>& push_constant_ranges);
+
+			// Gets number of distinct layouts created so far.
+			size_t getSetLayoutCount();
+			size_t getPipelineLayoutCount();
+			LogicalDevice* getDevice() const { return p_device; }
+
+		private:
+
+			LogicalDevice* p_device;
+
+			// Serializes creation of layouts, lookups go without it.
+			std::mutex mutex;
+			detail::LayoutTable<VkDescriptorSetLayout> set_layouts;
+			detail::LayoutTable<VkPipelineLayout> pipeline_layouts;
+		};
+
 	}// namespace Graphics
 }// namespace CorE
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CorE
+{
+	/**
+	* Computes a fast non-cryptographic 64-bit hash of a block of memory.
+	* Suitable for content-addressed caches, not for anything security-related.
+	*
+	* @param const void* p_data - Data to hash.
+	* @param size_t size - Size of the data in bytes.
+	* @param uint64_t seed - Initial value, allows chaining several blocks.
+	*/
+	uint64_t hashBytes(const void* p_data, size_t size, uint64_t seed = 0);
+
+	// Combines two hashes into one.
+	inline uint64_t hashCombine(uint64_t seed, uint64_t value)
+	{
+		return seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+	}
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "CorE/platform.hpp"
+#include "CorE/short_type.hpp"
+
+namespace CorE
+{
+
+	/*
+	 * Host memory allocator for the driver, to be plugged in through getCallbacks()
+	 * wherever a VkAllocationCallbacks* is taken.
+	 *
+	 * Requests up to MAX_CLASS_SIZE bytes, alignment and bookkeeping included, are served
+	 * from power of two size classes carved out of slabs. Every thread keeps a cache of free
+	 * slots per class, so the hot path neither locks nor calls malloc. Larger requests go to malloc.
+	 *
+	 * Counts and bytes are kept per VkSystemAllocationScope, to find out which objects
+	 * churn the driver heap, e.g. command scope allocations on every recorded frame.
+	 *
+	 * Thread-safe. Must outlive every object created with its callbacks.
+	 * Caches of threads that exited are kept until the allocator is destroyed.
+	 */
+	class HostAllocator
+	{
+	public:
+
+		static constexpr uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+		static constexpr size_t MIN_CLASS_SIZE = 32;
+		static constexpr size_t MAX_CLASS_SIZE = 8192;
+		static constexpr uint32_t CLASS_COUNT = 9;
+		// Memory taken from malloc at once to be cut into slots of a class.
+		static constexpr size_t SLAB_SIZE = 64 * 1024;
+
+		// Calls the driver made in one allocation scope since the last resetStats().
+		struct ScopeStats
+		{
+			uint64_t allocations = 0;
+			uint64_t reallocations = 0;
+			uint64_t frees = 0;
+			// Requested bytes, without alignment and bookkeeping.
+			uint64_t allocated_bytes = 0;
+			uint64_t freed_bytes = 0;
+			// Allocations that did not fit a size class and went to malloc.
+			uint64_t large_allocations = 0;
+			// Memory the driver allocated by itself and only reported, e.g. for executable code.
+			uint64_t internal_bytes = 0;
+		};
+
+		HostAllocator();
+		// Releases all slabs.
+		~HostAllocator();
+
+		HostAllocator(const HostAllocator&) = delete;
+		HostAllocator& operator=(const HostAllocator&) = delete;
+
+		// Gets callbacks to hand to Vulkan. They point to this allocator.
+		const VkAllocationCallbacks* getCallbacks() const { return &callbacks; }
+
+		ScopeStats getStats(VkSystemAllocationScope scope);
+		void resetStats();
+
+		// Gets bytes taken from malloc for slabs so far.
+		size_t getSlabBytes();
+
+	private:
+
+		// Slot of a size class, linked through its first bytes while free.
+		struct FreeSlot
+		{
+			FreeSlot* p_next;
+		};
+
+		// Counters written by one thread only, atomic so that getStats() may read them.
+		struct ThreadStats
+		{
+			std::atomic<uint64_t> allocations = 0;
+			std::atomic<uint64_t> reallocations = 0;
+			std::atomic<uint64_t> frees = 0;
+			std::atomic<uint64_t> allocated_bytes = 0;
+			std::atomic<uint64_t> freed_bytes = 0;
+			std::atomic<uint64_t> large_allocations = 0;
+			std::atomic<int64_t> internal_bytes = 0;
+		};
+
+		struct ThreadCache
+		{
+			std::thread::id thread_id;
+			arr<FreeSlot*, CLASS_COUNT> slots{};
+			arr<uint32_t, CLASS_COUNT> slot_counts{};
+			arr<ThreadStats, SCOPE_COUNT> stats;
+		};
+
+		// Slots shared by all threads.
+		struct ClassPool
+		{
+			std::mutex mutex;
+			FreeSlot* p_slots = nullptr;
+			uint32_t slot_count = 0;
+		};
+
+		static void* VKAPI_PTR allocation(void* p_user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+		static void* VKAPI_PTR reallocation(void* p_user_data, void* p_original, size_t size, size_t alignment,
+			VkSystemAllocationScope scope);
+		static void VKAPI_PTR free(void* p_user_data, void* p_memory);
+		static void VKAPI_PTR internalAllocation(void* p_user_data, size_t size, VkInternalAllocationType type,
+			VkSystemAllocationScope scope);
+		static void VKAPI_PTR internalFree(void* p_user_data, size_t size, VkInternalAllocationType type,
+			VkSystemAllocationScope scope);
+
+		// Gets memory with a header in front, which keeps size and scope for freeing. Stats are left to callers.
+		void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope, ThreadCache* p_cache);
+		void release(void* p_memory, ThreadCache* p_cache);
+		// Moves a batch of slots of a class from the shared pool, cutting a new slab if it is empty, into a cache.
+		void refill(ThreadCache* p_cache, uint32_t size_class);
+		// Moves half of the cached slots of a class back to the shared pool.
+		void drain(ThreadCache* p_cache, uint32_t size_class);
+		// Gets cache of the calling thread, created on first use.
+		ThreadCache* getThreadCache();
+
+		VkAllocationCallbacks callbacks;
+
+		arr<ClassPool, CLASS_COUNT> class_pools;
+		std::mutex slabs_mutex;
+		vec<void*> slabs;
+
+		// Distinguishes allocators in caches of threads, even if one is created where another was.
+		uint64_t id;
+		std::mutex threads_mutex;
+		vec<uptr<ThreadCache>> threads;
+	};
+
+}
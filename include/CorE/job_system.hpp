@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "CorE/short_type.hpp"
+
+namespace CorE
+{
+
+	/*
+	 * Unit of work of a JobSystem.
+	 * A job is finished when its function returned and all of its children are finished,
+	 * so a parent job doubles as a counter for a whole group of jobs.
+	 *
+	 * Jobs are allocated from a ring of JobSystem::MAX_JOBS_PER_THREAD jobs of the
+	 * creating thread, and reused once finished. Jobs still unfinished are skipped.
+	 */
+	struct alignas(64) Job
+	{
+		// Room for the captures of a job function.
+		static constexpr size_t DATA_SIZE = 88;
+
+		void (*p_function)(Job* p_job);
+		Job* p_parent;
+		// Itself plus unfinished children.
+		std::atomic<int32_t> unfinished;
+		alignas(std::max_align_t) unsigned char data[DATA_SIZE];
+
+		bool isFinished() const { return unfinished.load(std::memory_order_acquire) == 0; }
+	};
+
+	namespace detail
+	{
+		/*
+		 * Chase-Lev work-stealing deque of jobs, with a fixed capacity.
+		 * Only the owner thread may push and pop, at the bottom.
+		 * Any thread may steal, from the top.
+		 *
+		 * Memory orders follow Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models".
+		 */
+		class WorkStealingDeque
+		{
+		public:
+
+			static constexpr int64_t CAPACITY = 4096;
+
+			// Returns false if the deque is full.
+			bool push(Job* p_job);
+			Job* pop();
+			Job* steal();
+
+		private:
+
+			alignas(64) std::atomic<int64_t> top = 0;
+			alignas(64) std::atomic<int64_t> bottom = 0;
+			alignas(64) std::atomic<Job*> buffer[CAPACITY];
+		};
+
+		struct JobWorker;
+	}
+
+	/*
+	 * Fixed pool of worker threads, which run jobs and steal them from each other.
+	 * Every worker owns a lock-free deque. Jobs queued from threads outside the pool
+	 * go to a shared queue instead, which workers take from when their own deque is empty.
+	 *
+	 * Waiting for a job never blocks: the waiting thread runs other jobs meanwhile.
+	 * Idle workers spin shortly and then sleep until jobs are queued.
+	 */
+	class JobSystem
+	{
+	public:
+
+		static constexpr size_t MAX_JOBS_PER_THREAD = 4096;
+
+		/**
+		* Starts worker threads.
+		*
+		* @param unsigned int worker_count - Number of workers, 0 for one less than hardware
+		* threads, as the thread waiting for jobs runs them too.
+		*/
+		JobSystem(unsigned int worker_count = 0);
+
+		// Waits for workers to finish the jobs they are running. Jobs still queued are not run.
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		/**
+		* Creates a job, which does not run until passed to run().
+		*
+		* @param Function function - Callable without arguments. It is copied into the job, so it must be
+		* trivially copyable and destructible (e.g. a lambda capturing references and pointers) and fit Job::DATA_SIZE.
+		* @param Job* p_parent - Parent job, which is not finished before this one. Must not be finished yet.
+		* Throws if all MAX_JOBS_PER_THREAD jobs of this thread are unfinished.
+		*/
+		template <typename Function>
+		Job* createJob(Function function, Job* p_parent = nullptr)
+		{
+			Job* p_job = allocateJob(p_parent);
+			setFunction(p_job, function);
+			return p_job;
+		}
+
+		// Creates a job without function, to be used as parent of a group of jobs.
+		Job* createJob(Job* p_parent = nullptr);
+
+		// Queues a job. It is run right away if the queue of this thread is full.
+		void run(Job* p_job);
+
+		// Runs other jobs until p_job and all of its children are finished.
+		void wait(const Job* p_job);
+
+		/**
+		* Calls function(first, last) over [begin, end) split into ranges of about grain
+		* elements, which run in parallel, and waits for all of them.
+		* Ranges are split in halves recursively, so workers can steal large parts of the range.
+		*
+		* @param size_t begin - First index.
+		* @param size_t end - Index past the last one.
+		* @param size_t grain - Largest range a single call gets. 0 for a range per thread.
+		* @param const Function& function - Callable with (size_t first, size_t last).
+		*/
+		template <typename Function>
+		void parallelFor(size_t begin, size_t end, size_t grain, const Function& function)
+		{
+			if (begin >= end)
+			{
+				return;
+			}
+			if (grain == 0)
+			{
+				grain = (end - begin + getThreadCount() - 1) / getThreadCount();
+			}
+			if (end - begin <= grain)
+			{
+				function(begin, end);
+				return;
+			}
+
+			// Ranges are run here when the ring is full, so that a worker never throws.
+			Job* p_root = tryAllocateJob(nullptr);
+			if (!p_root)
+			{
+				for (size_t first = begin; first < end; first += grain)
+				{
+					function(first, std::min(first + grain, end));
+				}
+				return;
+			}
+			p_root->p_function = nullptr;
+			RangeJob<Function> range{ this, &function, begin, end, grain, p_root };
+			range();
+			run(p_root);
+			wait(p_root);
+		}
+
+		// Gets number of threads that run jobs, workers plus the waiting thread.
+		unsigned int getThreadCount() const;
+
+	private:
+
+		template <typename Function>
+		struct RangeJob
+		{
+			JobSystem* p_system;
+			const Function* p_function;
+			size_t begin;
+			size_t end;
+			size_t grain;
+			Job* p_parent;
+
+			void operator()() const
+			{
+				size_t last = end;
+				// Hands the upper halves out and keeps splitting the lower one.
+				while (last - begin > grain)
+				{
+					Job* p_job = p_system->tryAllocateJob(p_parent);
+					if (!p_job)
+					{
+						// Ring of this thread is full of unfinished jobs, the rest is run here.
+						break;
+					}
+					const size_t middle = begin + (last - begin) / 2;
+					setFunction(p_job, RangeJob{ p_system, p_function, middle, last, grain, p_parent });
+					p_system->run(p_job);
+					last = middle;
+				}
+				for (size_t first = begin; first < last; first += grain)
+				{
+					(*p_function)(first, std::min(first + grain, last));
+				}
+			}
+		};
+
+		template <typename Function>
+		static void setFunction(Job* p_job, const Function& function)
+		{
+			static_assert(sizeof(Function) <= Job::DATA_SIZE, "Job function captures too much, capture a pointer to a struct instead.");
+			static_assert(alignof(Function) <= alignof(std::max_align_t), "Job function is over-aligned.");
+			static_assert(std::is_trivially_copyable_v<Function> && std::is_trivially_destructible_v<Function>,
+				"Job function must be trivially copyable and destructible.");
+
+			::new (p_job->data) Function(function);
+			p_job->p_function = [](Job* p_self)
+			{
+				(*std::launder(reinterpret_cast<Function*>(p_self->data)))();
+			};
+		}
+
+		// Throws if the ring of this thread has no finished job.
+		Job* allocateJob(Job* p_parent);
+		// Returns nullptr if the ring of this thread has no finished job.
+		Job* tryAllocateJob(Job* p_parent);
+		void execute(Job* p_job);
+		void finish(Job* p_job);
+		Job* findJob(detail::JobWorker* p_worker);
+		void workerLoop(unsigned int index);
+		void wake();
+
+		vec<uptr<detail::JobWorker>> workers;
+		vec<std::thread> threads;
+
+		// Jobs queued from threads outside the pool.
+		std::mutex external_mutex;
+		vec<Job*> external_jobs;
+		std::atomic<size_t> external_count = 0;
+
+		std::mutex sleep_mutex;
+		std::condition_variable sleep_condition;
+		std::atomic<uint64_t> work_epoch = 0;
+		std::atomic<uint32_t> sleepers = 0;
+		std::atomic<bool> stopping = false;
+	};
+
+}
@@ -5,9 +5,14 @@
 
 /**
 * Loads 3-dimensional model vertex data from .obj file.
-* Note that non-triangle polygons are NOT supported.
-* 
+* The file is memory-mapped, split into newline-aligned chunks
+* and the chunks are parsed in parallel, one thread per chunk.
+* Polygons with more than 3 corners are split into triangle fans,
+* so only convex ones come out right.
+* Throws std::runtime_error if the file can not be read or is malformed.
+*
 * @param const char* file_path - Path of .obj file to load.
-* @returns A Model object.
+* @param unsigned int max_threads - Upper limit of parsing threads. 0 means one per hardware thread.
+* @returns A Model object with raw attribute streams and faces filled.
 */
-Dim3::Model_3D loadModelOBJ(const char* file_path);
\ No newline at end of file
+Dim3::Model_3D loadModelOBJ(const char* file_path, unsigned int max_threads = 0);
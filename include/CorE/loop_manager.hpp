@@ -1,12 +1,44 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <future>
+#include <mutex>
 #include "CorE/window_manager.hpp"
+#include "CorE/job_system.hpp"
 
 namespace CorE
 {
 
+	// How a Heart waits for the next frame when fps_cap is set.
+	enum class HeartPacing
+	{
+		// Busy-waits on the clock. Most precise, but burns a whole core.
+		Spin,
+		// Sleeps until the deadline. Cheapest, but frames start as late as the OS scheduler wants.
+		Sleep,
+		// Sleeps while the deadline is far, then spins for the last stretch.
+		// The stretch adapts to how much sleeps of this system overshoot.
+		Hybrid
+	};
+
+	// Average time a frame spends in each stage of a Heart, over the last second, in seconds.
+	struct HeartTimings
+	{
+		float input = 0;
+		// All update() calls of a frame together.
+		float update = 0;
+		float snapshot = 0;
+		float render = 0;
+		// Waiting for the frame deadline set by fps_cap.
+		float pacing = 0;
+		// Pipelined only. Simulation waiting for render to free a frame slot, i.e. render is the bottleneck.
+		float stall = 0;
+		// Pipelined only. Render waiting for a snapshot, i.e. simulation is the bottleneck.
+		float starve = 0;
+	};
+
 	/**
 	* Declares a set of properties to be used while creating a Heart object.
 	*
@@ -14,12 +46,36 @@ namespace CorE
 	*/
 	struct HeartProperties
 	{
+		// Frames per second to render at most, 0 for no limit.
 		unsigned int fps_cap = 60;
+		// Number of fixed steps update() is called with per second, regardless of frame rate.
+		unsigned int update_rate = 60;
+		// Updates done at most per frame. If the loop falls further behind, time is dropped
+		// rather than simulated, so that a slow frame can not cause even slower ones.
+		unsigned int max_updates_per_frame = 5;
+		HeartPacing pacing = HeartPacing::Hybrid;
+		// 1 runs render() right after updates, on the same thread. 2 or 3 pipeline frames:
+		// render() runs on its own thread, on a snapshot of frame N, while frame N+1 is simulated.
+		unsigned int frames_in_flight = 1;
+		// Job system that update() and render() may fan work out to.
+		// If null, the Heart creates its own, with a worker per hardware thread but one.
+		JobSystem* p_job_system = nullptr;
 	};
 
 	// This class represents an asynchronous rendering cycle.
 	// It must have at least one window attached.
-	// 
+	//
+	// Every frame calls input() once, update() as many times as fixed steps fit
+	// into the time passed, and render() once. Between two updates render() should
+	// blend states by getInterpolation(), which keeps motion smooth at any frame rate.
+	//
+	// With frames in flight, state is handed from simulation to render through slots:
+	// after the updates of a frame snapshot(slot) copies whatever render() needs into
+	// the given slot, and render() later reads the slot getRenderSlot() names. A slot
+	// is never written and read at the same time, so there is no locking in between.
+	//
+	// Derived classes must call stop() in their own destructor. The loop calls their
+	// overrides, so it has to be over before they are destroyed.
 	class Heart
 	{
 	public:
@@ -34,36 +90,79 @@ namespace CorE
 		// Note that starting it putting thread in which it was runned in a 100-millisecond sleep.
 		// This is done to prevent some inheritance bug, which is caused by vtables (I don't remember details, sorry).
 		void start();
+		// Stops the rendering cycle. Waits for the frame in progress, unless called
+		// from the loop itself, e.g. from update(), which can not wait for its own end.
 		void stop();
 
+		// Called at a fixed rate, getUpdateStep() seconds of simulation each time.
 		virtual void update();
 		virtual void input();
+		// Called once per frame, after snapshot(). Runs on a thread of its own if frames are pipelined.
 		virtual void render();
+		// Called after the updates of a frame, if frames are pipelined. Must copy everything
+		// render() reads into state slot number slot, which is less than getFramesInFlight().
+		virtual void snapshot(unsigned int slot);
 
 
+		// Gets time between starts of the last two frames, in seconds.
 		float getDelta();
 		unsigned int getFps();
 
+		// Gets duration of a single update() step, in seconds.
+		float getUpdateStep();
+		// Gets how far, from 0 to 1, the current time is between the last update and the next one.
+		float getInterpolation();
+		// Gets standard deviation of frame time over the last second, in seconds.
+		float getJitter();
+		HeartTimings getTimings();
+
+		unsigned int getFramesInFlight() const;
+		// Gets state slot the current render() call must read.
+		unsigned int getRenderSlot() const;
+
 		void setFpsCap(unsigned int cap);
 		unsigned int getFpsCap();
 
 		bool isRunning() const;
 
+		// Gets job system of this Heart, for spreading per-frame work over cores.
+		JobSystem* getJobSystem();
+
 	private:
 
 		void run();
+		void renderLoop();
 
-		std::future<void> async_call;
+		// Declared before async_call, so it outlives the loop thread.
+		uptr<JobSystem> owned_job_system;
+		JobSystem* p_job_system = nullptr;
 
-		bool is_running = false;
-		unsigned int fps_cap = 60;
-
-		unsigned int fps = 0;
-		float delta = 0;
-
-		unsigned const long NANOSECOND = 1000000000L;
-		const long FRAMERATE = 1000L;
-		const float FRAMETIME = 1.0f / FRAMERATE;
+		std::future<void> async_call;
+		std::future<void> render_call;
+
+		std::atomic<bool> is_running = false;
+		std::atomic<unsigned int> fps_cap = 60;
+		unsigned int update_rate = 60;
+		unsigned int max_updates_per_frame = 5;
+		HeartPacing pacing = HeartPacing::Hybrid;
+		unsigned int frames_in_flight = 1;
+
+		/// FRAME SLOTS ///
+		// Frames [frames_rendered, frames_written) are queued or being rendered.
+		std::mutex frame_mutex;
+		std::condition_variable frame_condition;
+		uint64_t frames_written = 0;
+		uint64_t frames_rendered = 0;
+		arr<float, 3> slot_interpolation{};
+		std::atomic<unsigned int> render_slot = 0;
+
+		std::mutex timings_mutex;
+		HeartTimings timings;
+
+		std::atomic<unsigned int> fps = 0;
+		std::atomic<float> delta = 0;
+		std::atomic<float> interpolation = 0;
+		std::atomic<float> jitter = 0;
 
 	};
 
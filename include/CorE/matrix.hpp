@@ -1,49 +1,391 @@
-
 #pragma once
 
+#include <cmath>
+#include <type_traits>
+
 #include "CorE/vector.hpp"
+#include "CorE/simd.hpp"
 
 namespace CorE
 {
 	namespace math
 	{
+		namespace detail
+		{
+			// Reduces an angle to [-pi, pi].
+			constexpr double reduceAngle(double x)
+			{
+				constexpr double two_pi = 6.283185307179586476925;
+				const double turns = x / two_pi;
+				const long long whole = static_cast<long long>(turns + (turns >= 0.0 ? 0.5 : -0.5));
+				return x - static_cast<double>(whole) * two_pi;
+			}
+
+			// Taylor series, only used in constant evaluation, where std::sin is not available.
+			constexpr double sinSeries(double x)
+			{
+				x = reduceAngle(x);
+				double term = x;
+				double sum = x;
+				for (int i = 1; i < 12; i++)
+				{
+					term *= -x * x / ((2.0 * i) * (2.0 * i + 1.0));
+					sum += term;
+				}
+				return sum;
+			}
+
+			// Taylor series, only used in constant evaluation, where std::cos is not available.
+			constexpr double cosSeries(double x)
+			{
+				x = reduceAngle(x);
+				double term = 1.0;
+				double sum = 1.0;
+				for (int i = 1; i < 12; i++)
+				{
+					term *= -x * x / ((2.0 * i - 1.0) * (2.0 * i));
+					sum += term;
+				}
+				return sum;
+			}
+
+			constexpr float sin(float x)
+			{
+				if (std::is_constant_evaluated())
+				{
+					return static_cast<float>(sinSeries(x));
+				}
+				return std::sin(x);
+			}
+
+			constexpr float cos(float x)
+			{
+				if (std::is_constant_evaluated())
+				{
+					return static_cast<float>(cosSeries(x));
+				}
+				return std::cos(x);
+			}
+
+			constexpr float tan(float x)
+			{
+				if (std::is_constant_evaluated())
+				{
+					return static_cast<float>(sinSeries(x) / cosSeries(x));
+				}
+				return std::tan(x);
+			}
+		} // namespace detail
+
 		// TODO - make a Mat class with ability to assign size upon creation.
 
-		struct Mat4x4
+		/*
+		 * 4x4 row-major float matrix, applied to column vectors (M * v).
+		 * Rows are 16-byte aligned, so each of them can be loaded into a single SIMD register.
+		 *
+		 * Everything except invert() is constexpr. In constant evaluation plain
+		 * loops are used, at runtime work goes to the SIMD kernels of CorE/simd.hpp.
+		 */
+		struct alignas(16) Mat4x4
 		{
 
 			float val[4][4];
 
-			Mat4x4();
+			// Constructs a zero matrix.
+			constexpr Mat4x4() noexcept : val{} {}
+
+			/////////////////////////
+			///      BUILDERS     ///
+			/////////////////////////
+
+			// Constructs an identity matrix.
+			static constexpr Mat4x4 identity() noexcept
+			{
+				Mat4x4 result;
+				for (int i = 0; i < 4; i++)
+				{
+					result.val[i][i] = 1.0f;
+				}
+				return result;
+			}
+
+			/**
+			* Constructs a perspective projection matrix from right-handed view space
+			* to Vulkan clip space (Y pointing down, depth in [0, 1]).
+			*
+			* @param float fov - Vertical field of view, in radians.
+			* @param float aspect_ratio - Width divided by height.
+			* @param float z_near - Distance to the near clip plane. Must be greater than zero.
+			* @param float z_far - Distance to the far clip plane.
+			*/
+			static constexpr Mat4x4 projection(float fov, float aspect_ratio, float z_near, float z_far) noexcept
+			{
+				const float focal = 1.0f / detail::tan(fov * 0.5f);
+
+				Mat4x4 result;
+				result.val[0][0] = focal / aspect_ratio;
+				result.val[1][1] = -focal;
+				result.val[2][2] = z_far / (z_near - z_far);
+				result.val[2][3] = z_near * z_far / (z_near - z_far);
+				result.val[3][2] = -1.0f;
+				return result;
+			}
+
+			// Constructs a translation matrix.
+			static constexpr Mat4x4 translation(Vec3 displace) noexcept
+			{
+				Mat4x4 result = identity();
+				result.val[0][3] = displace.x();
+				result.val[1][3] = displace.y();
+				result.val[2][3] = displace.z();
+				return result;
+			}
 
-			// Constructs a projection matrix from given values.
-			static Mat4x4& projection(float fov, float aspect_ratio, float z_near, float z_far);
-			// Constructs a transformation matrix from given values.
-			static Mat4x4& transformation(Vec3 scale, Vec3 rotate, Vec3 displace);
-			// Constructs an identity matrix
-			static Mat4x4& identity();
+			// Constructs a scaling matrix.
+			static constexpr Mat4x4 scaling(Vec3 scale) noexcept
+			{
+				Mat4x4 result;
+				result.val[0][0] = scale.x();
+				result.val[1][1] = scale.y();
+				result.val[2][2] = scale.z();
+				result.val[3][3] = 1.0f;
+				return result;
+			}
 
-			Mat4x4& multiplyNaive(Mat4x4& rhs) const;
-			Mat4x4& divideNaive(Mat4x4& rhs) const;
+			// Constructs a rotation matrix from Euler angles in radians.
+			// Rotation is applied around X, then Y, then Z, i.e. R = Rz * Ry * Rx.
+			static constexpr Mat4x4 rotation(Vec3 rotate) noexcept
+			{
+				return transformation(Vec3{ { 1.0f, 1.0f, 1.0f } }, rotate, Vec3{ { 0.0f, 0.0f, 0.0f } });
+			}
 
-			Mat4x4& T(); // transpose
-			//TODO - Mat4x4& invert();
+			/**
+			* Constructs a transformation matrix: T * R * S.
+			* The matrix is written directly, without multiplying the three of them.
+			*
+			* @param Vec3 scale - Scale along each axis.
+			* @param Vec3 rotate - Euler angles in radians, applied in X, Y, Z order.
+			* @param Vec3 displace - Translation.
+			*/
+			static constexpr Mat4x4 transformation(Vec3 scale, Vec3 rotate, Vec3 displace) noexcept
+			{
+				const float sx = detail::sin(rotate.x());
+				const float cx = detail::cos(rotate.x());
+				const float sy = detail::sin(rotate.y());
+				const float cy = detail::cos(rotate.y());
+				const float sz = detail::sin(rotate.z());
+				const float cz = detail::cos(rotate.z());
 
-			float* operator[](int column);
+				Mat4x4 result;
+				result.val[0][0] = cz * cy * scale.x();
+				result.val[0][1] = (cz * sy * sx - sz * cx) * scale.y();
+				result.val[0][2] = (cz * sy * cx + sz * sx) * scale.z();
+				result.val[0][3] = displace.x();
+
+				result.val[1][0] = sz * cy * scale.x();
+				result.val[1][1] = (sz * sy * sx + cz * cx) * scale.y();
+				result.val[1][2] = (sz * sy * cx - cz * sx) * scale.z();
+				result.val[1][3] = displace.y();
+
+				result.val[2][0] = -sy * scale.x();
+				result.val[2][1] = cy * sx * scale.y();
+				result.val[2][2] = cy * cx * scale.z();
+				result.val[2][3] = displace.z();
+
+				result.val[3][3] = 1.0f;
+				return result;
+			}
+
+			/////////////////////////
+			///     OPERATIONS    ///
+			/////////////////////////
+
+			// Element-wise product.
+			constexpr Mat4x4 multiplyNaive(const Mat4x4& rhs) const noexcept
+			{
+				Mat4x4 result;
+				for (int i = 0; i < 4; i++)
+				{
+					for (int j = 0; j < 4; j++)
+					{
+						result.val[i][j] = val[i][j] * rhs.val[i][j];
+					}
+				}
+				return result;
+			}
+
+			// Element-wise quotient.
+			constexpr Mat4x4 divideNaive(const Mat4x4& rhs) const noexcept
+			{
+				Mat4x4 result;
+				for (int i = 0; i < 4; i++)
+				{
+					for (int j = 0; j < 4; j++)
+					{
+						result.val[i][j] = val[i][j] / rhs.val[i][j];
+					}
+				}
+				return result;
+			}
+
+			// Transpose.
+			constexpr Mat4x4 T() const noexcept
+			{
+				Mat4x4 result;
+				if (std::is_constant_evaluated())
+				{
+					for (int i = 0; i < 4; i++)
+					{
+						for (int j = 0; j < 4; j++)
+						{
+							result.val[i][j] = val[j][i];
+						}
+					}
+				}
+				else
+				{
+					simd::active().transpose(&val[0][0], &result.val[0][0]);
+				}
+				return result;
+			}
+
+			/**
+			* Inverts this matrix.
+			*
+			* @param Mat4x4& out - Receives the inverse. Left untouched if this matrix is singular.
+			* @returns false if this matrix is singular.
+			*/
+			bool invert(Mat4x4& out) const noexcept;
+
+			constexpr float* operator[](int row) noexcept { return val[row]; }
+			constexpr const float* operator[](int row) const noexcept { return val[row]; }
 
 			// Matrix operators
-			Mat4x4& operator*(Mat4x4& rhs);
-			Mat4x4& operator+(Mat4x4& rhs);
-			Mat4x4& operator-(Mat4x4& rhs);
+			constexpr Mat4x4 operator*(const Mat4x4& rhs) const noexcept
+			{
+				Mat4x4 result;
+				if (std::is_constant_evaluated())
+				{
+					for (int i = 0; i < 4; i++)
+					{
+						for (int j = 0; j < 4; j++)
+						{
+							for (int k = 0; k < 4; k++)
+							{
+								result.val[i][j] += val[i][k] * rhs.val[k][j];
+							}
+						}
+					}
+				}
+				else
+				{
+					simd::active().mul(&val[0][0], &rhs.val[0][0], &result.val[0][0]);
+				}
+				return result;
+			}
+
+			constexpr Mat4x4 operator+(const Mat4x4& rhs) const noexcept
+			{
+				Mat4x4 result;
+				for (int i = 0; i < 4; i++)
+				{
+					for (int j = 0; j < 4; j++)
+					{
+						result.val[i][j] = val[i][j] + rhs.val[i][j];
+					}
+				}
+				return result;
+			}
+
+			constexpr Mat4x4 operator-(const Mat4x4& rhs) const noexcept
+			{
+				Mat4x4 result;
+				for (int i = 0; i < 4; i++)
+				{
+					for (int j = 0; j < 4; j++)
+					{
+						result.val[i][j] = val[i][j] - rhs.val[i][j];
+					}
+				}
+				return result;
+			}
 
 			// Scalar operators
-			Mat4x4& operator*(float& rhs);
-			Mat4x4& operator+(float& rhs);
-			Mat4x4& operator-(float& rhs);
+			constexpr Mat4x4 operator*(float rhs) const noexcept
+			{
+				Mat4x4 result;
+				for (int i = 0; i < 4; i++)
+				{
+					for (int j = 0; j < 4; j++)
+					{
+						result.val[i][j] = val[i][j] * rhs;
+					}
+				}
+				return result;
+			}
+
+			constexpr Mat4x4 operator+(float rhs) const noexcept
+			{
+				Mat4x4 result;
+				for (int i = 0; i < 4; i++)
+				{
+					for (int j = 0; j < 4; j++)
+					{
+						result.val[i][j] = val[i][j] + rhs;
+					}
+				}
+				return result;
+			}
+
+			constexpr Mat4x4 operator-(float rhs) const noexcept
+			{
+				Mat4x4 result;
+				for (int i = 0; i < 4; i++)
+				{
+					for (int j = 0; j < 4; j++)
+					{
+						result.val[i][j] = val[i][j] - rhs;
+					}
+				}
+				return result;
+			}
 
 			// Vector operators
-			Vec4& operator*(Vec4& rhs);
+			constexpr Vec4 operator*(const Vec4& rhs) const noexcept
+			{
+				Vec4 result{};
+				if (std::is_constant_evaluated())
+				{
+					for (int i = 0; i < 4; i++)
+					{
+						for (int j = 0; j < 4; j++)
+						{
+							result.val[i] += val[i][j] * rhs.val[j];
+						}
+					}
+				}
+				else
+				{
+					simd::active().mulVec(&val[0][0], rhs.val, result.val);
+				}
+				return result;
+			}
+
+			constexpr bool operator==(const Mat4x4& rhs) const noexcept
+			{
+				for (int i = 0; i < 4; i++)
+				{
+					for (int j = 0; j < 4; j++)
+					{
+						if (val[i][j] != rhs.val[i][j])
+						{
+							return false;
+						}
+					}
+				}
+				return true;
+			}
 
 		};
 	}
-}
\ No newline at end of file
+}
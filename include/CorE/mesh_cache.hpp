@@ -0,0 +1,113 @@
+#pragma once
+
+#include <span>
+#include <utility>
+
+#include "CorE/data_types.hpp"
+#include "CorE/file_mapping.hpp"
+
+///
+/// Binary mesh container, written once from an indexed Model_3D and loaded
+/// back by memory mapping, without parsing or copying.
+///
+/// Layout (little-endian):
+///   MeshFileHeader
+///   vertex block - vertex_count Vertex_3D, 16-byte aligned
+///   index block  - index_count indices of index_stride bytes, 16-byte aligned
+///
+
+namespace Dim3
+{
+	// Identifies the source a binary mesh was built from.
+	struct MeshSourceKey
+	{
+		// Last write time of the source, in file clock ticks.
+		int64_t mtime = 0;
+		// Size of the source in bytes.
+		uint64_t size = 0;
+		// Hash of the source contents.
+		uint64_t hash = 0;
+	};
+
+	struct MeshFileHeader
+	{
+		static constexpr char MAGIC[4] = { 'C', 'M', 'S', 'H' };
+		static constexpr uint32_t VERSION = 1;
+
+		char magic[4];
+		uint32_t version;
+
+		MeshSourceKey source;
+
+		uint64_t vertex_count;
+		uint64_t vertex_offset;
+		uint64_t index_count;
+		uint64_t index_offset;
+		uint32_t index_stride;
+		uint32_t reserved;
+
+		arr<float, 3> bounds_min;
+		arr<float, 3> bounds_max;
+	};
+
+	/*
+	 * Mesh mapped from a binary mesh file.
+	 * Vertices and indices point straight into the mapping
+	 * and stay valid as long as this object lives.
+	 */
+	struct MappedModel_3D
+	{
+		MappedModel_3D() = default;
+		explicit MappedModel_3D(CorE::MappedFile file) : file(std::move(file)) {}
+
+		CorE::MappedFile file;
+
+		MeshSourceKey source{};
+
+		std::span<const Vertex_3D> vertices;
+		// Only one of these is non-empty, depending on index size.
+		std::span<const uint16_t> indices_16;
+		std::span<const uint32_t> indices_32;
+
+		arr<float, 3> bounds_min{};
+		arr<float, 3> bounds_max{};
+	};
+
+	/**
+	* Writes an indexed model into a binary mesh file.
+	* The file is written next to the target and renamed over it, so
+	* readers never see a half-written mesh.
+	*
+	* @param const char* file_path - Path of the binary file.
+	* @param const Model_3D& model - Model to write. Must be indexed, see indexModel().
+	* @param const MeshSourceKey& source - Key of the source the model was loaded from.
+	*/
+	void writeMeshFile(const char* file_path, const Model_3D& model, const MeshSourceKey& source);
+
+	/**
+	* Maps a binary mesh file. Throws std::runtime_error if the file
+	* is not a valid mesh file of the current version.
+	*
+	* @param const char* file_path - Path of the binary file.
+	*/
+	MappedModel_3D mapMeshFile(const char* file_path);
+
+	/**
+	* Computes the key of a source file.
+	*
+	* @param const char* source_path - Path of the source file.
+	* @param bool with_hash - Whether to hash file contents, which requires reading the whole file.
+	*/
+	MeshSourceKey getSourceKey(const char* source_path, bool with_hash);
+
+	/**
+	* Loads an .obj model through the binary mesh cache.
+	* A cached mesh is used if its source size and write time match, or, if only the
+	* write time differs, if the contents hash matches. Otherwise the model is loaded
+	* with loadModelOBJ, indexed, written to the cache and mapped from there.
+	*
+	* @param const char* source_path - Path of the .obj file.
+	* @param const char* cache_dir - Directory of cached meshes. Created if missing.
+	*/
+	MappedModel_3D loadModelCached(const char* source_path, const char* cache_dir);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "CorE/data_types.hpp"
+
+/**
+* Builds an indexed mesh from the raw streams of a model, as filled by loadModelOBJ.
+* Every unique (position, tex_coord, normal) triplet of faces becomes a single
+* interleaved vertex in model.vertices, and model.indices gets three indices per
+* triangle. Indices are 16-bit when fewer than 65535 vertices are produced, so that
+* 0xFFFF stays free for primitive restart, and 32-bit otherwise.
+*
+* Triplets are deduplicated with an open-addressing hash table that is sized once,
+* from the number of corners, so time and memory grow linearly with the model.
+* Throws std::runtime_error if a face refers to an attribute that does not exist.
+*
+* @param Dim3::Model_3D& model - Model to index.
+* @param bool keep_raw - Whether to keep raw streams and faces. They are freed otherwise.
+*/
+void indexModel(Dim3::Model_3D& model, bool keep_raw = false);
+
+// Efficiency of an index buffer against a simulated FIFO post-transform vertex cache.
+struct VertexCacheStats
+{
+	// Average cache miss ratio, transformed vertices per triangle. Between 0.5 and 3, lower is better.
+	float acmr = 0.0f;
+	// Average transform to vertex ratio, transformed vertices per unique vertex. 1 is ideal.
+	float atvr = 0.0f;
+};
+
+struct MeshOptimizationProperties
+{
+	// Size of the FIFO cache ACMR and ATVR are measured against.
+	unsigned int stats_cache_size = 16;
+	// Whether to reorder triangle clusters front to back, to cut overdraw.
+	bool optimize_overdraw = false;
+	// Highest ACMR growth, as a factor, that the overdraw pass may cost. It is dropped otherwise.
+	float overdraw_threshold = 1.05f;
+};
+
+struct MeshOptimizationReport
+{
+	VertexCacheStats before;
+	VertexCacheStats after;
+};
+
+/**
+* Simulates a FIFO post-transform vertex cache over the index buffer of a model.
+*
+* @param const Dim3::Model_3D& model - Indexed model.
+* @param unsigned int cache_size - Number of vertices the simulated cache holds.
+*/
+VertexCacheStats analyzeVertexCache(const Dim3::Model_3D& model, unsigned int cache_size = 16);
+
+/**
+* Reorders an indexed model, as built by indexModel, for the GPU.
+* Triangles are reordered for post-transform vertex cache locality (Forsyth's
+* linear-speed algorithm), then optionally clustered front to back to cut overdraw,
+* and finally vertices are renumbered in order of first use for fetch locality.
+* Vertices no triangle refers to are dropped.
+*
+* The result only depends on the input, never on timing, so the same model
+* is always written out the same way.
+*
+* @param Dim3::Model_3D& model - Model to optimize.
+* @param const MeshOptimizationProperties& properties - Optimization settings.
+* @returns Vertex cache efficiency before and after.
+*/
+MeshOptimizationReport optimizeModel(Dim3::Model_3D& model, const MeshOptimizationProperties& properties = {});
+
+/**
+* Runs optimizeModel on several models at once, one model per thread.
+* Throws the first error met, after all threads have finished.
+*
+* @param const vec<Dim3::Model_3D*>& models - Models to optimize.
+* @param const MeshOptimizationProperties& properties - Optimization settings, shared by all models.
+* @param unsigned int max_threads - Thread limit, 0 for the number of hardware threads.
+* @returns One report per model, in the same order.
+*/
+vec<MeshOptimizationReport> optimizeModels(const vec<Dim3::Model_3D*>& models,
+	const MeshOptimizationProperties& properties = {}, unsigned int max_threads = 0);
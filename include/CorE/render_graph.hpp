@@ -0,0 +1,313 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "CorE/core_manager.hpp"
+#include "CorE/device_memory.hpp"
+#include "CorE/short_type.hpp"
+
+///
+/// Frame render graph. Passes declare the resources they read and write, and
+/// the graph works out everything between them: which passes are needed at all,
+/// the barriers from one pass to the next, render pass instances of passes with
+/// attachments, and which transient resources may share memory.
+///
+
+namespace CorE
+{
+	namespace Graphics
+	{
+		// Stages, accesses and layout a resource is in, e.g. when imported into a graph.
+		struct ResourceState
+		{
+			VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 access = VK_ACCESS_2_NONE;
+			VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		};
+
+		// How a pass uses a resource.
+		enum class RenderAccess : uint32_t
+		{
+			// Images only.
+			ColorAttachment,
+			DepthAttachment,
+			// Depth attachment that is tested against, but not written.
+			DepthRead,
+			SampledGraphics,
+			SampledCompute,
+
+			// Images and buffers.
+			StorageReadGraphics,
+			StorageReadCompute,
+			StorageWriteCompute,
+			TransferRead,
+			TransferWrite,
+
+			// Buffers only.
+			IndirectRead,
+			VertexRead,
+			IndexRead,
+			UniformRead
+		};
+
+		// Transient images are 2D, and get the usage of every access passes declare.
+		struct RenderImageDesc
+		{
+			VkFormat format;
+			VkExtent2D extent;
+			uint32_t mip_levels = 1;
+			uint32_t array_layers = 1;
+			VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		};
+
+		// Barriers recorded with a single vkCmdPipelineBarrier2.
+		struct BarrierBatch
+		{
+			// Images are set when the graph is executed.
+			vec<VkImageMemoryBarrier2> image_barriers;
+			// Resource of every image barrier.
+			vec<uint32_t> image_resources;
+			// Hazards of all buffers, merged, as buffers have no layouts to transition.
+			VkMemoryBarrier2 memory_barrier{};
+
+			bool hasMemoryBarrier() const { return memory_barrier.srcStageMask != 0 || memory_barrier.dstStageMask != 0; }
+			size_t getBarrierCount() const { return image_barriers.size() + (hasMemoryBarrier() ? 1 : 0); }
+			bool isEmpty() const { return getBarrierCount() == 0; }
+		};
+
+		// Pass that survived culling, with what is recorded around it.
+		struct CompiledPass
+		{
+			uint32_t pass;
+			// Recorded before the pass.
+			BarrierBatch barriers;
+
+			// Set if the pass has attachments, and is recorded in a render pass instance of them.
+			bool rendering = false;
+			VkExtent2D extent{};
+			// Image views are set when the graph is executed.
+			vec<VkRenderingAttachmentInfo> color_attachments;
+			vec<uint32_t> color_resources;
+			VkRenderingAttachmentInfo depth_attachment{};
+			uint32_t depth_resource = UINT32_MAX;
+		};
+
+		// Range of a transient heap a transient resource is bound to.
+		struct TransientPlacement
+		{
+			uint32_t resource;
+			uint32_t heap;
+			VkDeviceSize offset;
+			VkDeviceSize size;
+		};
+
+		// Memory shared by transient resources whose lifetimes do not overlap.
+		struct TransientHeap
+		{
+			VkDeviceSize size = 0;
+			VkDeviceSize alignment = 1;
+			uint32_t memory_type_bits = UINT32_MAX;
+			// Images and buffers get heaps of their own, so that they never share a bufferImageGranularity page.
+			bool images;
+		};
+
+		// Outcome of RenderGraph::compile(), for recording and for inspection.
+		struct CompiledGraph
+		{
+			// Passes to record, in order.
+			vec<CompiledPass> passes;
+			// Passes that were culled, as nothing needed their results.
+			vec<uint32_t> culled_passes;
+			// Recorded after the last pass, bringing imported resources into their final state.
+			BarrierBatch final_barriers;
+
+			vec<TransientPlacement> placements;
+			vec<TransientHeap> heaps;
+			// Memory of all transient heaps, the peak transient memory of the frame.
+			VkDeviceSize transient_size = 0;
+			// Memory transient resources would take without aliasing.
+			VkDeviceSize unaliased_size = 0;
+
+			// Gets number of barriers over all batches. Merged buffer barriers count once per batch.
+			size_t getBarrierCount() const;
+			// Gets number of vkCmdPipelineBarrier2 calls.
+			size_t getBatchCount() const;
+		};
+
+		/*
+		 * Graph of the passes of a frame and the resources they use.
+		 *
+		 * Passes run in the order they are added, each reading resources written by
+		 * passes before it. Resources are either transient, created and owned by the
+		 * graph, or imported, e.g. swapchain images, which keep their contents
+		 * beyond the frame and are left in a final state.
+		 *
+		 * compile():
+		 *  - culls passes whose writes nothing reads, unless they write imported
+		 *    resources or have side effects,
+		 *  - computes barriers, at most one batch per pass. A write is made visible to
+		 *    all the reads following it by a single barrier, and reads in the same layout
+		 *    need none between them,
+		 *  - places transient resources in heaps, so that resources whose lifetimes
+		 *    do not overlap share memory.
+		 * allocate() then creates transient resources and execute() records the frame.
+		 * A compiled graph may be executed every frame, with imported resources
+		 * swapped in with setImported(). Executions recorded into the same queue may
+		 * overlap on the GPU: the first use of a transient resource waits for the last
+		 * uses of its memory in the execution before. Executions on different queues
+		 * must be ordered with semaphores.
+		 *
+		 * Not thread-safe. The device must be idle when the graph is destroyed, compiled or allocated again.
+		 */
+		class RenderGraph
+		{
+		public:
+
+			// Gets memory requirements of a transient image or buffer, one of the infos is nullptr.
+			using MemoryQuery = std::function<VkMemoryRequirements(const VkImageCreateInfo* p_image_info,
+				const VkBufferCreateInfo* p_buffer_info)>;
+
+			RenderGraph() = default;
+			~RenderGraph();
+
+			RenderGraph(const RenderGraph&) = delete;
+			RenderGraph& operator=(const RenderGraph&) = delete;
+
+			// Adds an image owned by the graph. Returns its resource ID.
+			uint32_t createImage(const str& name, const RenderImageDesc& desc);
+			// Adds a buffer owned by the graph. Returns its resource ID.
+			uint32_t createBuffer(const str& name, VkDeviceSize size);
+
+			/**
+			* Adds an image owned by the caller. Returns its resource ID.
+			*
+			* @param const str& name - Name of the image.
+			* @param VkImage image - Image.
+			* @param VkImageView view - View of all of the image, used for attachments.
+			* @param const RenderImageDesc& desc - Description of the image.
+			* @param const ResourceState& initial - State the image is in when the frame begins, e.g. the
+			* stage a semaphore acquiring it is waited for in, and VK_IMAGE_LAYOUT_UNDEFINED if its contents are discarded.
+			* @param const ResourceState& final - State the image is left in, e.g. VK_IMAGE_LAYOUT_PRESENT_SRC_KHR.
+			*/
+			uint32_t importImage(const str& name, VkImage image, VkImageView view, const RenderImageDesc& desc,
+				const ResourceState& initial, const ResourceState& final);
+			// Adds a buffer owned by the caller. Returns its resource ID. See importImage().
+			uint32_t importBuffer(const str& name, VkBuffer buffer, VkDeviceSize size,
+				const ResourceState& initial, const ResourceState& final);
+
+			// Swaps an imported image, e.g. for the swapchain image of the next frame. Needs no compile().
+			void setImported(uint32_t resource, VkImage image, VkImageView view);
+			// Swaps an imported buffer. Needs no compile().
+			void setImported(uint32_t resource, VkBuffer buffer);
+
+			/**
+			* Adds a pass. Returns its ID.
+			*
+			* @param const str& name - Name of the pass.
+			* @param std::function<void(CommandBuffer*)> record - Records the pass, may be empty e.g. for passes that only clear. Passes with attachments
+			* are recorded inside a render pass instance of them.
+			* @param bool side_effects - Whether the pass is needed whatever it writes, e.g. as it reads back to the host.
+			*/
+			uint32_t addPass(const str& name, std::function<void(CommandBuffer*)> record, bool side_effects = false);
+
+			// Declares that a pass reads a resource.
+			void read(uint32_t pass, uint32_t resource, RenderAccess access);
+			/**
+			* Declares that a pass writes a resource.
+			*
+			* @param uint32_t pass - ID of the pass.
+			* @param uint32_t resource - ID of the resource.
+			* @param RenderAccess access - How the resource is written.
+			* @param const VkClearValue* p_clear - Value an attachment is cleared to, nullptr to keep its contents.
+			*/
+			void write(uint32_t pass, uint32_t resource, RenderAccess access, const VkClearValue* p_clear = nullptr);
+
+			/**
+			* Culls passes, computes barriers and places transient resources.
+			* Releases transient resources of an earlier allocate(), so allocate() must be called again.
+			*
+			* @param const MemoryQuery& query - Gets memory requirements of transient resources.
+			*/
+			void compile(const MemoryQuery& query);
+			// Compiles with memory requirements of a device.
+			void compile(LogicalDevice* p_device);
+
+			// Creates transient resources of the compiled graph, in as many allocations as it has heaps.
+			void allocate(LogicalDevice* p_device, DeviceMemoryAllocator* p_memory);
+
+			// Records passes of the compiled graph, with their barriers, into a command buffer outside a render pass instance.
+			void execute(CommandBuffer* p_buffer);
+
+			const CompiledGraph& getCompiled() const { return compiled; }
+
+			VkImage getImage(uint32_t resource) const { return resources.at(resource).image; }
+			VkImageView getImageView(uint32_t resource) const { return resources.at(resource).view; }
+			VkBuffer getBuffer(uint32_t resource) const { return resources.at(resource).buffer; }
+
+		private:
+
+			struct Resource
+			{
+				str name;
+				bool is_image;
+				bool imported;
+				RenderImageDesc image_desc{};
+				VkDeviceSize buffer_size = 0;
+				// Usage of every access declared, for transient resources.
+				VkFlags usage = 0;
+
+				VkImage image = VK_NULL_HANDLE;
+				VkImageView view = VK_NULL_HANDLE;
+				VkBuffer buffer = VK_NULL_HANDLE;
+
+				ResourceState initial;
+				ResourceState final;
+			};
+
+			enum class Attachment : uint8_t
+			{
+				None,
+				Color,
+				Depth,
+				DepthRead
+			};
+
+			// Every access of a pass to one resource, merged.
+			struct PassAccess
+			{
+				uint32_t resource;
+				VkPipelineStageFlags2 stages;
+				VkAccessFlags2 access;
+				VkImageLayout layout;
+				bool is_write;
+				Attachment attachment;
+				bool has_clear = false;
+				VkClearValue clear{};
+			};
+
+			struct Pass
+			{
+				str name;
+				std::function<void(CommandBuffer*)> record;
+				bool side_effects;
+				vec<PassAccess> accesses;
+			};
+
+			void declare(uint32_t pass, uint32_t resource, RenderAccess access, bool is_write, const VkClearValue* p_clear);
+			VkImageCreateInfo makeImageInfo(const Resource& resource) const;
+			VkBufferCreateInfo makeBufferInfo(const Resource& resource) const;
+			// Destroys transient resources and frees their memory.
+			void release();
+
+			vec<Resource> resources;
+			vec<Pass> passes;
+			CompiledGraph compiled;
+			bool is_compiled = false;
+
+			LogicalDevice* p_device = nullptr;
+			DeviceMemoryAllocator* p_memory = nullptr;
+			vec<DeviceAllocation*> heap_allocations;
+		};
+	}
+}
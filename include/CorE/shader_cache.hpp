@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include "CorE/file_mapping.hpp"
+#include "CorE/platform.hpp"
+#include "CorE/short_type.hpp"
+
+///
+/// Content-addressed cache of compiled shaders, one file per entry point.
+///
+/// Files are named after the key of their entry point, see getShaderKey(), and
+/// are written by the build stage of CorEngine for every shader in /shaders, so
+/// that shaders are only compiled at runtime if their source, or a module it
+/// imports, changed since.
+///
+/// Layout (little-endian):
+///   ShaderFileHeader
+///   entry point name - null-terminated
+///   dependency block - paths of imported modules, each null-terminated
+///   code block - code_size bytes of SPIR-V, 16-byte aligned
+///
+
+namespace CorE
+{
+	namespace Graphics
+	{
+		struct ShaderFileHeader
+		{
+			static constexpr char MAGIC[4] = { 'C', 'S', 'P', 'V' };
+			// Is part of every key, so bumping it invalidates all cached shaders.
+			static constexpr uint32_t VERSION = 3;
+
+			char magic[4];
+			uint32_t version;
+
+			uint64_t key;
+			// VkShaderStageFlagBits of the entry point.
+			uint32_t stage;
+			uint32_t dependency_count;
+
+			uint64_t entry_point_offset;
+			uint64_t entry_point_size;
+
+			// Hash of the contents of imported modules when compiled, see hashShaderDependencies().
+			uint64_t dependency_hash = 0;
+			uint64_t dependency_offset;
+			uint64_t dependency_size;
+
+			uint64_t code_offset;
+			uint64_t code_size;
+		};
+
+		/*
+		 * Code of an entry point mapped from the shader cache.
+		 * Code points straight into the mapping and stays valid as long as this object lives.
+		 */
+		struct MappedShaderCode
+		{
+			MappedShaderCode() = default;
+			explicit MappedShaderCode(MappedFile file) : file(std::move(file)) {}
+
+			MappedFile file;
+
+			uint64_t key = 0;
+			VkShaderStageFlagBits stage{};
+			str entry_point;
+
+			// Absolute paths of the modules the source imports.
+			vec<str> dependencies;
+			uint64_t dependency_hash = 0;
+
+			std::span<const char> code;
+		};
+
+		/**
+		* Computes the key of an entry point, from the contents of its source and its name.
+		* Modules the source imports are not part of the key, as they are only known once
+		* compiled. Shader files keep them and their hash instead, see hashShaderDependencies().
+		*
+		* @param const char* p_source - Source contents.
+		* @param size_t source_size - Size of the source in bytes.
+		* @param const char* entry_point - Name of the entry point.
+		*/
+		uint64_t getShaderKey(const char* p_source, size_t source_size, const char* entry_point);
+
+		/**
+		* Hashes the contents of the modules a shader imports. Throws std::runtime_error if one can not be read.
+		*
+		* @param const vec<str>& dependencies - Paths of the modules.
+		*/
+		uint64_t hashShaderDependencies(const vec<str>& dependencies);
+
+		/**
+		* Writes SPIR-V of an entry point into a shader file.
+		* The file is written next to the target, under a name unique to the thread, and
+		* renamed over it, so readers never see a half-written shader.
+		*
+		* @param const char* file_path - Path of the shader file.
+		* @param uint64_t key - Key of the entry point.
+		* @param const char* entry_point - Name of the entry point.
+		* @param VkShaderStageFlagBits stage - Stage of the entry point.
+		* @param const vec<str>& dependencies - Paths of the modules the source imports.
+		* @param uint64_t dependency_hash - Hash of the modules, of hashShaderDependencies().
+		* @param const void* p_code - SPIR-V.
+		* @param size_t code_size - Size of the SPIR-V in bytes.
+		*/
+		void writeShaderFile(const char* file_path, uint64_t key, const char* entry_point, VkShaderStageFlagBits stage,
+			const vec<str>& dependencies, uint64_t dependency_hash, const void* p_code, size_t code_size);
+
+		/**
+		* Maps a shader file. Throws std::runtime_error if the file
+		* is not a valid shader file of the current version.
+		*
+		* @param const char* file_path - Path of the shader file.
+		*/
+		MappedShaderCode mapShaderFile(const char* file_path);
+
+		/**
+		* Compiles every entry point of a Slang source to SPIR-V and writes them into the cache.
+		* Entry points keep their names in the SPIR-V. Throws std::runtime_error with the
+		* diagnostics of Slang if the source does not compile.
+		*
+		* @param const char* source_path - Path of the .slang file.
+		* @param const char* cache_dir - Directory of cached shaders. Created if missing.
+		* @returns Number of entry points written.
+		*/
+		uint32_t compileSlangToCache(const char* source_path, const char* cache_dir);
+
+		/**
+		* Loads SPIR-V of an entry point through the shader cache. The source is hashed
+		* to find the entry point, and only compiled, with compileSlangToCache(), if it is missing
+		* or a module the source imports changed since.
+		*
+		* @param const char* source_path - Path of the .slang file.
+		* @param const char* entry_point - Name of the entry point.
+		* @param const char* cache_dir - Directory of cached shaders. Created if missing.
+		*/
+		MappedShaderCode loadShaderCached(const char* source_path, const char* entry_point, const char* cache_dir);
+	}
+}
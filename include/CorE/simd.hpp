@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+///
+/// Vectorized math kernels with runtime instruction set dispatch.
+/// All matrices are 4x4, row-major, 16 floats in a row.
+///
+
+// SSE2 is taken as the baseline on x86, AVX2 is detected at runtime.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CORENGINE_SIMD_X86
+#elif defined(__aarch64__) || defined(_M_ARM64) || (defined(__ARM_NEON) && defined(__arm__))
+#define CORENGINE_SIMD_NEON
+#endif
+
+namespace CorE
+{
+	namespace math
+	{
+		namespace simd
+		{
+			// Instruction sets for which math kernels are provided.
+			enum class InstructionSet : uint8_t
+			{
+				Scalar,
+				SSE2,
+				AVX2,
+				NEON
+			};
+
+			/**
+			* Table of 4x4 matrix kernels for a single instruction set.
+			* Pointers may alias only where stated.
+			*/
+			struct Kernels
+			{
+				// p_out = p_lhs * p_rhs. p_out may alias any of the inputs.
+				void (*mul)(const float* p_lhs, const float* p_rhs, float* p_out);
+				// p_out = transpose(p_mat). p_out may alias p_mat.
+				void (*transpose)(const float* p_mat, float* p_out);
+				// p_out = p_mat * p_vec, where p_vec is a 4-component column vector.
+				void (*mulVec)(const float* p_mat, const float* p_vec, float* p_out);
+				// p_out = inverse(p_mat). Returns false and leaves p_out untouched if p_mat is singular.
+				bool (*inverse)(const float* p_mat, float* p_out);
+
+				/**
+				* Transforms count vectors stored as x/y/z/w streams by a single matrix.
+				* Output streams may be the same as input ones.
+				*
+				* @param const float* p_mat - Matrix to transform by.
+				* @param const float* const* pp_in - Four input streams: x, y, z, w.
+				* @param float* const* pp_out - Four output streams: x, y, z, w.
+				* @param size_t count - Number of vectors in every stream.
+				*/
+				void (*transformStreams)(const float* p_mat, const float* const* pp_in,
+					float* const* pp_out, size_t count);
+				// p_out[i] = p_lhs[i] * p_rhs[i] for count tightly packed matrices.
+				void (*mulBatch)(const float* p_lhs, const float* p_rhs, float* p_out, size_t count);
+
+				InstructionSet set;
+				const char* name;
+			};
+
+			// Detects the widest instruction set supported by current CPU and OS.
+			InstructionSet detect();
+
+			// Checks whether kernels of given set can be run on current CPU.
+			bool isSupported(InstructionSet set);
+
+			/**
+			* Gets kernels of given instruction set.
+			* If the set is not supported by this build or CPU, scalar kernels are returned.
+			*
+			* @param InstructionSet set - Desired instruction set.
+			*/
+			const Kernels& getKernels(InstructionSet set);
+
+			// Gets kernels selected by runtime detection. Detection is done once, on first call.
+			const Kernels& active();
+
+		} // namespace simd
+	} // namespace math
+} // namespace CorE
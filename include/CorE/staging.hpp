@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include "CorE/core_manager.hpp"
+#include "CorE/data_types.hpp"
+#include "CorE/device_memory.hpp"
+#include "CorE/short_type.hpp"
+
+namespace CorE
+{
+
+	/**
+	* Declares a set of properties to be used while creating a StagingUploader object.
+	*/
+	struct StagingProperties
+	{
+		// Size of the host visible ring uploads are staged in. Larger uploads are split,
+		// except image uploads, which must fit as a whole.
+		VkDeviceSize ring_size = VkDeviceSize(64) << 20;
+		// Batches that may be recorded or executed at once, before a new one waits for the oldest.
+		uint32_t batches_in_flight = 3;
+	};
+
+	/*
+	 * Streams buffer and image contents to the device through a persistently mapped ring buffer.
+	 *
+	 * Every upload takes the next free range of the ring, is copied there on the host,
+	 * and a copy command is recorded into the current batch. submit() hands the batch to the
+	 * transfer queue, which signals a timeline semaphore once it is done. Ranges of the ring
+	 * are reused once their batch completed, the host only waits if the ring is full.
+	 *
+	 * If the transfer queue is of another family than the graphics one, uploaded resources
+	 * are released by the transfer queue and acquired by the graphics one in acquire().
+	 *
+	 * Images are uploaded whole, one subresource layer range at a time, discarding their
+	 * previous contents, and end up in the layout asked for.
+	 *
+	 * Not thread-safe. The device must be idle when the uploader is destroyed.
+	 */
+	class StagingUploader
+	{
+	public:
+
+		// Counters of the uploader, since it was created.
+		struct Stats
+		{
+			uint64_t uploads = 0;
+			uint64_t bytes = 0;
+			uint64_t batches = 0;
+			// Times the host waited for the GPU, as the ring or all batches were in use.
+			uint64_t stalls = 0;
+		};
+
+		/**
+		* @param LogicalDevice* p_device - Device to upload to.
+		* @param DeviceMemoryAllocator* p_memory - Allocator the ring is taken from.
+		* @param Queue* p_transfer_queue - Queue copies are submitted to, e.g. of findTransferFamily().
+		* @param Queue* p_graphics_queue - Queue resources are used on. May be p_transfer_queue.
+		* @param const StagingProperties& props - Properties of the uploader.
+		*/
+		StagingUploader(LogicalDevice* p_device, DeviceMemoryAllocator* p_memory, Queue* p_transfer_queue,
+			Queue* p_graphics_queue, const StagingProperties& props = {});
+		~StagingUploader();
+
+		StagingUploader(const StagingUploader&) = delete;
+		StagingUploader& operator=(const StagingUploader&) = delete;
+
+		// Finds a family with transfer queues only, which DMA engines usually back. nullptr if there is none.
+		static QueueFamily* findTransferFamily(PhysicalDevice* p_device);
+
+		/**
+		* Uploads data into a buffer, which needs VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+		*
+		* @param VkBuffer buffer - Destination buffer.
+		* @param VkDeviceSize offset - Offset in the buffer to write to.
+		* @param const void* p_data - Data to upload, only read during the call.
+		* @param VkDeviceSize size - Number of bytes.
+		*/
+		void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* p_data, VkDeviceSize size);
+
+		/**
+		* Uploads tightly packed texels into an image, which needs VK_IMAGE_USAGE_TRANSFER_DST_BIT.
+		*
+		* @param VkImage image - Destination image.
+		* @param const VkImageSubresourceLayers& subresource - Mip level and layers to fill.
+		* @param VkExtent3D extent - Extent of the mip level.
+		* @param const void* p_data - Texels, layer after layer.
+		* @param VkDeviceSize size - Number of bytes.
+		* @param VkImageLayout final_layout - Layout the image is used in afterwards.
+		*/
+		void uploadImage(VkImage image, const VkImageSubresourceLayers& subresource, VkExtent3D extent,
+			const void* p_data, VkDeviceSize size, VkImageLayout final_layout);
+
+		// Uploads vertices and indices of a model indexed by indexModel() into buffers large enough for them.
+		void uploadModel(const Dim3::Model_3D& model, VkBuffer vertex_buffer, VkBuffer index_buffer);
+
+		// Submits the uploads recorded so far. Returns the timeline value they complete at,
+		// or the value of the last batch if nothing was recorded.
+		uint64_t submit();
+
+		/**
+		* Hands resources of completed batches over to the graphics queue. Records acquire barriers
+		* into p_buffer, if queue families differ, and makes buffers added to the graphics queue
+		* from now on wait for the batches, which never blocks as they are complete.
+		* Must be called before p_buffer is added to the graphics queue.
+		*
+		* @param CommandBuffer* p_buffer - Graphics command buffer being recorded.
+		*/
+		void acquire(CommandBuffer* p_buffer);
+
+		// Checks whether uploads submitted with a value are done and acquired.
+		bool isAcquired(uint64_t value) const { return value <= acquired_value; }
+		// Timeline the transfer queue signals, with a value per batch.
+		Queue::Semaphore* getTimeline() { return &timeline; }
+		Stats getStats() const { return stats; }
+
+	private:
+
+		// Range of the ring a submitted batch holds, up to ring_end in the offsets of reserve().
+		struct RingRetirement
+		{
+			uint64_t value;
+			VkDeviceSize ring_end;
+		};
+
+		// Barriers acquiring resources of a submitted batch on the graphics queue.
+		struct PendingAcquire
+		{
+			uint64_t value;
+			vec<VkBufferMemoryBarrier2> buffers;
+			vec<VkImageMemoryBarrier2> images;
+		};
+
+		// Takes a range of the ring. Returns its offset, which grows by the ring size on every wrap.
+		VkDeviceSize reserve(VkDeviceSize size, VkDeviceSize alignment);
+		// Releases ranges of batches completed by the GPU.
+		void reclaim(uint64_t completed_value);
+		void copyToRing(VkDeviceSize ring_offset, const void* p_data, VkDeviceSize size);
+		// Begins a batch if none is being recorded.
+		void beginBatch();
+		bool isSharedQueue() const { return p_transfer_queue == p_graphics_queue; }
+
+		LogicalDevice* p_device;
+		DeviceMemoryAllocator* p_memory;
+		Queue* p_transfer_queue;
+		Queue* p_graphics_queue;
+		StagingProperties props;
+		VkDeviceSize copy_alignment;
+		// Set if the queues are of different families, so that resources change owner.
+		bool ownership_transfer;
+
+		VkBuffer ring_buffer;
+		DeviceAllocation* p_ring_allocation;
+		char* p_ring;
+		VkDeviceSize ring_head = 0;
+		VkDeviceSize ring_tail = 0;
+
+		Queue::Semaphore timeline;
+		// Value the next submitted batch signals.
+		uint64_t next_value = 1;
+		uint64_t acquired_value = 0;
+		CommandPoolManager pools;
+		// Value every slot of pools was last submitted with.
+		vec<uint64_t> slot_values;
+
+		CommandBuffer* p_recording = nullptr;
+		// Barriers of the batch being recorded, releasing resources to the graphics queue.
+		vec<VkBufferMemoryBarrier2> buffer_releases;
+		vec<VkImageMemoryBarrier2> image_releases;
+		std::deque<RingRetirement> ring_retirements;
+		std::deque<PendingAcquire> pending_acquires;
+
+		Stats stats;
+	};
+
+}
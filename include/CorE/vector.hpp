@@ -10,28 +10,40 @@ namespace CorE
 		// TODO - make a Vec class with ability to assign size upon creation.
 
 		// 4-dimensional signed float vector suitable for doing math on it.
-		struct Vec4
+		// Aligned to 16 bytes, so it can be loaded into a single SIMD register.
+		struct alignas(16) Vec4
 		{
 			float val[4];
 
-			float& x();
-			float& y();
-			float& z();
-			float& w();
+			constexpr float& x() { return val[0]; }
+			constexpr float& y() { return val[1]; }
+			constexpr float& z() { return val[2]; }
+			constexpr float& w() { return val[3]; }
 
-			float& operator[](int dim);
+			constexpr float x() const { return val[0]; }
+			constexpr float y() const { return val[1]; }
+			constexpr float z() const { return val[2]; }
+			constexpr float w() const { return val[3]; }
+
+			constexpr float& operator[](int dim) { return val[dim]; }
+			constexpr float operator[](int dim) const { return val[dim]; }
 		};
 
 		struct Vec3
 		{
 			float val[3];
 
-			float& x();
-			float& y();
-			float& z();
+			constexpr float& x() { return val[0]; }
+			constexpr float& y() { return val[1]; }
+			constexpr float& z() { return val[2]; }
+
+			constexpr float x() const { return val[0]; }
+			constexpr float y() const { return val[1]; }
+			constexpr float z() const { return val[2]; }
 
-			float& operator[](int dim);
+			constexpr float& operator[](int dim) { return val[dim]; }
+			constexpr float operator[](int dim) const { return val[dim]; }
 		};
 
 	}
-}
\ No newline at end of file
+}
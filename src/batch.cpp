@@ -0,0 +1,28 @@
+#include <stdexcept>
+
+#include "CorE/batch.hpp"
+#include "CorE/simd.hpp"
+
+// Mat4x4 arrays are handed to the kernels as tightly packed floats.
+static_assert(sizeof(CorE::math::Mat4x4) == 16 * sizeof(float), "Mat4x4 must be tightly packed.");
+
+void CorE::math::transformBatch(const Mat4x4& mat, const Vec4Streams& in, const Vec4Streams& out)
+{
+	if (out.count < in.count)
+	{
+		throw std::runtime_error("Output streams are shorter than input ones.");
+	}
+
+	const float* in_streams[4] = { in.p_x, in.p_y, in.p_z, in.p_w };
+	float* out_streams[4] = { out.p_x, out.p_y, out.p_z, out.p_w };
+	simd::active().transformStreams(&mat.val[0][0], in_streams, out_streams, in.count);
+} // void math::transformBatch()
+
+void CorE::math::multiplyBatch(const Mat4x4* p_lhs, const Mat4x4* p_rhs, Mat4x4* p_out, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	simd::active().mulBatch(&p_lhs->val[0][0], &p_rhs->val[0][0], &p_out->val[0][0], count);
+} // void math::multiplyBatch()
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include "CorE/binary_cache.hpp"
+#include "CorE/hash.hpp"
+
+static_assert(std::is_trivially_copyable_v<CorE::Graphics::BinaryFileHeader>, "BinaryFileHeader must be trivially copyable.");
+static_assert(std::is_trivially_copyable_v<CorE::Graphics::BinaryRecord>, "BinaryRecord must be trivially copyable.");
+
+namespace
+{
+	// Binary shader code must be aligned to 16 bytes, wherever it is read from.
+	constexpr uint64_t BLOCK_ALIGNMENT = 16;
+
+	inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	uint64_t hashString(const str& string, uint64_t seed)
+	{
+		return CorE::hashBytes(string.data(), string.size(), seed);
+	}
+
+	// Hashes specialization constants by value, as their pointers differ between runs.
+	uint64_t hashSpecialization(const VkSpecializationInfo* p_spec_info, uint64_t seed)
+	{
+		if (p_spec_info == nullptr)
+		{
+			return seed;
+		}
+		uint64_t hash = seed;
+		for (uint32_t i = 0; i < p_spec_info->mapEntryCount; i++)
+		{
+			const VkSpecializationMapEntry& entry = p_spec_info->pMapEntries[i];
+			hash = CorE::hashCombine(hash, entry.constantID);
+			hash = CorE::hashCombine(hash, entry.offset);
+			hash = CorE::hashCombine(hash, entry.size);
+		}
+		return CorE::hashBytes(p_spec_info->pData, p_spec_info->dataSize, hash);
+	}
+} // anonymous namespace
+
+CorE::Graphics::BinaryCache::BinaryCache(LogicalDevice* p_device, const char* cache_dir)
+	: p_device(p_device), cache_dir(cache_dir)
+{
+	if constexpr (std::endian::native != std::endian::little)
+	{
+		throw std::runtime_error("Binary cache files are only supported on little-endian hosts.");
+	}
+	std::filesystem::create_directories(cache_dir);
+
+	shader_object_props = {};
+	shader_object_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_PROPERTIES_EXT;
+	id_props = {};
+	id_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+	id_props.pNext = &shader_object_props;
+	VkPhysicalDeviceProperties2 props{};
+	props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	props.pNext = &id_props;
+	vkGetPhysicalDeviceProperties2(p_device->p_parent->vk_handle, &props);
+	device_props = props.properties;
+	id_props.pNext = nullptr;
+	shader_object_props.pNext = nullptr;
+
+	device_key = hashBytes(id_props.deviceUUID, VK_UUID_SIZE);
+	device_key = hashBytes(id_props.driverUUID, VK_UUID_SIZE, device_key);
+	device_key = hashCombine(device_key, device_props.vendorID);
+	device_key = hashCombine(device_key, device_props.deviceID);
+	device_key = hashCombine(device_key, device_props.driverVersion);
+
+	// A missing or stale cache only costs time, so pipelines start from an empty one then.
+	const BinaryFileHeader expected = makeHeader(0, device_props.pipelineCacheUUID, 0);
+	vec<BinaryRecord> records;
+	MappedFile file = mapFile(getPath(0, "cpipe"), expected, records);
+
+	VkPipelineCacheCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	if (file.getData() != nullptr && records.size() == 1)
+	{
+		info.initialDataSize = records[0].size;
+		info.pInitialData = file.getData() + records[0].offset;
+	}
+	if (vkCreatePipelineCache(p_device->vk_handle, &info, p_device->getAllocator(), &pipeline_cache) != VK_SUCCESS)
+	{
+		info.initialDataSize = 0;
+		info.pInitialData = nullptr;
+		ensureVkSuccess(vkCreatePipelineCache(p_device->vk_handle, &info, p_device->getAllocator(), &pipeline_cache),
+			"Failed to create pipeline cache.");
+	}
+} // BinaryCache::BinaryCache()
+
+CorE::Graphics::BinaryCache::~BinaryCache()
+{
+	vkDestroyPipelineCache(p_device->vk_handle, pipeline_cache, p_device->getAllocator());
+} // BinaryCache::~BinaryCache()
+
+uptr<CorE::Graphics::ShaderGroup> CorE::Graphics::BinaryCache::createShaderGroup(const vec<ShaderGroup::Stage>& stages,
+	const vec<VkDescriptorSetLayout>& desc_set_layouts, const vec<VkPushConstantRange>& push_constant_ranges,
+	VkShaderCreateFlagsEXT flags)
+{
+	const bool from_code = std::all_of(stages.begin(), stages.end(), [](const ShaderGroup::Stage& stage)
+		{
+			return stage.code_type != VK_SHADER_CODE_TYPE_BINARY_EXT;
+		});
+	if (!from_code)
+	{
+		return std::make_unique<ShaderGroup>(p_device, stages, desc_set_layouts, push_constant_ranges, flags);
+	}
+
+	// Stages are keyed in stage order, so that the order they were listed in does not matter.
+	vec<const ShaderGroup::Stage*> ordered;
+	for (const ShaderGroup::Stage& stage : stages)
+	{
+		ordered.push_back(&stage);
+	}
+	std::sort(ordered.begin(), ordered.end(), [](const ShaderGroup::Stage* p_a, const ShaderGroup::Stage* p_b)
+		{
+			return p_a->stage < p_b->stage;
+		});
+
+	uint64_t key = hashCombine(BinaryFileHeader::VERSION, flags);
+	key = hashCombine(key, desc_set_layouts.size());
+	for (const VkPushConstantRange& range : push_constant_ranges)
+	{
+		key = hashCombine(key, range.stageFlags);
+		key = hashCombine(key, range.offset);
+		key = hashCombine(key, range.size);
+	}
+	for (const ShaderGroup::Stage* p_stage : ordered)
+	{
+		key = hashCombine(key, p_stage->stage);
+		key = hashBytes(p_stage->p_code, p_stage->code_size, key);
+		key = hashString(p_stage->entry_point, key);
+		key = hashSpecialization(p_stage->p_spec_info, key);
+	}
+
+	const str file_path = getPath(key, "cshd");
+	const BinaryFileHeader expected = makeHeader(key, shader_object_props.shaderBinaryUUID,
+		shader_object_props.shaderBinaryVersion);
+
+	vec<BinaryRecord> records;
+	MappedFile file = mapFile(file_path, expected, records);
+	if (file.getData() != nullptr && records.size() == ordered.size())
+	{
+		vec<ShaderGroup::Stage> binaries(ordered.size());
+		for (size_t i = 0; i < ordered.size(); i++)
+		{
+			binaries[i] = *ordered[i];
+			binaries[i].stage = static_cast<VkShaderStageFlagBits>(records[i].stage);
+			binaries[i].code_type = VK_SHADER_CODE_TYPE_BINARY_EXT;
+			binaries[i].p_code = file.getData() + records[i].offset;
+			binaries[i].code_size = records[i].size;
+		}
+		try
+		{
+			uptr<ShaderGroup> p_group = std::make_unique<ShaderGroup>(p_device, binaries, desc_set_layouts,
+				push_constant_ranges, flags);
+			hits.fetch_add(1, std::memory_order_relaxed);
+			return p_group;
+		}
+		catch (const std::exception&)
+		{
+			// Recreated from code and replaced below.
+			rejected.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	file = MappedFile();
+
+	uptr<ShaderGroup> p_group = std::make_unique<ShaderGroup>(p_device, stages, desc_set_layouts,
+		push_constant_ranges, flags);
+	misses.fetch_add(1, std::memory_order_relaxed);
+
+	vec<vec<char>> binaries(ordered.size());
+	vec<const void*> data(ordered.size());
+	records.assign(ordered.size(), BinaryRecord{});
+	for (size_t i = 0; i < ordered.size(); i++)
+	{
+		VkShaderEXT shader = p_group->getShader(ordered[i]->stage);
+		size_t size = 0;
+		ensureVkSuccess(vkGetShaderBinaryDataEXT(p_device->vk_handle, shader, &size, nullptr),
+			"Failed to get shader binary size.");
+		binaries[i].resize(size);
+		ensureVkSuccess(vkGetShaderBinaryDataEXT(p_device->vk_handle, shader, &size, binaries[i].data()),
+			"Failed to get shader binary.");
+
+		records[i].stage = static_cast<uint32_t>(ordered[i]->stage);
+		records[i].size = size;
+		data[i] = binaries[i].data();
+	}
+	writeFile(file_path, expected, records, data);
+	return p_group;
+} // uptr<ShaderGroup> BinaryCache::createShaderGroup()
+
+void CorE::Graphics::BinaryCache::savePipelineCache()
+{
+	size_t size = 0;
+	ensureVkSuccess(vkGetPipelineCacheData(p_device->vk_handle, pipeline_cache, &size, nullptr),
+		"Failed to get pipeline cache size.");
+	vec<char> blob(size);
+	// Incomplete if pipelines were added in between, the part written is still valid.
+	VkResult result = vkGetPipelineCacheData(p_device->vk_handle, pipeline_cache, &size, blob.data());
+	if (result != VK_INCOMPLETE)
+	{
+		ensureVkSuccess(result, "Failed to get pipeline cache data.");
+	}
+
+	vec<BinaryRecord> records(1, BinaryRecord{});
+	records[0].size = size;
+	writeFile(getPath(0, "cpipe"), makeHeader(0, device_props.pipelineCacheUUID, 0), records, { blob.data() });
+} // void BinaryCache::savePipelineCache()
+
+CorE::Graphics::BinaryCache::Stats CorE::Graphics::BinaryCache::getStats() const
+{
+	Stats stats;
+	stats.hits = hits.load(std::memory_order_relaxed);
+	stats.misses = misses.load(std::memory_order_relaxed);
+	stats.rejected = rejected.load(std::memory_order_relaxed);
+	return stats;
+} // Stats BinaryCache::getStats()
+
+CorE::Graphics::BinaryFileHeader CorE::Graphics::BinaryCache::makeHeader(uint64_t key, const uint8_t* binary_uuid,
+	uint32_t binary_version) const
+{
+	BinaryFileHeader header{};
+	std::memcpy(header.magic, BinaryFileHeader::MAGIC, sizeof(header.magic));
+	header.version = BinaryFileHeader::VERSION;
+	header.vendor_id = device_props.vendorID;
+	header.device_id = device_props.deviceID;
+	header.driver_version = device_props.driverVersion;
+	header.binary_version = binary_version;
+	std::memcpy(header.device_uuid, id_props.deviceUUID, VK_UUID_SIZE);
+	std::memcpy(header.driver_uuid, id_props.driverUUID, VK_UUID_SIZE);
+	std::memcpy(header.binary_uuid, binary_uuid, VK_UUID_SIZE);
+	header.key = key;
+	return header;
+} // BinaryFileHeader BinaryCache::makeHeader()
+
+CorE::MappedFile CorE::Graphics::BinaryCache::mapFile(const str& file_path, const BinaryFileHeader& expected,
+	vec<BinaryRecord>& records) const
+{
+	records.clear();
+	if (!std::filesystem::exists(file_path))
+	{
+		return MappedFile();
+	}
+
+	try
+	{
+		MappedFile file(file_path.c_str());
+		const uint64_t size = file.getSize();
+		if (size < sizeof(BinaryFileHeader))
+		{
+			return MappedFile();
+		}
+
+		BinaryFileHeader header;
+		std::memcpy(&header, file.getData(), sizeof(header));
+		// Everything but the counts and the hash of the data must match what this device would write.
+		BinaryFileHeader identity = header;
+		identity.record_count = 0;
+		identity.data_hash = 0;
+		if (std::memcmp(&identity, &expected, sizeof(BinaryFileHeader)) != 0
+			|| header.record_count > (size - sizeof(BinaryFileHeader)) / sizeof(BinaryRecord))
+		{
+			return MappedFile();
+		}
+
+		records.resize(header.record_count);
+		std::memcpy(records.data(), file.getData() + sizeof(BinaryFileHeader), records.size() * sizeof(BinaryRecord));
+		uint64_t data_hash = 0;
+		for (const BinaryRecord& record : records)
+		{
+			if (record.offset % BLOCK_ALIGNMENT != 0 || record.offset > size || record.size > size - record.offset)
+			{
+				records.clear();
+				return MappedFile();
+			}
+			data_hash = hashBytes(file.getData() + record.offset, record.size, data_hash);
+		}
+		if (data_hash != header.data_hash)
+		{
+			records.clear();
+			return MappedFile();
+		}
+		return file;
+	}
+	catch (const std::runtime_error&)
+	{
+		// Unreadable, e.g. replaced while being opened, treated as missing.
+		records.clear();
+		return MappedFile();
+	}
+} // MappedFile BinaryCache::mapFile()
+
+void CorE::Graphics::BinaryCache::writeFile(const str& file_path, const BinaryFileHeader& header,
+	const vec<BinaryRecord>& records, const vec<const void*>& data) const
+{
+	BinaryFileHeader full_header = header;
+	full_header.record_count = static_cast<uint32_t>(records.size());
+
+	vec<BinaryRecord> placed = records;
+	uint64_t offset = sizeof(BinaryFileHeader) + placed.size() * sizeof(BinaryRecord);
+	for (size_t i = 0; i < placed.size(); i++)
+	{
+		offset = alignUp(offset, BLOCK_ALIGNMENT);
+		placed[i].offset = offset;
+		offset += placed[i].size;
+		full_header.data_hash = hashBytes(data[i], placed[i].size, full_header.data_hash);
+	}
+
+	// Written aside and renamed over the target, so a crash never leaves a torn file behind.
+	// Names of files aside are unique per thread, as threads may write the same key at once.
+	std::filesystem::path temp = file_path;
+	temp += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		static const char zeros[BLOCK_ALIGNMENT] = {};
+		std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to create binary cache file.");
+		}
+		stream.write(reinterpret_cast<const char*>(&full_header), sizeof(full_header));
+		stream.write(reinterpret_cast<const char*>(placed.data()),
+			static_cast<std::streamsize>(placed.size() * sizeof(BinaryRecord)));
+		for (size_t i = 0; i < placed.size(); i++)
+		{
+			const uint64_t current = static_cast<uint64_t>(stream.tellp());
+			stream.write(zeros, static_cast<std::streamsize>(placed[i].offset - current));
+			stream.write(static_cast<const char*>(data[i]), static_cast<std::streamsize>(placed[i].size));
+		}
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to write binary cache file.");
+		}
+	}
+	std::filesystem::rename(temp, file_path);
+} // void BinaryCache::writeFile()
+
+str CorE::Graphics::BinaryCache::getPath(uint64_t key, const char* extension) const
+{
+	char file_name[48];
+	std::snprintf(file_name, sizeof(file_name), "%016llx.%s",
+		static_cast<unsigned long long>(hashCombine(device_key, key)), extension);
+	return (std::filesystem::path(cache_dir) / file_name).string();
+} // str BinaryCache::getPath()
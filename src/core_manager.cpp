@@ -1,4 +1,6 @@
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 #include "CorE/core_manager.hpp"
@@ -34,9 +36,9 @@ CorE::Queue::Queue(QueueFamily* p_parent)
 } // Queue::Queue()
 
 CorE::LogicalDevice::LogicalDevice(PhysicalDevice* p_parent, VkDeviceCreateInfo info, VkAllocationCallbacks allocator)
-	: p_parent(p_parent)
+	: p_parent(p_parent), allocator(allocator)
 {
-	ensureVkSuccess(vkCreateDevice(p_parent->vk_handle, &info, &allocator, &vk_handle),
+	ensureVkSuccess(vkCreateDevice(p_parent->vk_handle, &info, getAllocator(), &vk_handle),
 		"Failed to create logical device.");
 
 	p_parent->enumerateQueueFamilies();
@@ -59,9 +61,14 @@ CorE::LogicalDevice::LogicalDevice(PhysicalDevice* p_parent, VkDeviceCreateInfo
 	p_parent->logical_devices.push_back(std::move(*this));
 } // LogicalDevice::LogicalDevice()
 
+const VkAllocationCallbacks* CorE::LogicalDevice::getAllocator() const
+{
+	return allocator.pfnAllocation ? &allocator : nullptr;
+} // const VkAllocationCallbacks* LogicalDevice::getAllocator()
+
 CorE::CommandPool::CommandPool(LogicalDevice* p_parent, QueueFamily* p_queue_family,
 	VkCommandPoolCreateFlagBits flags_bitmask, const VkAllocationCallbacks* p_allocator)
-	: p_parent(p_parent), p_queue_family(p_queue_family)
+	: p_parent(p_parent), p_queue_family(p_queue_family), p_allocator(p_allocator)
 {
 	VkCommandPool pool;
 	VkCommandPoolCreateInfo pool_info{};
@@ -72,33 +79,96 @@ CorE::CommandPool::CommandPool(LogicalDevice* p_parent, QueueFamily* p_queue_fam
 	ensureVkSuccess(vkCreateCommandPool(p_parent->vk_handle, &pool_info, p_allocator, &pool),
 		"Failed to create command pool.");
 	vk_handle = pool;
+	flags = flags_bitmask;
 	thread_id = std::this_thread::get_id();
-	p_parent->command_pools.push_back(std::move(*this));
+	p_parent->command_pools.push_back(this);
 } // CommandPool::CommandPool()
 
 CorE::CommandBuffer::CommandBuffer(VkCommandBuffer vk_handle, CommandPool* p_parent, uint32_t index)
-	: vk_handle(vk_handle), p_parent(p_parent), index(index)
+	: index(index), p_parent(p_parent), vk_handle(vk_handle), p_next(nullptr), p_prev(nullptr)
 {
 
 } // CommandBuffer::CommandBuffer()
 
-void CorE::CommandBuffer::setViewportCounts(std::vector<VkViewport> viewports)
+namespace
+{
+	// Compares state with the shadow of it bytewise, so that equal values padded differently are
+	// only recorded again, never dropped.
+	template<typename T>
+	bool equalState(const vec<T>& shadow, std::span<const T> values)
+	{
+		return shadow.size() == values.size()
+			&& (values.empty() || std::memcmp(shadow.data(), values.data(), values.size_bytes()) == 0);
+	}
+} // anonymous namespace
+
+template<typename T>
+bool CorE::CommandBuffer::updateState(StateBit bit, T& shadow_value, const T& value)
+{
+	if ((state_known & bit) && shadow_value == value)
+	{
+		state_stats.elided++;
+		return false;
+	}
+	shadow_value = value;
+	state_known |= bit;
+	state_stats.emitted++;
+	return true;
+} // bool CommandBuffer::updateState()
+
+template<typename T>
+bool CorE::CommandBuffer::updateState(StateBit bit, vec<T>& shadow_values, std::span<const T> values)
+{
+	if ((state_known & bit) && equalState(shadow_values, values))
+	{
+		state_stats.elided++;
+		return false;
+	}
+	shadow_values.assign(values.begin(), values.end());
+	state_known |= bit;
+	state_stats.emitted++;
+	return true;
+} // bool CommandBuffer::updateState()
+
+void CorE::CommandBuffer::setViewportCounts(std::span<const VkViewport> viewports)
 {
-	vkCmdSetViewportWithCount(vk_handle, static_cast<uint32_t>(viewports.size()), viewports.data());
+	if (updateState(STATE_VIEWPORTS, shadow.viewports, viewports))
+	{
+		vkCmdSetViewportWithCount(vk_handle, static_cast<uint32_t>(viewports.size()), viewports.data());
+	}
 }
 
-void CorE::CommandBuffer::setScissorCounts(std::vector<VkRect2D> scissors)
+void CorE::CommandBuffer::setScissorCounts(std::span<const VkRect2D> scissors)
 {
-	vkCmdSetScissorWithCountEXT(vk_handle, static_cast<uint32_t>(scissors.size()), scissors.data());
+	if (updateState(STATE_SCISSORS, shadow.scissors, scissors))
+	{
+		vkCmdSetScissorWithCountEXT(vk_handle, static_cast<uint32_t>(scissors.size()), scissors.data());
+	}
 }
 
 void CorE::CommandBuffer::setRasterizerDiscardEnable(VkBool32 rasterizer_discard_enable)
 {
-	vkCmdSetRasterizerDiscardEnableEXT(vk_handle, rasterizer_discard_enable);
+	if (updateState(STATE_RASTERIZER_DISCARD, shadow.rasterizer_discard, rasterizer_discard_enable))
+	{
+		vkCmdSetRasterizerDiscardEnableEXT(vk_handle, rasterizer_discard_enable);
+	}
 }
 
-void CorE::CommandBuffer::setVertexInput(std::vector<VkVertexInputBindingDescription2EXT> vertex_input_bindings, std::vector<VkVertexInputAttributeDescription2EXT> vertex_input_attrib_descriptions)
+void CorE::CommandBuffer::setVertexInput(std::span<const VkVertexInputBindingDescription2EXT> vertex_input_bindings,
+	std::span<const VkVertexInputAttributeDescription2EXT> vertex_input_attrib_descriptions)
 {
+	// Both arrays are one piece of state, set by a single command.
+	if ((state_known & STATE_VERTEX_INPUT) && equalState(shadow.vertex_bindings, vertex_input_bindings)
+		&& equalState(shadow.vertex_attribs, vertex_input_attrib_descriptions))
+	{
+		state_stats.elided++;
+		return;
+	}
+	shadow.vertex_bindings.assign(vertex_input_bindings.begin(), vertex_input_bindings.end());
+	shadow.vertex_attribs.assign(vertex_input_attrib_descriptions.begin(), vertex_input_attrib_descriptions.end());
+	state_known |= STATE_VERTEX_INPUT;
+	state_stats.emitted++;
+
 	vkCmdSetVertexInputEXT(
 		vk_handle,
 		static_cast<uint32_t>(vertex_input_bindings.size()),
@@ -110,97 +180,162 @@ void CorE::CommandBuffer::setVertexInput(std::vector<VkVertexInputBindingDescrip
 
 void CorE::CommandBuffer::setPrimitiveTopology(VkPrimitiveTopology topology)
 {
-	vkCmdSetPrimitiveTopologyEXT(vk_handle, topology);
+	if (updateState(STATE_PRIMITIVE_TOPOLOGY, shadow.primitive_topology, topology))
+	{
+		vkCmdSetPrimitiveTopologyEXT(vk_handle, topology);
+	}
 }
 
 void CorE::CommandBuffer::setPrimitiveRestartEnable(VkBool32 primitive_restart_enable)
 {
-	vkCmdSetPrimitiveRestartEnableEXT(vk_handle, primitive_restart_enable);
+	if (updateState(STATE_PRIMITIVE_RESTART, shadow.primitive_restart, primitive_restart_enable))
+	{
+		vkCmdSetPrimitiveRestartEnableEXT(vk_handle, primitive_restart_enable);
+	}
 }
 
 void CorE::CommandBuffer::setPatchControlPoints(uint32_t patch_control_points)
 {
-	vkCmdSetPatchControlPointsEXT(vk_handle, patch_control_points);
+	if (updateState(STATE_PATCH_CONTROL_POINTS, shadow.patch_control_points, patch_control_points))
+	{
+		vkCmdSetPatchControlPointsEXT(vk_handle, patch_control_points);
+	}
 }
 
 void CorE::CommandBuffer::setTessellationDomainOrigin(VkTessellationDomainOrigin domain_origin)
 {
-	vkCmdSetTessellationDomainOriginEXT(vk_handle, domain_origin);
+	if (updateState(STATE_DOMAIN_ORIGIN, shadow.domain_origin, domain_origin))
+	{
+		vkCmdSetTessellationDomainOriginEXT(vk_handle, domain_origin);
+	}
 }
 
 void CorE::CommandBuffer::setRasterizationSamples(VkSampleCountFlagBits rasterization_samples)
 {
-	vkCmdSetRasterizationSamplesEXT(vk_handle, rasterization_samples);
+	if (updateState(STATE_RASTERIZATION_SAMPLES, shadow.rasterization_samples, rasterization_samples))
+	{
+		vkCmdSetRasterizationSamplesEXT(vk_handle, rasterization_samples);
+	}
 }
 
-void CorE::CommandBuffer::setSampleMask(VkSampleCountFlagBits samples, std::vector<VkSampleMask> sample_masks)
+void CorE::CommandBuffer::setSampleMask(VkSampleCountFlagBits samples, std::span<const VkSampleMask> sample_masks)
 {
-	vkCmdSetSampleMaskEXT(vk_handle, samples, sample_masks.data());
+	// The sample count decides how many words of the mask are read, so it is part of the state.
+	const bool same_samples = (state_known & STATE_SAMPLE_MASK) && shadow.mask_samples == samples;
+	if (!same_samples)
+	{
+		state_known &= ~STATE_SAMPLE_MASK;
+		shadow.mask_samples = samples;
+	}
+	if (updateState(STATE_SAMPLE_MASK, shadow.sample_masks, sample_masks))
+	{
+		vkCmdSetSampleMaskEXT(vk_handle, samples, sample_masks.data());
+	}
 }
 
 void CorE::CommandBuffer::setAlphaToCoverage(VkBool32 atc_enable)
 {
-	vkCmdSetAlphaToCoverageEnableEXT(vk_handle, atc_enable);
+	if (updateState(STATE_ALPHA_TO_COVERAGE, shadow.alpha_to_coverage, atc_enable))
+	{
+		vkCmdSetAlphaToCoverageEnableEXT(vk_handle, atc_enable);
+	}
 }
 
 void CorE::CommandBuffer::setAlphaToOne(VkBool32 ato_enable)
 {
-	vkCmdSetAlphaToOneEnableEXT(vk_handle, ato_enable);
+	if (updateState(STATE_ALPHA_TO_ONE, shadow.alpha_to_one, ato_enable))
+	{
+		vkCmdSetAlphaToOneEnableEXT(vk_handle, ato_enable);
+	}
 }
 
 void CorE::CommandBuffer::setPolygonMode(VkPolygonMode mode)
 {
-	vkCmdSetPolygonModeEXT(vk_handle, mode);
+	if (updateState(STATE_POLYGON_MODE, shadow.polygon_mode, mode))
+	{
+		vkCmdSetPolygonModeEXT(vk_handle, mode);
+	}
 }
 
 void CorE::CommandBuffer::setLineWidth(float width)
 {
-	vkCmdSetLineWidth(vk_handle, width);
+	if (updateState(STATE_LINE_WIDTH, shadow.line_width, width))
+	{
+		vkCmdSetLineWidth(vk_handle, width);
+	}
 }
 
 void CorE::CommandBuffer::setCullMode(VkCullModeFlags cull_mode)
 {
-	vkCmdSetCullMode(vk_handle, cull_mode);
+	if (updateState(STATE_CULL_MODE, shadow.cull_mode, cull_mode))
+	{
+		vkCmdSetCullMode(vk_handle, cull_mode);
+	}
 }
 
 void CorE::CommandBuffer::setFrontFace(VkFrontFace front_face)
 {
-	vkCmdSetFrontFace(vk_handle, front_face);
+	if (updateState(STATE_FRONT_FACE, shadow.front_face, front_face))
+	{
+		vkCmdSetFrontFace(vk_handle, front_face);
+	}
 }
 
 void CorE::CommandBuffer::setDepthTestEnable(VkBool32 depth_test_enable)
 {
-	vkCmdSetDepthTestEnable(vk_handle, depth_test_enable);
+	if (updateState(STATE_DEPTH_TEST, shadow.depth_test, depth_test_enable))
+	{
+		vkCmdSetDepthTestEnable(vk_handle, depth_test_enable);
+	}
 }
 
 void CorE::CommandBuffer::setDepthCompareOp(VkCompareOp depth_compare_op)
 {
-	vkCmdSetDepthCompareOp(vk_handle, depth_compare_op);
+	if (updateState(STATE_DEPTH_COMPARE_OP, shadow.depth_compare_op, depth_compare_op))
+	{
+		vkCmdSetDepthCompareOp(vk_handle, depth_compare_op);
+	}
 }
 
 void CorE::CommandBuffer::setDepthWriteEnable(VkBool32 depth_write_enable)
 {
-	vkCmdSetDepthWriteEnable(vk_handle, depth_write_enable);
+	if (updateState(STATE_DEPTH_WRITE, shadow.depth_write, depth_write_enable))
+	{
+		vkCmdSetDepthWriteEnable(vk_handle, depth_write_enable);
+	}
 }
 
 void CorE::CommandBuffer::setDepthBoundsTestEnable(VkBool32 depth_bounds_test_enable)
 {
-	vkCmdSetDepthBoundsTestEnable(vk_handle, depth_bounds_test_enable);
+	if (updateState(STATE_DEPTH_BOUNDS_TEST, shadow.depth_bounds_test, depth_bounds_test_enable))
+	{
+		vkCmdSetDepthBoundsTestEnable(vk_handle, depth_bounds_test_enable);
+	}
 }
 
 void CorE::CommandBuffer::setDepthBounds(float min_depth_bounds, float max_depth_bounds)
 {
-	vkCmdSetDepthBounds(vk_handle, min_depth_bounds, max_depth_bounds);
+	if (updateState(STATE_DEPTH_BOUNDS, shadow.depth_bounds, arr<float, 2>{ min_depth_bounds, max_depth_bounds }))
+	{
+		vkCmdSetDepthBounds(vk_handle, min_depth_bounds, max_depth_bounds);
+	}
 }
 
 void CorE::CommandBuffer::setDepthBiasEnable(VkBool32 depth_bias_enable)
 {
-	vkCmdSetDepthBiasEnable(vk_handle, depth_bias_enable);
+	if (updateState(STATE_DEPTH_BIAS_ENABLE, shadow.depth_bias_enable, depth_bias_enable))
+	{
+		vkCmdSetDepthBiasEnable(vk_handle, depth_bias_enable);
+	}
 }
 
 void CorE::CommandBuffer::setDepthBias(float depth_bias_constant, float depth_bias_clamp, float depth_bias_slope)
 {
-	vkCmdSetDepthBias(vk_handle, depth_bias_constant, depth_bias_clamp, depth_bias_slope);
+	if (updateState(STATE_DEPTH_BIAS, shadow.depth_bias,
+		arr<float, 3>{ depth_bias_constant, depth_bias_clamp, depth_bias_slope }))
+	{
+		vkCmdSetDepthBias(vk_handle, depth_bias_constant, depth_bias_clamp, depth_bias_slope);
+	}
 }
 
 CorE::Display::Display(VkDisplayPropertiesKHR props, PhysicalDevice* p_phys_device)
@@ -210,13 +345,15 @@ CorE::Display::Display(VkDisplayPropertiesKHR props, PhysicalDevice* p_phys_devi
 CorE::Queue::Semaphore::Semaphore(LogicalDevice* p_device, VkSemaphoreType type, uint64_t initial_value)
 {
 	this->type = type;
+	this->p_device = p_device;
 	VkSemaphoreCreateInfo semaphore_info{};
 	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 	semaphore_info.flags = 0;
 
+	// Must outlive vkCreateSemaphore, which reads it through pNext.
+	VkSemaphoreTypeCreateInfo type_info{};
 	if (type == VK_SEMAPHORE_TYPE_TIMELINE)
 	{
-		VkSemaphoreTypeCreateInfo type_info{};
 		type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
 		type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
 		type_info.initialValue = initial_value;
@@ -253,15 +390,13 @@ void CorE::PhysicalDevice::enumerateDeviceLayers()
 	uint32_t layer_count;
 	ensureVkSuccess(vkEnumerateDeviceLayerProperties(vk_handle, &layer_count, nullptr),
 		"Failed to enumerate device layers.");
+	// Device layers are deprecated, most drivers (e.g. lavapipe) have none, which is fine.
+	layer_props.resize(layer_count);
 	if (layer_count != 0)
 	{
 		ensureVkSuccess(vkEnumerateDeviceLayerProperties(vk_handle, &layer_count, layer_props.data()),
 			"Failed to enumerate device layers.");
 	}
-	else
-	{
-		throw std::exception("Error - No available layers found for current device.");
-	}
 } // PhysicalDevice::enumerateDeviceLayers()
 
 VkPhysicalDeviceFeatures CorE::PhysicalDevice::getFeatures()
@@ -332,9 +467,7 @@ void CorE::CommandPool::reset(VkCommandPoolResetFlags flags)
 
 void CorE::CommandPool::allocBuffers(std::vector<VkCommandBufferLevel> levels, std::vector<uint32_t> quantities)
 {
-	vec<VkCommandBufferAllocateInfo> infos(levels.size());
-	bool single_per_level;
-	quantities.empty() ? single_per_level = true : single_per_level = false;
+	const bool single_per_level = quantities.empty();
 	for (size_t i = 0; i < levels.size(); i++)
 	{
 		VkCommandBufferAllocateInfo info{};
@@ -342,32 +475,51 @@ void CorE::CommandPool::allocBuffers(std::vector<VkCommandBufferLevel> levels, s
 		info.commandPool = vk_handle;
 		info.level = levels[i];
 		info.commandBufferCount = single_per_level ? 1 : quantities[i];
-		info.commandBufferCount = quantities[i];
-		infos.push_back(info);
-	}
-	vec<VkCommandBuffer> raw_buffers(levels.size());
-	ensureVkSuccess(vkAllocateCommandBuffers(p_parent->vk_handle, infos.data(), raw_buffers.data()),
-		"Failed to allocate command buffers.");
+		if (info.commandBufferCount == 0)
+		{
+			continue;
+		}
 
-	for (size_t i = 0; i < raw_buffers.size(); i++)
-	{
-		CommandBuffer buffer(raw_buffers[i], this, command_buffers.size() + 1);
+		vec<VkCommandBuffer> raw_buffers(info.commandBufferCount);
+		ensureVkSuccess(vkAllocateCommandBuffers(p_parent->vk_handle, &info, raw_buffers.data()),
+			"Failed to allocate command buffers.");
 
-		command_buffers.push_back(buffer);
+		for (size_t j = 0; j < raw_buffers.size(); j++)
+		{
+			command_buffers.push_back(CommandBuffer(raw_buffers[j], this, static_cast<uint32_t>(command_buffers.size())));
+		}
 	}
 } // void CommandPool::allocBuffers()
 
 void CorE::CommandPool::freeBuffers(std::vector<uint32_t> buffer_indices)
 {
-	for (size_t i = 0; i < buffer_indices.size(); i++)
+	// Erased from the back, so that indices still to be erased stay valid.
+	std::sort(buffer_indices.begin(), buffer_indices.end());
+	buffer_indices.erase(std::unique(buffer_indices.begin(), buffer_indices.end()), buffer_indices.end());
+
+	vec<VkCommandBuffer> raw_buffers;
+	raw_buffers.reserve(buffer_indices.size());
+	for (size_t i = buffer_indices.size(); i-- > 0;)
 	{
+		raw_buffers.push_back(command_buffers[buffer_indices[i]].vk_handle);
 		command_buffers.erase(command_buffers.begin() + buffer_indices[i]);
 	}
+	if (!raw_buffers.empty())
+	{
+		vkFreeCommandBuffers(p_parent->vk_handle, vk_handle, static_cast<uint32_t>(raw_buffers.size()), raw_buffers.data());
+	}
+
+	for (size_t i = 0; i < command_buffers.size(); i++)
+	{
+		command_buffers[i].index = static_cast<uint32_t>(i);
+	}
 } // void CommandPool::freeBuffers()
 
 CorE::CommandPool::~CommandPool()
 {
-	vkDestroyCommandPool(p_parent->vk_handle, vk_handle, nullptr);
+	vec<CommandPool*>& pools = p_parent->command_pools;
+	pools.erase(std::remove(pools.begin(), pools.end(), this), pools.end());
+	vkDestroyCommandPool(p_parent->vk_handle, vk_handle, p_allocator);
 } // CommandPool::~CommandPool()
 
 CorE::QueueFamily CorE::CommandPool::getQueueFamily()
@@ -385,18 +537,177 @@ std::vector<CorE::CommandBuffer> CorE::CommandPool::getCommandBuffers()
 	return command_buffers;
 } // std::vector<CommandBuffer> CommandPool::getCommandBuffers()
 
+namespace
+{
+	std::atomic<uint64_t> next_pool_manager_id = 1;
+
+	// Pools the calling thread used last, saves a lookup under lock on every acquire.
+	struct ThreadPoolsCache
+	{
+		uint64_t manager_id = 0;
+		CorE::CommandPoolManager::ThreadPools* p_pools = nullptr;
+	};
+	thread_local ThreadPoolsCache tls_pools_cache;
+
+	// Smallest number of buffers allocated at once, so pools warm up in a few frames.
+	constexpr uint32_t MIN_BUFFER_BATCH = 4;
+} // anonymous namespace
+
+CorE::CommandPoolManager::CommandPoolManager(LogicalDevice* p_device, QueueFamily* p_queue_family,
+	uint32_t frames_in_flight, const VkAllocationCallbacks* p_allocator)
+	: p_device(p_device), p_queue_family(p_queue_family), p_allocator(p_allocator),
+	frames_in_flight(std::max(1u, frames_in_flight)), retirements(std::max(1u, frames_in_flight)),
+	id(next_pool_manager_id++)
+{
+
+} // CommandPoolManager::CommandPoolManager()
+
+void CorE::CommandPoolManager::beginFrame()
+{
+	const uint32_t slot = getFrameIndex();
+	Retirement& retirement = retirements[slot];
+	if (retirement.fence != VK_NULL_HANDLE)
+	{
+		ensureVkSuccess(vkWaitForFences(p_device->vk_handle, 1, &retirement.fence, VK_TRUE, UINT64_MAX),
+			"Failed to wait for a frame fence.");
+	}
+	else if (retirement.timeline != VK_NULL_HANDLE)
+	{
+		VkSemaphoreWaitInfo wait_info{};
+		wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		wait_info.semaphoreCount = 1;
+		wait_info.pSemaphores = &retirement.timeline;
+		wait_info.pValues = &retirement.value;
+		ensureVkSuccess(vkWaitSemaphores(p_device->vk_handle, &wait_info, UINT64_MAX),
+			"Failed to wait for a frame timeline value.");
+	}
+	retirement = Retirement();
+
+	// Flags are 0, so pools keep their memory for the next time the slot is used.
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	for (uptr<ThreadPools>& p_thread : threads)
+	{
+		FramePool& frame = p_thread->frames[slot];
+		if (frame.p_pool && (frame.used_primaries != 0 || frame.used_secondaries != 0))
+		{
+			frame.p_pool->reset(0);
+		}
+		frame.used_primaries = 0;
+		frame.used_secondaries = 0;
+	}
+} // void CommandPoolManager::beginFrame()
+
+CorE::CommandBuffer* CorE::CommandPoolManager::acquireBuffer(VkCommandBufferLevel level)
+{
+	FramePool& frame = getThreadPools()->frames[getFrameIndex()];
+	if (!frame.p_pool)
+	{
+		// Created here, so that the owner thread of the pool is the one that records.
+		// Locked, as pools register themselves in the device.
+		std::lock_guard<std::mutex> lock(threads_mutex);
+		frame.p_pool = std::make_unique<CommandPool>(p_device, p_queue_family,
+			VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, p_allocator);
+	}
+
+	const bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	std::deque<CommandBuffer>& buffers = primary ? frame.primaries : frame.secondaries;
+	size_t& used = primary ? frame.used_primaries : frame.used_secondaries;
+
+	if (used == buffers.size())
+	{
+		// Grows geometrically, so a thread that records many buffers allocates rarely.
+		const uint32_t count = std::max(MIN_BUFFER_BATCH, static_cast<uint32_t>(buffers.size()));
+		const size_t first = frame.p_pool->command_buffers.size();
+		frame.p_pool->allocBuffers({ level }, { count });
+		buffers.insert(buffers.end(), frame.p_pool->command_buffers.begin() + first, frame.p_pool->command_buffers.end());
+		allocated_count += count;
+	}
+	return &buffers[used++];
+} // CommandBuffer* CommandPoolManager::acquireBuffer()
+
+void CorE::CommandPoolManager::endFrame(VkFence fence)
+{
+	retirements[getFrameIndex()].fence = fence;
+	frame_count++;
+} // void CommandPoolManager::endFrame()
+
+void CorE::CommandPoolManager::endFrame(Queue::Semaphore* p_timeline, uint64_t value)
+{
+	Retirement& retirement = retirements[getFrameIndex()];
+	retirement.timeline = p_timeline->vk_handle;
+	retirement.value = value;
+	frame_count++;
+} // void CommandPoolManager::endFrame()
+
+uint32_t CorE::CommandPoolManager::getFrameIndex()
+{
+	return static_cast<uint32_t>(frame_count % frames_in_flight);
+} // uint32_t CommandPoolManager::getFrameIndex()
+
+uint32_t CorE::CommandPoolManager::getFramesInFlight()
+{
+	return frames_in_flight;
+} // uint32_t CommandPoolManager::getFramesInFlight()
+
+size_t CorE::CommandPoolManager::getAllocatedCount()
+{
+	return allocated_count;
+} // size_t CommandPoolManager::getAllocatedCount()
+
+CorE::CommandPoolManager::ThreadPools* CorE::CommandPoolManager::getThreadPools()
+{
+	if (tls_pools_cache.manager_id == id)
+	{
+		return tls_pools_cache.p_pools;
+	}
+
+	const std::thread::id thread_id = std::this_thread::get_id();
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	ThreadPools* p_pools = nullptr;
+	for (uptr<ThreadPools>& p_thread : threads)
+	{
+		if (p_thread->thread_id == thread_id)
+		{
+			p_pools = p_thread.get();
+			break;
+		}
+	}
+	if (!p_pools)
+	{
+		threads.push_back(std::make_unique<ThreadPools>());
+		p_pools = threads.back().get();
+		p_pools->thread_id = thread_id;
+		p_pools->frames.resize(frames_in_flight);
+	}
+
+	tls_pools_cache.manager_id = id;
+	tls_pools_cache.p_pools = p_pools;
+	return p_pools;
+} // ThreadPools* CommandPoolManager::getThreadPools()
+
 void CorE::CommandBuffer::beginRenderPass(VkRenderingInfo* p_info)
 {
 
 	vkCmdBeginRendering(vk_handle, p_info);
 }
 
+void CorE::CommandBuffer::endRenderPass()
+{
+	vkCmdEndRendering(vk_handle);
+} // void CommandBuffer::endRenderPass()
+
 // Shaders must be linked before binding.
 void CorE::CommandBuffer::bindShader(Graphics::Shader* p_shader, VkShaderStageFlagBits stage)
 {
 	vkCmdBindShadersEXT(this->vk_handle, 1, &stage, &p_shader->vk_handle);
 }
 
+void CorE::CommandBuffer::bindShaders(Graphics::ShaderGroup* p_group)
+{
+	vkCmdBindShadersEXT(vk_handle, static_cast<uint32_t>(p_group->stages.size()), p_group->stages.data(),
+		p_group->vk_handles.data());
+} // void CommandBuffer::bindShaders()
+
 void CorE::CommandBuffer::begin(VkCommandBufferUsageFlags flags, VkCommandBufferInheritanceInfo* p_inherit_info)
 {
 	const VkCommandBufferBeginInfo info
@@ -409,6 +720,11 @@ void CorE::CommandBuffer::begin(VkCommandBufferUsageFlags flags, VkCommandBuffer
 
 	ensureVkSuccess(vkBeginCommandBuffer(vk_handle, &info),
 		"Failed to begin recording to a command buffer.");
+	p_next = nullptr;
+	p_prev = nullptr;
+	// Recording starts with all dynamic state undefined, also in secondary buffers, which inherit none.
+	state_known = 0;
+	state_stats = {};
 } // void CommandBuffer::begin()
 
 void CorE::CommandBuffer::end()
@@ -419,14 +735,70 @@ void CorE::CommandBuffer::end()
 
 void CorE::CommandBuffer::chain(std::vector<CorE::CommandBuffer*> buffers)
 {
+	if (buffers.empty())
+	{
+		return;
+	}
+
+	vec<VkCommandBuffer> raw_buffers(buffers.size());
+	CommandBuffer* p_last = this;
+	while (p_last->p_next)
+	{
+		p_last = p_last->p_next;
+	}
 	for (size_t i = 0; i < buffers.size(); i++)
 	{
-		vkCmdExecuteCommands(vk_handle, 1, &buffers[i]->vk_handle);
-		p_next = buffers[i];
-		buffers[i]->p_prev = this;
+		raw_buffers[i] = buffers[i]->vk_handle;
+		p_last->p_next = buffers[i];
+		buffers[i]->p_prev = p_last;
+		buffers[i]->p_next = nullptr;
+		p_last = buffers[i];
 	}
+	vkCmdExecuteCommands(vk_handle, static_cast<uint32_t>(raw_buffers.size()), raw_buffers.data());
+	// Dynamic state set by the secondary buffers is left undefined once they are executed.
+	invalidateState();
 } // void CommandBuffer::chain()
 
+void CorE::CommandBuffer::recordParallel(CommandPoolManager* p_pools, JobSystem* p_jobs,
+	const VkCommandBufferInheritanceRenderingInfo& rendering, size_t draw_count, size_t grain,
+	const std::function<void(CommandBuffer* p_buffer, size_t first, size_t last)>& record)
+{
+	if (draw_count == 0)
+	{
+		return;
+	}
+	if (grain == 0)
+	{
+		grain = (draw_count + p_jobs->getThreadCount() - 1) / p_jobs->getThreadCount();
+	}
+	const size_t range_count = (draw_count + grain - 1) / grain;
+
+	VkCommandBufferInheritanceRenderingInfo rendering_info = rendering;
+	rendering_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+	// Only the primary buffer declares that it executes secondaries.
+	rendering_info.flags &= ~VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+	VkCommandBufferInheritanceInfo inherit_info{};
+	inherit_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inherit_info.pNext = &rendering_info;
+
+	// Every range writes its own slot, so the order does not depend on which job finished first.
+	vec<CommandBuffer*> secondaries(range_count);
+	p_jobs->parallelFor(0, range_count, 1, [&](size_t first_range, size_t last_range)
+	{
+		for (size_t range = first_range; range < last_range; range++)
+		{
+			// Taken on the recording thread, so it comes from a pool of that thread.
+			CommandBuffer* p_secondary = p_pools->acquireBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+			p_secondary->begin(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+				&inherit_info);
+			record(p_secondary, range * grain, std::min(draw_count, (range + 1) * grain));
+			p_secondary->end();
+			secondaries[range] = p_secondary;
+		}
+	});
+	chain(secondaries);
+} // void CommandBuffer::recordParallel()
+
 namespace
 {
 	VkInstanceCreateInfo createVkInstanceInfo(VkApplicationInfo app_info, uint32_t ext_count, const char** pp_ext_names)
@@ -526,6 +898,129 @@ VkSemaphoreType CorE::Queue::Semaphore::getType()
 	return type;
 }
 
+void CorE::Queue::Semaphore::wait(uint64_t value)
+{
+	VkSemaphoreWaitInfo wait_info{};
+	wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &vk_handle;
+	wait_info.pValues = &value;
+	ensureVkSuccess(vkWaitSemaphores(p_device->vk_handle, &wait_info, UINT64_MAX),
+		"Failed to wait for a semaphore.");
+} // void Queue::Semaphore::wait()
+
+uint64_t CorE::Queue::Semaphore::getValue()
+{
+	uint64_t value;
+	ensureVkSuccess(vkGetSemaphoreCounterValue(p_device->vk_handle, vk_handle, &value),
+		"Failed to get value of a semaphore.");
+	return value;
+} // uint64_t Queue::Semaphore::getValue()
+
+namespace
+{
+	VkSemaphoreSubmitInfo createSemaphoreSubmitInfo(CorE::Queue::Semaphore* p_semaphore, uint64_t value, VkPipelineStageFlags2 stages)
+	{
+		VkSemaphoreSubmitInfo info{};
+		info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		info.semaphore = p_semaphore->vk_handle;
+		info.value = p_semaphore->type == VK_SEMAPHORE_TYPE_TIMELINE ? value : 0;
+		info.stageMask = stages;
+		return info;
+	}
+} // anonymous namespace
+
+void CorE::Queue::submitBuffers(const std::vector<CommandBuffer*>& buffers)
+{
+	// Buffers after a signal would delay it, so they start a batch of their own.
+	if (pending_count == 0 || !pending_batches[pending_count - 1].signals.empty())
+	{
+		startBatch();
+	}
+	Batch& batch = pending_batches[pending_count - 1];
+	for (CommandBuffer* p_buffer : buffers)
+	{
+		VkCommandBufferSubmitInfo info{};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+		info.commandBuffer = p_buffer->vk_handle;
+		batch.buffers.push_back(info);
+	}
+} // void Queue::submitBuffers()
+
+void CorE::Queue::waitFor(Semaphore* p_semaphore, uint64_t value, VkPipelineStageFlags2 stages)
+{
+	// Waits hold up the whole batch, so buffers added before must not be in it.
+	if (pending_count == 0 || !pending_batches[pending_count - 1].buffers.empty()
+		|| !pending_batches[pending_count - 1].signals.empty())
+	{
+		startBatch();
+	}
+	pending_batches[pending_count - 1].waits.push_back(createSemaphoreSubmitInfo(p_semaphore, value, stages));
+} // void Queue::waitFor()
+
+void CorE::Queue::signal(Semaphore* p_semaphore, uint64_t value, VkPipelineStageFlags2 stages)
+{
+	if (pending_count == 0)
+	{
+		startBatch();
+	}
+	pending_batches[pending_count - 1].signals.push_back(createSemaphoreSubmitInfo(p_semaphore, value, stages));
+} // void Queue::signal()
+
+void CorE::Queue::flush()
+{
+	if (pending_count == 0)
+	{
+		return;
+	}
+
+	submit_infos.resize(pending_count);
+	uint64_t buffer_count = 0;
+	for (size_t i = 0; i < pending_count; i++)
+	{
+		const Batch& batch = pending_batches[i];
+		VkSubmitInfo2& info = submit_infos[i];
+		info = {};
+		info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+		info.waitSemaphoreInfoCount = static_cast<uint32_t>(batch.waits.size());
+		info.pWaitSemaphoreInfos = batch.waits.data();
+		info.commandBufferInfoCount = static_cast<uint32_t>(batch.buffers.size());
+		info.pCommandBufferInfos = batch.buffers.data();
+		info.signalSemaphoreInfoCount = static_cast<uint32_t>(batch.signals.size());
+		info.pSignalSemaphoreInfos = batch.signals.data();
+		buffer_count += batch.buffers.size();
+	}
+
+	const VkResult result = vkQueueSubmit2(vk_handle, static_cast<uint32_t>(pending_count), submit_infos.data(), VK_NULL_HANDLE);
+	stats.submit_calls++;
+	stats.batches += pending_count;
+	stats.command_buffers += buffer_count;
+	pending_count = 0;
+	ensureVkSuccess(result, "Failed to submit to a queue.");
+} // void Queue::flush()
+
+void CorE::Queue::startBatch()
+{
+	if (pending_count == pending_batches.size())
+	{
+		pending_batches.emplace_back();
+	}
+	Batch& batch = pending_batches[pending_count++];
+	batch.waits.clear();
+	batch.buffers.clear();
+	batch.signals.clear();
+} // void Queue::startBatch()
+
+CorE::Queue::Stats CorE::Queue::getStats()
+{
+	return stats;
+} // Stats Queue::getStats()
+
+void CorE::Queue::resetStats()
+{
+	stats = Stats();
+} // void Queue::resetStats()
+
 CorE::Swapchain::Swapchain(LogicalDevice* p_device, VkSwapchainCreateInfoKHR info)
 {
 	this->p_device = p_device;
@@ -0,0 +1,756 @@
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "CorE/device_memory.hpp"
+
+namespace
+{
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return value & ~(alignment - 1);
+	}
+} // anonymous namespace
+
+struct CorE::detail::MemoryBlock
+{
+	VkDeviceMemory memory;
+	uint32_t memory_type;
+	// Holds a single allocation, and is released with it.
+	bool dedicated;
+	char* p_mapped;
+	TlsfHeap heap;
+	vec<DeviceAllocation*> allocations;
+};
+
+struct CorE::detail::MemoryTypePool
+{
+	uint32_t memory_type;
+	VkDeviceSize block_size;
+	std::mutex mutex;
+	vec<uptr<MemoryBlock>> blocks;
+};
+
+
+CorE::detail::TlsfHeap::TlsfHeap(VkDeviceSize size) : size(size)
+{
+	for (arr<uint32_t, SL_COUNT>& heads : free_heads)
+	{
+		heads.fill(INVALID_NODE);
+	}
+
+	const uint32_t node = createNode();
+	nodes[node].offset = 0;
+	nodes[node].size = size;
+	insertFree(node);
+} // CorE::detail::TlsfHeap::TlsfHeap(VkDeviceSize size)
+
+CorE::detail::TlsfHeap::Allocation CorE::detail::TlsfHeap::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	size = std::max<VkDeviceSize>(size, 1);
+	alignment = std::max<VkDeviceSize>(alignment, 1);
+
+	// A range this large fits the allocation wherever it starts.
+	uint32_t node = findFree(size + alignment - 1);
+	if (node == INVALID_NODE)
+	{
+		// Tighter ranges may still fit if they happen to be aligned, e.g. a whole fresh block.
+		node = findFree(size);
+		if (node == INVALID_NODE || alignUp(nodes[node].offset, alignment) + size > nodes[node].offset + nodes[node].size)
+		{
+			return { 0, INVALID_NODE };
+		}
+	}
+	removeFree(node);
+
+	const VkDeviceSize padding = alignUp(nodes[node].offset, alignment) - nodes[node].offset;
+	if (padding > 0)
+	{
+		const uint32_t front = node;
+		node = split(front, padding);
+		insertFree(front);
+	}
+	if (nodes[node].size > size)
+	{
+		insertFree(split(node, size));
+	}
+
+	used_size += nodes[node].size;
+	return { nodes[node].offset, node };
+} // CorE::detail::TlsfHeap::Allocation CorE::detail::TlsfHeap::allocate(VkDeviceSize size, VkDeviceSize alignment)
+
+void CorE::detail::TlsfHeap::free(uint32_t node)
+{
+	used_size -= nodes[node].size;
+
+	const uint32_t prev = nodes[node].prev_physical;
+	if (prev != INVALID_NODE && nodes[prev].is_free)
+	{
+		removeFree(prev);
+		nodes[prev].size += nodes[node].size;
+		nodes[prev].next_physical = nodes[node].next_physical;
+		if (nodes[node].next_physical != INVALID_NODE)
+		{
+			nodes[nodes[node].next_physical].prev_physical = prev;
+		}
+		releaseNode(node);
+		node = prev;
+	}
+
+	const uint32_t next = nodes[node].next_physical;
+	if (next != INVALID_NODE && nodes[next].is_free)
+	{
+		removeFree(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].next_physical = nodes[next].next_physical;
+		if (nodes[next].next_physical != INVALID_NODE)
+		{
+			nodes[nodes[next].next_physical].prev_physical = node;
+		}
+		releaseNode(next);
+	}
+
+	insertFree(node);
+} // void CorE::detail::TlsfHeap::free(uint32_t node)
+
+void CorE::detail::TlsfHeap::mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+{
+	if (size < SL_COUNT)
+	{
+		fl = 0;
+		sl = static_cast<uint32_t>(size);
+		return;
+	}
+	const uint32_t bit = 63 - static_cast<uint32_t>(std::countl_zero(size));
+	fl = bit - SL_SHIFT + 1;
+	sl = static_cast<uint32_t>(size >> (bit - SL_SHIFT)) & (SL_COUNT - 1);
+} // void CorE::detail::TlsfHeap::mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+
+uint32_t CorE::detail::TlsfHeap::findFree(VkDeviceSize size)
+{
+	if (size > this->size)
+	{
+		return INVALID_NODE;
+	}
+	// Rounds size up to the next bin, so that every range of the bin found is large enough.
+	if (size >= SL_COUNT)
+	{
+		const uint32_t bit = 63 - static_cast<uint32_t>(std::countl_zero(size));
+		size += (VkDeviceSize(1) << (bit - SL_SHIFT)) - 1;
+	}
+
+	uint32_t fl, sl;
+	mapping(size, fl, sl);
+	if (fl >= FL_COUNT)
+	{
+		return INVALID_NODE;
+	}
+
+	uint32_t sl_map = sl_bitmaps[fl] & (~0u << sl);
+	if (!sl_map)
+	{
+		const uint64_t fl_map = fl + 1 < 64 ? fl_bitmap & (~uint64_t(0) << (fl + 1)) : 0;
+		if (!fl_map)
+		{
+			return INVALID_NODE;
+		}
+		fl = static_cast<uint32_t>(std::countr_zero(fl_map));
+		sl_map = sl_bitmaps[fl];
+	}
+	sl = static_cast<uint32_t>(std::countr_zero(sl_map));
+	return free_heads[fl][sl];
+} // uint32_t CorE::detail::TlsfHeap::findFree(VkDeviceSize size)
+
+void CorE::detail::TlsfHeap::insertFree(uint32_t node)
+{
+	uint32_t fl, sl;
+	mapping(nodes[node].size, fl, sl);
+
+	const uint32_t head = free_heads[fl][sl];
+	nodes[node].prev_free = INVALID_NODE;
+	nodes[node].next_free = head;
+	nodes[node].is_free = true;
+	if (head != INVALID_NODE)
+	{
+		nodes[head].prev_free = node;
+	}
+	free_heads[fl][sl] = node;
+	fl_bitmap |= uint64_t(1) << fl;
+	sl_bitmaps[fl] |= 1u << sl;
+} // void CorE::detail::TlsfHeap::insertFree(uint32_t node)
+
+void CorE::detail::TlsfHeap::removeFree(uint32_t node)
+{
+	uint32_t fl, sl;
+	mapping(nodes[node].size, fl, sl);
+
+	const uint32_t prev = nodes[node].prev_free;
+	const uint32_t next = nodes[node].next_free;
+	if (prev != INVALID_NODE)
+	{
+		nodes[prev].next_free = next;
+	}
+	if (next != INVALID_NODE)
+	{
+		nodes[next].prev_free = prev;
+	}
+	if (free_heads[fl][sl] == node)
+	{
+		free_heads[fl][sl] = next;
+		if (next == INVALID_NODE)
+		{
+			sl_bitmaps[fl] &= ~(1u << sl);
+			if (!sl_bitmaps[fl])
+			{
+				fl_bitmap &= ~(uint64_t(1) << fl);
+			}
+		}
+	}
+	nodes[node].is_free = false;
+} // void CorE::detail::TlsfHeap::removeFree(uint32_t node)
+
+uint32_t CorE::detail::TlsfHeap::split(uint32_t node, VkDeviceSize size)
+{
+	// May reallocate nodes, so no references are held across it.
+	const uint32_t rest = createNode();
+	nodes[rest].offset = nodes[node].offset + size;
+	nodes[rest].size = nodes[node].size - size;
+	nodes[rest].prev_physical = node;
+	nodes[rest].next_physical = nodes[node].next_physical;
+	if (nodes[node].next_physical != INVALID_NODE)
+	{
+		nodes[nodes[node].next_physical].prev_physical = rest;
+	}
+	nodes[node].size = size;
+	nodes[node].next_physical = rest;
+	return rest;
+} // uint32_t CorE::detail::TlsfHeap::split(uint32_t node, VkDeviceSize size)
+
+uint32_t CorE::detail::TlsfHeap::createNode()
+{
+	if (!spare_nodes.empty())
+	{
+		const uint32_t node = spare_nodes.back();
+		spare_nodes.pop_back();
+		nodes[node] = Node{};
+		return node;
+	}
+	nodes.emplace_back();
+	return static_cast<uint32_t>(nodes.size() - 1);
+} // uint32_t CorE::detail::TlsfHeap::createNode()
+
+void CorE::detail::TlsfHeap::releaseNode(uint32_t node)
+{
+	spare_nodes.push_back(node);
+} // void CorE::detail::TlsfHeap::releaseNode(uint32_t node)
+
+
+CorE::DeviceMemoryAllocator::DeviceMemoryAllocator(LogicalDevice* p_device, const DeviceMemoryProperties& props)
+	: p_device(p_device), props(props)
+{
+	const VkPhysicalDevice physical_device = p_device->p_parent->vk_handle;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_props);
+	VkPhysicalDeviceProperties device_props;
+	vkGetPhysicalDeviceProperties(physical_device, &device_props);
+	buffer_image_granularity = std::max<VkDeviceSize>(device_props.limits.bufferImageGranularity, 1);
+	non_coherent_atom_size = std::max<VkDeviceSize>(device_props.limits.nonCoherentAtomSize, 1);
+
+	if (this->props.dedicated_threshold == 0)
+	{
+		this->props.dedicated_threshold = this->props.block_size / 2;
+	}
+
+	for (uint32_t i = 0; i < memory_props.memoryTypeCount; i++)
+	{
+		uptr<detail::MemoryTypePool> p_pool = std::make_unique<detail::MemoryTypePool>();
+		p_pool->memory_type = i;
+		p_pool->block_size = this->props.block_size;
+		const VkDeviceSize heap_size = memory_props.memoryHeaps[memory_props.memoryTypes[i].heapIndex].size;
+		if (heap_size < (VkDeviceSize(1) << 30))
+		{
+			p_pool->block_size = std::min(p_pool->block_size, alignUp(heap_size / 8, 4096));
+		}
+		pools.push_back(std::move(p_pool));
+	}
+
+	heap_budgets.resize(memory_props.memoryHeapCount);
+	for (uint32_t i = 0; i < memory_props.memoryHeapCount; i++)
+	{
+		getBudget(i);
+	}
+} // CorE::DeviceMemoryAllocator::DeviceMemoryAllocator(LogicalDevice* p_device, const DeviceMemoryProperties& props)
+
+CorE::DeviceMemoryAllocator::~DeviceMemoryAllocator()
+{
+	for (uptr<detail::MemoryTypePool>& p_pool : pools)
+	{
+		for (uptr<detail::MemoryBlock>& p_block : p_pool->blocks)
+		{
+			for (DeviceAllocation* p_allocation : p_block->allocations)
+			{
+				delete p_allocation;
+			}
+			vkFreeMemory(p_device->vk_handle, p_block->memory, props.p_allocator);
+		}
+	}
+} // CorE::DeviceMemoryAllocator::~DeviceMemoryAllocator()
+
+CorE::DeviceAllocation* CorE::DeviceMemoryAllocator::allocate(const DeviceAllocationInfo& info)
+{
+	VkDeviceSize size = info.requirements.size;
+	VkDeviceSize alignment = std::max<VkDeviceSize>(info.requirements.alignment, 1);
+	if (info.optimal_image)
+	{
+		alignment = std::max(alignment, buffer_image_granularity);
+		size = alignUp(size, buffer_image_granularity);
+	}
+	const bool dedicated = info.dedicated || size > props.dedicated_threshold;
+
+	// Candidates ordered by preferred flags they have, then by being within budget, then by index,
+	// which the specification already sorts from the most to the least performant.
+	struct Candidate
+	{
+		uint32_t memory_type;
+		int preferred_count;
+		bool over_budget;
+	};
+	vec<Candidate> candidates;
+	{
+		std::lock_guard<std::mutex> lock(heaps_mutex);
+		for (uint32_t i = 0; i < memory_props.memoryTypeCount; i++)
+		{
+			const VkMemoryPropertyFlags flags = memory_props.memoryTypes[i].propertyFlags;
+			if (!(info.requirements.memoryTypeBits & (1u << i)) || (flags & info.required_flags) != info.required_flags)
+			{
+				continue;
+			}
+			const HeapBudget& heap = heap_budgets[memory_props.memoryTypes[i].heapIndex];
+			candidates.push_back({ i, std::popcount(flags & info.preferred_flags), heap.block_bytes + size > heap.budget });
+		}
+	}
+	std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b)
+	{
+		if (a.preferred_count != b.preferred_count)
+		{
+			return a.preferred_count > b.preferred_count;
+		}
+		return !a.over_budget && b.over_budget;
+	});
+
+	for (const Candidate& candidate : candidates)
+	{
+		if (DeviceAllocation* p_allocation = allocateFromType(candidate.memory_type, size, alignment, dedicated))
+		{
+			return p_allocation;
+		}
+	}
+	throw std::runtime_error("Failed to allocate device memory.");
+} // CorE::DeviceAllocation* CorE::DeviceMemoryAllocator::allocate(const DeviceAllocationInfo& info)
+
+void CorE::DeviceMemoryAllocator::free(DeviceAllocation* p_allocation)
+{
+	if (!p_allocation)
+	{
+		return;
+	}
+	detail::MemoryBlock* p_block = p_allocation->p_block;
+	detail::MemoryTypePool& pool = *pools[p_block->memory_type];
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		p_block->heap.free(p_allocation->heap_node);
+		unlinkAllocation(p_allocation);
+		{
+			std::lock_guard<std::mutex> heaps_lock(heaps_mutex);
+			heap_budgets[memory_props.memoryTypes[p_block->memory_type].heapIndex].allocation_bytes -= p_allocation->size;
+		}
+		if (p_block->dedicated)
+		{
+			destroyBlock(pool, p_block);
+		}
+		else if (p_block->heap.isEmpty())
+		{
+			trimPool(pool);
+		}
+	}
+	delete p_allocation;
+} // void CorE::DeviceMemoryAllocator::free(DeviceAllocation* p_allocation)
+
+VkBuffer CorE::DeviceMemoryAllocator::createBuffer(const VkBufferCreateInfo& info, VkMemoryPropertyFlags required_flags,
+	VkMemoryPropertyFlags preferred_flags, DeviceAllocation** pp_allocation)
+{
+	VkBuffer buffer;
+	ensureVkSuccess(vkCreateBuffer(p_device->vk_handle, &info, props.p_allocator, &buffer), "Failed to create buffer.");
+
+	DeviceAllocationInfo alloc_info{};
+	vkGetBufferMemoryRequirements(p_device->vk_handle, buffer, &alloc_info.requirements);
+	alloc_info.required_flags = required_flags;
+	alloc_info.preferred_flags = preferred_flags;
+
+	DeviceAllocation* p_allocation;
+	try
+	{
+		p_allocation = allocate(alloc_info);
+	}
+	catch (...)
+	{
+		vkDestroyBuffer(p_device->vk_handle, buffer, props.p_allocator);
+		throw;
+	}
+	ensureVkSuccess(vkBindBufferMemory(p_device->vk_handle, buffer, p_allocation->memory, p_allocation->offset),
+		"Failed to bind buffer memory.");
+	*pp_allocation = p_allocation;
+	return buffer;
+} // VkBuffer CorE::DeviceMemoryAllocator::createBuffer(const VkBufferCreateInfo& info, ...)
+
+VkImage CorE::DeviceMemoryAllocator::createImage(const VkImageCreateInfo& info, VkMemoryPropertyFlags required_flags,
+	VkMemoryPropertyFlags preferred_flags, DeviceAllocation** pp_allocation)
+{
+	VkImage image;
+	ensureVkSuccess(vkCreateImage(p_device->vk_handle, &info, props.p_allocator, &image), "Failed to create image.");
+
+	DeviceAllocationInfo alloc_info{};
+	vkGetImageMemoryRequirements(p_device->vk_handle, image, &alloc_info.requirements);
+	alloc_info.required_flags = required_flags;
+	alloc_info.preferred_flags = preferred_flags;
+	alloc_info.optimal_image = info.tiling == VK_IMAGE_TILING_OPTIMAL;
+
+	DeviceAllocation* p_allocation;
+	try
+	{
+		p_allocation = allocate(alloc_info);
+	}
+	catch (...)
+	{
+		vkDestroyImage(p_device->vk_handle, image, props.p_allocator);
+		throw;
+	}
+	ensureVkSuccess(vkBindImageMemory(p_device->vk_handle, image, p_allocation->memory, p_allocation->offset),
+		"Failed to bind image memory.");
+	*pp_allocation = p_allocation;
+	return image;
+} // VkImage CorE::DeviceMemoryAllocator::createImage(const VkImageCreateInfo& info, ...)
+
+void CorE::DeviceMemoryAllocator::destroyBuffer(VkBuffer buffer, DeviceAllocation* p_allocation)
+{
+	vkDestroyBuffer(p_device->vk_handle, buffer, props.p_allocator);
+	free(p_allocation);
+} // void CorE::DeviceMemoryAllocator::destroyBuffer(VkBuffer buffer, DeviceAllocation* p_allocation)
+
+void CorE::DeviceMemoryAllocator::destroyImage(VkImage image, DeviceAllocation* p_allocation)
+{
+	vkDestroyImage(p_device->vk_handle, image, props.p_allocator);
+	free(p_allocation);
+} // void CorE::DeviceMemoryAllocator::destroyImage(VkImage image, DeviceAllocation* p_allocation)
+
+void CorE::DeviceMemoryAllocator::flush(DeviceAllocation* p_allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (memory_props.memoryTypes[p_allocation->memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	{
+		return;
+	}
+	const VkMappedMemoryRange range = createAtomRange(p_allocation, offset, size);
+	ensureVkSuccess(vkFlushMappedMemoryRanges(p_device->vk_handle, 1, &range), "Failed to flush memory.");
+} // void CorE::DeviceMemoryAllocator::flush(DeviceAllocation* p_allocation, VkDeviceSize offset, VkDeviceSize size)
+
+void CorE::DeviceMemoryAllocator::invalidate(DeviceAllocation* p_allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (memory_props.memoryTypes[p_allocation->memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	{
+		return;
+	}
+	const VkMappedMemoryRange range = createAtomRange(p_allocation, offset, size);
+	ensureVkSuccess(vkInvalidateMappedMemoryRanges(p_device->vk_handle, 1, &range), "Failed to invalidate memory.");
+} // void CorE::DeviceMemoryAllocator::invalidate(DeviceAllocation* p_allocation, VkDeviceSize offset, VkDeviceSize size)
+
+CorE::HeapBudget CorE::DeviceMemoryAllocator::getBudget(uint32_t heap_index)
+{
+	std::lock_guard<std::mutex> lock(heaps_mutex);
+	HeapBudget& heap = heap_budgets[heap_index];
+	if (props.use_memory_budget)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props{};
+		budget_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memory_props_2{};
+		memory_props_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memory_props_2.pNext = &budget_props;
+		vkGetPhysicalDeviceMemoryProperties2(p_device->p_parent->vk_handle, &memory_props_2);
+		heap.usage = budget_props.heapUsage[heap_index];
+		heap.budget = budget_props.heapBudget[heap_index];
+	}
+	else
+	{
+		heap.usage = heap.block_bytes;
+		heap.budget = memory_props.memoryHeaps[heap_index].size / 10 * 8;
+	}
+	return heap;
+} // CorE::HeapBudget CorE::DeviceMemoryAllocator::getBudget(uint32_t heap_index)
+
+size_t CorE::DeviceMemoryAllocator::getBlockCount()
+{
+	size_t count = 0;
+	for (uptr<detail::MemoryTypePool>& p_pool : pools)
+	{
+		std::lock_guard<std::mutex> lock(p_pool->mutex);
+		count += p_pool->blocks.size();
+	}
+	return count;
+} // size_t CorE::DeviceMemoryAllocator::getBlockCount()
+
+vec<CorE::DefragmentationMove> CorE::DeviceMemoryAllocator::beginDefragmentation(VkDeviceSize max_bytes)
+{
+	vec<DefragmentationMove> moves;
+	VkDeviceSize moved_bytes = 0;
+	for (uptr<detail::MemoryTypePool>& p_pool : pools)
+	{
+		std::lock_guard<std::mutex> lock(p_pool->mutex);
+
+		vec<detail::MemoryBlock*> blocks;
+		for (uptr<detail::MemoryBlock>& p_block : p_pool->blocks)
+		{
+			if (!p_block->dedicated)
+			{
+				blocks.push_back(p_block.get());
+			}
+		}
+		std::sort(blocks.begin(), blocks.end(), [](const detail::MemoryBlock* a, const detail::MemoryBlock* b)
+		{
+			return a->heap.getUsedSize() < b->heap.getUsedSize();
+		});
+
+		// Empties the sparsest blocks into the fuller ones, a whole block at a time,
+		// since moving only part of a block frees no memory. Stops at the first block
+		// moved into, as its reserved ranges are not among its allocations and it could never be emptied.
+		size_t first_dst = blocks.size();
+		for (size_t src = 0; src < first_dst && src + 1 < blocks.size(); src++)
+		{
+			detail::MemoryBlock* p_src = blocks[src];
+			if (p_src->heap.isEmpty())
+			{
+				continue;
+			}
+			if (moved_bytes + p_src->heap.getUsedSize() > max_bytes)
+			{
+				break;
+			}
+
+			const size_t first_move = moves.size();
+			bool emptied = true;
+			for (DeviceAllocation* p_allocation : p_src->allocations)
+			{
+				bool placed = false;
+				for (size_t dst = blocks.size() - 1; dst > src && !placed; dst--)
+				{
+					detail::MemoryBlock* p_dst = blocks[dst];
+					const detail::TlsfHeap::Allocation range = p_dst->heap.allocate(p_allocation->size, p_allocation->alignment);
+					if (range.node != detail::TlsfHeap::INVALID_NODE)
+					{
+						moves.push_back({ p_allocation, p_dst->memory, range.offset,
+							p_dst->p_mapped ? p_dst->p_mapped + range.offset : nullptr, p_dst, range.node });
+						first_dst = std::min(first_dst, dst);
+						placed = true;
+					}
+				}
+				if (!placed)
+				{
+					emptied = false;
+					break;
+				}
+			}
+
+			if (!emptied)
+			{
+				// Fuller blocks are out of room, so later blocks would not fit either.
+				for (size_t i = first_move; i < moves.size(); i++)
+				{
+					moves[i].p_dst_block->heap.free(moves[i].dst_node);
+				}
+				moves.resize(first_move);
+				break;
+			}
+			moved_bytes += p_src->heap.getUsedSize();
+		}
+	}
+	return moves;
+} // vec<CorE::DefragmentationMove> CorE::DeviceMemoryAllocator::beginDefragmentation(VkDeviceSize max_bytes)
+
+void CorE::DeviceMemoryAllocator::endDefragmentation(const vec<DefragmentationMove>& moves)
+{
+	for (const DefragmentationMove& move : moves)
+	{
+		DeviceAllocation* p_allocation = move.p_allocation;
+		detail::MemoryTypePool& pool = *pools[p_allocation->memory_type];
+		std::lock_guard<std::mutex> lock(pool.mutex);
+
+		p_allocation->p_block->heap.free(p_allocation->heap_node);
+		unlinkAllocation(p_allocation);
+
+		p_allocation->memory = move.dst_memory;
+		p_allocation->offset = move.dst_offset;
+		p_allocation->p_mapped = move.p_dst_mapped;
+		p_allocation->p_block = move.p_dst_block;
+		p_allocation->heap_node = move.dst_node;
+		p_allocation->block_index = static_cast<uint32_t>(move.p_dst_block->allocations.size());
+		move.p_dst_block->allocations.push_back(p_allocation);
+	}
+
+	for (uptr<detail::MemoryTypePool>& p_pool : pools)
+	{
+		std::lock_guard<std::mutex> lock(p_pool->mutex);
+		trimPool(*p_pool);
+	}
+} // void CorE::DeviceMemoryAllocator::endDefragmentation(const vec<DefragmentationMove>& moves)
+
+CorE::DeviceAllocation* CorE::DeviceMemoryAllocator::allocateFromType(uint32_t memory_type, VkDeviceSize size,
+	VkDeviceSize alignment, bool dedicated)
+{
+	detail::MemoryTypePool& pool = *pools[memory_type];
+	std::lock_guard<std::mutex> lock(pool.mutex);
+
+	detail::MemoryBlock* p_block = nullptr;
+	detail::TlsfHeap::Allocation range{ 0, detail::TlsfHeap::INVALID_NODE };
+	if (!dedicated)
+	{
+		for (uptr<detail::MemoryBlock>& p_candidate : pool.blocks)
+		{
+			if (p_candidate->dedicated)
+			{
+				continue;
+			}
+			range = p_candidate->heap.allocate(size, alignment);
+			if (range.node != detail::TlsfHeap::INVALID_NODE)
+			{
+				p_block = p_candidate.get();
+				break;
+			}
+		}
+	}
+	if (!p_block)
+	{
+		p_block = createBlock(pool, dedicated ? size : std::max(pool.block_size, size), dedicated);
+		if (!p_block)
+		{
+			return nullptr;
+		}
+		range = p_block->heap.allocate(size, alignment);
+	}
+
+	DeviceAllocation* p_allocation = new DeviceAllocation;
+	p_allocation->memory = p_block->memory;
+	p_allocation->offset = range.offset;
+	p_allocation->size = size;
+	p_allocation->memory_type = memory_type;
+	p_allocation->p_mapped = p_block->p_mapped ? p_block->p_mapped + range.offset : nullptr;
+	p_allocation->p_block = p_block;
+	p_allocation->heap_node = range.node;
+	p_allocation->block_index = static_cast<uint32_t>(p_block->allocations.size());
+	p_allocation->alignment = alignment;
+	p_block->allocations.push_back(p_allocation);
+
+	std::lock_guard<std::mutex> heaps_lock(heaps_mutex);
+	heap_budgets[memory_props.memoryTypes[memory_type].heapIndex].allocation_bytes += size;
+	return p_allocation;
+} // CorE::DeviceAllocation* CorE::DeviceMemoryAllocator::allocateFromType(uint32_t memory_type, ...)
+
+CorE::detail::MemoryBlock* CorE::DeviceMemoryAllocator::createBlock(detail::MemoryTypePool& pool, VkDeviceSize size, bool dedicated)
+{
+	VkMemoryAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = pool.memory_type;
+	VkMemoryAllocateFlagsInfo flags_info{};
+	if (props.buffer_device_address)
+	{
+		flags_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+		flags_info.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+		alloc_info.pNext = &flags_info;
+	}
+
+	VkDeviceMemory memory;
+	// Running out of memory is not an error here, the caller tries other memory types.
+	if (vkAllocateMemory(p_device->vk_handle, &alloc_info, props.p_allocator, &memory) != VK_SUCCESS)
+	{
+		return nullptr;
+	}
+
+	void* p_mapped = nullptr;
+	if (memory_props.memoryTypes[pool.memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		if (vkMapMemory(p_device->vk_handle, memory, 0, VK_WHOLE_SIZE, 0, &p_mapped) != VK_SUCCESS)
+		{
+			vkFreeMemory(p_device->vk_handle, memory, props.p_allocator);
+			return nullptr;
+		}
+	}
+
+	pool.blocks.push_back(uptr<detail::MemoryBlock>(new detail::MemoryBlock{
+		memory, pool.memory_type, dedicated, static_cast<char*>(p_mapped), detail::TlsfHeap(size), {} }));
+
+	std::lock_guard<std::mutex> lock(heaps_mutex);
+	heap_budgets[memory_props.memoryTypes[pool.memory_type].heapIndex].block_bytes += size;
+	return pool.blocks.back().get();
+} // CorE::detail::MemoryBlock* CorE::DeviceMemoryAllocator::createBlock(detail::MemoryTypePool& pool, VkDeviceSize size, bool dedicated)
+
+void CorE::DeviceMemoryAllocator::destroyBlock(detail::MemoryTypePool& pool, detail::MemoryBlock* p_block)
+{
+	// Freeing memory unmaps it as well.
+	vkFreeMemory(p_device->vk_handle, p_block->memory, props.p_allocator);
+	{
+		std::lock_guard<std::mutex> lock(heaps_mutex);
+		heap_budgets[memory_props.memoryTypes[pool.memory_type].heapIndex].block_bytes -= p_block->heap.getSize();
+	}
+	pool.blocks.erase(std::find_if(pool.blocks.begin(), pool.blocks.end(),
+		[p_block](const uptr<detail::MemoryBlock>& p_other) { return p_other.get() == p_block; }));
+} // void CorE::DeviceMemoryAllocator::destroyBlock(detail::MemoryTypePool& pool, detail::MemoryBlock* p_block)
+
+void CorE::DeviceMemoryAllocator::trimPool(detail::MemoryTypePool& pool)
+{
+	bool kept = false;
+	for (size_t i = 0; i < pool.blocks.size();)
+	{
+		detail::MemoryBlock* p_block = pool.blocks[i].get();
+		if (p_block->dedicated || !p_block->heap.isEmpty())
+		{
+			i++;
+		}
+		else if (!kept)
+		{
+			kept = true;
+			i++;
+		}
+		else
+		{
+			destroyBlock(pool, p_block);
+		}
+	}
+} // void CorE::DeviceMemoryAllocator::trimPool(detail::MemoryTypePool& pool)
+
+void CorE::DeviceMemoryAllocator::unlinkAllocation(DeviceAllocation* p_allocation)
+{
+	vec<DeviceAllocation*>& allocations = p_allocation->p_block->allocations;
+	allocations[p_allocation->block_index] = allocations.back();
+	allocations[p_allocation->block_index]->block_index = p_allocation->block_index;
+	allocations.pop_back();
+} // void CorE::DeviceMemoryAllocator::unlinkAllocation(DeviceAllocation* p_allocation)
+
+VkMappedMemoryRange CorE::DeviceMemoryAllocator::createAtomRange(DeviceAllocation* p_allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+	if (size == VK_WHOLE_SIZE)
+	{
+		size = p_allocation->size - offset;
+	}
+	const VkDeviceSize block_size = p_allocation->p_block->heap.getSize();
+	const VkDeviceSize begin = alignDown(p_allocation->offset + offset, non_coherent_atom_size);
+	const VkDeviceSize end = std::min(alignUp(p_allocation->offset + offset + size, non_coherent_atom_size), block_size);
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = p_allocation->memory;
+	range.offset = begin;
+	range.size = end - begin;
+	return range;
+} // VkMappedMemoryRange CorE::DeviceMemoryAllocator::createAtomRange(DeviceAllocation* p_allocation, ...)
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "CorE/draw_list.hpp"
+
+namespace
+{
+	constexpr uint32_t RADIX_BITS = 8;
+	constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+	// Below this, a comparison sort beats eight passes over the list.
+	constexpr size_t SMALL_SORT_SIZE = 1024;
+	// Smallest block a thread sorts, so that jobs are not spent on a few packets each.
+	constexpr size_t MIN_BLOCK_SIZE = size_t(1) << 15;
+
+	/**
+	* Stable LSD radix sort, 8 bits per pass. Every block of the list is counted and
+	* scattered on a job of its own, at offsets that keep the blocks in order.
+	* Passes over a byte all keys share are skipped, which is common in high bytes.
+	* Leaves the result in entries, scratch is clobbered.
+	*/
+	template <typename Entry>
+	void radixSort(vec<Entry>& entries, vec<Entry>& scratch, CorE::JobSystem* p_jobs)
+	{
+		const size_t count = entries.size();
+		scratch.resize(count);
+
+		size_t block_count = 1;
+		if (p_jobs != nullptr)
+		{
+			block_count = std::min<size_t>(p_jobs->getThreadCount(), (count + MIN_BLOCK_SIZE - 1) / MIN_BLOCK_SIZE);
+		}
+		const size_t block_size = (count + block_count - 1) / block_count;
+		vec<arr<size_t, RADIX_SIZE>> offsets(block_count);
+
+		auto forBlocks = [&](const auto& function)
+		{
+			auto range = [&](size_t first, size_t last)
+			{
+				for (size_t block = first; block < last; block++)
+				{
+					function(block, block * block_size, std::min(count, (block + 1) * block_size));
+				}
+			};
+			if (block_count == 1)
+			{
+				range(0, 1);
+			}
+			else
+			{
+				p_jobs->parallelFor(0, block_count, 1, range);
+			}
+		};
+
+		Entry* p_src = entries.data();
+		Entry* p_dst = scratch.data();
+		for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS)
+		{
+			forBlocks([&](size_t block, size_t first, size_t last)
+			{
+				arr<size_t, RADIX_SIZE>& counts = offsets[block];
+				counts.fill(0);
+				for (size_t i = first; i < last; i++)
+				{
+					counts[(p_src[i].key >> shift) & (RADIX_SIZE - 1)]++;
+				}
+			});
+
+			// Turns counts into offsets: digit by digit, and block by block within a digit.
+			size_t offset = 0;
+			bool shared_digit = false;
+			for (uint32_t digit = 0; digit < RADIX_SIZE; digit++)
+			{
+				size_t digit_count = 0;
+				for (size_t block = 0; block < block_count; block++)
+				{
+					const size_t block_digits = offsets[block][digit];
+					offsets[block][digit] = offset + digit_count;
+					digit_count += block_digits;
+				}
+				if (digit_count == count)
+				{
+					shared_digit = true;
+					break;
+				}
+				offset += digit_count;
+			}
+			if (shared_digit)
+			{
+				continue;
+			}
+
+			forBlocks([&](size_t block, size_t first, size_t last)
+			{
+				arr<size_t, RADIX_SIZE>& block_offsets = offsets[block];
+				for (size_t i = first; i < last; i++)
+				{
+					p_dst[block_offsets[(p_src[i].key >> shift) & (RADIX_SIZE - 1)]++] = p_src[i];
+				}
+			});
+			std::swap(p_src, p_dst);
+		}
+
+		if (p_src != entries.data())
+		{
+			entries.swap(scratch);
+		}
+	}
+} // anonymous namespace
+
+uint32_t CorE::Graphics::quantizeDepth(float depth, bool back_to_front)
+{
+	constexpr uint32_t max_depth = (1u << DRAW_KEY_DEPTH_BITS) - 1;
+	// Also maps NaN to 0.
+	const float clamped = depth > 0.0f ? std::min(depth, 1.0f) : 0.0f;
+	const uint32_t quantized = static_cast<uint32_t>(clamped * static_cast<float>(max_depth));
+	return back_to_front ? max_depth - quantized : quantized;
+} // uint32_t CorE::Graphics::quantizeDepth()
+
+uint16_t CorE::Graphics::DrawList::addShaderGroup(ShaderGroup* p_group)
+{
+	if (shader_groups.size() >= (size_t(1) << DRAW_KEY_SHADER_BITS))
+	{
+		throw std::runtime_error("Draw list has no room for more shader groups.");
+	}
+	shader_groups.push_back(p_group);
+	return static_cast<uint16_t>(shader_groups.size() - 1);
+} // uint16_t DrawList::addShaderGroup()
+
+uint16_t CorE::Graphics::DrawList::addRenderState(const RenderState& state)
+{
+	if (render_states.size() >= (size_t(1) << DRAW_KEY_STATE_BITS))
+	{
+		throw std::runtime_error("Draw list has no room for more render states.");
+	}
+	render_states.push_back(state);
+	return static_cast<uint16_t>(render_states.size() - 1);
+} // uint16_t DrawList::addRenderState()
+
+uint32_t CorE::Graphics::DrawList::addMaterial(const Material& material)
+{
+	if (materials.size() >= (size_t(1) << DRAW_KEY_MATERIAL_BITS))
+	{
+		throw std::runtime_error("Draw list has no room for more materials.");
+	}
+	if (material.push_size > sizeof(material.push_data))
+	{
+		throw std::runtime_error("Material pushes more constants than it holds.");
+	}
+	materials.push_back(material);
+	return static_cast<uint32_t>(materials.size() - 1);
+} // uint32_t DrawList::addMaterial()
+
+void CorE::Graphics::DrawList::add(const DrawPacket& packet)
+{
+	order.push_back({ packet.key, packets.size() });
+	packets.push_back(packet);
+} // void DrawList::add()
+
+void CorE::Graphics::DrawList::clear()
+{
+	packets.clear();
+	order.clear();
+} // void DrawList::clear()
+
+void CorE::Graphics::DrawList::sort(JobSystem* p_jobs)
+{
+	if (order.size() <= SMALL_SORT_SIZE)
+	{
+		std::stable_sort(order.begin(), order.end(), [](const SortEntry& lhs, const SortEntry& rhs)
+		{
+			return lhs.key < rhs.key;
+		});
+		return;
+	}
+	radixSort(order, scratch, p_jobs);
+} // void DrawList::sort()
+
+CorE::Graphics::DrawList::Stats CorE::Graphics::DrawList::record(CommandBuffer* p_buffer, size_t first, size_t last)
+{
+	if (first > last || last > order.size())
+	{
+		throw std::runtime_error("Draw range is out of the list.");
+	}
+
+	Stats stats;
+	// Nothing is known to be bound in the buffer, e.g. if it is a secondary one.
+	uint32_t bound_group = UINT32_MAX;
+	uint32_t bound_state = UINT32_MAX;
+	uint32_t bound_material = UINT32_MAX;
+	for (size_t i = first; i < last; i++)
+	{
+		const DrawPacket& packet = packets[order[i].index];
+
+		if (packet.shader_group != bound_group)
+		{
+			bound_group = packet.shader_group;
+			p_buffer->bindShaders(shader_groups.at(bound_group));
+			stats.shader_binds++;
+		}
+
+		if (packet.render_state != bound_state)
+		{
+			bound_state = packet.render_state;
+			const RenderState& state = render_states.at(bound_state);
+			p_buffer->setPrimitiveTopology(state.topology);
+			p_buffer->setPolygonMode(state.polygon_mode);
+			p_buffer->setCullMode(state.cull_mode);
+			p_buffer->setFrontFace(state.front_face);
+			p_buffer->setDepthTestEnable(state.depth_test);
+			p_buffer->setDepthWriteEnable(state.depth_write);
+			p_buffer->setDepthCompareOp(state.depth_compare_op);
+			stats.state_changes++;
+		}
+
+		if (packet.material != bound_material)
+		{
+			bound_material = packet.material;
+			const Material& material = materials.at(bound_material);
+			if (material.set != VK_NULL_HANDLE)
+			{
+				vkCmdBindDescriptorSets(p_buffer->vk_handle, VK_PIPELINE_BIND_POINT_GRAPHICS, material.layout,
+					material.first_set, 1, &material.set, 0, nullptr);
+			}
+			if (material.push_size != 0)
+			{
+				vkCmdPushConstants(p_buffer->vk_handle, material.layout, material.push_stages, 0, material.push_size,
+					material.push_data.data());
+			}
+			if (material.index_buffer != VK_NULL_HANDLE)
+			{
+				vkCmdBindIndexBuffer(p_buffer->vk_handle, material.index_buffer, material.index_offset, material.index_type);
+			}
+			stats.material_binds++;
+		}
+
+		if (packet.indexed)
+		{
+			vkCmdDrawIndexed(p_buffer->vk_handle, packet.count, packet.instance_count, packet.first,
+				packet.vertex_offset, packet.first_instance);
+		}
+		else
+		{
+			vkCmdDraw(p_buffer->vk_handle, packet.count, packet.instance_count, packet.first, packet.first_instance);
+		}
+		stats.draws++;
+	}
+	return stats;
+} // Stats DrawList::record()
+
+CorE::Graphics::DrawList::Stats CorE::Graphics::DrawList::countTransitions() const
+{
+	Stats stats;
+	uint32_t bound_group = UINT32_MAX;
+	uint32_t bound_state = UINT32_MAX;
+	uint32_t bound_material = UINT32_MAX;
+	for (const SortEntry& entry : order)
+	{
+		const DrawPacket& packet = packets[entry.index];
+		stats.shader_binds += packet.shader_group != bound_group;
+		stats.state_changes += packet.render_state != bound_state;
+		stats.material_binds += packet.material != bound_material;
+		bound_group = packet.shader_group;
+		bound_state = packet.render_state;
+		bound_material = packet.material;
+	}
+	stats.draws = order.size();
+	return stats;
+} // Stats DrawList::countTransitions()
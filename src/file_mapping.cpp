@@ -0,0 +1,185 @@
+#include <stdexcept>
+#include <utility>
+
+#include "CorE/file_mapping.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+CorE::MappedFile::MappedFile(const char* file_path)
+{
+	HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open file for mapping.");
+	}
+	p_file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size))
+	{
+		close();
+		throw std::runtime_error("Failed to query size of mapped file.");
+	}
+	size = static_cast<size_t>(file_size.QuadPart);
+
+	// Empty files can not be mapped.
+	if (size == 0)
+	{
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		close();
+		throw std::runtime_error("Failed to create file mapping.");
+	}
+	p_mapping_handle = mapping;
+
+	p_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (p_data == nullptr)
+	{
+		close();
+		throw std::runtime_error("Failed to map view of file.");
+	}
+} // MappedFile::MappedFile()
+
+void CorE::MappedFile::close()
+{
+	if (p_data != nullptr)
+	{
+		UnmapViewOfFile(p_data);
+	}
+	if (p_mapping_handle != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(p_mapping_handle));
+	}
+	if (p_file_handle != nullptr)
+	{
+		CloseHandle(static_cast<HANDLE>(p_file_handle));
+	}
+	p_data = nullptr;
+	p_mapping_handle = nullptr;
+	p_file_handle = nullptr;
+	size = 0;
+} // void MappedFile::close()
+
+CorE::MappedFile::MappedFile(MappedFile&& other) noexcept
+	: p_data(std::exchange(other.p_data, nullptr)),
+	size(std::exchange(other.size, 0)),
+	p_file_handle(std::exchange(other.p_file_handle, nullptr)),
+	p_mapping_handle(std::exchange(other.p_mapping_handle, nullptr))
+{
+
+} // MappedFile::MappedFile()
+
+CorE::MappedFile& CorE::MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		p_data = std::exchange(other.p_data, nullptr);
+		size = std::exchange(other.size, 0);
+		p_file_handle = std::exchange(other.p_file_handle, nullptr);
+		p_mapping_handle = std::exchange(other.p_mapping_handle, nullptr);
+	}
+	return *this;
+} // MappedFile& MappedFile::operator=()
+
+#else
+
+CorE::MappedFile::MappedFile(const char* file_path)
+{
+	file_descriptor = open(file_path, O_RDONLY);
+	if (file_descriptor < 0)
+	{
+		throw std::runtime_error("Failed to open file for mapping.");
+	}
+
+	struct stat file_stat;
+	if (fstat(file_descriptor, &file_stat) != 0)
+	{
+		close();
+		throw std::runtime_error("Failed to query size of mapped file.");
+	}
+	size = static_cast<size_t>(file_stat.st_size);
+
+	// Empty files can not be mapped.
+	if (size == 0)
+	{
+		return;
+	}
+
+	void* p_mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	if (p_mapping == MAP_FAILED)
+	{
+		close();
+		throw std::runtime_error("Failed to map file.");
+	}
+	p_data = static_cast<const char*>(p_mapping);
+	madvise(p_mapping, size, MADV_SEQUENTIAL);
+} // MappedFile::MappedFile()
+
+void CorE::MappedFile::close()
+{
+	if (p_data != nullptr)
+	{
+		munmap(const_cast<char*>(p_data), size);
+	}
+	if (file_descriptor >= 0)
+	{
+		::close(file_descriptor);
+	}
+	p_data = nullptr;
+	file_descriptor = -1;
+	size = 0;
+} // void MappedFile::close()
+
+CorE::MappedFile::MappedFile(MappedFile&& other) noexcept
+	: p_data(std::exchange(other.p_data, nullptr)),
+	size(std::exchange(other.size, 0)),
+	file_descriptor(std::exchange(other.file_descriptor, -1))
+{
+
+} // MappedFile::MappedFile()
+
+CorE::MappedFile& CorE::MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		p_data = std::exchange(other.p_data, nullptr);
+		size = std::exchange(other.size, 0);
+		file_descriptor = std::exchange(other.file_descriptor, -1);
+	}
+	return *this;
+} // MappedFile& MappedFile::operator=()
+
+#endif
+
+CorE::MappedFile::~MappedFile()
+{
+	close();
+} // MappedFile::~MappedFile()
+
+const char* CorE::MappedFile::getData() const
+{
+	return p_data;
+} // const char* MappedFile::getData()
+
+size_t CorE::MappedFile::getSize() const
+{
+	return size;
+} // size_t MappedFile::getSize()
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include "CorE/gpu_culling.hpp"
+
+static_assert(sizeof(CorE::Graphics::CullObject) == 80, "CullObject must match the layout of cull.slang.");
+static_assert(std::is_trivially_copyable_v<CorE::Graphics::CullObject>, "CullObject must be trivially copyable.");
+
+void CorE::Graphics::CullObject::setTransform(const math::Mat4x4& transform)
+{
+	std::memcpy(rows, transform.val, sizeof(rows));
+} // void CullObject::setTransform()
+
+CorE::Graphics::Frustum CorE::Graphics::Frustum::fromMatrix(const math::Mat4x4& view_projection)
+{
+	// Clip space of Vulkan is -w <= x, y <= w and 0 <= z <= w, each bound being a plane of rows of the matrix.
+	const float(&m)[4][4] = view_projection.val;
+	Frustum frustum;
+	for (int i = 0; i < 4; i++)
+	{
+		frustum.planes[0][i] = m[3][i] + m[0][i];
+		frustum.planes[1][i] = m[3][i] - m[0][i];
+		frustum.planes[2][i] = m[3][i] + m[1][i];
+		frustum.planes[3][i] = m[3][i] - m[1][i];
+		frustum.planes[4][i] = m[2][i];
+		frustum.planes[5][i] = m[3][i] - m[2][i];
+	}
+	// Normalized, so that distances to planes compare with radii.
+	for (float(&plane)[4] : frustum.planes)
+	{
+		const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 0.0f)
+		{
+			for (float& value : plane)
+			{
+				value /= length;
+			}
+		}
+	}
+	return frustum;
+} // Frustum Frustum::fromMatrix()
+
+bool CorE::Graphics::isVisible(const CullObject& object, const Frustum& frustum)
+{
+	// Keep in step with cullMain in cull.slang.
+	float center[3];
+	for (int i = 0; i < 3; i++)
+	{
+		center[i] = object.rows[i][0] * object.sphere[0] + object.rows[i][1] * object.sphere[1]
+			+ object.rows[i][2] * object.sphere[2] + object.rows[i][3];
+	}
+	// Scaling stretches the sphere by the longest axis.
+	float scale_sq = 0.0f;
+	for (int j = 0; j < 3; j++)
+	{
+		const float axis_sq = object.rows[0][j] * object.rows[0][j] + object.rows[1][j] * object.rows[1][j]
+			+ object.rows[2][j] * object.rows[2][j];
+		scale_sq = std::max(scale_sq, axis_sq);
+	}
+	const float radius = object.sphere[3] * std::sqrt(scale_sq);
+
+	for (const float(&plane)[4] : frustum.planes)
+	{
+		if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+} // bool CorE::Graphics::isVisible()
+
+uint32_t CorE::Graphics::cullObjects(std::span<const CullObject> objects, const Frustum& frustum,
+	vec<VkDrawIndexedIndirectCommand>& commands)
+{
+	commands.clear();
+	for (size_t i = 0; i < objects.size(); i++)
+	{
+		const CullObject& object = objects[i];
+		if (isVisible(object, frustum))
+		{
+			commands.push_back({ object.index_count, 1, object.first_index, object.vertex_offset, static_cast<uint32_t>(i) });
+		}
+	}
+	return static_cast<uint32_t>(commands.size());
+} // uint32_t CorE::Graphics::cullObjects()
+
+CorE::Graphics::IndirectCuller::IndirectCuller(LogicalDevice* p_device, DeviceMemoryAllocator* p_memory,
+	Descriptor::BindlessHeap* p_heap, const MappedShaderCode& cull_shader, uint32_t max_objects)
+	: p_device(p_device), p_memory(p_memory), p_heap(p_heap), max_objects(max_objects)
+{
+	const VkPushConstantRange push_range = p_heap->getPushConstantRange();
+	if (push_range.size < sizeof(CullConstants) || !(push_range.stageFlags & VK_SHADER_STAGE_COMPUTE_BIT))
+	{
+		throw std::runtime_error("Bindless heap has too few push constants for culling, or none in compute shaders.");
+	}
+	if (max_objects == 0)
+	{
+		throw std::runtime_error("Culler must hold at least one object.");
+	}
+	if (cull_shader.stage != VK_SHADER_STAGE_COMPUTE_BIT)
+	{
+		throw std::runtime_error("Cull shader must be a compute shader.");
+	}
+
+	p_shader = std::make_unique<ShaderGroup>(p_device, vec<ShaderGroup::Stage>{ ShaderGroup::Stage(cull_shader) },
+		vec<VkDescriptorSetLayout>{ p_heap->getSetLayout() }, vec<VkPushConstantRange>{ push_range });
+
+	VkBufferCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// Written by the host whenever objects change, read by the GPU every frame.
+	info.size = sizeof(CullObject) * VkDeviceSize(max_objects);
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	object_buffer = p_memory->createBuffer(info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &p_object_allocation);
+
+	info.size = sizeof(VkDrawIndexedIndirectCommand) * VkDeviceSize(max_objects);
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	command_buffer = p_memory->createBuffer(info, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &p_command_allocation);
+
+	info.size = sizeof(uint32_t);
+	info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+		| VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	count_buffer = p_memory->createBuffer(info, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &p_count_allocation);
+
+	Descriptor::StorageBuffer desc{};
+	desc.buffer = object_buffer;
+	objects_index = p_heap->add(desc);
+	desc.buffer = command_buffer;
+	commands_index = p_heap->add(desc);
+	desc.buffer = count_buffer;
+	count_index = p_heap->add(desc);
+} // IndirectCuller::IndirectCuller()
+
+CorE::Graphics::IndirectCuller::~IndirectCuller()
+{
+	p_heap->remove(Descriptor::StorageBuffer::type, objects_index);
+	p_heap->remove(Descriptor::StorageBuffer::type, commands_index);
+	p_heap->remove(Descriptor::StorageBuffer::type, count_index);
+	p_memory->destroyBuffer(object_buffer, p_object_allocation);
+	p_memory->destroyBuffer(command_buffer, p_command_allocation);
+	p_memory->destroyBuffer(count_buffer, p_count_allocation);
+} // IndirectCuller::~IndirectCuller()
+
+void CorE::Graphics::IndirectCuller::setObjects(uint32_t first, std::span<const CullObject> objects)
+{
+	if (first > max_objects || objects.size() > max_objects - first)
+	{
+		throw std::runtime_error("Objects do not fit the culler.");
+	}
+	if (objects.empty())
+	{
+		return;
+	}
+	const VkDeviceSize offset = sizeof(CullObject) * VkDeviceSize(first);
+	std::memcpy(static_cast<char*>(p_object_allocation->p_mapped) + offset, objects.data(), objects.size_bytes());
+	p_memory->flush(p_object_allocation, offset, objects.size_bytes());
+} // void IndirectCuller::setObjects()
+
+void CorE::Graphics::IndirectCuller::cull(CommandBuffer* p_buffer, const Frustum& frustum, uint32_t object_count)
+{
+	if (object_count > max_objects)
+	{
+		throw std::runtime_error("Culler holds fewer objects than asked to cull.");
+	}
+
+	// Draws of earlier cull() calls in the queue must be done reading before the count is cleared and draws rewritten.
+	// The barriers below chain onto this one, so it covers the draws too.
+	VkMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT;
+	VkDependencyInfo dependency{};
+	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency.memoryBarrierCount = 1;
+	dependency.pMemoryBarriers = &barrier;
+	vkCmdPipelineBarrier2(p_buffer->vk_handle, &dependency);
+
+	vkCmdFillBuffer(p_buffer->vk_handle, count_buffer, 0, sizeof(uint32_t), 0);
+
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+	vkCmdPipelineBarrier2(p_buffer->vk_handle, &dependency);
+
+	const CullConstants constants{ frustum, object_count, objects_index, commands_index, count_index };
+	p_buffer->bindShaders(p_shader.get());
+	p_heap->bind(p_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+	p_heap->pushConstants(p_buffer, 0, sizeof(constants), &constants);
+	vkCmdDispatch(p_buffer->vk_handle, (object_count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier2(p_buffer->vk_handle, &dependency);
+} // void IndirectCuller::cull()
+
+void CorE::Graphics::IndirectCuller::draw(CommandBuffer* p_buffer)
+{
+	vkCmdDrawIndexedIndirectCount(p_buffer->vk_handle, command_buffer, 0, count_buffer, 0, max_objects,
+		sizeof(VkDrawIndexedIndirectCommand));
+} // void IndirectCuller::draw()
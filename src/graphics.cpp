@@ -1,6 +1,37 @@
 
 #include "CorE/graphics.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+
+#include "CorE/hash.hpp"
+#include "CorE/shader_cache.hpp"
+
+namespace
+{
+	// Appends a handle to a layout key, as two words whatever its size is.
+	template<typename Handle>
+	void appendHandle(vec<uint32_t>& key, Handle handle)
+	{
+		uint64_t bits = 0;
+		std::memcpy(&bits, &handle, sizeof(handle));
+		key.push_back(static_cast<uint32_t>(bits));
+		key.push_back(static_cast<uint32_t>(bits >> 32));
+	}
+
+	uint64_t hashKey(const vec<uint32_t>& key)
+	{
+		return CorE::hashBytes(key.data(), key.size() * sizeof(uint32_t));
+	}
+
+	// Reused by lookups of a thread, so that cache hits do not allocate.
+	thread_local vec<uint32_t> t_key;
+	thread_local vec<uint32_t> t_order;
+} // anonymous namespace
+
 namespace CorE
 {
 	namespace Graphics
@@ -29,6 +60,14 @@ namespace CorE
 
 			ensureVkSuccess(vkCreateShadersEXT(p_device->vk_handle, 1, &info,
 				nullptr, &vk_handle), "Failed to create shader.");
+		}
+		Shader::Shader(LogicalDevice* p_device, const MappedShaderCode& code, VkShaderStageFlags next_stage,
+			std::vector<VkDescriptorSetLayout> desc_set_layouts, std::vector<VkPushConstantRange> push_constant_ranges,
+			VkSpecializationInfo p_spec_info)
+			: Shader(p_device, 0, code.stage, next_stage, VK_SHADER_CODE_TYPE_SPIRV_EXT, code.code.size(),
+				code.code.data(), code.entry_point, std::move(desc_set_layouts), std::move(push_constant_ranges), p_spec_info)
+		{
+
 		}
 		Shader::~Shader()
 		{
@@ -37,15 +76,661 @@ namespace CorE
 	} // namespace Graphics
 } // namespace CorE
 
-CorE::Graphics::Descriptor::DescriptorSet::DescriptorSet(VkDescriptorSetLayoutCreateFlags flags, 
-	std::vector<VkDescriptorSetLayoutBinding> bindings)
+CorE::Graphics::ShaderGroup::Stage::Stage(const MappedShaderCode& code, const VkSpecializationInfo* p_spec_info)
+	: stage(code.stage), code_type(VK_SHADER_CODE_TYPE_SPIRV_EXT), p_code(code.code.data()), code_size(code.code.size()),
+	entry_point(code.entry_point), p_spec_info(p_spec_info)
+{
+
+} // ShaderGroup::Stage::Stage()
+
+CorE::Graphics::ShaderGroup::ShaderGroup(LogicalDevice* p_device, const vec<Stage>& stages,
+	const vec<VkDescriptorSetLayout>& desc_set_layouts, const vec<VkPushConstantRange>& push_constant_ranges,
+	VkShaderCreateFlagsEXT flags)
+	: p_device(p_device)
 {
+	// Graphics stages in pipeline order. Task and mesh stages replace vertex and tessellation ones.
+	static constexpr VkShaderStageFlagBits GRAPHICS_STAGES[] =
+	{
+		VK_SHADER_STAGE_TASK_BIT_EXT,
+		VK_SHADER_STAGE_MESH_BIT_EXT,
+		VK_SHADER_STAGE_VERTEX_BIT,
+		VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+		VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+		VK_SHADER_STAGE_GEOMETRY_BIT,
+		VK_SHADER_STAGE_FRAGMENT_BIT
+	};
+
+	vec<const Stage*> ordered;
+	if (stages.size() == 1 && stages[0].stage == VK_SHADER_STAGE_COMPUTE_BIT)
+	{
+		ordered.push_back(&stages[0]);
+		this->stages.push_back(VK_SHADER_STAGE_COMPUTE_BIT);
+	}
+	else
+	{
+		for (VkShaderStageFlagBits graphics_stage : GRAPHICS_STAGES)
+		{
+			auto it = std::find_if(stages.begin(), stages.end(), [&](const Stage& stage)
+				{
+					return stage.stage == graphics_stage;
+				});
+			if (it != stages.end())
+			{
+				ordered.push_back(&*it);
+			}
+			this->stages.push_back(graphics_stage);
+		}
+	}
+	// Fewer stages were taken than given if some are duplicates or of no graphics kind.
+	if (ordered.empty() || ordered.size() != stages.size())
+	{
+		throw std::runtime_error("Shader group must have one compute stage, or distinct graphics stages.");
+	}
+
+	// Stages can only be linked if all of them are of one code type.
+	bool link = ordered.size() > 1 && std::all_of(ordered.begin(), ordered.end(), [&](const Stage* p_stage)
+		{
+			return p_stage->code_type == ordered[0]->code_type;
+		});
+
+	vec<VkShaderCreateInfoEXT> infos(ordered.size());
+	for (size_t i = 0; i < ordered.size(); i++)
+	{
+		VkShaderCreateInfoEXT& info = infos[i];
+		info.sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
+		info.flags = flags | (link ? VK_SHADER_CREATE_LINK_STAGE_BIT_EXT : 0);
+		info.stage = ordered[i]->stage;
+		info.nextStage = i + 1 < ordered.size() ? ordered[i + 1]->stage : 0;
+		info.codeType = ordered[i]->code_type;
+		info.codeSize = ordered[i]->code_size;
+		info.pCode = ordered[i]->p_code;
+		info.pName = ordered[i]->entry_point.c_str();
+		info.setLayoutCount = static_cast<uint32_t>(desc_set_layouts.size());
+		info.pSetLayouts = desc_set_layouts.data();
+		info.pushConstantRangeCount = static_cast<uint32_t>(push_constant_ranges.size());
+		info.pPushConstantRanges = push_constant_ranges.data();
+		info.pSpecializationInfo = ordered[i]->p_spec_info;
+	}
+
+	vec<VkShaderEXT> created(ordered.size(), VK_NULL_HANDLE);
+	VkResult result = vkCreateShadersEXT(p_device->vk_handle, static_cast<uint32_t>(infos.size()), infos.data(),
+		p_device->getAllocator(), created.data());
+	if (result != VK_SUCCESS)
+	{
+		// Unlinked stages may have been created before one failed.
+		for (VkShaderEXT shader : created)
+		{
+			if (shader != VK_NULL_HANDLE)
+			{
+				vkDestroyShaderEXT(p_device->vk_handle, shader, p_device->getAllocator());
+			}
+		}
+		ensureVkSuccess(result, "Failed to create shader group.");
+	}
+
+	vk_handles.assign(this->stages.size(), VK_NULL_HANDLE);
+	for (size_t i = 0; i < ordered.size(); i++)
+	{
+		size_t slot = std::find(this->stages.begin(), this->stages.end(), ordered[i]->stage) - this->stages.begin();
+		vk_handles[slot] = created[i];
+	}
+} // ShaderGroup::ShaderGroup()
+
+CorE::Graphics::ShaderGroup::~ShaderGroup()
+{
+	for (VkShaderEXT shader : vk_handles)
+	{
+		if (shader != VK_NULL_HANDLE)
+		{
+			vkDestroyShaderEXT(p_device->vk_handle, shader, p_device->getAllocator());
+		}
+	}
+} // ShaderGroup::~ShaderGroup()
+
+VkShaderEXT CorE::Graphics::ShaderGroup::getShader(VkShaderStageFlagBits stage) const
+{
+	for (size_t i = 0; i < stages.size(); i++)
+	{
+		if (stages[i] == stage)
+		{
+			return vk_handles[i];
+		}
+	}
+	return VK_NULL_HANDLE;
+} // VkShaderEXT ShaderGroup::getShader()
+
+CorE::Graphics::Descriptor::DescriptorSet::DescriptorSet(LogicalDevice* p_device, VkDescriptorSetLayoutCreateFlags flags, 
+	std::vector<VkDescriptorSetLayoutBinding> bindings, std::vector<VkDescriptorBindingFlags> binding_flags)
+	: p_device(p_device)
+{
+	if (!binding_flags.empty() && binding_flags.size() != bindings.size())
+	{
+		throw std::runtime_error("Binding flags of a descriptor set layout must match its bindings.");
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info{};
+	flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	flags_info.bindingCount = static_cast<uint32_t>(binding_flags.size());
+	flags_info.pBindingFlags = binding_flags.data();
+
 	VkDescriptorSetLayoutCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	create_info.pNext = binding_flags.empty() ? nullptr : &flags_info;
 	create_info.flags = flags;
 	create_info.bindingCount = static_cast<uint32_t>(bindings.size());
 	create_info.pBindings = bindings.data();
 
-	ensureVkSuccess(vkCreateDescriptorSetLayout(p_device->vk_handle, &create_info, nullptr,
+	ensureVkSuccess(vkCreateDescriptorSetLayout(p_device->vk_handle, &create_info, p_device->getAllocator(),
 		&vk_handle), "Failed to create descriptor set layout.");
-}
+} // DescriptorSet::DescriptorSet()
+
+CorE::Graphics::Descriptor::DescriptorSet::DescriptorSet(LayoutCache* p_cache, VkDescriptorSetLayoutCreateFlags flags,
+	const std::vector<VkDescriptorSetLayoutBinding>& bindings, const std::vector<VkDescriptorBindingFlags>& binding_flags)
+	: vk_handle(p_cache->getSetLayout(flags, bindings, binding_flags)), p_device(p_cache->getDevice()), p_cache(p_cache)
+{
+
+} // DescriptorSet::DescriptorSet()
+
+CorE::Graphics::Descriptor::DescriptorSet::~DescriptorSet()
+{
+	if (p_cache == nullptr)
+	{
+		vkDestroyDescriptorSetLayout(p_device->vk_handle, vk_handle, p_device->getAllocator());
+	}
+} // DescriptorSet::~DescriptorSet()
+
+
+
+CorE::Graphics::Descriptor::BindlessHeap::BindlessHeap(LogicalDevice* p_device, const BindlessProperties& props)
+	: p_device(p_device)
+{
+	VkPhysicalDeviceDescriptorIndexingProperties indexing_props{};
+	indexing_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+	VkPhysicalDeviceProperties2 device_props{};
+	device_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	device_props.pNext = &indexing_props;
+	vkGetPhysicalDeviceProperties2(p_device->p_parent->vk_handle, &device_props);
+
+	// Every stage sees all three arrays, so per stage limits bound them as well as per set ones.
+	sampled_images = { SAMPLED_IMAGE_BINDING, SampledImage::type, std::min({ props.sampled_image_count,
+		indexing_props.maxDescriptorSetUpdateAfterBindSampledImages,
+		indexing_props.maxPerStageDescriptorUpdateAfterBindSampledImages }), 0, {}, {} };
+	storage_buffers = { STORAGE_BUFFER_BINDING, StorageBuffer::type, std::min({ props.storage_buffer_count,
+		indexing_props.maxDescriptorSetUpdateAfterBindStorageBuffers,
+		indexing_props.maxPerStageDescriptorUpdateAfterBindStorageBuffers }), 0, {}, {} };
+	samplers = { SAMPLER_BINDING, Sampler::type, std::min({ props.sampler_count,
+		indexing_props.maxDescriptorSetUpdateAfterBindSamplers,
+		indexing_props.maxPerStageDescriptorUpdateAfterBindSamplers }), 0, {}, {} };
+
+	uint64_t resources = uint64_t(sampled_images.capacity) + storage_buffers.capacity + samplers.capacity;
+	if (resources > indexing_props.maxPerStageUpdateAfterBindResources)
+	{
+		// Scales the arrays down by the same ratio to fit the shared limit.
+		double scale = double(indexing_props.maxPerStageUpdateAfterBindResources) / double(resources);
+		for (IndexArray* p_array : { &sampled_images, &storage_buffers, &samplers })
+		{
+			p_array->capacity = static_cast<uint32_t>(p_array->capacity * scale);
+		}
+	}
+
+	vec<VkDescriptorSetLayoutBinding> bindings;
+	vec<VkDescriptorPoolSize> pool_sizes;
+	for (IndexArray* p_array : { &sampled_images, &storage_buffers, &samplers })
+	{
+		if (p_array->capacity == 0)
+		{
+			throw std::runtime_error("Device does not support update-after-bind descriptors of a bindless heap.");
+		}
+
+		VkDescriptorSetLayoutBinding binding{};
+		binding.binding = p_array->binding;
+		binding.descriptorType = p_array->type;
+		binding.descriptorCount = p_array->capacity;
+		binding.stageFlags = props.stages;
+		bindings.push_back(binding);
+
+		pool_sizes.push_back({ p_array->type, p_array->capacity });
+	}
+
+	VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+		| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+	p_layout = std::make_unique<DescriptorSet>(p_device, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+		bindings, vec<VkDescriptorBindingFlags>(bindings.size(), binding_flags));
+
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	pool_info.maxSets = 1;
+	pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+	pool_info.pPoolSizes = pool_sizes.data();
+	ensureVkSuccess(vkCreateDescriptorPool(p_device->vk_handle, &pool_info, p_device->getAllocator(), &pool),
+		"Failed to create descriptor pool of a bindless heap.");
+
+	VkDescriptorSetAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = pool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &p_layout->vk_handle;
+	ensureVkSuccess(vkAllocateDescriptorSets(p_device->vk_handle, &alloc_info, &vk_set),
+		"Failed to allocate descriptor set of a bindless heap.");
+
+	push_constant_range = { props.stages, 0, props.push_constant_size };
+
+	VkPipelineLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layout_info.setLayoutCount = 1;
+	layout_info.pSetLayouts = &p_layout->vk_handle;
+	layout_info.pushConstantRangeCount = props.push_constant_size == 0 ? 0 : 1;
+	layout_info.pPushConstantRanges = &push_constant_range;
+	ensureVkSuccess(vkCreatePipelineLayout(p_device->vk_handle, &layout_info, p_device->getAllocator(),
+		&pipeline_layout), "Failed to create pipeline layout of a bindless heap.");
+} // BindlessHeap::BindlessHeap()
+
+CorE::Graphics::Descriptor::BindlessHeap::~BindlessHeap()
+{
+	vkDestroyPipelineLayout(p_device->vk_handle, pipeline_layout, p_device->getAllocator());
+	// Frees the set too.
+	vkDestroyDescriptorPool(p_device->vk_handle, pool, p_device->getAllocator());
+} // BindlessHeap::~BindlessHeap()
+
+uint32_t CorE::Graphics::Descriptor::BindlessHeap::add(const SampledImage& desc)
+{
+	VkDescriptorImageInfo info{ VK_NULL_HANDLE, desc.image_view, desc.layout };
+	std::lock_guard lock(mutex);
+	uint32_t index = allocateIndex(&sampled_images);
+	write(&sampled_images, index, &info, nullptr);
+	return index;
+} // uint32_t BindlessHeap::add(const SampledImage&)
+
+uint32_t CorE::Graphics::Descriptor::BindlessHeap::add(const StorageBuffer& desc)
+{
+	VkDescriptorBufferInfo info{ desc.buffer, desc.offset, desc.range };
+	std::lock_guard lock(mutex);
+	uint32_t index = allocateIndex(&storage_buffers);
+	write(&storage_buffers, index, nullptr, &info);
+	return index;
+} // uint32_t BindlessHeap::add(const StorageBuffer&)
+
+uint32_t CorE::Graphics::Descriptor::BindlessHeap::add(const Sampler& desc)
+{
+	VkDescriptorImageInfo info{ desc.sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+	std::lock_guard lock(mutex);
+	uint32_t index = allocateIndex(&samplers);
+	write(&samplers, index, &info, nullptr);
+	return index;
+} // uint32_t BindlessHeap::add(const Sampler&)
+
+void CorE::Graphics::Descriptor::BindlessHeap::update(uint32_t index, const SampledImage& desc)
+{
+	VkDescriptorImageInfo info{ VK_NULL_HANDLE, desc.image_view, desc.layout };
+	std::lock_guard lock(mutex);
+	checkIndex(&sampled_images, index);
+	write(&sampled_images, index, &info, nullptr);
+} // void BindlessHeap::update(uint32_t, const SampledImage&)
+
+void CorE::Graphics::Descriptor::BindlessHeap::update(uint32_t index, const StorageBuffer& desc)
+{
+	VkDescriptorBufferInfo info{ desc.buffer, desc.offset, desc.range };
+	std::lock_guard lock(mutex);
+	checkIndex(&storage_buffers, index);
+	write(&storage_buffers, index, nullptr, &info);
+} // void BindlessHeap::update(uint32_t, const StorageBuffer&)
+
+void CorE::Graphics::Descriptor::BindlessHeap::update(uint32_t index, const Sampler& desc)
+{
+	VkDescriptorImageInfo info{ desc.sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+	std::lock_guard lock(mutex);
+	checkIndex(&samplers, index);
+	write(&samplers, index, &info, nullptr);
+} // void BindlessHeap::update(uint32_t, const Sampler&)
+
+void CorE::Graphics::Descriptor::BindlessHeap::remove(VkDescriptorType type, uint32_t index, uint64_t retire_value)
+{
+	IndexArray* p_array = getArray(type);
+	std::lock_guard lock(mutex);
+	checkIndex(p_array, index);
+	p_array->in_use[index] = false;
+	if (retire_value == 0)
+	{
+		p_array->free_indices.push_back(index);
+	}
+	else
+	{
+		retirements.push_back({ retire_value, p_array, index });
+	}
+} // void BindlessHeap::remove()
+
+void CorE::Graphics::Descriptor::BindlessHeap::reclaim(uint64_t completed_value)
+{
+	std::lock_guard lock(mutex);
+	// Values need not be removed in order, e.g. with several timelines, so all of them are looked at.
+	for (size_t i = 0; i < retirements.size();)
+	{
+		if (retirements[i].value <= completed_value)
+		{
+			retirements[i].p_array->free_indices.push_back(retirements[i].index);
+			retirements[i] = retirements.back();
+			retirements.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+} // void BindlessHeap::reclaim()
+
+void CorE::Graphics::Descriptor::BindlessHeap::bind(CommandBuffer* p_buffer, VkPipelineBindPoint bind_point)
+{
+	vkCmdBindDescriptorSets(p_buffer->vk_handle, bind_point, pipeline_layout, 0, 1, &vk_set, 0, nullptr);
+} // void BindlessHeap::bind()
+
+void CorE::Graphics::Descriptor::BindlessHeap::pushConstants(CommandBuffer* p_buffer, uint32_t offset, uint32_t size,
+	const void* p_values)
+{
+	vkCmdPushConstants(p_buffer->vk_handle, pipeline_layout, push_constant_range.stageFlags, offset, size, p_values);
+} // void BindlessHeap::pushConstants()
+
+uint32_t CorE::Graphics::Descriptor::BindlessHeap::getCapacity(VkDescriptorType type)
+{
+	return getArray(type)->capacity;
+} // uint32_t BindlessHeap::getCapacity()
+
+uint32_t CorE::Graphics::Descriptor::BindlessHeap::getUsedCount(VkDescriptorType type)
+{
+	IndexArray* p_array = getArray(type);
+	std::lock_guard lock(mutex);
+	return p_array->next_index - static_cast<uint32_t>(p_array->free_indices.size());
+} // uint32_t BindlessHeap::getUsedCount()
+
+CorE::Graphics::Descriptor::BindlessHeap::IndexArray* CorE::Graphics::Descriptor::BindlessHeap::getArray(VkDescriptorType type)
+{
+	switch (type)
+	{
+	case SampledImage::type:
+		return &sampled_images;
+	case StorageBuffer::type:
+		return &storage_buffers;
+	case Sampler::type:
+		return &samplers;
+	default:
+		throw std::runtime_error("Bindless heap has no array of the descriptor type.");
+	}
+} // IndexArray* BindlessHeap::getArray()
+
+uint32_t CorE::Graphics::Descriptor::BindlessHeap::allocateIndex(IndexArray* p_array)
+{
+	// Freed elements go first, which keeps the used part of the array dense.
+	if (!p_array->free_indices.empty())
+	{
+		uint32_t index = p_array->free_indices.back();
+		p_array->free_indices.pop_back();
+		p_array->in_use[index] = true;
+		return index;
+	}
+	if (p_array->next_index == p_array->capacity)
+	{
+		throw std::runtime_error("Bindless heap array is full.");
+	}
+	p_array->in_use.push_back(true);
+	return p_array->next_index++;
+} // uint32_t BindlessHeap::allocateIndex()
+
+void CorE::Graphics::Descriptor::BindlessHeap::write(IndexArray* p_array, uint32_t index,
+	const VkDescriptorImageInfo* p_image_info, const VkDescriptorBufferInfo* p_buffer_info)
+{
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = vk_set;
+	write.dstBinding = p_array->binding;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = p_array->type;
+	write.pImageInfo = p_image_info;
+	write.pBufferInfo = p_buffer_info;
+	vkUpdateDescriptorSets(p_device->vk_handle, 1, &write, 0, nullptr);
+} // void BindlessHeap::write()
+
+void CorE::Graphics::Descriptor::BindlessHeap::checkIndex(IndexArray* p_array, uint32_t index)
+{
+	if (index >= p_array->next_index)
+	{
+		throw std::runtime_error("Index was not handed out by the bindless heap.");
+	}
+	// Catches removing twice, and using an element after removing it.
+	if (!p_array->in_use[index])
+	{
+		throw std::runtime_error("Index was removed from the bindless heap.");
+	}
+} // void BindlessHeap::checkIndex()
+
+
+
+template<typename Handle>
+CorE::Graphics::detail::LayoutTable<Handle>::LayoutTable()
+{
+	uptr<Slots> p_table = std::make_unique<Slots>();
+	p_table->mask = 63;
+	p_table->p_slots = std::make_unique<std::atomic<Entry*>[]>(p_table->mask + 1);
+	p_current.store(p_table.get(), std::memory_order_relaxed);
+	tables.push_back(std::move(p_table));
+} // LayoutTable::LayoutTable()
+
+template<typename Handle>
+Handle CorE::Graphics::detail::LayoutTable<Handle>::find(uint64_t hash, const vec<uint32_t>& key) const
+{
+	const Slots* p_table = p_current.load(std::memory_order_acquire);
+	for (size_t i = hash & p_table->mask;; i = (i + 1) & p_table->mask)
+	{
+		const Entry* p_entry = p_table->p_slots[i].load(std::memory_order_acquire);
+		if (p_entry == nullptr)
+		{
+			return VK_NULL_HANDLE;
+		}
+		if (p_entry->hash == hash && p_entry->key == key)
+		{
+			return p_entry->handle;
+		}
+	}
+} // Handle LayoutTable::find()
+
+template<typename Handle>
+void CorE::Graphics::detail::LayoutTable<Handle>::insert(uint64_t hash, const vec<uint32_t>& key, Handle handle)
+{
+	entries.push_back(std::make_unique<Entry>(Entry{ hash, key, handle }));
+
+	Slots* p_table = p_current.load(std::memory_order_relaxed);
+	if (entries.size() * 2 > p_table->mask + 1)
+	{
+		// Readers may still probe the old table, which is kept, and see the new one once it is complete.
+		uptr<Slots> p_grown = std::make_unique<Slots>();
+		p_grown->mask = p_table->mask * 2 + 1;
+		p_grown->p_slots = std::make_unique<std::atomic<Entry*>[]>(p_grown->mask + 1);
+		for (const uptr<Entry>& p_entry : entries)
+		{
+			place(p_grown.get(), p_entry.get());
+		}
+		p_current.store(p_grown.get(), std::memory_order_release);
+		tables.push_back(std::move(p_grown));
+	}
+	else
+	{
+		place(p_table, entries.back().get());
+	}
+} // void LayoutTable::insert()
+
+template<typename Handle>
+void CorE::Graphics::detail::LayoutTable<Handle>::place(Slots* p_table, Entry* p_entry)
+{
+	size_t i = p_entry->hash & p_table->mask;
+	while (p_table->p_slots[i].load(std::memory_order_relaxed) != nullptr)
+	{
+		i = (i + 1) & p_table->mask;
+	}
+	p_table->p_slots[i].store(p_entry, std::memory_order_release);
+} // void LayoutTable::place()
+
+template class CorE::Graphics::detail::LayoutTable<VkDescriptorSetLayout>;
+template class CorE::Graphics::detail::LayoutTable<VkPipelineLayout>;
+
+
+
+CorE::Graphics::LayoutCache::LayoutCache(LogicalDevice* p_device)
+	: p_device(p_device)
+{
+
+} // LayoutCache::LayoutCache()
+
+CorE::Graphics::LayoutCache::~LayoutCache()
+{
+	// Pipeline layouts go first, as they were created with the set layouts.
+	for (const auto& p_entry : pipeline_layouts.getEntries())
+	{
+		vkDestroyPipelineLayout(p_device->vk_handle, p_entry->handle, p_device->getAllocator());
+	}
+	for (const auto& p_entry : set_layouts.getEntries())
+	{
+		vkDestroyDescriptorSetLayout(p_device->vk_handle, p_entry->handle, p_device->getAllocator());
+	}
+} // LayoutCache::~LayoutCache()
+
+VkDescriptorSetLayout CorE::Graphics::LayoutCache::getSetLayout(VkDescriptorSetLayoutCreateFlags flags,
+	const vec<VkDescriptorSetLayoutBinding>& bindings, const vec<VkDescriptorBindingFlags>& binding_flags)
+{
+	if (!binding_flags.empty() && binding_flags.size() != bindings.size())
+	{
+		throw std::runtime_error("Binding flags of a descriptor set layout must match its bindings.");
+	}
+
+	// Bindings are keyed in binding order, so that the order they were listed in does not matter.
+	vec<uint32_t>& order = t_order;
+	order.resize(bindings.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+		{
+			return bindings[a].binding < bindings[b].binding;
+		});
+
+	vec<uint32_t>& key = t_key;
+	key.clear();
+	key.push_back(flags);
+	for (uint32_t i : order)
+	{
+		const VkDescriptorSetLayoutBinding& binding = bindings[i];
+		key.push_back(binding.binding);
+		key.push_back(static_cast<uint32_t>(binding.descriptorType));
+		key.push_back(binding.descriptorCount);
+		key.push_back(binding.stageFlags);
+		key.push_back(binding_flags.empty() ? 0 : binding_flags[i]);
+		// Immutable samplers are part of the layout, so their handles are too.
+		key.push_back(binding.pImmutableSamplers != nullptr);
+		if (binding.pImmutableSamplers != nullptr)
+		{
+			for (uint32_t j = 0; j < binding.descriptorCount; ++j)
+			{
+				appendHandle(key, binding.pImmutableSamplers[j]);
+			}
+		}
+	}
+	uint64_t hash = hashKey(key);
+
+	VkDescriptorSetLayout layout = set_layouts.find(hash, key);
+	if (layout != VK_NULL_HANDLE)
+	{
+		return layout;
+	}
+
+	std::lock_guard lock(mutex);
+	// Another thread may have created it since the lookup.
+	layout = set_layouts.find(hash, key);
+	if (layout != VK_NULL_HANDLE)
+	{
+		return layout;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info{};
+	flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	flags_info.bindingCount = static_cast<uint32_t>(binding_flags.size());
+	flags_info.pBindingFlags = binding_flags.data();
+
+	VkDescriptorSetLayoutCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	create_info.pNext = binding_flags.empty() ? nullptr : &flags_info;
+	create_info.flags = flags;
+	create_info.bindingCount = static_cast<uint32_t>(bindings.size());
+	create_info.pBindings = bindings.data();
+
+	ensureVkSuccess(vkCreateDescriptorSetLayout(p_device->vk_handle, &create_info, p_device->getAllocator(),
+		&layout), "Failed to create descriptor set layout.");
+	set_layouts.insert(hash, key, layout);
+	return layout;
+} // VkDescriptorSetLayout LayoutCache::getSetLayout()
+
+VkPipelineLayout CorE::Graphics::LayoutCache::getPipelineLayout(const vec<VkDescriptorSetLayout>& set_layouts,
+	const vec<VkPushConstantRange>& push_constant_ranges)
+{
+	vec<uint32_t>& order = t_order;
+	order.resize(push_constant_ranges.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+		{
+			const VkPushConstantRange& range_a = push_constant_ranges[a];
+			const VkPushConstantRange& range_b = push_constant_ranges[b];
+			if (range_a.offset != range_b.offset)
+			{
+				return range_a.offset < range_b.offset;
+			}
+			return range_a.stageFlags < range_b.stageFlags;
+		});
+
+	vec<uint32_t>& key = t_key;
+	key.clear();
+	key.push_back(static_cast<uint32_t>(set_layouts.size()));
+	for (VkDescriptorSetLayout set_layout : set_layouts)
+	{
+		appendHandle(key, set_layout);
+	}
+	for (uint32_t i : order)
+	{
+		key.push_back(push_constant_ranges[i].stageFlags);
+		key.push_back(push_constant_ranges[i].offset);
+		key.push_back(push_constant_ranges[i].size);
+	}
+	uint64_t hash = hashKey(key);
+
+	VkPipelineLayout layout = pipeline_layouts.find(hash, key);
+	if (layout != VK_NULL_HANDLE)
+	{
+		return layout;
+	}
+
+	std::lock_guard lock(mutex);
+	layout = pipeline_layouts.find(hash, key);
+	if (layout != VK_NULL_HANDLE)
+	{
+		return layout;
+	}
+
+	VkPipelineLayoutCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	create_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+	create_info.pSetLayouts = set_layouts.data();
+	create_info.pushConstantRangeCount = static_cast<uint32_t>(push_constant_ranges.size());
+	create_info.pPushConstantRanges = push_constant_ranges.data();
+
+	ensureVkSuccess(vkCreatePipelineLayout(p_device->vk_handle, &create_info, p_device->getAllocator(),
+		&layout), "Failed to create pipeline layout.");
+	pipeline_layouts.insert(hash, key, layout);
+	return layout;
+} // VkPipelineLayout LayoutCache::getPipelineLayout()
+
+size_t CorE::Graphics::LayoutCache::getSetLayoutCount()
+{
+	std::lock_guard lock(mutex);
+	return set_layouts.getEntries().size();
+} // size_t LayoutCache::getSetLayoutCount()
+
+size_t CorE::Graphics::LayoutCache::getPipelineLayoutCount()
+{
+	std::lock_guard lock(mutex);
+	return pipeline_layouts.getEntries().size();
+} // size_t LayoutCache::getPipelineLayoutCount()
@@ -0,0 +1,85 @@
+#include <cstring>
+
+#include "CorE/hash.hpp"
+
+namespace
+{
+	constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+	constexpr uint64_t PRIME_3 = 0x165667B19E3779F9ull;
+
+	inline uint64_t rotl(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t read64(const unsigned char* p)
+	{
+		uint64_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t round(uint64_t acc, uint64_t input)
+	{
+		acc += input * PRIME_2;
+		acc = rotl(acc, 31);
+		return acc * PRIME_1;
+	}
+
+	inline uint64_t avalanche(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= PRIME_2;
+		h ^= h >> 29;
+		h *= PRIME_3;
+		h ^= h >> 32;
+		return h;
+	}
+} // anonymous namespace
+
+// Four independent accumulators over 32-byte stripes, so the loop is not
+// bound by multiply latency, then a scalar tail and a final avalanche.
+uint64_t CorE::hashBytes(const void* p_data, size_t size, uint64_t seed)
+{
+	const unsigned char* p = static_cast<const unsigned char*>(p_data);
+	const unsigned char* end = p + size;
+
+	uint64_t h;
+	if (size >= 32)
+	{
+		uint64_t acc[4] = { seed + PRIME_1 + PRIME_2, seed + PRIME_2, seed, seed - PRIME_1 };
+		do
+		{
+			acc[0] = round(acc[0], read64(p));
+			acc[1] = round(acc[1], read64(p + 8));
+			acc[2] = round(acc[2], read64(p + 16));
+			acc[3] = round(acc[3], read64(p + 24));
+			p += 32;
+		} while (end - p >= 32);
+		h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+		for (uint64_t a : acc)
+		{
+			h = (h ^ round(0, a)) * PRIME_1 + PRIME_3;
+		}
+	}
+	else
+	{
+		h = seed + PRIME_3;
+	}
+	h += static_cast<uint64_t>(size);
+
+	while (end - p >= 8)
+	{
+		h ^= round(0, read64(p));
+		h = rotl(h, 27) * PRIME_1 + PRIME_3;
+		p += 8;
+	}
+	while (p < end)
+	{
+		h ^= static_cast<uint64_t>(*p) * PRIME_3;
+		h = rotl(h, 11) * PRIME_1;
+		p++;
+	}
+	return avalanche(h);
+} // uint64_t hashBytes()
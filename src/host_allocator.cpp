@@ -0,0 +1,374 @@
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+
+#include "CorE/host_allocator.hpp"
+
+namespace
+{
+	std::atomic<uint64_t> next_allocator_id = 1;
+
+	// Cache the calling thread used last, saves a lookup under lock on every allocation.
+	struct ThreadCacheRef
+	{
+		uint64_t allocator_id = 0;
+		void* p_cache = nullptr;
+	};
+	thread_local ThreadCacheRef tls_cache_ref;
+
+	// Slots moved between a thread cache and the shared pool at once.
+	constexpr uint32_t SLOT_BATCH = 32;
+	// A thread cache gives half of its slots of a class back once it holds more.
+	constexpr uint32_t MAX_CACHED_SLOTS = 2 * SLOT_BATCH;
+	// Marks allocations that went to malloc.
+	constexpr uint8_t LARGE_CLASS = UINT8_MAX;
+
+	// Sits right before every allocation.
+	struct AllocationHeader
+	{
+		// Distance from the slot or malloc block start to the allocation.
+		uint32_t offset;
+		uint8_t size_class;
+		uint8_t scope;
+		uint16_t unused;
+		uint64_t size;
+	};
+	static_assert(sizeof(AllocationHeader) == 16);
+
+	AllocationHeader* getHeader(void* p_memory)
+	{
+		return static_cast<AllocationHeader*>(p_memory) - 1;
+	}
+
+	uint32_t getSizeClass(size_t slot_size)
+	{
+		return static_cast<uint32_t>(std::bit_width(std::max(slot_size, CorE::HostAllocator::MIN_CLASS_SIZE) - 1))
+			- static_cast<uint32_t>(std::countr_zero(CorE::HostAllocator::MIN_CLASS_SIZE));
+	}
+
+	size_t getClassSize(uint32_t size_class)
+	{
+		return CorE::HostAllocator::MIN_CLASS_SIZE << size_class;
+	}
+} // anonymous namespace
+
+CorE::HostAllocator::HostAllocator() : id(next_allocator_id++)
+{
+	static_assert(MIN_CLASS_SIZE << (CLASS_COUNT - 1) == MAX_CLASS_SIZE);
+
+	callbacks.pUserData = this;
+	callbacks.pfnAllocation = allocation;
+	callbacks.pfnReallocation = reallocation;
+	callbacks.pfnFree = free;
+	callbacks.pfnInternalAllocation = internalAllocation;
+	callbacks.pfnInternalFree = internalFree;
+} // HostAllocator::HostAllocator()
+
+CorE::HostAllocator::~HostAllocator()
+{
+	for (void* p_slab : slabs)
+	{
+		std::free(p_slab);
+	}
+} // HostAllocator::~HostAllocator()
+
+CorE::HostAllocator::ScopeStats CorE::HostAllocator::getStats(VkSystemAllocationScope scope)
+{
+	ScopeStats stats;
+	int64_t internal_bytes = 0;
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	for (uptr<ThreadCache>& p_cache : threads)
+	{
+		const ThreadStats& thread_stats = p_cache->stats[scope];
+		stats.allocations += thread_stats.allocations.load(std::memory_order_relaxed);
+		stats.reallocations += thread_stats.reallocations.load(std::memory_order_relaxed);
+		stats.frees += thread_stats.frees.load(std::memory_order_relaxed);
+		stats.allocated_bytes += thread_stats.allocated_bytes.load(std::memory_order_relaxed);
+		stats.freed_bytes += thread_stats.freed_bytes.load(std::memory_order_relaxed);
+		stats.large_allocations += thread_stats.large_allocations.load(std::memory_order_relaxed);
+		internal_bytes += thread_stats.internal_bytes.load(std::memory_order_relaxed);
+	}
+	// Internal memory may be reported freed on another thread than allocated, only the sum makes sense.
+	stats.internal_bytes = static_cast<uint64_t>(std::max<int64_t>(internal_bytes, 0));
+	return stats;
+} // ScopeStats HostAllocator::getStats()
+
+void CorE::HostAllocator::resetStats()
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	for (uptr<ThreadCache>& p_cache : threads)
+	{
+		for (ThreadStats& thread_stats : p_cache->stats)
+		{
+			thread_stats.allocations.store(0, std::memory_order_relaxed);
+			thread_stats.reallocations.store(0, std::memory_order_relaxed);
+			thread_stats.frees.store(0, std::memory_order_relaxed);
+			thread_stats.allocated_bytes.store(0, std::memory_order_relaxed);
+			thread_stats.freed_bytes.store(0, std::memory_order_relaxed);
+			thread_stats.large_allocations.store(0, std::memory_order_relaxed);
+		}
+	}
+} // void HostAllocator::resetStats()
+
+size_t CorE::HostAllocator::getSlabBytes()
+{
+	std::lock_guard<std::mutex> lock(slabs_mutex);
+	return slabs.size() * SLAB_SIZE;
+} // size_t HostAllocator::getSlabBytes()
+
+void* VKAPI_PTR CorE::HostAllocator::allocation(void* p_user_data, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	HostAllocator* p_allocator = static_cast<HostAllocator*>(p_user_data);
+	ThreadCache* p_cache = p_allocator->getThreadCache();
+	void* p_memory = p_allocator->allocate(size, alignment, scope, p_cache);
+	if (p_memory)
+	{
+		ThreadStats& stats = p_cache->stats[scope];
+		stats.allocations.fetch_add(1, std::memory_order_relaxed);
+		stats.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+		if (getHeader(p_memory)->size_class == LARGE_CLASS)
+		{
+			stats.large_allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	return p_memory;
+} // void* HostAllocator::allocation()
+
+void* VKAPI_PTR CorE::HostAllocator::reallocation(void* p_user_data, void* p_original, size_t size, size_t alignment,
+	VkSystemAllocationScope scope)
+{
+	if (!p_original)
+	{
+		return allocation(p_user_data, size, alignment, scope);
+	}
+	if (size == 0)
+	{
+		free(p_user_data, p_original);
+		return nullptr;
+	}
+
+	HostAllocator* p_allocator = static_cast<HostAllocator*>(p_user_data);
+	ThreadCache* p_cache = p_allocator->getThreadCache();
+	AllocationHeader* p_header = getHeader(p_original);
+	const size_t original_size = p_header->size;
+	ThreadStats& original_stats = p_cache->stats[p_header->scope];
+	ThreadStats& stats = p_cache->stats[scope];
+
+	// Alignment of a reallocation must match the original, so the slot only has to be large enough.
+	void* p_memory = p_original;
+	if (p_header->size_class == LARGE_CLASS || p_header->offset + size > getClassSize(p_header->size_class))
+	{
+		p_memory = p_allocator->allocate(size, alignment, scope, p_cache);
+		if (!p_memory)
+		{
+			return nullptr;
+		}
+		std::memcpy(p_memory, p_original, std::min(size, original_size));
+		p_allocator->release(p_original, p_cache);
+		if (getHeader(p_memory)->size_class == LARGE_CLASS)
+		{
+			stats.large_allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	else
+	{
+		p_header->size = size;
+		p_header->scope = static_cast<uint8_t>(scope);
+	}
+
+	original_stats.freed_bytes.fetch_add(original_size, std::memory_order_relaxed);
+	stats.reallocations.fetch_add(1, std::memory_order_relaxed);
+	stats.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	return p_memory;
+} // void* HostAllocator::reallocation()
+
+void VKAPI_PTR CorE::HostAllocator::free(void* p_user_data, void* p_memory)
+{
+	if (!p_memory)
+	{
+		return;
+	}
+	HostAllocator* p_allocator = static_cast<HostAllocator*>(p_user_data);
+	ThreadCache* p_cache = p_allocator->getThreadCache();
+	const AllocationHeader* p_header = getHeader(p_memory);
+	ThreadStats& stats = p_cache->stats[p_header->scope];
+	stats.frees.fetch_add(1, std::memory_order_relaxed);
+	stats.freed_bytes.fetch_add(p_header->size, std::memory_order_relaxed);
+	p_allocator->release(p_memory, p_cache);
+} // void HostAllocator::free()
+
+void VKAPI_PTR CorE::HostAllocator::internalAllocation(void* p_user_data, size_t size, VkInternalAllocationType type,
+	VkSystemAllocationScope scope)
+{
+	HostAllocator* p_allocator = static_cast<HostAllocator*>(p_user_data);
+	p_allocator->getThreadCache()->stats[scope].internal_bytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+} // void HostAllocator::internalAllocation()
+
+void VKAPI_PTR CorE::HostAllocator::internalFree(void* p_user_data, size_t size, VkInternalAllocationType type,
+	VkSystemAllocationScope scope)
+{
+	HostAllocator* p_allocator = static_cast<HostAllocator*>(p_user_data);
+	p_allocator->getThreadCache()->stats[scope].internal_bytes.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+} // void HostAllocator::internalFree()
+
+void* CorE::HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope, ThreadCache* p_cache)
+{
+	if (size == 0)
+	{
+		return nullptr;
+	}
+	// Slots and malloc blocks are aligned to the header size, so the header fits in the alignment padding.
+	alignment = std::max(alignment, sizeof(AllocationHeader));
+	const size_t slot_size = size + alignment;
+
+	char* p_slot;
+	uint8_t size_class;
+	if (slot_size <= MAX_CLASS_SIZE)
+	{
+		size_class = static_cast<uint8_t>(getSizeClass(slot_size));
+		if (!p_cache->slots[size_class])
+		{
+			refill(p_cache, size_class);
+			if (!p_cache->slots[size_class])
+			{
+				return nullptr;
+			}
+		}
+		FreeSlot* p_free = p_cache->slots[size_class];
+		p_cache->slots[size_class] = p_free->p_next;
+		p_cache->slot_counts[size_class]--;
+		p_slot = reinterpret_cast<char*>(p_free);
+	}
+	else
+	{
+		p_slot = static_cast<char*>(std::malloc(slot_size));
+		if (!p_slot)
+		{
+			return nullptr;
+		}
+		size_class = LARGE_CLASS;
+	}
+
+	const uintptr_t first = reinterpret_cast<uintptr_t>(p_slot) + sizeof(AllocationHeader);
+	char* p_memory = reinterpret_cast<char*>((first + alignment - 1) & ~(uintptr_t(alignment) - 1));
+	*getHeader(p_memory) = { static_cast<uint32_t>(p_memory - p_slot), size_class, static_cast<uint8_t>(scope), 0, size };
+	return p_memory;
+} // void* HostAllocator::allocate()
+
+void CorE::HostAllocator::release(void* p_memory, ThreadCache* p_cache)
+{
+	const AllocationHeader* p_header = getHeader(p_memory);
+	char* p_slot = static_cast<char*>(p_memory) - p_header->offset;
+	if (p_header->size_class == LARGE_CLASS)
+	{
+		std::free(p_slot);
+		return;
+	}
+
+	const uint8_t size_class = p_header->size_class;
+	FreeSlot* p_free = reinterpret_cast<FreeSlot*>(p_slot);
+	p_free->p_next = p_cache->slots[size_class];
+	p_cache->slots[size_class] = p_free;
+	if (++p_cache->slot_counts[size_class] > MAX_CACHED_SLOTS)
+	{
+		drain(p_cache, size_class);
+	}
+} // void HostAllocator::release()
+
+void CorE::HostAllocator::refill(ThreadCache* p_cache, uint32_t size_class)
+{
+	ClassPool& pool = class_pools[size_class];
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	if (!pool.p_slots)
+	{
+		char* p_slab = static_cast<char*>(std::malloc(SLAB_SIZE));
+		if (!p_slab)
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> slabs_lock(slabs_mutex);
+			slabs.push_back(p_slab);
+		}
+
+		const size_t class_size = getClassSize(size_class);
+		const uint32_t slot_count = static_cast<uint32_t>(SLAB_SIZE / class_size);
+		for (uint32_t i = slot_count; i-- > 0;)
+		{
+			FreeSlot* p_free = reinterpret_cast<FreeSlot*>(p_slab + i * class_size);
+			p_free->p_next = pool.p_slots;
+			pool.p_slots = p_free;
+		}
+		pool.slot_count += slot_count;
+	}
+
+	const uint32_t count = std::min(SLOT_BATCH, pool.slot_count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		FreeSlot* p_free = pool.p_slots;
+		pool.p_slots = p_free->p_next;
+		p_free->p_next = p_cache->slots[size_class];
+		p_cache->slots[size_class] = p_free;
+	}
+	pool.slot_count -= count;
+	p_cache->slot_counts[size_class] += count;
+} // void HostAllocator::refill()
+
+void CorE::HostAllocator::drain(ThreadCache* p_cache, uint32_t size_class)
+{
+	// Cuts the list of the cache after half of its slots, the front half stays.
+	const uint32_t kept = p_cache->slot_counts[size_class] / 2;
+	FreeSlot* p_last_kept = p_cache->slots[size_class];
+	for (uint32_t i = 1; i < kept; i++)
+	{
+		p_last_kept = p_last_kept->p_next;
+	}
+	FreeSlot* p_first = p_last_kept->p_next;
+	p_last_kept->p_next = nullptr;
+
+	FreeSlot* p_last = p_first;
+	uint32_t count = 1;
+	while (p_last->p_next)
+	{
+		p_last = p_last->p_next;
+		count++;
+	}
+	p_cache->slot_counts[size_class] = kept;
+
+	ClassPool& pool = class_pools[size_class];
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	p_last->p_next = pool.p_slots;
+	pool.p_slots = p_first;
+	pool.slot_count += count;
+} // void HostAllocator::drain()
+
+CorE::HostAllocator::ThreadCache* CorE::HostAllocator::getThreadCache()
+{
+	if (tls_cache_ref.allocator_id == id)
+	{
+		return static_cast<ThreadCache*>(tls_cache_ref.p_cache);
+	}
+
+	const std::thread::id thread_id = std::this_thread::get_id();
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	ThreadCache* p_cache = nullptr;
+	for (uptr<ThreadCache>& p_thread : threads)
+	{
+		if (p_thread->thread_id == thread_id)
+		{
+			p_cache = p_thread.get();
+			break;
+		}
+	}
+	if (!p_cache)
+	{
+		threads.push_back(std::make_unique<ThreadCache>());
+		p_cache = threads.back().get();
+		p_cache->thread_id = thread_id;
+	}
+
+	tls_cache_ref.allocator_id = id;
+	tls_cache_ref.p_cache = p_cache;
+	return p_cache;
+} // ThreadCache* HostAllocator::getThreadCache()
@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "CorE/job_system.hpp"
+
+namespace
+{
+	// Rounds of stealing an idle worker tries before going to sleep.
+	constexpr int IDLE_SPINS = 64;
+
+	// Ring of jobs of the current thread, shared by all job systems.
+	struct JobRing
+	{
+		uptr<CorE::Job[]> jobs = std::make_unique<CorE::Job[]>(CorE::JobSystem::MAX_JOBS_PER_THREAD);
+		size_t next = 0;
+	};
+
+	thread_local JobRing tls_ring;
+} // anonymous namespace
+
+struct CorE::detail::JobWorker
+{
+	detail::WorkStealingDeque deque;
+	// State of the xorshift generator that picks victims to steal from.
+	uint32_t random_state;
+};
+
+namespace
+{
+	// Set on worker threads only.
+	thread_local CorE::detail::JobWorker* tls_worker = nullptr;
+	thread_local const CorE::JobSystem* tls_system = nullptr;
+} // anonymous namespace
+
+
+/////////////////////////
+///       DEQUE       ///
+/////////////////////////
+
+bool CorE::detail::WorkStealingDeque::push(Job* p_job)
+{
+	const int64_t b = bottom.load(std::memory_order_relaxed);
+	const int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= CAPACITY)
+	{
+		return false;
+	}
+	buffer[b & (CAPACITY - 1)].store(p_job, std::memory_order_relaxed);
+	// Publishes the job, and everything written to it, to thieves.
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+} // bool WorkStealingDeque::push()
+
+CorE::Job* CorE::detail::WorkStealingDeque::pop()
+{
+	const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// Empty.
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* p_job = buffer[b & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// Last job, races with thieves for it.
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			p_job = nullptr;
+		}
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return p_job;
+} // Job* WorkStealingDeque::pop()
+
+CorE::Job* CorE::detail::WorkStealingDeque::steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b)
+	{
+		return nullptr;
+	}
+
+	Job* p_job = buffer[t & (CAPACITY - 1)].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		// Lost to the owner or another thief.
+		return nullptr;
+	}
+	return p_job;
+} // Job* WorkStealingDeque::steal()
+
+
+/////////////////////////
+///     JOB SYSTEM    ///
+/////////////////////////
+
+CorE::JobSystem::JobSystem(unsigned int worker_count)
+{
+	if (worker_count == 0)
+	{
+		worker_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	workers.reserve(worker_count);
+	for (unsigned int i = 0; i < worker_count; i++)
+	{
+		workers.push_back(std::make_unique<detail::JobWorker>());
+		workers.back()->random_state = 0x9E3779B9u * (i + 1);
+	}
+	threads.reserve(worker_count);
+	for (unsigned int i = 0; i < worker_count; i++)
+	{
+		threads.emplace_back(&JobSystem::workerLoop, this, i);
+	}
+}
+
+CorE::JobSystem::~JobSystem()
+{
+	stopping = true;
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	sleep_condition.notify_all();
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+CorE::Job* CorE::JobSystem::createJob(Job* p_parent)
+{
+	Job* p_job = allocateJob(p_parent);
+	p_job->p_function = nullptr;
+	return p_job;
+} // Job* JobSystem::createJob()
+
+CorE::Job* CorE::JobSystem::allocateJob(Job* p_parent)
+{
+	Job* p_job = tryAllocateJob(p_parent);
+	if (!p_job)
+	{
+		throw std::runtime_error("Too many unfinished jobs created on one thread.");
+	}
+	return p_job;
+} // Job* JobSystem::allocateJob()
+
+CorE::Job* CorE::JobSystem::tryAllocateJob(Job* p_parent)
+{
+	// Jobs finish out of order, e.g. a parallelFor root outlives the jobs created after it,
+	// so unfinished ones are stepped over rather than waited for.
+	Job* p_job = nullptr;
+	for (size_t i = 0; i < MAX_JOBS_PER_THREAD; i++)
+	{
+		Job* p_candidate = &tls_ring.jobs[tls_ring.next];
+		tls_ring.next = (tls_ring.next + 1) % MAX_JOBS_PER_THREAD;
+		if (p_candidate->isFinished())
+		{
+			p_job = p_candidate;
+			break;
+		}
+	}
+	if (!p_job)
+	{
+		return nullptr;
+	}
+
+	p_job->p_parent = p_parent;
+	p_job->unfinished.store(1, std::memory_order_relaxed);
+	if (p_parent)
+	{
+		p_parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+	}
+	return p_job;
+} // Job* JobSystem::tryAllocateJob()
+
+void CorE::JobSystem::run(Job* p_job)
+{
+	if (tls_worker && tls_system == this)
+	{
+		if (!tls_worker->deque.push(p_job))
+		{
+			execute(p_job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(external_mutex);
+		external_jobs.push_back(p_job);
+		external_count.fetch_add(1, std::memory_order_release);
+	}
+	wake();
+} // void JobSystem::run()
+
+void CorE::JobSystem::wait(const Job* p_job)
+{
+	detail::JobWorker* p_worker = tls_system == this ? tls_worker : nullptr;
+	while (!p_job->isFinished())
+	{
+		if (Job* p_other = findJob(p_worker))
+		{
+			execute(p_other);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+} // void JobSystem::wait()
+
+unsigned int CorE::JobSystem::getThreadCount() const
+{
+	return static_cast<unsigned int>(workers.size()) + 1;
+} // unsigned int JobSystem::getThreadCount()
+
+void CorE::JobSystem::execute(Job* p_job)
+{
+	if (p_job->p_function)
+	{
+		p_job->p_function(p_job);
+	}
+	finish(p_job);
+} // void JobSystem::execute()
+
+void CorE::JobSystem::finish(Job* p_job)
+{
+	while (p_job)
+	{
+		// Once complete, the job may be recycled by allocateJob() at once, so its parent is read first.
+		Job* p_parent = p_job->p_parent;
+		if (p_job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		{
+			return;
+		}
+		p_job = p_parent;
+	}
+} // void JobSystem::finish()
+
+CorE::Job* CorE::JobSystem::findJob(detail::JobWorker* p_worker)
+{
+	if (p_worker)
+	{
+		if (Job* p_job = p_worker->deque.pop())
+		{
+			return p_job;
+		}
+	}
+
+	if (external_count.load(std::memory_order_acquire) != 0)
+	{
+		std::lock_guard<std::mutex> lock(external_mutex);
+		if (!external_jobs.empty())
+		{
+			Job* p_job = external_jobs.back();
+			external_jobs.pop_back();
+			external_count.fetch_sub(1, std::memory_order_relaxed);
+			return p_job;
+		}
+	}
+
+	if (workers.empty())
+	{
+		return nullptr;
+	}
+
+	// Starts from a random victim, so thieves do not all fight over the same deque.
+	uint32_t random = 0x2545F491u;
+	if (p_worker)
+	{
+		random = p_worker->random_state;
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		p_worker->random_state = random;
+	}
+	const size_t first = random % workers.size();
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		detail::JobWorker* p_victim = workers[(first + i) % workers.size()].get();
+		if (p_victim == p_worker)
+		{
+			continue;
+		}
+		if (Job* p_job = p_victim->deque.steal())
+		{
+			return p_job;
+		}
+	}
+	return nullptr;
+} // Job* JobSystem::findJob()
+
+void CorE::JobSystem::workerLoop(unsigned int index)
+{
+	detail::JobWorker* p_worker = workers[index].get();
+	tls_worker = p_worker;
+	tls_system = this;
+
+	int idle_spins = 0;
+	while (!stopping.load(std::memory_order_relaxed))
+	{
+		const uint64_t epoch = work_epoch.load(std::memory_order_seq_cst);
+		if (Job* p_job = findJob(p_worker))
+		{
+			execute(p_job);
+			idle_spins = 0;
+			continue;
+		}
+		if (++idle_spins < IDLE_SPINS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Nothing was queued since the epoch was read, sleeps until something is.
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		sleepers.fetch_add(1, std::memory_order_seq_cst);
+		sleep_condition.wait(lock, [this, epoch]()
+		{
+			return stopping.load(std::memory_order_relaxed) || work_epoch.load(std::memory_order_seq_cst) != epoch;
+		});
+		sleepers.fetch_sub(1, std::memory_order_relaxed);
+		idle_spins = 0;
+	}
+
+	tls_worker = nullptr;
+	tls_system = nullptr;
+} // void JobSystem::workerLoop()
+
+void CorE::JobSystem::wake()
+{
+	work_epoch.fetch_add(1, std::memory_order_seq_cst);
+	if (sleepers.load(std::memory_order_seq_cst) != 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleep_mutex);
+		}
+		sleep_condition.notify_one();
+	}
+} // void JobSystem::wake()
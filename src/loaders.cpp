@@ -1,96 +1,324 @@
-
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <string>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <thread>
 
 #include "CorE/loaders.hpp"
+#include "CorE/file_mapping.hpp"
 
-static void processLine(std::vector<std::string> storage, size_t offset, char separation, std::string line)
+namespace
 {
-	char slot = 0; // current slot of the storage
-	for (size_t i = offset; i < line.length(); i++)
+	// Chunks smaller than this are not worth a thread.
+	constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+	// A corner written to faces with one or more negative (relative) indices, which
+	// may point to attributes of previous chunks and are fixed up while merging.
+	struct RelativeCorner
+	{
+		size_t corner;
+		uint8_t attrib_mask;
+	};
+
+	// Everything parsed from a single chunk. Indices are chunk-local.
+	struct ChunkResult
+	{
+		vec<arr<float, 3>> positions;
+		vec<arr<float, 2>> tex_coords;
+		vec<arr<float, 3>> normals;
+		vec<arr<int, 3>> faces;
+
+		vec<RelativeCorner> relative_corners;
+	};
+
+	struct Corner
+	{
+		arr<int, 3> index{ -1, -1, -1 };
+		uint8_t relative_mask = 0;
+	};
+
+	inline const char* skipBlanks(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+		{
+			p++;
+		}
+		return p;
+	}
+
+	inline const char* findLineEnd(const char* p, const char* end)
+	{
+		const void* p_newline = std::memchr(p, '\n', static_cast<size_t>(end - p));
+		return p_newline ? static_cast<const char*>(p_newline) : end;
+	}
+
+	inline const char* parseFloat(const char* p, const char* end, float& out)
 	{
-		if (line[i] != separation)
+		p = skipBlanks(p, end);
+		// from_chars does not accept an explicit plus sign.
+		if (p < end && *p == '+')
 		{
-			storage[slot][i - offset] = (line[i]);
+			p++;
 		}
-		else
+		auto [p_next, error] = std::from_chars(p, end, out);
+		if (error != std::errc())
 		{
-			slot++; // if came to the separation sign, jumps to the next slot
+			throw std::runtime_error("Malformed number in .obj file.");
 		}
+		return p_next;
 	}
-}
 
-Dim3::Model_3D loadModelOBJ(const char* file_path)
-{
-	Dim3::Model_3D model;
+	inline const char* parseIndex(const char* p, const char* end, int& out)
+	{
+		auto [p_next, error] = std::from_chars(p, end, out);
+		if (error != std::errc() || out == 0)
+		{
+			throw std::runtime_error("Malformed face index in .obj file.");
+		}
+		return p_next;
+	}
 
-	std::ifstream stream;
+	// Parses one face line (without the leading 'f') and emits it as a triangle fan.
+	void parseFace(const char* p, const char* line_end, ChunkResult& result)
+	{
+		const int counts[3] = {
+			static_cast<int>(result.positions.size()),
+			static_cast<int>(result.tex_coords.size()),
+			static_cast<int>(result.normals.size())
+		};
 
-	stream.open(static_cast<std::string>(file_path).append(".obj"));
-	//std::cout << static_cast<std::string>(file_path).append(".obj") << std::endl;
+		Corner first;
+		Corner previous;
+		size_t corner_count = 0;
 
-	std::string line;
-	while (std::getline(stream, line))
-	{
-		Dim3::Vertex_3D vertex;
-		switch (line[0])
+		auto emit = [&result](const Corner& corner)
 		{
-		case ('v'):
-			switch (line[1])
+			if (corner.relative_mask != 0)
 			{
-			case (' '):
+				result.relative_corners.push_back({ result.faces.size(), corner.relative_mask });
+			}
+			result.faces.push_back(corner.index);
+		};
+
+		while (true)
+		{
+			p = skipBlanks(p, line_end);
+			if (p >= line_end || *p == '\r' || *p == '#')
 			{
-				//v 1.000000 1.000000 -1.000000
-				//^^ <- offset = 2
-				vec<str> coord;
-				processLine(coord, 2, ' ', line);
-				vertex.coord[0] = std::stof(coord[0]);
-				vertex.coord[1] = std::stof(coord[1]);
-				vertex.coord[2] = std::stof(coord[2]);
+				break;
 			}
-			case ('n'):
+
+			// v, v/t, v//n or v/t/n
+			Corner corner;
+			for (int attrib = 0; attrib < 3; attrib++)
 			{
-				//vn -0.0000 1.0000 -0.0000
-				//^^^ <- offset = 3
-				vec<str> normal;
-				processLine(normal, 3, ' ', line);
-				vertex.normal[0] = std::stof(normal[0]);
-				vertex.normal[1] = std::stof(normal[1]);
-				vertex.normal[2] = std::stof(normal[2]);
+				if (attrib > 0)
+				{
+					if (p >= line_end || *p != '/')
+					{
+						break;
+					}
+					p++;
+					if (p < line_end && *p == '/')
+					{
+						continue;
+					}
+				}
+
+				int raw;
+				p = parseIndex(p, line_end, raw);
+				if (raw > 0)
+				{
+					corner.index[attrib] = raw - 1;
+				}
+				else
+				{
+					// Relative to the end of the attributes read so far.
+					corner.index[attrib] = counts[attrib] + raw;
+					corner.relative_mask |= static_cast<uint8_t>(1 << attrib);
+				}
 			}
-			case ('t'):
+
+			if (corner_count == 0)
 			{
-				//vt 0.625000 0.500000
-				//^^^ <- offset = 3
-				vec<str> tex_coord;
-				processLine(tex_coord, 3, ' ', line);
-				vertex.tex_coord[0] = std::stof(tex_coord[0]);
-				vertex.tex_coord[1] = std::stof(tex_coord[1]);
+				first = corner;
 			}
+			else if (corner_count >= 2)
+			{
+				emit(first);
+				emit(previous);
+				emit(corner);
+			}
+			previous = corner;
+			corner_count++;
+		}
+
+		if (corner_count != 0 && corner_count < 3)
+		{
+			throw std::runtime_error("Face with less than 3 corners in .obj file.");
+		}
+	}
+
+	void parseChunk(const char* begin, const char* end, ChunkResult& result)
+	{
+		const char* p = begin;
+		while (p < end)
+		{
+			p = skipBlanks(p, end);
+			const char* line_end = findLineEnd(p, end);
+
+			if (line_end - p >= 2)
+			{
+				if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+				{
+					//v 1.000000 1.000000 -1.000000
+					arr<float, 3>& coord = result.positions.emplace_back();
+					const char* q = parseFloat(p + 2, line_end, coord[0]);
+					q = parseFloat(q, line_end, coord[1]);
+					parseFloat(q, line_end, coord[2]);
+				}
+				else if (p[0] == 'v' && p[1] == 'n')
+				{
+					//vn -0.0000 1.0000 -0.0000
+					arr<float, 3>& normal = result.normals.emplace_back();
+					const char* q = parseFloat(p + 2, line_end, normal[0]);
+					q = parseFloat(q, line_end, normal[1]);
+					parseFloat(q, line_end, normal[2]);
+				}
+				else if (p[0] == 'v' && p[1] == 't')
+				{
+					//vt 0.625000 0.500000
+					arr<float, 2>& tex_coord = result.tex_coords.emplace_back();
+					const char* q = parseFloat(p + 2, line_end, tex_coord[0]);
+					parseFloat(q, line_end, tex_coord[1]);
+				}
+				else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+				{
+					//f 1/1/1 5/2/1 7/3/1
+					parseFace(p + 1, line_end, result);
+				}
+				// Everything else (comments, groups, materials) is skipped.
 			}
-		case ('f'):
-			//f 1/1/1 5/2/1 7/3/1
-			//^^ <- offset = 2
-			// non-triangle polygons are not supported.
-			// TODO - add ear-clip algorithm
-			vec<str> face;
-			processLine(face, 3, ' ', line);
-			for (size_t i = 0; i < 2; i++)
+
+			p = line_end < end ? line_end + 1 : end;
+		}
+	}
+
+	// Moves the end of a chunk forward to the start of the next line.
+	const char* alignToLine(const char* p, const char* begin, const char* end)
+	{
+		if (p <= begin)
+		{
+			return begin;
+		}
+		if (p >= end)
+		{
+			return end;
+		}
+		const char* line_end = findLineEnd(p - 1, end);
+		return line_end < end ? line_end + 1 : end;
+	}
+} // anonymous namespace
+
+Dim3::Model_3D loadModelOBJ(const char* file_path, unsigned int max_threads)
+{
+	Dim3::Model_3D model;
+
+	CorE::MappedFile file(file_path);
+	const char* begin = file.getData();
+	const char* end = begin + file.getSize();
+	if (file.getSize() == 0)
+	{
+		return model;
+	}
+
+	size_t thread_count = max_threads != 0 ? max_threads : std::max(1u, std::thread::hardware_concurrency());
+	thread_count = std::clamp<size_t>(file.getSize() / MIN_CHUNK_SIZE, 1, thread_count);
+
+	/// SPLITTING ///
+	vec<const char*> bounds(thread_count + 1);
+	bounds[0] = begin;
+	for (size_t i = 1; i < thread_count; i++)
+	{
+		bounds[i] = alignToLine(begin + file.getSize() * i / thread_count, bounds[i - 1], end);
+	}
+	bounds[thread_count] = end;
+
+	/// PARSING ///
+	vec<ChunkResult> results(thread_count);
+	{
+		vec<std::future<void>> tasks;
+		tasks.reserve(thread_count);
+		for (size_t i = 0; i < thread_count; i++)
+		{
+			tasks.push_back(std::async(std::launch::async, parseChunk, bounds[i], bounds[i + 1], std::ref(results[i])));
+		}
+		// Rethrows the first parsing error, if any.
+		for (std::future<void>& task : tasks)
+		{
+			task.get();
+		}
+	}
+
+	/// MERGING ///
+	// Chunk-local indices become global by adding counts of all previous chunks.
+	vec<arr<size_t, 4>> bases(thread_count + 1);
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		bases[i + 1][0] = bases[i][0] + results[i].positions.size();
+		bases[i + 1][1] = bases[i][1] + results[i].tex_coords.size();
+		bases[i + 1][2] = bases[i][2] + results[i].normals.size();
+		bases[i + 1][3] = bases[i][3] + results[i].faces.size();
+	}
+	model.positions.resize(bases[thread_count][0]);
+	model.tex_coords.resize(bases[thread_count][1]);
+	model.normals.resize(bases[thread_count][2]);
+	model.faces.resize(bases[thread_count][3]);
+
+	auto merge = [&model, &results, &bases](size_t i)
+	{
+		ChunkResult& chunk = results[i];
+		const arr<size_t, 4>& base = bases[i];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), model.positions.begin() + base[0]);
+		std::copy(chunk.tex_coords.begin(), chunk.tex_coords.end(), model.tex_coords.begin() + base[1]);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), model.normals.begin() + base[2]);
+
+		for (const RelativeCorner& relative : chunk.relative_corners)
+		{
+			for (int attrib = 0; attrib < 3; attrib++)
 			{
-				arr<int, 3> iface;
-				std::string part = face[i];
-				vec<str> val;
-				processLine(val, 0, '/', part);
-
-				iface[0] = std::stoi(val[0]);
-				iface[1] = std::stoi(val[1]);
-				iface[2] = std::stoi(val[2]);
-				model.faces.push_back(iface);
+				if (relative.attrib_mask & (1 << attrib))
+				{
+					int& index = chunk.faces[relative.corner][attrib];
+					index += static_cast<int>(base[attrib]);
+					// Otherwise it would pass for an absent attribute.
+					if (index < 0)
+					{
+						throw std::runtime_error("Face index in .obj file refers to before the start of the file.");
+					}
+				}
 			}
-		
+		}
+		std::copy(chunk.faces.begin(), chunk.faces.end(), model.faces.begin() + base[3]);
+
+		// Frees chunk memory as soon as possible, merging doubles peak usage otherwise.
+		chunk = ChunkResult();
+	};
+
+	{
+		vec<std::future<void>> tasks;
+		tasks.reserve(thread_count);
+		for (size_t i = 0; i < thread_count; i++)
+		{
+			tasks.push_back(std::async(std::launch::async, merge, i));
+		}
+		for (std::future<void>& task : tasks)
+		{
+			// Rethrows the first index error, if any.
+			task.get();
 		}
 	}
+
 	return model;
 }
@@ -1,21 +1,191 @@
 
 #include <iostream>
+#include <algorithm>
+#include <cassert>
 #include <chrono>
+#include <cmath>
 #include <future>
+#include <thread>
 
 #include "CorE/window_manager.hpp"
 #include "CorE/loop_manager.hpp"
 
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Heart whose loop runs on this thread, either its simulation or its render thread.
+	thread_local const CorE::Heart* p_loop_heart = nullptr;
+
+	// Waits for frame deadlines. Learns how long a short sleep really takes on this
+	// system, so that hybrid pacing sleeps as long as it can without oversleeping.
+	class FrameWaiter
+	{
+	public:
+
+		FrameWaiter()
+		{
+#if (CORENGINE_PLATFORM == CORENGINE_WINDOWS)
+			// Regular sleeps are rounded up to the 15.6 ms system tick, this timer is not.
+			// Not available before Windows 10 1803, plain sleeps are used there.
+			timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+		}
+
+		~FrameWaiter()
+		{
+#if (CORENGINE_PLATFORM == CORENGINE_WINDOWS)
+			if (timer)
+			{
+				CloseHandle(timer);
+			}
+#endif
+		}
+
+		FrameWaiter(const FrameWaiter&) = delete;
+		FrameWaiter& operator=(const FrameWaiter&) = delete;
+
+		void waitUntil(Clock::time_point deadline, CorE::HeartPacing pacing)
+		{
+			switch (pacing)
+			{
+			case CorE::HeartPacing::Sleep:
+				sleepFor(deadline - Clock::now());
+				break;
+
+			case CorE::HeartPacing::Hybrid:
+				while (true)
+				{
+					const double remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+					if (remaining <= estimate)
+					{
+						break;
+					}
+					const auto start = Clock::now();
+					sleepFor(SLEEP_QUANTUM);
+					observe(std::chrono::duration<double>(Clock::now() - start).count());
+				}
+				spinUntil(deadline);
+				break;
+
+			case CorE::HeartPacing::Spin:
+				spinUntil(deadline);
+				break;
+			}
+		}
+
+	private:
+
+		static constexpr std::chrono::milliseconds SLEEP_QUANTUM{ 1 };
+		// Older samples stop counting past this, so the estimate follows changes in system load.
+		static constexpr double MAX_SAMPLES = 1000.0;
+
+		static void spinUntil(Clock::time_point deadline)
+		{
+			while (Clock::now() < deadline)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		void sleepFor(Clock::duration duration)
+		{
+			if (duration <= Clock::duration::zero())
+			{
+				return;
+			}
+#if (CORENGINE_PLATFORM == CORENGINE_WINDOWS)
+			if (timer)
+			{
+				LARGE_INTEGER due;
+				// Relative time, in 100 ns units.
+				due.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count() / 100);
+				SetWaitableTimer(timer, &due, 0, nullptr, nullptr, FALSE);
+				WaitForSingleObject(timer, INFINITE);
+				return;
+			}
+#endif
+			std::this_thread::sleep_for(duration);
+		}
+
+		// Adds a measured sleep to the running mean and variance (Welford).
+		void observe(double seconds)
+		{
+			samples = std::min(samples + 1.0, MAX_SAMPLES);
+			const double deviation = seconds - mean;
+			mean += deviation / samples;
+			m2 = std::max(0.0, m2 + deviation * (seconds - mean));
+			if (samples == MAX_SAMPLES)
+			{
+				m2 *= (MAX_SAMPLES - 1.0) / MAX_SAMPLES;
+			}
+			estimate = mean + std::sqrt(m2 / samples);
+		}
+
+		// Pessimistic until measured, so the first frames rather spin than oversleep.
+		double estimate = 5e-3;
+		double mean = 5e-3;
+		double m2 = 0.0;
+		double samples = 1.0;
+
+#if (CORENGINE_PLATFORM == CORENGINE_WINDOWS)
+		HANDLE timer = nullptr;
+#endif
+	};
+
+	// Time spent in each stage of a Heart during the current second.
+	struct StageTimes
+	{
+		Clock::duration input{};
+		Clock::duration update{};
+		Clock::duration snapshot{};
+		Clock::duration render{};
+		Clock::duration pacing{};
+		Clock::duration stall{};
+		Clock::duration starve{};
+
+		// Gets time since stage_start, and moves stage_start to now.
+		static Clock::duration lap(Clock::time_point& stage_start)
+		{
+			const auto now = Clock::now();
+			const Clock::duration passed = now - stage_start;
+			stage_start = now;
+			return passed;
+		}
+
+		static float average(Clock::duration total, unsigned int frames)
+		{
+			return frames ? static_cast<float>(std::chrono::duration<double>(total).count() / frames) : 0.0f;
+		}
+	};
+} // anonymous namespace
+
 
 CorE::Heart::Heart(HeartProperties* props) :
-	fps_cap(props->fps_cap)
+	fps_cap(props->fps_cap),
+	update_rate(props->update_rate),
+	max_updates_per_frame(props->max_updates_per_frame),
+	pacing(props->pacing),
+	frames_in_flight(std::clamp(props->frames_in_flight, 1u, 3u))
 {
+	if (props->p_job_system)
+	{
+		p_job_system = props->p_job_system;
+	}
+	else
+	{
+		owned_job_system = std::make_unique<JobSystem>();
+		p_job_system = owned_job_system.get();
+	}
 
 }
 
 CorE::Heart::~Heart()
 {
-
+	// Derived parts are gone by now, so a loop still running would call their overrides.
+	assert((!async_call.valid() || async_call.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		&& "Derived classes of Heart must call stop() in their destructor.");
+	stop();
 }
 
 void CorE::Heart::init()
@@ -27,6 +197,8 @@ void CorE::Heart::start()
 {
 	if (!is_running)
 	{
+		// Set before the loop starts, so that a stop() right after is not missed.
+		is_running = true;
 		async_call = std::async(std::launch::async, &Heart::run, this);
 
 		// delay for slow ass vtables
@@ -40,130 +212,234 @@ void CorE::Heart::stop()
 	if (is_running)
 	{
 		this->is_running = false;
+
+		// Wakes threads waiting for a frame slot.
+		{
+			std::lock_guard<std::mutex> lock(frame_mutex);
+		}
+		frame_condition.notify_all();
+	}
+
+	if (p_loop_heart != this && async_call.valid())
+	{
+		async_call.wait();
 	}
 }
 
 void CorE::Heart::run()
 {
+	p_loop_heart = this;
+
+	FrameWaiter waiter;
 
-	is_running = true;
+	const Clock::duration update_step = std::chrono::duration_cast<Clock::duration>(
+		std::chrono::duration<double>(1.0 / std::max(1u, update_rate)));
 
 	// Why do we need frames_processed variable?
 	/// To know how much frames we
 	/// did processed per this second.
 	unsigned int frames_processed = 0;
-	// Why do we need nanos_counter variable?
+	// Why do we need window_time variable?
 	/// To know when the second of real time is passed.
-	unsigned int nanos_counter = 0;
+	Clock::duration window_time{};
 	// Why do we need unprocessed time?
-	/// 
-	double unprocessed_time = 0;
+	/// It is the simulation time update() still owes,
+	/// always less than update_step after updates of a frame.
+	Clock::duration unprocessed_time{};
 
-	auto loop_start_time = std::chrono::steady_clock::now();
-	auto loop_end_time = std::chrono::steady_clock::now();
+	// Running mean and variance of frame time (Welford), in seconds, for jitter.
+	double frame_time_mean = 0.0;
+	double frame_time_m2 = 0.0;
 
-	bool rendering = false;
+	// Time spent in each stage during the current second.
+	StageTimes stage_times;
+
+	const bool pipelined = frames_in_flight > 1;
+	if (pipelined)
+	{
+		frames_written = 0;
+		frames_rendered = 0;
+		render_call = std::async(std::launch::async, &Heart::renderLoop, this);
+	}
 
-	unsigned int loops_per_frame = 0;
+	auto loop_start_time = Clock::now();
+	auto next_frame_time = loop_start_time;
 
 	/// ------------------------------- /// LOOP /// ------------------------------- ///
 	while (is_running)
 	{
-		/// SUMMARY OF THE PREVIOUS LOOP ///
-		//// Summary calculations are kept outside the loop.
-		// Time passed to process a frame (in nanos).
-		float passed_to_frame = static_cast<float>(loop_end_time.time_since_epoch().count() - loop_start_time.time_since_epoch().count());
-		// Same thing, but in seconds.
-		delta = passed_to_frame / static_cast<float>(NANOSECOND);
-		/// SUMMARY OF THE PREVIOUS LOOP ///
-
-
 		///         \/ \/ \/         ///
 		///   START  OF  THE  LOOP   ///
-		// Note that the end of the previous
-		// loop is taken as the start time.
-		// It is done to exclude time spent
-		// to summary calculation from loop (?)
-		loop_start_time = loop_end_time;
+		const auto now = Clock::now();
+		const Clock::duration passed_to_frame = now - loop_start_time;
+		loop_start_time = now;
 		///   START  OF  THE  LOOP   ///
 		///         \/ \/ \/         ///
 
+		const double frame_seconds = std::chrono::duration<double>(passed_to_frame).count();
+		delta = static_cast<float>(frame_seconds);
 
-		// Adds time spent to previous loop (In seconds)
-		unprocessed_time += passed_to_frame / (double)NANOSECOND;
+		/// STATISTICS ///
+		frames_processed++;
+		window_time += passed_to_frame;
+		const double deviation = frame_seconds - frame_time_mean;
+		frame_time_mean += deviation / frames_processed;
+		frame_time_m2 += deviation * (frame_seconds - frame_time_mean);
+		if (window_time >= std::chrono::seconds(1))
+		{
+			fps = frames_processed;
+			jitter = static_cast<float>(std::sqrt(frame_time_m2 / frames_processed));
+			{
+				std::lock_guard<std::mutex> lock(timings_mutex);
+				timings.input = stage_times.average(stage_times.input, frames_processed);
+				timings.update = stage_times.average(stage_times.update, frames_processed);
+				timings.snapshot = stage_times.average(stage_times.snapshot, frames_processed);
+				timings.pacing = stage_times.average(stage_times.pacing, frames_processed);
+				timings.stall = stage_times.average(stage_times.stall, frames_processed);
+				if (!pipelined)
+				{
+					timings.render = stage_times.average(stage_times.render, frames_processed);
+				}
+			}
+			stage_times = StageTimes();
 
-		// Adds time spent to previous loop (In nanos)
-		nanos_counter += static_cast<unsigned int>(passed_to_frame);
+			frames_processed = 0;
+			window_time = Clock::duration::zero();
+			frame_time_mean = 0.0;
+			frame_time_m2 = 0.0;
+		}
 
 		// Here, the loop processes all kinds of user input.
+		auto stage_start = Clock::now();
 		input();
+		stage_times.input += stage_times.lap(stage_start);
 
-
-		///= INNER LOOP
-		//=== While UNPROCESSED is more than FRAMETIME :::
-		while (unprocessed_time > FRAMETIME)
+		/// FIXED UPDATES ///
+		unprocessed_time += passed_to_frame;
+		unsigned int updates = 0;
+		while (unprocessed_time >= update_step && updates < max_updates_per_frame)
 		{
+			update();
+			unprocessed_time -= update_step;
+			updates++;
+		}
+		if (unprocessed_time >= update_step)
+		{
+			// Too far behind to catch up, the rest is dropped.
+			unprocessed_time %= update_step;
+		}
+		const float frame_interpolation = static_cast<float>(unprocessed_time.count()) / static_cast<float>(update_step.count());
+		stage_times.update += stage_times.lap(stage_start);
 
-			/// We enable the render, therefore, consider this frame processed.
-			rendering = true;
-
-			/// We subtract one FRAMETIME unit from
-			/// unprocessed time, leaving it only the surplus
-			unprocessed_time -= FRAMETIME;
+		if (pipelined)
+		{
+			/// HANDOFF ///
+			unsigned int slot;
+			{
+				std::unique_lock<std::mutex> lock(frame_mutex);
+				frame_condition.wait(lock, [this]() { return !is_running || frames_written - frames_rendered < frames_in_flight; });
+				slot = static_cast<unsigned int>(frames_written % frames_in_flight);
+			}
+			stage_times.stall += stage_times.lap(stage_start);
+			if (!is_running)
+			{
+				break;
+			}
 
-			// If nanos_counter is more than 1 million, i.e. if
-			// the time passed to render previous several frames
-			// is more than 1 second :::
-			if (nanos_counter >= NANOSECOND)
+			snapshot(slot);
+			slot_interpolation[slot] = frame_interpolation;
 			{
-				/// We may determine FPS, i.e. how much frames we're processed
-				/// per said second. Remember, that not every loop processes
-				/// a frame, it does only if UNPROCESSED become more than FRAMETIME
-				/// in this loop, i.e. if time spent to process several previous
-				/// loops is more than 0.001 second.
-				fps = frames_processed;
-
-				/// We also do reset both FRAMES and FRAME_COUNTER variables to 0.
-				frames_processed = 0;
-				nanos_counter = 0;
+				std::lock_guard<std::mutex> lock(frame_mutex);
+				frames_written++;
 			}
+			frame_condition.notify_all();
+			stage_times.snapshot += stage_times.lap(stage_start);
+		}
+		else
+		{
+			interpolation = frame_interpolation;
+			render();
+			stage_times.render += stage_times.lap(stage_start);
 		}
-		//===========================================//
 
+		/// PACING ///
+		const unsigned int cap = fps_cap;
+		if (cap != 0)
+		{
+			const Clock::duration frame_time = std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(1.0 / cap));
+			// Deadlines follow a fixed grid, so that lateness of one frame is made up by the next.
+			next_frame_time += frame_time;
+			const auto after_render = Clock::now();
+			if (next_frame_time < after_render - frame_time)
+			{
+				// More than a whole frame late, e.g. after a stall. Starts the grid anew.
+				next_frame_time = after_render;
+			}
+			waiter.waitUntil(next_frame_time, pacing);
+			stage_times.pacing += stage_times.lap(stage_start);
+		}
+		else
+		{
+			next_frame_time = loop_start_time;
+		}
+	}
+	/// ------------------------------- /// LOOP /// ------------------------------- ///
 
-		// If rendering is enabled (i.e. in this loop
-		// unprocessed time counter became more than 0.001f),
-		/// we call general update() and render() functions, and add
-		/// 1 to FRAMES variable, i.e. consider this frame processed and rendered.
-		if (rendering)
+	if (pipelined)
+	{
 		{
-			update();
-			render();
-			frames_processed++;
+			std::lock_guard<std::mutex> lock(frame_mutex);
 		}
+		frame_condition.notify_all();
+		render_call.get();
+	}
+}
 
+void CorE::Heart::renderLoop()
+{
+	p_loop_heart = this;
+
+	StageTimes stage_times;
+	unsigned int frames_processed = 0;
+	auto window_start = Clock::now();
 
-		// Disabling the rendering, because it only need to be
-		// enabled if the unprocessed_time became more than 0.001 sec.
-		if (!rendering)
+	while (true)
+	{
+		auto stage_start = Clock::now();
 		{
-			loops_per_frame++;
+			std::unique_lock<std::mutex> lock(frame_mutex);
+			frame_condition.wait(lock, [this]() { return !is_running || frames_rendered < frames_written; });
+			if (!is_running)
+			{
+				return;
+			}
+			render_slot = static_cast<unsigned int>(frames_rendered % frames_in_flight);
 		}
-		else
+		stage_times.starve += stage_times.lap(stage_start);
+
+		interpolation = slot_interpolation[render_slot];
+		render();
+		stage_times.render += stage_times.lap(stage_start);
+
 		{
-			loops_per_frame = 0;
-			rendering = false;
+			std::lock_guard<std::mutex> lock(frame_mutex);
+			frames_rendered++;
 		}
-		
+		frame_condition.notify_all();
 
+		frames_processed++;
+		if (stage_start - window_start >= std::chrono::seconds(1))
+		{
+			std::lock_guard<std::mutex> lock(timings_mutex);
+			timings.render = stage_times.average(stage_times.render, frames_processed);
+			timings.starve = stage_times.average(stage_times.starve, frames_processed);
 
-		///        \/ \/ \/        ///
-		///   END  OF  THE  LOOP   ///
-		loop_end_time = std::chrono::steady_clock::now();
-		///   END  OF  THE  LOOP   ///
-		///        \/ \/ \/        ///
+			stage_times = StageTimes();
+			frames_processed = 0;
+			window_start = stage_start;
+		}
 	}
-	/// ------------------------------- /// LOOP /// ------------------------------- ///
 }
 
 void CorE::Heart::update()
@@ -177,6 +453,10 @@ void CorE::Heart::input()
 void CorE::Heart::render()
 {
 	
+}
+void CorE::Heart::snapshot(unsigned int slot)
+{
+
 }
 
 
@@ -189,6 +469,33 @@ unsigned int CorE::Heart::getFps()
 	return fps;
 }
 
+float CorE::Heart::getUpdateStep()
+{
+	return 1.0f / static_cast<float>(std::max(1u, update_rate));
+}
+float CorE::Heart::getInterpolation()
+{
+	return interpolation;
+}
+float CorE::Heart::getJitter()
+{
+	return jitter;
+}
+CorE::HeartTimings CorE::Heart::getTimings()
+{
+	std::lock_guard<std::mutex> lock(timings_mutex);
+	return timings;
+}
+
+unsigned int CorE::Heart::getFramesInFlight() const
+{
+	return frames_in_flight;
+}
+unsigned int CorE::Heart::getRenderSlot() const
+{
+	return render_slot;
+}
+
 void CorE::Heart::setFpsCap(unsigned int cap)
 {
 	fps_cap = cap;
@@ -203,3 +510,8 @@ bool CorE::Heart::isRunning() const
 	return is_running;
 }
 
+CorE::JobSystem* CorE::Heart::getJobSystem()
+{
+	return p_job_system;
+}
+
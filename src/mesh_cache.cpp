@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include "CorE/mesh_cache.hpp"
+#include "CorE/mesh_processing.hpp"
+#include "CorE/loaders.hpp"
+#include "CorE/hash.hpp"
+
+// Vertices are handed out straight from the mapping, so their layout is the file format.
+static_assert(sizeof(Dim3::Vertex_3D) == 8 * sizeof(float), "Vertex_3D must be tightly packed.");
+static_assert(std::is_trivially_copyable_v<Dim3::Vertex_3D>, "Vertex_3D must be trivially copyable.");
+static_assert(std::is_trivially_copyable_v<Dim3::MeshFileHeader>, "MeshFileHeader must be trivially copyable.");
+
+namespace
+{
+	constexpr uint64_t BLOCK_ALIGNMENT = 16;
+
+	inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	void ensureLittleEndian()
+	{
+		if constexpr (std::endian::native != std::endian::little)
+		{
+			throw std::runtime_error("Binary mesh files are only supported on little-endian hosts.");
+		}
+	}
+
+	void writePadding(std::ofstream& stream, uint64_t target_offset)
+	{
+		static const char zeros[BLOCK_ALIGNMENT] = {};
+		const uint64_t current = static_cast<uint64_t>(stream.tellp());
+		stream.write(zeros, static_cast<std::streamsize>(target_offset - current));
+	}
+
+	uint64_t hashFile(const char* file_path)
+	{
+		CorE::MappedFile file(file_path);
+		return CorE::hashBytes(file.getData(), file.getSize());
+	}
+} // anonymous namespace
+
+void Dim3::writeMeshFile(const char* file_path, const Model_3D& model, const MeshSourceKey& source)
+{
+	ensureLittleEndian();
+	if (model.indices.size() == 0 && !model.faces.empty())
+	{
+		throw std::runtime_error("Model must be indexed before being written to a mesh file.");
+	}
+
+	MeshFileHeader header{};
+	std::memcpy(header.magic, MeshFileHeader::MAGIC, sizeof(header.magic));
+	header.version = MeshFileHeader::VERSION;
+	header.source = source;
+	header.vertex_count = model.vertices.size();
+	header.vertex_offset = alignUp(sizeof(MeshFileHeader), BLOCK_ALIGNMENT);
+	header.index_count = model.indices.size();
+	header.index_stride = static_cast<uint32_t>(model.indices.getStride());
+	header.index_offset = alignUp(header.vertex_offset + header.vertex_count * sizeof(Vertex_3D), BLOCK_ALIGNMENT);
+
+	header.bounds_min = { 0.0f, 0.0f, 0.0f };
+	header.bounds_max = { 0.0f, 0.0f, 0.0f };
+	if (!model.vertices.empty())
+	{
+		header.bounds_min = model.vertices[0].coord;
+		header.bounds_max = model.vertices[0].coord;
+		for (const Vertex_3D& vertex : model.vertices)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				header.bounds_min[axis] = std::min(header.bounds_min[axis], vertex.coord[axis]);
+				header.bounds_max[axis] = std::max(header.bounds_max[axis], vertex.coord[axis]);
+			}
+		}
+	}
+
+	// Written aside and renamed over the target, so a crash never leaves a torn file behind.
+	const std::filesystem::path target(file_path);
+	std::filesystem::path temp = target;
+	temp += ".tmp";
+	{
+		std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to create mesh file.");
+		}
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		writePadding(stream, header.vertex_offset);
+		stream.write(reinterpret_cast<const char*>(model.vertices.data()),
+			static_cast<std::streamsize>(header.vertex_count * sizeof(Vertex_3D)));
+		writePadding(stream, header.index_offset);
+		stream.write(static_cast<const char*>(model.indices.getData()),
+			static_cast<std::streamsize>(header.index_count * header.index_stride));
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to write mesh file.");
+		}
+	}
+	std::filesystem::rename(temp, target);
+} // void Dim3::writeMeshFile()
+
+Dim3::MappedModel_3D Dim3::mapMeshFile(const char* file_path)
+{
+	ensureLittleEndian();
+
+	MappedModel_3D mesh{ CorE::MappedFile(file_path) };
+	const char* p_data = mesh.file.getData();
+	const uint64_t size = mesh.file.getSize();
+
+	if (size < sizeof(MeshFileHeader))
+	{
+		throw std::runtime_error("Mesh file is too small.");
+	}
+	MeshFileHeader header;
+	std::memcpy(&header, p_data, sizeof(header));
+	if (std::memcmp(header.magic, MeshFileHeader::MAGIC, sizeof(header.magic)) != 0)
+	{
+		throw std::runtime_error("File is not a mesh file.");
+	}
+	if (header.version != MeshFileHeader::VERSION)
+	{
+		throw std::runtime_error("Mesh file version is not supported.");
+	}
+
+	const bool aligned = header.vertex_offset % BLOCK_ALIGNMENT == 0 && header.index_offset % BLOCK_ALIGNMENT == 0;
+	const bool stride_ok = header.index_stride == sizeof(uint16_t) || header.index_stride == sizeof(uint32_t);
+	const bool vertices_fit = header.vertex_offset <= size
+		&& header.vertex_count <= (size - header.vertex_offset) / sizeof(Vertex_3D);
+	const bool indices_fit = stride_ok && header.index_offset <= size
+		&& header.index_count <= (size - header.index_offset) / header.index_stride;
+	if (!(aligned && vertices_fit && indices_fit))
+	{
+		throw std::runtime_error("Mesh file is corrupted.");
+	}
+
+	mesh.source = header.source;
+	mesh.bounds_min = header.bounds_min;
+	mesh.bounds_max = header.bounds_max;
+	mesh.vertices = std::span<const Vertex_3D>(
+		reinterpret_cast<const Vertex_3D*>(p_data + header.vertex_offset), header.vertex_count);
+	if (header.index_stride == sizeof(uint16_t))
+	{
+		mesh.indices_16 = std::span<const uint16_t>(
+			reinterpret_cast<const uint16_t*>(p_data + header.index_offset), header.index_count);
+	}
+	else
+	{
+		mesh.indices_32 = std::span<const uint32_t>(
+			reinterpret_cast<const uint32_t*>(p_data + header.index_offset), header.index_count);
+	}
+	return mesh;
+} // MappedModel_3D Dim3::mapMeshFile()
+
+Dim3::MeshSourceKey Dim3::getSourceKey(const char* source_path, bool with_hash)
+{
+	MeshSourceKey key;
+	key.mtime = static_cast<int64_t>(std::filesystem::last_write_time(source_path).time_since_epoch().count());
+	key.size = static_cast<uint64_t>(std::filesystem::file_size(source_path));
+	key.hash = with_hash ? hashFile(source_path) : 0;
+	return key;
+} // MeshSourceKey Dim3::getSourceKey()
+
+Dim3::MappedModel_3D Dim3::loadModelCached(const char* source_path, const char* cache_dir)
+{
+	const std::filesystem::path source = std::filesystem::canonical(source_path);
+	const str source_str = source.string();
+
+	std::filesystem::create_directories(cache_dir);
+	char cache_name[32];
+	std::snprintf(cache_name, sizeof(cache_name), "%016llx.cmesh",
+		static_cast<unsigned long long>(CorE::hashBytes(source_str.data(), source_str.size())));
+	const std::filesystem::path cache_path = std::filesystem::path(cache_dir) / cache_name;
+	const str cache_str = cache_path.string();
+
+	MeshSourceKey key = getSourceKey(source_str.c_str(), false);
+	bool key_hashed = false;
+
+	if (std::filesystem::exists(cache_path))
+	{
+		try
+		{
+			MappedModel_3D cached = mapMeshFile(cache_str.c_str());
+			if (cached.source.size == key.size)
+			{
+				if (cached.source.mtime == key.mtime)
+				{
+					return cached;
+				}
+
+				// Touched, but possibly not changed.
+				key.hash = hashFile(source_str.c_str());
+				key_hashed = true;
+				if (cached.source.hash == key.hash)
+				{
+					// Stores the new write time, so the next load takes the fast path again. Written aside and
+					// renamed over the file like writeMeshFile() does, so a crash never leaves a torn header behind.
+					MeshFileHeader header;
+					std::memcpy(&header, cached.file.getData(), sizeof(header));
+					header.source = key;
+					std::filesystem::path temp = cache_path;
+					temp += ".tmp";
+					{
+						std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+						stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+						stream.write(cached.file.getData() + sizeof(header),
+							static_cast<std::streamsize>(cached.file.getSize() - sizeof(header)));
+						if (!stream)
+						{
+							// Only costs hashing the source again next time.
+							stream.close();
+							std::filesystem::remove(temp);
+							return cached;
+						}
+					}
+					// Unmapped first, as mapped files can not be replaced on Windows.
+					cached = MappedModel_3D();
+					std::filesystem::rename(temp, cache_path);
+					return mapMeshFile(cache_str.c_str());
+				}
+			}
+		}
+		catch (const std::runtime_error&)
+		{
+			// Outdated or corrupted, rebuilt below.
+		}
+	}
+
+	if (!key_hashed)
+	{
+		key.hash = hashFile(source_str.c_str());
+	}
+
+	Model_3D model = loadModelOBJ(source_str.c_str());
+	indexModel(model);
+	writeMeshFile(cache_str.c_str(), model, key);
+	return mapMeshFile(cache_str.c_str());
+} // MappedModel_3D Dim3::loadModelCached()
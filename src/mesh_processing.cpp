@@ -0,0 +1,594 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "CorE/mesh_processing.hpp"
+
+namespace
+{
+	constexpr uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+
+	// Vertex counts below this get 16-bit indices, so index 0xFFFF is left for primitive restart.
+	constexpr size_t NARROW_VERTEX_LIMIT = 0xFFFF;
+
+	// Mixes the three indices of a corner into a well-distributed hash.
+	inline uint64_t hashCorner(const arr<int, 3>& corner)
+	{
+		uint64_t h = static_cast<uint32_t>(corner[0]);
+		h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(corner[1]);
+		h = h * 0x9E3779B97F4A7C15ull ^ static_cast<uint32_t>(corner[2]);
+		// Final avalanche, from MurmurHash3.
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 33;
+		return h;
+	}
+
+	// Absent attributes are exactly -1, any other negative index is invalid.
+	void validateCorner(const arr<int, 3>& corner, const Dim3::Model_3D& model)
+	{
+		const bool position_ok = corner[0] >= 0 && static_cast<size_t>(corner[0]) < model.positions.size();
+		const bool tex_coord_ok = corner[1] == -1
+			|| (corner[1] >= 0 && static_cast<size_t>(corner[1]) < model.tex_coords.size());
+		const bool normal_ok = corner[2] == -1
+			|| (corner[2] >= 0 && static_cast<size_t>(corner[2]) < model.normals.size());
+		if (!(position_ok && tex_coord_ok && normal_ok))
+		{
+			throw std::runtime_error("Face refers to a vertex attribute that does not exist.");
+		}
+	}
+
+	/// VERTEX CACHE OPTIMIZATION ///
+	// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation", with its reference constants.
+	constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+	constexpr uint32_t FORSYTH_MAX_VALENCE = 64;
+	constexpr float CACHE_DECAY_POWER = 1.5f;
+	constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+	constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	constexpr uint32_t NO_TRIANGLE = std::numeric_limits<uint32_t>::max();
+
+	struct ScoreTables
+	{
+		float cache[FORSYTH_CACHE_SIZE];
+		float valence[FORSYTH_MAX_VALENCE + 1];
+
+		ScoreTables()
+		{
+			for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; i++)
+			{
+				// Vertices of the last triangle get a fixed score, so that it is not reused right away.
+				cache[i] = i < 3 ? LAST_TRIANGLE_SCORE
+					: std::pow(1.0f - static_cast<float>(i - 3) / (FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+			}
+			valence[0] = 0.0f;
+			for (uint32_t i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+			{
+				// Boosts vertices with few triangles left, so that they are finished off.
+				valence[i] = VALENCE_BOOST_SCALE * std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+			}
+		}
+
+		float score(int cache_position, uint32_t live_triangles) const
+		{
+			if (live_triangles == 0)
+			{
+				return 0.0f;
+			}
+			const float cache_score = cache_position >= 0 ? cache[cache_position] : 0.0f;
+			return cache_score + valence[std::min(live_triangles, FORSYTH_MAX_VALENCE)];
+		}
+	};
+
+	vec<uint32_t> readIndices(const Dim3::IndexBuffer_3D& buffer)
+	{
+		if (buffer.isWide())
+		{
+			return buffer.indices_32;
+		}
+		return vec<uint32_t>(buffer.indices_16.begin(), buffer.indices_16.end());
+	}
+
+	void writeIndices(Dim3::IndexBuffer_3D& buffer, vec<uint32_t>&& indices, size_t vertex_count)
+	{
+		buffer = Dim3::IndexBuffer_3D();
+		if (vertex_count < NARROW_VERTEX_LIMIT)
+		{
+			buffer.indices_16.assign(indices.begin(), indices.end());
+		}
+		else
+		{
+			buffer.indices_32 = std::move(indices);
+		}
+	}
+
+	VertexCacheStats simulateFifo(const vec<uint32_t>& indices, size_t vertex_count, unsigned int cache_size)
+	{
+		VertexCacheStats stats;
+		if (indices.empty())
+		{
+			return stats;
+		}
+
+		// A vertex is cached while fewer than cache_size misses happened since it was last loaded.
+		vec<size_t> loaded_at(vertex_count, 0);
+		size_t time = static_cast<size_t>(cache_size) + 1;
+		size_t misses = 0;
+		size_t unique = 0;
+		for (uint32_t index : indices)
+		{
+			if (loaded_at[index] == 0)
+			{
+				unique++;
+			}
+			if (time - loaded_at[index] > cache_size)
+			{
+				loaded_at[index] = time++;
+				misses++;
+			}
+		}
+		stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+		stats.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+		return stats;
+	}
+
+	vec<uint32_t> reorderForVertexCache(const vec<uint32_t>& indices, size_t vertex_count)
+	{
+		static const ScoreTables tables;
+		const size_t triangle_count = indices.size() / 3;
+
+		// Triangles of each vertex, packed. Only the first live_triangles[v] of them are not emitted yet.
+		vec<uint32_t> live_triangles(vertex_count, 0);
+		for (uint32_t index : indices)
+		{
+			live_triangles[index]++;
+		}
+		vec<uint32_t> offsets(vertex_count + 1, 0);
+		for (size_t v = 0; v < vertex_count; v++)
+		{
+			offsets[v + 1] = offsets[v] + live_triangles[v];
+		}
+		vec<uint32_t> adjacency(indices.size());
+		{
+			vec<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+			{
+				adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		vec<float> vertex_score(vertex_count);
+		for (size_t v = 0; v < vertex_count; v++)
+		{
+			vertex_score[v] = tables.score(-1, live_triangles[v]);
+		}
+
+		vec<float> triangle_score(triangle_count);
+		uint32_t best = NO_TRIANGLE;
+		float best_score = -1.0f;
+		for (size_t t = 0; t < triangle_count; t++)
+		{
+			triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+			if (triangle_score[t] > best_score)
+			{
+				best_score = triangle_score[t];
+				best = static_cast<uint32_t>(t);
+			}
+		}
+
+		vec<uint8_t> emitted(triangle_count, 0);
+		vec<uint32_t> result;
+		result.reserve(indices.size());
+
+		// Extra room for the vertices pushed out by the last triangle, their scores must drop too.
+		uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+		uint32_t cache_count = 0;
+		size_t cursor = 0;
+
+		for (size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++)
+		{
+			if (best == NO_TRIANGLE)
+			{
+				// Nothing in the cache has triangles left, continues from the first remaining one.
+				while (emitted[cursor])
+				{
+					cursor++;
+				}
+				best = static_cast<uint32_t>(cursor);
+			}
+
+			const uint32_t* p_triangle = &indices[static_cast<size_t>(best) * 3];
+			emitted[best] = 1;
+			uint32_t new_cache[FORSYTH_CACHE_SIZE + 3];
+			uint32_t new_count = 0;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const uint32_t v = p_triangle[corner];
+				result.push_back(v);
+
+				uint32_t* p_begin = &adjacency[offsets[v]];
+				uint32_t* p_end = p_begin + live_triangles[v];
+				std::iter_swap(std::find(p_begin, p_end, best), p_end - 1);
+				live_triangles[v]--;
+
+				if (std::find(new_cache, new_cache + new_count, v) == new_cache + new_count)
+				{
+					new_cache[new_count++] = v;
+				}
+			}
+			for (uint32_t i = 0; i < cache_count; i++)
+			{
+				const uint32_t v = cache[i];
+				if (v != p_triangle[0] && v != p_triangle[1] && v != p_triangle[2])
+				{
+					new_cache[new_count++] = v;
+				}
+			}
+
+			best = NO_TRIANGLE;
+			best_score = -1.0f;
+			for (uint32_t i = 0; i < new_count; i++)
+			{
+				const uint32_t v = new_cache[i];
+				const int position = i < FORSYTH_CACHE_SIZE ? static_cast<int>(i) : -1;
+
+				const float score = tables.score(position, live_triangles[v]);
+				const float delta = score - vertex_score[v];
+				vertex_score[v] = score;
+				for (uint32_t a = offsets[v]; a < offsets[v] + live_triangles[v]; a++)
+				{
+					const uint32_t t = adjacency[a];
+					triangle_score[t] += delta;
+					if (position >= 0 && triangle_score[t] > best_score)
+					{
+						best_score = triangle_score[t];
+						best = t;
+					}
+				}
+			}
+
+			cache_count = std::min(new_count, FORSYTH_CACHE_SIZE);
+			std::copy(new_cache, new_cache + cache_count, cache);
+		}
+
+		return result;
+	}
+
+	/// OVERDRAW OPTIMIZATION ///
+	// Pedro Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+	constexpr size_t MIN_CLUSTER_TRIANGLES = 16;
+
+	// The cache-friendly order is split into clusters, which are then drawn outward-facing first.
+	vec<uint32_t> reorderForOverdraw(const vec<uint32_t>& indices, const vec<Dim3::Vertex_3D>& vertices,
+		unsigned int cache_size, float target_acmr)
+	{
+		const size_t triangle_count = indices.size() / 3;
+
+		// Each cluster is simulated from a cold cache, so drawing clusters in any order keeps
+		// their ACMR. A cluster ends as soon as its own ACMR gets down to target_acmr,
+		// which keeps them small, and the sort effective, without losing much locality.
+		vec<size_t> cluster_starts;
+		{
+			vec<size_t> loaded_at(vertices.size(), 0);
+			size_t time = static_cast<size_t>(cache_size) + 1;
+			size_t cluster_misses = 0;
+			size_t cluster_triangles = 0;
+			for (size_t t = 0; t < triangle_count; t++)
+			{
+				if (cluster_triangles == 0)
+				{
+					cluster_starts.push_back(t);
+					// Every vertex loaded so far is now too old to be cached.
+					time += cache_size;
+				}
+				for (int corner = 0; corner < 3; corner++)
+				{
+					const uint32_t v = indices[t * 3 + corner];
+					if (time - loaded_at[v] > cache_size)
+					{
+						loaded_at[v] = time++;
+						cluster_misses++;
+					}
+				}
+				cluster_triangles++;
+
+				if (cluster_triangles >= MIN_CLUSTER_TRIANGLES
+					&& static_cast<float>(cluster_misses) <= target_acmr * static_cast<float>(cluster_triangles))
+				{
+					cluster_misses = 0;
+					cluster_triangles = 0;
+				}
+			}
+			cluster_starts.push_back(triangle_count);
+		}
+
+		const size_t cluster_count = cluster_starts.size() - 1;
+		if (cluster_count < 2)
+		{
+			return indices;
+		}
+
+		// Area-weighted centroid and normal of each cluster, and of the whole mesh.
+		vec<arr<double, 3>> centroids(cluster_count, arr<double, 3>{});
+		vec<arr<double, 3>> normals(cluster_count, arr<double, 3>{});
+		vec<double> areas(cluster_count, 0.0);
+		arr<double, 3> mesh_centroid{};
+		double mesh_area = 0.0;
+
+		for (size_t c = 0; c < cluster_count; c++)
+		{
+			for (size_t t = cluster_starts[c]; t < cluster_starts[c + 1]; t++)
+			{
+				const arr<float, 3>& a = vertices[indices[t * 3]].coord;
+				const arr<float, 3>& b = vertices[indices[t * 3 + 1]].coord;
+				const arr<float, 3>& d = vertices[indices[t * 3 + 2]].coord;
+
+				const double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+				const double ad[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+				const double normal[3] = {
+					ab[1] * ad[2] - ab[2] * ad[1],
+					ab[2] * ad[0] - ab[0] * ad[2],
+					ab[0] * ad[1] - ab[1] * ad[0]
+				};
+				const double area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const double center = (static_cast<double>(a[axis]) + b[axis] + d[axis]) / 3.0;
+					centroids[c][axis] += center * area;
+					normals[c][axis] += normal[axis];
+					mesh_centroid[axis] += center * area;
+				}
+				areas[c] += area;
+				mesh_area += area;
+			}
+		}
+		if (mesh_area <= 0.0)
+		{
+			return indices;
+		}
+		for (int axis = 0; axis < 3; axis++)
+		{
+			mesh_centroid[axis] /= mesh_area;
+		}
+
+		// The further out a cluster faces, the more likely it occludes others.
+		vec<double> keys(cluster_count, 0.0);
+		for (size_t c = 0; c < cluster_count; c++)
+		{
+			if (areas[c] <= 0.0)
+			{
+				continue;
+			}
+			const arr<double, 3>& n = normals[c];
+			const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if (length <= 0.0)
+			{
+				continue;
+			}
+			for (int axis = 0; axis < 3; axis++)
+			{
+				keys[c] += (centroids[c][axis] / areas[c] - mesh_centroid[axis]) * n[axis] / length;
+			}
+		}
+
+		vec<uint32_t> order(cluster_count);
+		for (size_t c = 0; c < cluster_count; c++)
+		{
+			order[c] = static_cast<uint32_t>(c);
+		}
+		std::stable_sort(order.begin(), order.end(), [&keys](uint32_t lhs, uint32_t rhs) { return keys[lhs] > keys[rhs]; });
+
+		vec<uint32_t> result;
+		result.reserve(indices.size());
+		for (uint32_t c : order)
+		{
+			result.insert(result.end(), indices.begin() + cluster_starts[c] * 3, indices.begin() + cluster_starts[c + 1] * 3);
+		}
+		return result;
+	}
+
+	/// VERTEX FETCH OPTIMIZATION ///
+	// Renumbers vertices in order of first use and drops the unused ones.
+	void reorderForVertexFetch(vec<uint32_t>& indices, vec<Dim3::Vertex_3D>& vertices)
+	{
+		vec<uint32_t> remap(vertices.size(), NO_TRIANGLE);
+		uint32_t next = 0;
+		for (uint32_t& index : indices)
+		{
+			if (remap[index] == NO_TRIANGLE)
+			{
+				remap[index] = next++;
+			}
+			index = remap[index];
+		}
+
+		vec<Dim3::Vertex_3D> reordered(next);
+		for (size_t v = 0; v < vertices.size(); v++)
+		{
+			if (remap[v] != NO_TRIANGLE)
+			{
+				reordered[remap[v]] = vertices[v];
+			}
+		}
+		vertices = std::move(reordered);
+	}
+} // anonymous namespace
+
+void indexModel(Dim3::Model_3D& model, bool keep_raw)
+{
+	const size_t corner_count = model.faces.size();
+	if (corner_count % 3 != 0)
+	{
+		throw std::runtime_error("Number of face corners is not a multiple of 3.");
+	}
+	if (corner_count >= EMPTY_SLOT)
+	{
+		throw std::runtime_error("Model has too many corners to be indexed.");
+	}
+
+	// Every corner may be unique in the worst case, so the table is sized
+	// for all of them at once and never rehashed. Load factor stays below 2/3.
+	const size_t capacity = std::bit_ceil(corner_count + corner_count / 2 + 1);
+	const size_t mask = capacity - 1;
+	vec<uint32_t> table(capacity, EMPTY_SLOT);
+
+	// Key of each unique vertex, compared against on probing.
+	vec<arr<int, 3>> unique_corners;
+	unique_corners.reserve(corner_count / 4 + 1);
+	vec<uint32_t> remap(corner_count);
+
+	for (size_t i = 0; i < corner_count; i++)
+	{
+		const arr<int, 3>& corner = model.faces[i];
+		size_t slot = static_cast<size_t>(hashCorner(corner)) & mask;
+		while (true)
+		{
+			const uint32_t candidate = table[slot];
+			if (candidate == EMPTY_SLOT)
+			{
+				validateCorner(corner, model);
+				const uint32_t index = static_cast<uint32_t>(unique_corners.size());
+				unique_corners.push_back(corner);
+				table[slot] = index;
+				remap[i] = index;
+				break;
+			}
+			if (unique_corners[candidate] == corner)
+			{
+				remap[i] = candidate;
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+	table = vec<uint32_t>();
+
+	/// VERTICES ///
+	model.vertices.resize(unique_corners.size());
+	for (size_t i = 0; i < unique_corners.size(); i++)
+	{
+		const arr<int, 3>& corner = unique_corners[i];
+		Dim3::Vertex_3D& vertex = model.vertices[i];
+		vertex.coord = model.positions[corner[0]];
+		vertex.tex_coord = corner[1] >= 0 ? model.tex_coords[corner[1]] : arr<float, 2>{};
+		vertex.normal = corner[2] >= 0 ? model.normals[corner[2]] : arr<float, 3>{};
+	}
+
+	/// INDICES ///
+	model.indices = Dim3::IndexBuffer_3D();
+	if (unique_corners.size() < NARROW_VERTEX_LIMIT)
+	{
+		model.indices.indices_16.assign(remap.begin(), remap.end());
+	}
+	else
+	{
+		model.indices.indices_32 = std::move(remap);
+	}
+
+	if (!keep_raw)
+	{
+		model.faces = vec<arr<int, 3>>();
+		model.positions = vec<arr<float, 3>>();
+		model.tex_coords = vec<arr<float, 2>>();
+		model.normals = vec<arr<float, 3>>();
+	}
+}
+
+VertexCacheStats analyzeVertexCache(const Dim3::Model_3D& model, unsigned int cache_size)
+{
+	return simulateFifo(readIndices(model.indices), model.vertices.size(), cache_size);
+}
+
+MeshOptimizationReport optimizeModel(Dim3::Model_3D& model, const MeshOptimizationProperties& properties)
+{
+	if (model.indices.size() == 0 && !model.faces.empty())
+	{
+		throw std::runtime_error("Model must be indexed before being optimized.");
+	}
+	vec<uint32_t> indices = readIndices(model.indices);
+	if (indices.size() % 3 != 0)
+	{
+		throw std::runtime_error("Number of indices is not a multiple of 3.");
+	}
+	const size_t vertex_count = model.vertices.size();
+	for (uint32_t index : indices)
+	{
+		if (index >= vertex_count)
+		{
+			throw std::runtime_error("Index refers to a vertex that does not exist.");
+		}
+	}
+
+	MeshOptimizationReport report;
+	report.before = simulateFifo(indices, vertex_count, properties.stats_cache_size);
+	if (indices.empty())
+	{
+		report.after = report.before;
+		return report;
+	}
+
+	indices = reorderForVertexCache(indices, vertex_count);
+
+	if (properties.optimize_overdraw)
+	{
+		const float cache_acmr = simulateFifo(indices, vertex_count, properties.stats_cache_size).acmr;
+		vec<uint32_t> sorted = reorderForOverdraw(indices, model.vertices,
+			properties.stats_cache_size, cache_acmr * properties.overdraw_threshold);
+		const float sorted_acmr = simulateFifo(sorted, vertex_count, properties.stats_cache_size).acmr;
+		if (sorted_acmr <= cache_acmr * properties.overdraw_threshold)
+		{
+			indices = std::move(sorted);
+		}
+	}
+
+	reorderForVertexFetch(indices, model.vertices);
+	report.after = simulateFifo(indices, model.vertices.size(), properties.stats_cache_size);
+	writeIndices(model.indices, std::move(indices), model.vertices.size());
+	return report;
+}
+
+vec<MeshOptimizationReport> optimizeModels(const vec<Dim3::Model_3D*>& models,
+	const MeshOptimizationProperties& properties, unsigned int max_threads)
+{
+	vec<MeshOptimizationReport> reports(models.size());
+	if (models.empty())
+	{
+		return reports;
+	}
+
+	size_t thread_count = max_threads != 0 ? max_threads : std::max(1u, std::thread::hardware_concurrency());
+	thread_count = std::min(thread_count, models.size());
+
+	// Models differ a lot in size, so threads take the next one as soon as they are done.
+	std::atomic<size_t> next_model = 0;
+	auto work = [&models, &properties, &reports, &next_model]()
+	{
+		for (size_t i = next_model++; i < models.size(); i = next_model++)
+		{
+			reports[i] = optimizeModel(*models[i], properties);
+		}
+	};
+
+	vec<std::future<void>> tasks;
+	tasks.reserve(thread_count);
+	for (size_t i = 0; i < thread_count; i++)
+	{
+		tasks.push_back(std::async(std::launch::async, work));
+	}
+	for (std::future<void>& task : tasks)
+	{
+		task.wait();
+	}
+	for (std::future<void>& task : tasks)
+	{
+		task.get();
+	}
+	return reports;
+}
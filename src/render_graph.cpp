@@ -0,0 +1,932 @@
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include "CorE/debug.hpp"
+#include "CorE/render_graph.hpp"
+
+namespace
+{
+	// Stages, accesses and layout of a RenderAccess, and what it allows.
+	struct AccessInfo
+	{
+		VkPipelineStageFlags2 stages;
+		VkAccessFlags2 access;
+		VkImageLayout layout;
+		VkImageUsageFlags image_usage;
+		VkBufferUsageFlags buffer_usage;
+		bool is_write;
+	};
+
+	constexpr VkPipelineStageFlags2 GRAPHICS_SHADER_STAGES = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+	constexpr VkPipelineStageFlags2 DEPTH_STAGES = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+	// Accesses that make memory available, and so must be waited for by any later access.
+	constexpr VkAccessFlags2 WRITE_ACCESS = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT
+		| VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+	// Indexed by RenderAccess. Usage 0 means the access is not allowed on that kind of resource.
+	constexpr AccessInfo ACCESS_INFOS[] = {
+		// ColorAttachment
+		{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0, true },
+		// DepthAttachment
+		{ DEPTH_STAGES, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, true },
+		// DepthRead
+		{ DEPTH_STAGES, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, false },
+		// SampledGraphics
+		{ GRAPHICS_SHADER_STAGES, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0, false },
+		// SampledCompute
+		{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0, false },
+		// StorageReadGraphics
+		{ GRAPHICS_SHADER_STAGES, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false },
+		// StorageReadCompute
+		{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false },
+		// StorageWriteCompute
+		{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true },
+		// TransferRead
+		{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false },
+		// TransferWrite
+		{ VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT, true },
+		// IndirectRead
+		{ VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, false },
+		// VertexRead
+		{ VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, false },
+		// IndexRead
+		{ VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, false },
+		// UniformRead
+		{ GRAPHICS_SHADER_STAGES | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, false }
+	};
+	static_assert(std::size(ACCESS_INFOS) == size_t(CorE::Graphics::RenderAccess::UniformRead) + 1,
+		"Every RenderAccess needs an AccessInfo.");
+
+	VkImageAspectFlags aspectOf(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_S8_UINT:
+			return VK_IMAGE_ASPECT_STENCIL_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+	}
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Where a resource stands between passes, while barriers are computed.
+	struct TrackState
+	{
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		// Last write, or layout transition, that later accesses must wait for.
+		VkPipelineStageFlags2 write_stages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+		// Reads since the last write, that a later write must wait for.
+		VkPipelineStageFlags2 read_stages = VK_PIPELINE_STAGE_2_NONE;
+		// Stages and accesses the last write is visible to already.
+		VkPipelineStageFlags2 visible_stages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 visible_access = VK_ACCESS_2_NONE;
+		// Whether the resource has contents an attachment should load.
+		bool has_contents = false;
+	};
+
+	void addBarrier(CorE::Graphics::BarrierBatch& batch, uint32_t resource, bool is_image, VkImageAspectFlags aspect,
+		VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access,
+		VkImageLayout old_layout, VkImageLayout new_layout)
+	{
+		if (!is_image)
+		{
+			batch.memory_barrier.srcStageMask |= src_stages;
+			batch.memory_barrier.srcAccessMask |= src_access;
+			batch.memory_barrier.dstStageMask |= dst_stages;
+			batch.memory_barrier.dstAccessMask |= dst_access;
+			return;
+		}
+		VkImageMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barrier.srcStageMask = src_stages;
+		barrier.srcAccessMask = src_access;
+		barrier.dstStageMask = dst_stages;
+		barrier.dstAccessMask = dst_access;
+		barrier.oldLayout = old_layout;
+		barrier.newLayout = new_layout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange = { aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+		batch.image_barriers.push_back(barrier);
+		batch.image_resources.push_back(resource);
+	}
+}
+
+size_t CorE::Graphics::CompiledGraph::getBarrierCount() const
+{
+	size_t count = final_barriers.getBarrierCount();
+	for (const CompiledPass& pass : passes)
+	{
+		count += pass.barriers.getBarrierCount();
+	}
+	return count;
+} // size_t CompiledGraph::getBarrierCount()
+
+size_t CorE::Graphics::CompiledGraph::getBatchCount() const
+{
+	size_t count = final_barriers.isEmpty() ? 0 : 1;
+	for (const CompiledPass& pass : passes)
+	{
+		count += pass.barriers.isEmpty() ? 0 : 1;
+	}
+	return count;
+} // size_t CompiledGraph::getBatchCount()
+
+CorE::Graphics::RenderGraph::~RenderGraph()
+{
+	release();
+} // RenderGraph::~RenderGraph()
+
+uint32_t CorE::Graphics::RenderGraph::createImage(const str& name, const RenderImageDesc& desc)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.is_image = true;
+	resource.imported = false;
+	resource.image_desc = desc;
+	resources.push_back(resource);
+	is_compiled = false;
+	return static_cast<uint32_t>(resources.size() - 1);
+} // uint32_t RenderGraph::createImage()
+
+uint32_t CorE::Graphics::RenderGraph::createBuffer(const str& name, VkDeviceSize size)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.is_image = false;
+	resource.imported = false;
+	resource.buffer_size = size;
+	resources.push_back(resource);
+	is_compiled = false;
+	return static_cast<uint32_t>(resources.size() - 1);
+} // uint32_t RenderGraph::createBuffer()
+
+uint32_t CorE::Graphics::RenderGraph::importImage(const str& name, VkImage image, VkImageView view,
+	const RenderImageDesc& desc, const ResourceState& initial, const ResourceState& final)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.is_image = true;
+	resource.imported = true;
+	resource.image_desc = desc;
+	resource.image = image;
+	resource.view = view;
+	resource.initial = initial;
+	resource.final = final;
+	resources.push_back(resource);
+	is_compiled = false;
+	return static_cast<uint32_t>(resources.size() - 1);
+} // uint32_t RenderGraph::importImage()
+
+uint32_t CorE::Graphics::RenderGraph::importBuffer(const str& name, VkBuffer buffer, VkDeviceSize size,
+	const ResourceState& initial, const ResourceState& final)
+{
+	Resource resource{};
+	resource.name = name;
+	resource.is_image = false;
+	resource.imported = true;
+	resource.buffer_size = size;
+	resource.buffer = buffer;
+	resource.initial = initial;
+	resource.final = final;
+	resources.push_back(resource);
+	is_compiled = false;
+	return static_cast<uint32_t>(resources.size() - 1);
+} // uint32_t RenderGraph::importBuffer()
+
+void CorE::Graphics::RenderGraph::setImported(uint32_t resource, VkImage image, VkImageView view)
+{
+	Resource& target = resources.at(resource);
+	if (!target.imported || !target.is_image)
+	{
+		throw std::runtime_error("Resource \"" + target.name + "\" is not an imported image.");
+	}
+	target.image = image;
+	target.view = view;
+} // void RenderGraph::setImported(uint32_t resource, VkImage image, VkImageView view)
+
+void CorE::Graphics::RenderGraph::setImported(uint32_t resource, VkBuffer buffer)
+{
+	Resource& target = resources.at(resource);
+	if (!target.imported || target.is_image)
+	{
+		throw std::runtime_error("Resource \"" + target.name + "\" is not an imported buffer.");
+	}
+	target.buffer = buffer;
+} // void RenderGraph::setImported(uint32_t resource, VkBuffer buffer)
+
+uint32_t CorE::Graphics::RenderGraph::addPass(const str& name, std::function<void(CommandBuffer*)> record, bool side_effects)
+{
+	passes.push_back(Pass{ name, std::move(record), side_effects, {} });
+	is_compiled = false;
+	return static_cast<uint32_t>(passes.size() - 1);
+} // uint32_t RenderGraph::addPass()
+
+void CorE::Graphics::RenderGraph::read(uint32_t pass, uint32_t resource, RenderAccess access)
+{
+	declare(pass, resource, access, false, nullptr);
+} // void RenderGraph::read()
+
+void CorE::Graphics::RenderGraph::write(uint32_t pass, uint32_t resource, RenderAccess access, const VkClearValue* p_clear)
+{
+	declare(pass, resource, access, true, p_clear);
+} // void RenderGraph::write()
+
+void CorE::Graphics::RenderGraph::declare(uint32_t pass, uint32_t resource, RenderAccess access, bool is_write,
+	const VkClearValue* p_clear)
+{
+	Pass& target = passes.at(pass);
+	Resource& used = resources.at(resource);
+	const AccessInfo& info = ACCESS_INFOS[size_t(access)];
+
+	if (info.is_write != is_write)
+	{
+		throw std::runtime_error("Pass \"" + target.name + "\" declares a " + (is_write ? "write" : "read")
+			+ " of \"" + used.name + "\" with an access that " + (is_write ? "only reads." : "writes."));
+	}
+	const VkFlags usage = used.is_image ? info.image_usage : info.buffer_usage;
+	if (usage == 0)
+	{
+		throw std::runtime_error("Pass \"" + target.name + "\" uses \"" + used.name + "\" in a way its kind of resource does not allow.");
+	}
+
+	Attachment attachment = Attachment::None;
+	if (access == RenderAccess::ColorAttachment)
+	{
+		attachment = Attachment::Color;
+	}
+	else if (access == RenderAccess::DepthAttachment)
+	{
+		attachment = Attachment::Depth;
+	}
+	else if (access == RenderAccess::DepthRead)
+	{
+		attachment = Attachment::DepthRead;
+	}
+	if (p_clear && attachment == Attachment::None)
+	{
+		throw std::runtime_error("Pass \"" + target.name + "\" clears \"" + used.name + "\", which it does not use as an attachment.");
+	}
+
+	const VkImageLayout layout = used.is_image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+	auto it = std::find_if(target.accesses.begin(), target.accesses.end(),
+		[resource](const PassAccess& declared) { return declared.resource == resource; });
+	if (it == target.accesses.end())
+	{
+		PassAccess declared{ resource, info.stages, info.access, layout, is_write, attachment };
+		declared.has_clear = p_clear != nullptr;
+		if (p_clear)
+		{
+			declared.clear = *p_clear;
+		}
+		target.accesses.push_back(declared);
+	}
+	else
+	{
+		// A resource is in one layout for all of a pass.
+		if (it->layout != layout || (attachment != Attachment::None && it->attachment != Attachment::None && it->attachment != attachment))
+		{
+			throw std::runtime_error("Pass \"" + target.name + "\" uses \"" + used.name + "\" in two layouts.");
+		}
+		it->stages |= info.stages;
+		it->access |= info.access;
+		it->is_write = it->is_write || is_write;
+		if (attachment != Attachment::None)
+		{
+			it->attachment = attachment;
+		}
+		if (p_clear)
+		{
+			it->has_clear = true;
+			it->clear = *p_clear;
+		}
+	}
+
+	used.usage |= usage;
+	is_compiled = false;
+} // void RenderGraph::declare()
+
+VkImageCreateInfo CorE::Graphics::RenderGraph::makeImageInfo(const Resource& resource) const
+{
+	VkImageCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	info.imageType = VK_IMAGE_TYPE_2D;
+	info.format = resource.image_desc.format;
+	info.extent = { resource.image_desc.extent.width, resource.image_desc.extent.height, 1 };
+	info.mipLevels = resource.image_desc.mip_levels;
+	info.arrayLayers = resource.image_desc.array_layers;
+	info.samples = resource.image_desc.samples;
+	info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	info.usage = resource.usage;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	return info;
+} // VkImageCreateInfo RenderGraph::makeImageInfo()
+
+VkBufferCreateInfo CorE::Graphics::RenderGraph::makeBufferInfo(const Resource& resource) const
+{
+	VkBufferCreateInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.size = resource.buffer_size;
+	info.usage = resource.usage;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	return info;
+} // VkBufferCreateInfo RenderGraph::makeBufferInfo()
+
+void CorE::Graphics::RenderGraph::compile(LogicalDevice* p_device)
+{
+	compile([p_device](const VkImageCreateInfo* p_image_info, const VkBufferCreateInfo* p_buffer_info)
+	{
+		// Requirements of resources not created yet, as they would be once created.
+		VkMemoryRequirements2 requirements{};
+		requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+		if (p_image_info)
+		{
+			VkDeviceImageMemoryRequirements info{};
+			info.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+			info.pCreateInfo = p_image_info;
+			vkGetDeviceImageMemoryRequirements(p_device->vk_handle, &info, &requirements);
+		}
+		else
+		{
+			VkDeviceBufferMemoryRequirements info{};
+			info.sType = VK_STRUCTURE_TYPE_DEVICE_BUFFER_MEMORY_REQUIREMENTS;
+			info.pCreateInfo = p_buffer_info;
+			vkGetDeviceBufferMemoryRequirements(p_device->vk_handle, &info, &requirements);
+		}
+		return requirements.memoryRequirements;
+	});
+} // void RenderGraph::compile(LogicalDevice* p_device)
+
+void CorE::Graphics::RenderGraph::compile(const MemoryQuery& query)
+{
+	// Transient resources of an earlier compile() were placed and created for other passes.
+	release();
+	compiled = CompiledGraph{};
+	is_compiled = false;
+
+	// Culling. Every access depends on the last write before it, unless it clears. Passes writing
+	// imported resources or with side effects are needed, and so is every pass a needed one depends on.
+	// Producers always come earlier, so a single backward sweep finds them all.
+	vec<vec<uint32_t>> producers(passes.size());
+	vec<bool> needed(passes.size(), false);
+	vec<uint32_t> last_writer(resources.size(), UINT32_MAX);
+	for (uint32_t i = 0; i < passes.size(); i++)
+	{
+		needed[i] = passes[i].side_effects;
+		for (const PassAccess& access : passes[i].accesses)
+		{
+			if (!access.has_clear && last_writer[access.resource] != UINT32_MAX)
+			{
+				producers[i].push_back(last_writer[access.resource]);
+			}
+			if (access.is_write)
+			{
+				last_writer[access.resource] = i;
+				needed[i] = needed[i] || resources[access.resource].imported;
+			}
+		}
+	}
+	for (uint32_t i = static_cast<uint32_t>(passes.size()); i-- > 0;)
+	{
+		if (needed[i])
+		{
+			for (uint32_t producer : producers[i])
+			{
+				needed[producer] = true;
+			}
+		}
+	}
+
+	// Uses of every resource by needed passes, in order, as indices of compiled passes and accesses.
+	struct Use
+	{
+		uint32_t position;
+		const PassAccess* p_access;
+	};
+	vec<vec<Use>> uses(resources.size());
+	for (uint32_t i = 0; i < passes.size(); i++)
+	{
+		if (!needed[i])
+		{
+			compiled.culled_passes.push_back(i);
+			continue;
+		}
+		const uint32_t position = static_cast<uint32_t>(compiled.passes.size());
+		CompiledPass pass{};
+		pass.pass = i;
+		compiled.passes.push_back(pass);
+		for (const PassAccess& access : passes[i].accesses)
+		{
+			uses[access.resource].push_back({ position, &access });
+		}
+	}
+
+	// Aliasing. Transient resources live from their first use to their last, and are placed largest first,
+	// each at the lowest offset of a heap that overlaps no resource alive at the same time.
+	struct Lifetime
+	{
+		uint32_t resource;
+		uint32_t first;
+		uint32_t last;
+		VkMemoryRequirements requirements;
+	};
+	vec<Lifetime> lifetimes;
+	for (uint32_t r = 0; r < resources.size(); r++)
+	{
+		if (resources[r].imported || uses[r].empty())
+		{
+			continue;
+		}
+		VkMemoryRequirements requirements;
+		if (resources[r].is_image)
+		{
+			const VkImageCreateInfo info = makeImageInfo(resources[r]);
+			requirements = query(&info, nullptr);
+		}
+		else
+		{
+			const VkBufferCreateInfo info = makeBufferInfo(resources[r]);
+			requirements = query(nullptr, &info);
+		}
+		requirements.alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+		lifetimes.push_back({ r, uses[r].front().position, uses[r].back().position, requirements });
+		compiled.unaliased_size += requirements.size;
+	}
+	std::stable_sort(lifetimes.begin(), lifetimes.end(),
+		[](const Lifetime& a, const Lifetime& b) { return a.requirements.size > b.requirements.size; });
+
+	// Placement index of every transient resource, to find what it aliases.
+	vec<uint32_t> placement_of(resources.size(), UINT32_MAX);
+	for (const Lifetime& lifetime : lifetimes)
+	{
+		const Resource& resource = resources[lifetime.resource];
+		uint32_t heap = 0;
+		while (heap < compiled.heaps.size() && (compiled.heaps[heap].images != resource.is_image
+			|| !(compiled.heaps[heap].memory_type_bits & lifetime.requirements.memoryTypeBits)))
+		{
+			heap++;
+		}
+		if (heap == compiled.heaps.size())
+		{
+			TransientHeap created{};
+			created.images = resource.is_image;
+			compiled.heaps.push_back(created);
+		}
+
+		// Resources of the heap alive at the same time as this one.
+		vec<const TransientPlacement*> overlapping;
+		for (const TransientPlacement& placed : compiled.placements)
+		{
+			const uint32_t first = uses[placed.resource].front().position;
+			const uint32_t last = uses[placed.resource].back().position;
+			if (placed.heap == heap && first <= lifetime.last && lifetime.first <= last)
+			{
+				overlapping.push_back(&placed);
+			}
+		}
+		vec<VkDeviceSize> candidates{ 0 };
+		for (const TransientPlacement* p_placed : overlapping)
+		{
+			candidates.push_back(alignUp(p_placed->offset + p_placed->size, lifetime.requirements.alignment));
+		}
+		std::sort(candidates.begin(), candidates.end());
+		VkDeviceSize offset = 0;
+		for (VkDeviceSize candidate : candidates)
+		{
+			const bool fits = std::none_of(overlapping.begin(), overlapping.end(), [&](const TransientPlacement* p_placed)
+			{
+				return candidate < p_placed->offset + p_placed->size && p_placed->offset < candidate + lifetime.requirements.size;
+			});
+			if (fits)
+			{
+				offset = candidate;
+				break;
+			}
+		}
+
+		TransientHeap& target = compiled.heaps[heap];
+		target.size = std::max(target.size, offset + lifetime.requirements.size);
+		target.alignment = std::max(target.alignment, lifetime.requirements.alignment);
+		target.memory_type_bits &= lifetime.requirements.memoryTypeBits;
+		placement_of[lifetime.resource] = static_cast<uint32_t>(compiled.placements.size());
+		compiled.placements.push_back({ lifetime.resource, heap, offset, lifetime.requirements.size });
+	}
+	for (const TransientHeap& heap : compiled.heaps)
+	{
+		compiled.transient_size += heap.size;
+	}
+
+	// Resources whose memory a transient resource takes over, which must be done with it first.
+	vec<vec<uint32_t>> aliased(resources.size());
+	for (const TransientPlacement& a : compiled.placements)
+	{
+		for (const TransientPlacement& b : compiled.placements)
+		{
+			if (a.heap == b.heap && a.offset < b.offset + b.size && b.offset < a.offset + a.size
+				&& uses[b.resource].back().position < uses[a.resource].front().position)
+			{
+				aliased[a.resource].push_back(b.resource);
+			}
+		}
+	}
+
+	// Barriers, walking needed passes with the state of every resource.
+	vec<TrackState> track(resources.size());
+	for (uint32_t r = 0; r < resources.size(); r++)
+	{
+		if (resources[r].imported)
+		{
+			track[r].layout = resources[r].initial.layout;
+			track[r].write_stages = resources[r].initial.stages;
+			track[r].write_access = resources[r].initial.access;
+			track[r].has_contents = !resources[r].is_image || resources[r].initial.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+	}
+	vec<uint32_t> next_use(resources.size(), 0);
+	for (uint32_t position = 0; position < compiled.passes.size(); position++)
+	{
+		CompiledPass& pass = compiled.passes[position];
+		for (const PassAccess& access : passes[pass.pass].accesses)
+		{
+			const uint32_t r = access.resource;
+			const Resource& resource = resources[r];
+			TrackState& state = track[r];
+			const uint32_t use = next_use[r]++;
+			const bool has_later_use = use + 1 < uses[r].size();
+
+			VkPipelineStageFlags2 src_stages = VK_PIPELINE_STAGE_2_NONE;
+			VkAccessFlags2 src_access = VK_ACCESS_2_NONE;
+			bool needs_barrier = false;
+			if (use == 0 && !resource.imported)
+			{
+				// Memory taken over from aliased resources. The access scope of an image barrier covers that image
+				// only, so their writes are made available by the memory barrier, and the layout transition out of
+				// undefined contents only waits for their stages.
+				VkPipelineStageFlags2 aliased_stages = VK_PIPELINE_STAGE_2_NONE;
+				VkAccessFlags2 aliased_access = VK_ACCESS_2_NONE;
+				for (uint32_t previous : aliased[r])
+				{
+					aliased_stages |= track[previous].write_stages | track[previous].read_stages;
+					aliased_access |= track[previous].write_access;
+				}
+				if (aliased_stages != VK_PIPELINE_STAGE_2_NONE)
+				{
+					addBarrier(pass.barriers, r, false, 0, aliased_stages, aliased_access, access.stages, access.access,
+						VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED);
+					if (resource.is_image)
+					{
+						src_stages |= aliased_stages;
+					}
+				}
+			}
+
+			const bool transition = resource.is_image && state.layout != access.layout;
+			VkPipelineStageFlags2 dst_stages = access.stages;
+			VkAccessFlags2 dst_access = access.access;
+			if (transition || access.is_write)
+			{
+				// Layout transitions and writes wait for every access before them.
+				src_stages |= state.write_stages | state.read_stages;
+				src_access |= state.write_access;
+				needs_barrier = needs_barrier || transition || src_stages != VK_PIPELINE_STAGE_2_NONE;
+			}
+			else if (state.write_stages != VK_PIPELINE_STAGE_2_NONE
+				&& ((access.stages & ~state.visible_stages) || (access.access & ~state.visible_access)))
+			{
+				src_stages |= state.write_stages;
+				src_access |= state.write_access;
+				needs_barrier = true;
+			}
+
+			if (needs_barrier && !access.is_write)
+			{
+				// One barrier makes the write visible to all the reads up to the next write or layout change.
+				for (size_t later = use + 1; later < uses[r].size(); later++)
+				{
+					const PassAccess& later_access = *uses[r][later].p_access;
+					if (later_access.is_write || later_access.layout != access.layout)
+					{
+						break;
+					}
+					dst_stages |= later_access.stages;
+					dst_access |= later_access.access;
+				}
+			}
+			if (needs_barrier)
+			{
+				addBarrier(pass.barriers, r, resource.is_image, aspectOf(resource.image_desc.format), src_stages, src_access,
+					dst_stages, dst_access, use == 0 && !resource.imported ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout, access.layout);
+			}
+
+			if (access.attachment != Attachment::None)
+			{
+				if (pass.rendering && (pass.extent.width != resource.image_desc.extent.width
+					|| pass.extent.height != resource.image_desc.extent.height))
+				{
+					throw std::runtime_error("Attachments of pass \"" + passes[pass.pass].name + "\" differ in extent.");
+				}
+				pass.rendering = true;
+				pass.extent = resource.image_desc.extent;
+
+				VkRenderingAttachmentInfo attachment{};
+				attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+				attachment.imageLayout = access.layout;
+				attachment.loadOp = access.has_clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
+					: state.has_contents ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachment.storeOp = access.attachment == Attachment::DepthRead ? VK_ATTACHMENT_STORE_OP_NONE
+					: resource.imported || has_later_use ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.clearValue = access.clear;
+				if (access.attachment == Attachment::Color)
+				{
+					pass.color_attachments.push_back(attachment);
+					pass.color_resources.push_back(r);
+				}
+				else
+				{
+					if (pass.depth_resource != UINT32_MAX)
+					{
+						throw std::runtime_error("Pass \"" + passes[pass.pass].name + "\" has more than one depth attachment.");
+					}
+					pass.depth_attachment = attachment;
+					pass.depth_resource = r;
+				}
+			}
+
+			if (access.is_write)
+			{
+				state.write_stages = access.stages;
+				state.write_access = access.access & WRITE_ACCESS;
+				state.read_stages = VK_PIPELINE_STAGE_2_NONE;
+				state.visible_stages = VK_PIPELINE_STAGE_2_NONE;
+				state.visible_access = VK_ACCESS_2_NONE;
+				state.has_contents = true;
+			}
+			else
+			{
+				if (transition)
+				{
+					// Accesses outside the barrier must still wait for the transition.
+					state.write_stages = dst_stages;
+					state.write_access = VK_ACCESS_2_NONE;
+					state.read_stages = VK_PIPELINE_STAGE_2_NONE;
+					state.visible_stages = dst_stages;
+					state.visible_access = dst_access;
+				}
+				else if (needs_barrier)
+				{
+					state.visible_stages |= dst_stages;
+					state.visible_access |= dst_access;
+				}
+				state.read_stages |= access.stages;
+			}
+			state.layout = access.layout;
+		}
+	}
+
+	// Executions follow each other on the queue, so the first use of a transient resource also waits for the
+	// last uses in the previous execution of every resource sharing its memory, itself included. They are
+	// known once the whole frame is walked, and made available the same way as those of aliased resources.
+	for (const TransientPlacement& placement : compiled.placements)
+	{
+		VkPipelineStageFlags2 wrap_stages = VK_PIPELINE_STAGE_2_NONE;
+		VkAccessFlags2 wrap_access = VK_ACCESS_2_NONE;
+		for (const TransientPlacement& other : compiled.placements)
+		{
+			if (other.heap == placement.heap && placement.offset < other.offset + other.size
+				&& other.offset < placement.offset + placement.size)
+			{
+				wrap_stages |= track[other.resource].write_stages | track[other.resource].read_stages;
+				wrap_access |= track[other.resource].write_access;
+			}
+		}
+		if (wrap_stages == VK_PIPELINE_STAGE_2_NONE)
+		{
+			continue;
+		}
+
+		const Use& first = uses[placement.resource].front();
+		BarrierBatch& batch = compiled.passes[first.position].barriers;
+		addBarrier(batch, placement.resource, false, 0, wrap_stages, wrap_access, first.p_access->stages,
+			first.p_access->access, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED);
+		for (size_t i = 0; i < batch.image_resources.size(); i++)
+		{
+			if (batch.image_resources[i] == placement.resource)
+			{
+				batch.image_barriers[i].srcStageMask |= wrap_stages;
+			}
+		}
+	}
+
+	// Imported resources are left as their owner expects them.
+	for (uint32_t r = 0; r < resources.size(); r++)
+	{
+		const Resource& resource = resources[r];
+		if (!resource.imported)
+		{
+			continue;
+		}
+		const TrackState& state = track[r];
+		const bool transition = resource.is_image && resource.final.layout != VK_IMAGE_LAYOUT_UNDEFINED
+			&& resource.final.layout != state.layout;
+		const VkPipelineStageFlags2 src_stages = state.write_stages | state.read_stages;
+		if (transition || (resource.final.stages != VK_PIPELINE_STAGE_2_NONE && src_stages != VK_PIPELINE_STAGE_2_NONE))
+		{
+			addBarrier(compiled.final_barriers, r, resource.is_image, aspectOf(resource.image_desc.format), src_stages,
+				state.write_access, resource.final.stages, resource.final.access, state.layout,
+				transition ? resource.final.layout : state.layout);
+		}
+	}
+
+	is_compiled = true;
+} // void RenderGraph::compile(const MemoryQuery& query)
+
+void CorE::Graphics::RenderGraph::allocate(LogicalDevice* p_device, DeviceMemoryAllocator* p_memory)
+{
+	if (!is_compiled)
+	{
+		throw std::runtime_error("Render graph must be compiled before its resources are allocated.");
+	}
+	release();
+	this->p_device = p_device;
+	this->p_memory = p_memory;
+
+	for (const TransientHeap& heap : compiled.heaps)
+	{
+		DeviceAllocationInfo info{};
+		info.requirements = { heap.size, heap.alignment, heap.memory_type_bits };
+		info.preferred_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		info.optimal_image = heap.images;
+		heap_allocations.push_back(p_memory->allocate(info));
+	}
+
+	for (const TransientPlacement& placement : compiled.placements)
+	{
+		Resource& resource = resources[placement.resource];
+		const DeviceAllocation* p_allocation = heap_allocations[placement.heap];
+		if (resource.is_image)
+		{
+			const VkImageCreateInfo info = makeImageInfo(resource);
+			ensureVkSuccess(vkCreateImage(p_device->vk_handle, &info, p_device->getAllocator(), &resource.image),
+				"Failed to create render graph image.");
+			ensureVkSuccess(vkBindImageMemory(p_device->vk_handle, resource.image, p_allocation->memory,
+				p_allocation->offset + placement.offset), "Failed to bind render graph image memory.");
+
+			VkImageViewCreateInfo view_info{};
+			view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			view_info.image = resource.image;
+			view_info.viewType = info.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+			view_info.format = info.format;
+			view_info.subresourceRange = { aspectOf(info.format), 0, info.mipLevels, 0, info.arrayLayers };
+			ensureVkSuccess(vkCreateImageView(p_device->vk_handle, &view_info, p_device->getAllocator(), &resource.view),
+				"Failed to create render graph image view.");
+		}
+		else
+		{
+			const VkBufferCreateInfo info = makeBufferInfo(resource);
+			ensureVkSuccess(vkCreateBuffer(p_device->vk_handle, &info, p_device->getAllocator(), &resource.buffer),
+				"Failed to create render graph buffer.");
+			ensureVkSuccess(vkBindBufferMemory(p_device->vk_handle, resource.buffer, p_allocation->memory,
+				p_allocation->offset + placement.offset), "Failed to bind render graph buffer memory.");
+		}
+	}
+} // void RenderGraph::allocate()
+
+void CorE::Graphics::RenderGraph::release()
+{
+	for (Resource& resource : resources)
+	{
+		if (resource.imported)
+		{
+			continue;
+		}
+		if (resource.view != VK_NULL_HANDLE)
+		{
+			vkDestroyImageView(p_device->vk_handle, resource.view, p_device->getAllocator());
+		}
+		if (resource.image != VK_NULL_HANDLE)
+		{
+			vkDestroyImage(p_device->vk_handle, resource.image, p_device->getAllocator());
+		}
+		if (resource.buffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(p_device->vk_handle, resource.buffer, p_device->getAllocator());
+		}
+		resource.view = VK_NULL_HANDLE;
+		resource.image = VK_NULL_HANDLE;
+		resource.buffer = VK_NULL_HANDLE;
+	}
+	for (DeviceAllocation* p_allocation : heap_allocations)
+	{
+		p_memory->free(p_allocation);
+	}
+	heap_allocations.clear();
+} // void RenderGraph::release()
+
+void CorE::Graphics::RenderGraph::execute(CommandBuffer* p_buffer)
+{
+	if (!is_compiled)
+	{
+		throw std::runtime_error("Render graph must be compiled before it is executed.");
+	}
+	if (heap_allocations.size() != compiled.heaps.size())
+	{
+		throw std::runtime_error("Render graph must be allocated before it is executed.");
+	}
+
+	auto record_barriers = [&](BarrierBatch& batch)
+	{
+		if (batch.isEmpty())
+		{
+			return;
+		}
+		for (size_t i = 0; i < batch.image_barriers.size(); i++)
+		{
+			batch.image_barriers[i].image = resources[batch.image_resources[i]].image;
+		}
+		batch.memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+		VkDependencyInfo dependency{};
+		dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependency.memoryBarrierCount = batch.hasMemoryBarrier() ? 1 : 0;
+		dependency.pMemoryBarriers = &batch.memory_barrier;
+		dependency.imageMemoryBarrierCount = static_cast<uint32_t>(batch.image_barriers.size());
+		dependency.pImageMemoryBarriers = batch.image_barriers.data();
+		vkCmdPipelineBarrier2(p_buffer->vk_handle, &dependency);
+	};
+
+	for (CompiledPass& pass : compiled.passes)
+	{
+		record_barriers(pass.barriers);
+		const std::function<void(CommandBuffer*)>& record = passes[pass.pass].record;
+		if (!pass.rendering)
+		{
+			if (record)
+			{
+				record(p_buffer);
+			}
+			continue;
+		}
+
+		for (size_t i = 0; i < pass.color_attachments.size(); i++)
+		{
+			pass.color_attachments[i].imageView = resources[pass.color_resources[i]].view;
+		}
+		VkRenderingInfo info{};
+		info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+		info.renderArea = { { 0, 0 }, pass.extent };
+		info.layerCount = 1;
+		info.colorAttachmentCount = static_cast<uint32_t>(pass.color_attachments.size());
+		info.pColorAttachments = pass.color_attachments.data();
+		if (pass.depth_resource != UINT32_MAX)
+		{
+			pass.depth_attachment.imageView = resources[pass.depth_resource].view;
+			// Stencil-only formats such as VK_FORMAT_S8_UINT have no depth aspect to bind.
+			const VkImageAspectFlags aspect = aspectOf(resources[pass.depth_resource].image_desc.format);
+			if (aspect & VK_IMAGE_ASPECT_DEPTH_BIT)
+			{
+				info.pDepthAttachment = &pass.depth_attachment;
+			}
+			if (aspect & VK_IMAGE_ASPECT_STENCIL_BIT)
+			{
+				info.pStencilAttachment = &pass.depth_attachment;
+			}
+		}
+		p_buffer->beginRenderPass(&info);
+		if (record)
+		{
+			record(p_buffer);
+		}
+		p_buffer->endRenderPass();
+	}
+	record_barriers(compiled.final_barriers);
+} // void RenderGraph::execute()
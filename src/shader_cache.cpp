@@ -0,0 +1,337 @@
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include <slang.h>
+#include <slang-com-ptr.h>
+
+#include "CorE/shader_cache.hpp"
+#include "CorE/hash.hpp"
+
+static_assert(std::is_trivially_copyable_v<CorE::Graphics::ShaderFileHeader>, "ShaderFileHeader must be trivially copyable.");
+
+namespace
+{
+	constexpr uint64_t CODE_ALIGNMENT = 16;
+
+	void ensureLittleEndian()
+	{
+		if constexpr (std::endian::native != std::endian::little)
+		{
+			throw std::runtime_error("Shader files are only supported on little-endian hosts.");
+		}
+	}
+
+	std::filesystem::path getCachePath(const char* cache_dir, uint64_t key)
+	{
+		char cache_name[32];
+		std::snprintf(cache_name, sizeof(cache_name), "%016llx.cspv", static_cast<unsigned long long>(key));
+		return std::filesystem::path(cache_dir) / cache_name;
+	}
+
+	VkShaderStageFlagBits toShaderStage(SlangStage stage)
+	{
+		switch (stage)
+		{
+		case SLANG_STAGE_VERTEX:
+			return VK_SHADER_STAGE_VERTEX_BIT;
+		case SLANG_STAGE_HULL:
+			return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case SLANG_STAGE_DOMAIN:
+			return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case SLANG_STAGE_GEOMETRY:
+			return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case SLANG_STAGE_FRAGMENT:
+			return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case SLANG_STAGE_COMPUTE:
+			return VK_SHADER_STAGE_COMPUTE_BIT;
+		case SLANG_STAGE_AMPLIFICATION:
+			return VK_SHADER_STAGE_TASK_BIT_EXT;
+		case SLANG_STAGE_MESH:
+			return VK_SHADER_STAGE_MESH_BIT_EXT;
+		default:
+			// Ray tracing stages have no shader objects.
+			throw std::runtime_error("Shader stage is not supported by shader objects.");
+		}
+	}
+
+	// Throws with the diagnostics of Slang if a call failed.
+	void ensureSlangSuccess(SlangResult result, slang::IBlob* p_diagnostics, const str& message)
+	{
+		if (SLANG_FAILED(result))
+		{
+			str text = message;
+			if (p_diagnostics != nullptr)
+			{
+				text += "\n";
+				text.append(static_cast<const char*>(p_diagnostics->getBufferPointer()), p_diagnostics->getBufferSize());
+			}
+			throw std::runtime_error(text);
+		}
+	}
+
+	// Global sessions are expensive to create and not thread-safe, so one is shared under a mutex.
+	std::mutex slang_mutex;
+	Slang::ComPtr<slang::IGlobalSession> p_global_session;
+} // anonymous namespace
+
+uint64_t CorE::Graphics::getShaderKey(const char* p_source, size_t source_size, const char* entry_point)
+{
+	uint64_t key = hashBytes(p_source, source_size, ShaderFileHeader::VERSION);
+	return hashCombine(key, hashBytes(entry_point, std::strlen(entry_point)));
+} // uint64_t CorE::Graphics::getShaderKey()
+
+uint64_t CorE::Graphics::hashShaderDependencies(const vec<str>& dependencies)
+{
+	uint64_t hash = 0;
+	for (const str& dependency : dependencies)
+	{
+		MappedFile file(dependency.c_str());
+		hash = hashCombine(hash, hashBytes(file.getData(), file.getSize()));
+	}
+	return hash;
+} // uint64_t CorE::Graphics::hashShaderDependencies()
+
+void CorE::Graphics::writeShaderFile(const char* file_path, uint64_t key, const char* entry_point, VkShaderStageFlagBits stage,
+	const vec<str>& dependencies, uint64_t dependency_hash, const void* p_code, size_t code_size)
+{
+	ensureLittleEndian();
+
+	str dependency_block;
+	for (const str& dependency : dependencies)
+	{
+		dependency_block.append(dependency.c_str(), dependency.size() + 1);
+	}
+
+	ShaderFileHeader header{};
+	std::memcpy(header.magic, ShaderFileHeader::MAGIC, sizeof(header.magic));
+	header.version = ShaderFileHeader::VERSION;
+	header.key = key;
+	header.stage = static_cast<uint32_t>(stage);
+	header.dependency_count = static_cast<uint32_t>(dependencies.size());
+	header.entry_point_offset = sizeof(ShaderFileHeader);
+	header.entry_point_size = std::strlen(entry_point) + 1;
+	header.dependency_hash = dependency_hash;
+	header.dependency_offset = header.entry_point_offset + header.entry_point_size;
+	header.dependency_size = dependency_block.size();
+	header.code_offset = (header.dependency_offset + header.dependency_size + CODE_ALIGNMENT - 1) & ~(CODE_ALIGNMENT - 1);
+	header.code_size = code_size;
+
+	// Written aside and renamed over the target, so a crash never leaves a torn file behind.
+	// Names of files aside are unique per thread, as threads may write the same key at once.
+	const std::filesystem::path target(file_path);
+	std::filesystem::path temp = target;
+	temp += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		static const char zeros[CODE_ALIGNMENT] = {};
+		std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to create shader file.");
+		}
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(entry_point, static_cast<std::streamsize>(header.entry_point_size));
+		stream.write(dependency_block.data(), static_cast<std::streamsize>(dependency_block.size()));
+		stream.write(zeros, static_cast<std::streamsize>(header.code_offset - header.dependency_offset - header.dependency_size));
+		stream.write(static_cast<const char*>(p_code), static_cast<std::streamsize>(code_size));
+		if (!stream)
+		{
+			throw std::runtime_error("Failed to write shader file.");
+		}
+	}
+	std::filesystem::rename(temp, target);
+} // void CorE::Graphics::writeShaderFile()
+
+CorE::Graphics::MappedShaderCode CorE::Graphics::mapShaderFile(const char* file_path)
+{
+	ensureLittleEndian();
+
+	MappedShaderCode shader{ MappedFile(file_path) };
+	const char* p_data = shader.file.getData();
+	const uint64_t size = shader.file.getSize();
+
+	if (size < sizeof(ShaderFileHeader))
+	{
+		throw std::runtime_error("Shader file is too small.");
+	}
+	ShaderFileHeader header;
+	std::memcpy(&header, p_data, sizeof(header));
+	if (std::memcmp(header.magic, ShaderFileHeader::MAGIC, sizeof(header.magic)) != 0)
+	{
+		throw std::runtime_error("File is not a shader file.");
+	}
+	if (header.version != ShaderFileHeader::VERSION)
+	{
+		throw std::runtime_error("Shader file version is not supported.");
+	}
+	// SPIR-V is made of words, which Vulkan reads in place.
+	if (header.code_offset % CODE_ALIGNMENT != 0 || header.code_size % sizeof(uint32_t) != 0
+		|| header.code_offset > size || header.code_size > size - header.code_offset)
+	{
+		throw std::runtime_error("Shader file is corrupted.");
+	}
+	if (header.entry_point_offset > size || header.entry_point_size == 0 || header.entry_point_size > size - header.entry_point_offset
+		|| p_data[header.entry_point_offset + header.entry_point_size - 1] != '\0')
+	{
+		throw std::runtime_error("Shader file is corrupted.");
+	}
+	if (header.dependency_offset > size || header.dependency_size > size - header.dependency_offset
+		|| (header.dependency_size != 0 && p_data[header.dependency_offset + header.dependency_size - 1] != '\0'))
+	{
+		throw std::runtime_error("Shader file is corrupted.");
+	}
+
+	// Paths follow one another, each null-terminated.
+	const char* p_dependency = p_data + header.dependency_offset;
+	const char* p_dependencies_end = p_dependency + header.dependency_size;
+	while (p_dependency < p_dependencies_end)
+	{
+		shader.dependencies.emplace_back(p_dependency);
+		p_dependency += shader.dependencies.back().size() + 1;
+	}
+	if (shader.dependencies.size() != header.dependency_count)
+	{
+		throw std::runtime_error("Shader file is corrupted.");
+	}
+
+	shader.key = header.key;
+	shader.entry_point = p_data + header.entry_point_offset;
+	shader.dependency_hash = header.dependency_hash;
+	shader.stage = static_cast<VkShaderStageFlagBits>(header.stage);
+	shader.code = std::span<const char>(p_data + header.code_offset, header.code_size);
+	return shader;
+} // MappedShaderCode CorE::Graphics::mapShaderFile()
+
+uint32_t CorE::Graphics::compileSlangToCache(const char* source_path, const char* cache_dir)
+{
+	const std::filesystem::path source = std::filesystem::canonical(source_path);
+	const str source_str = source.string();
+	const str source_dir = source.parent_path().string();
+	const str module_name = source.stem().string();
+
+	// Keys hash the same bytes Slang compiles, so that a source changing meanwhile is not cached under an old key.
+	MappedFile file(source_str.c_str());
+	const str contents(file.getData(), file.getSize());
+
+	std::filesystem::create_directories(cache_dir);
+	std::lock_guard lock(slang_mutex);
+
+	if (!p_global_session)
+	{
+		ensureSlangSuccess(slang::createGlobalSession(p_global_session.writeRef()), nullptr,
+			"Failed to create Slang global session.");
+	}
+
+	slang::TargetDesc target_desc{};
+	target_desc.format = SLANG_SPIRV;
+	target_desc.profile = p_global_session->findProfile("spirv_1_5");
+
+	// Entry points keep their names, as shader objects are created by name, instead of all being "main".
+	slang::CompilerOptionEntry option{};
+	option.name = slang::CompilerOptionName::VulkanUseEntryPointName;
+	option.value.kind = slang::CompilerOptionValueKind::Int;
+	option.value.intValue0 = 1;
+
+	const char* search_paths[] = { source_dir.c_str() };
+
+	slang::SessionDesc session_desc{};
+	session_desc.targets = &target_desc;
+	session_desc.targetCount = 1;
+	session_desc.searchPaths = search_paths;
+	session_desc.searchPathCount = 1;
+	session_desc.compilerOptionEntries = &option;
+	session_desc.compilerOptionEntryCount = 1;
+
+	Slang::ComPtr<slang::ISession> p_session;
+	ensureSlangSuccess(p_global_session->createSession(session_desc, p_session.writeRef()), nullptr,
+		"Failed to create Slang session.");
+
+	Slang::ComPtr<slang::IBlob> p_diagnostics;
+	slang::IModule* p_module = p_session->loadModuleFromSourceString(module_name.c_str(), source_str.c_str(),
+		contents.c_str(), p_diagnostics.writeRef());
+	ensureSlangSuccess(p_module == nullptr ? SLANG_FAIL : SLANG_OK, p_diagnostics, "Failed to compile " + source_str + ".");
+
+	// Imported modules are not part of keys, so shader files keep them to be checked when loaded.
+	vec<str> dependencies;
+	for (SlangInt32 i = 0; i < p_module->getDependencyFileCount(); i++)
+	{
+		const std::filesystem::path dependency = std::filesystem::weakly_canonical(p_module->getDependencyFilePath(i));
+		if (dependency != source && std::filesystem::is_regular_file(dependency))
+		{
+			dependencies.push_back(dependency.string());
+		}
+	}
+	const uint64_t dependency_hash = hashShaderDependencies(dependencies);
+
+	const uint32_t entry_point_count = static_cast<uint32_t>(p_module->getDefinedEntryPointCount());
+	for (uint32_t i = 0; i < entry_point_count; i++)
+	{
+		Slang::ComPtr<slang::IEntryPoint> p_entry_point;
+		ensureSlangSuccess(p_module->getDefinedEntryPoint(static_cast<SlangInt32>(i), p_entry_point.writeRef()), nullptr,
+			"Failed to get entry point of " + source_str + ".");
+
+		slang::IComponentType* components[] = { p_module, p_entry_point };
+		Slang::ComPtr<slang::IComponentType> p_program;
+		ensureSlangSuccess(p_session->createCompositeComponentType(components, 2, p_program.writeRef(),
+			p_diagnostics.writeRef()), p_diagnostics, "Failed to compose " + source_str + ".");
+
+		Slang::ComPtr<slang::IComponentType> p_linked;
+		ensureSlangSuccess(p_program->link(p_linked.writeRef(), p_diagnostics.writeRef()), p_diagnostics,
+			"Failed to link " + source_str + ".");
+
+		Slang::ComPtr<slang::IBlob> p_code;
+		ensureSlangSuccess(p_linked->getEntryPointCode(0, 0, p_code.writeRef(), p_diagnostics.writeRef()), p_diagnostics,
+			"Failed to generate SPIR-V of " + source_str + ".");
+
+		slang::EntryPointReflection* p_reflection = p_linked->getLayout()->getEntryPointByIndex(0);
+		const char* entry_point = p_reflection->getName();
+		const uint64_t key = getShaderKey(contents.data(), contents.size(), entry_point);
+
+		writeShaderFile(getCachePath(cache_dir, key).string().c_str(), key, entry_point, toShaderStage(p_reflection->getStage()),
+			dependencies, dependency_hash, p_code->getBufferPointer(), p_code->getBufferSize());
+	}
+	return entry_point_count;
+} // uint32_t CorE::Graphics::compileSlangToCache()
+
+CorE::Graphics::MappedShaderCode CorE::Graphics::loadShaderCached(const char* source_path, const char* entry_point,
+	const char* cache_dir)
+{
+	uint64_t key;
+	{
+		MappedFile source(source_path);
+		key = getShaderKey(source.getData(), source.getSize(), entry_point);
+	}
+	const std::filesystem::path cache_path = getCachePath(cache_dir, key);
+	const str cache_str = cache_path.string();
+
+	if (std::filesystem::exists(cache_path))
+	{
+		try
+		{
+			MappedShaderCode cached = mapShaderFile(cache_str.c_str());
+			// Guards against files copied or renamed by hand, and against imported modules that changed.
+			if (cached.key == key && hashShaderDependencies(cached.dependencies) == cached.dependency_hash)
+			{
+				return cached;
+			}
+		}
+		catch (const std::runtime_error&)
+		{
+			// Outdated, corrupted or importing a module that is gone, rebuilt below.
+		}
+	}
+
+	compileSlangToCache(source_path, cache_dir);
+	if (!std::filesystem::exists(cache_path))
+	{
+		throw std::runtime_error(str("Shader has no entry point ") + entry_point + ", or changed while being compiled.");
+	}
+	return mapShaderFile(cache_str.c_str());
+} // MappedShaderCode CorE::Graphics::loadShaderCached()
@@ -0,0 +1,687 @@
+#include <cstring>
+
+#include "CorE/simd.hpp"
+
+#if defined(CORENGINE_SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <immintrin.h>
+#elif defined(CORENGINE_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+// MSVC allows AVX intrinsics in any function, GCC and Clang
+// need the target to be enabled per function instead.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CORENGINE_TARGET_AVX2
+#else
+#define CORENGINE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace
+{
+	using CorE::math::simd::InstructionSet;
+	using CorE::math::simd::Kernels;
+
+	/// ------------------------------- /// SCALAR /// ------------------------------- ///
+
+	void mulScalar(const float* p_lhs, const float* p_rhs, float* p_out)
+	{
+		float result[16];
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				float sum = 0.0f;
+				for (int k = 0; k < 4; k++)
+				{
+					sum += p_lhs[i * 4 + k] * p_rhs[k * 4 + j];
+				}
+				result[i * 4 + j] = sum;
+			}
+		}
+		std::memcpy(p_out, result, sizeof(result));
+	}
+
+	void transposeScalar(const float* p_mat, float* p_out)
+	{
+		float result[16];
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				result[i * 4 + j] = p_mat[j * 4 + i];
+			}
+		}
+		std::memcpy(p_out, result, sizeof(result));
+	}
+
+	void mulVecScalar(const float* p_mat, const float* p_vec, float* p_out)
+	{
+		float result[4];
+		for (int i = 0; i < 4; i++)
+		{
+			result[i] = p_mat[i * 4 + 0] * p_vec[0] + p_mat[i * 4 + 1] * p_vec[1]
+				+ p_mat[i * 4 + 2] * p_vec[2] + p_mat[i * 4 + 3] * p_vec[3];
+		}
+		std::memcpy(p_out, result, sizeof(result));
+	}
+
+	// Cofactor expansion over 2x2 sub-determinants of the upper (s) and lower (c) row pairs.
+	bool inverseScalar(const float* a, float* p_out)
+	{
+		const float s0 = a[0] * a[5] - a[4] * a[1];
+		const float s1 = a[0] * a[6] - a[4] * a[2];
+		const float s2 = a[0] * a[7] - a[4] * a[3];
+		const float s3 = a[1] * a[6] - a[5] * a[2];
+		const float s4 = a[1] * a[7] - a[5] * a[3];
+		const float s5 = a[2] * a[7] - a[6] * a[3];
+
+		const float c5 = a[10] * a[15] - a[14] * a[11];
+		const float c4 = a[9] * a[15] - a[13] * a[11];
+		const float c3 = a[9] * a[14] - a[13] * a[10];
+		const float c2 = a[8] * a[15] - a[12] * a[11];
+		const float c1 = a[8] * a[14] - a[12] * a[10];
+		const float c0 = a[8] * a[13] - a[12] * a[9];
+
+		const float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+		if (det == 0.0f)
+		{
+			return false;
+		}
+		const float inv_det = 1.0f / det;
+
+		float result[16];
+		result[0] = (a[5] * c5 - a[6] * c4 + a[7] * c3) * inv_det;
+		result[1] = (-a[1] * c5 + a[2] * c4 - a[3] * c3) * inv_det;
+		result[2] = (a[13] * s5 - a[14] * s4 + a[15] * s3) * inv_det;
+		result[3] = (-a[9] * s5 + a[10] * s4 - a[11] * s3) * inv_det;
+
+		result[4] = (-a[4] * c5 + a[6] * c2 - a[7] * c1) * inv_det;
+		result[5] = (a[0] * c5 - a[2] * c2 + a[3] * c1) * inv_det;
+		result[6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * inv_det;
+		result[7] = (a[8] * s5 - a[10] * s2 + a[11] * s1) * inv_det;
+
+		result[8] = (a[4] * c4 - a[5] * c2 + a[7] * c0) * inv_det;
+		result[9] = (-a[0] * c4 + a[1] * c2 - a[3] * c0) * inv_det;
+		result[10] = (a[12] * s4 - a[13] * s2 + a[15] * s0) * inv_det;
+		result[11] = (-a[8] * s4 + a[9] * s2 - a[11] * s0) * inv_det;
+
+		result[12] = (-a[4] * c3 + a[5] * c1 - a[6] * c0) * inv_det;
+		result[13] = (a[0] * c3 - a[1] * c1 + a[2] * c0) * inv_det;
+		result[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * inv_det;
+		result[15] = (a[8] * s3 - a[9] * s1 + a[10] * s0) * inv_det;
+
+		std::memcpy(p_out, result, sizeof(result));
+		return true;
+	}
+
+	void transformStreamsScalar(const float* p_mat, const float* const* pp_in,
+		float* const* pp_out, size_t count)
+	{
+		const float* m = p_mat;
+		for (size_t i = 0; i < count; i++)
+		{
+			const float x = pp_in[0][i];
+			const float y = pp_in[1][i];
+			const float z = pp_in[2][i];
+			const float w = pp_in[3][i];
+			pp_out[0][i] = m[0] * x + m[1] * y + m[2] * z + m[3] * w;
+			pp_out[1][i] = m[4] * x + m[5] * y + m[6] * z + m[7] * w;
+			pp_out[2][i] = m[8] * x + m[9] * y + m[10] * z + m[11] * w;
+			pp_out[3][i] = m[12] * x + m[13] * y + m[14] * z + m[15] * w;
+		}
+	}
+
+	void mulBatchScalar(const float* p_lhs, const float* p_rhs, float* p_out, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			mulScalar(p_lhs + i * 16, p_rhs + i * 16, p_out + i * 16);
+		}
+	}
+
+	const Kernels scalar_kernels{ mulScalar, transposeScalar, mulVecScalar, inverseScalar,
+		transformStreamsScalar, mulBatchScalar, InstructionSet::Scalar, "Scalar" };
+
+#if defined(CORENGINE_SIMD_X86)
+
+	/// ------------------------------- /// SSE2 /// ------------------------------- ///
+
+	// Picks lanes X, Y from a and Z, W from b.
+	template <int X, int Y, int Z, int W>
+	inline __m128 shuffle(__m128 a, __m128 b)
+	{
+		return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X));
+	}
+
+	template <int X, int Y, int Z, int W>
+	inline __m128 swizzle(__m128 v)
+	{
+		return shuffle<X, Y, Z, W>(v, v);
+	}
+
+	void mulSSE2(const float* p_lhs, const float* p_rhs, float* p_out)
+	{
+		const __m128 b0 = _mm_loadu_ps(p_rhs + 0);
+		const __m128 b1 = _mm_loadu_ps(p_rhs + 4);
+		const __m128 b2 = _mm_loadu_ps(p_rhs + 8);
+		const __m128 b3 = _mm_loadu_ps(p_rhs + 12);
+
+		__m128 rows[4];
+		for (int i = 0; i < 4; i++)
+		{
+			const __m128 a = _mm_loadu_ps(p_lhs + i * 4);
+			__m128 r = _mm_mul_ps(swizzle<0, 0, 0, 0>(a), b0);
+			r = _mm_add_ps(r, _mm_mul_ps(swizzle<1, 1, 1, 1>(a), b1));
+			r = _mm_add_ps(r, _mm_mul_ps(swizzle<2, 2, 2, 2>(a), b2));
+			r = _mm_add_ps(r, _mm_mul_ps(swizzle<3, 3, 3, 3>(a), b3));
+			rows[i] = r;
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			_mm_storeu_ps(p_out + i * 4, rows[i]);
+		}
+	}
+
+	void transposeSSE2(const float* p_mat, float* p_out)
+	{
+		__m128 r0 = _mm_loadu_ps(p_mat + 0);
+		__m128 r1 = _mm_loadu_ps(p_mat + 4);
+		__m128 r2 = _mm_loadu_ps(p_mat + 8);
+		__m128 r3 = _mm_loadu_ps(p_mat + 12);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(p_out + 0, r0);
+		_mm_storeu_ps(p_out + 4, r1);
+		_mm_storeu_ps(p_out + 8, r2);
+		_mm_storeu_ps(p_out + 12, r3);
+	}
+
+	void mulVecSSE2(const float* p_mat, const float* p_vec, float* p_out)
+	{
+		const __m128 v = _mm_loadu_ps(p_vec);
+		__m128 p0 = _mm_mul_ps(_mm_loadu_ps(p_mat + 0), v);
+		__m128 p1 = _mm_mul_ps(_mm_loadu_ps(p_mat + 4), v);
+		__m128 p2 = _mm_mul_ps(_mm_loadu_ps(p_mat + 8), v);
+		__m128 p3 = _mm_mul_ps(_mm_loadu_ps(p_mat + 12), v);
+		// After transposing, lane i of every product holds a part of row i dot product.
+		_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+		_mm_storeu_ps(p_out, _mm_add_ps(_mm_add_ps(p0, p1), _mm_add_ps(p2, p3)));
+	}
+
+	// 2x2 row-major matrix product A * B.
+	inline __m128 mat2Mul(__m128 a, __m128 b)
+	{
+		return _mm_add_ps(_mm_mul_ps(a, swizzle<0, 3, 0, 3>(b)),
+			_mm_mul_ps(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+	}
+
+	// 2x2 row-major adjugate product adj(A) * B.
+	inline __m128 mat2AdjMul(__m128 a, __m128 b)
+	{
+		return _mm_sub_ps(_mm_mul_ps(swizzle<3, 3, 0, 0>(a), b),
+			_mm_mul_ps(swizzle<1, 1, 2, 2>(a), swizzle<2, 3, 0, 1>(b)));
+	}
+
+	// 2x2 row-major product with adjugate A * adj(B).
+	inline __m128 mat2MulAdj(__m128 a, __m128 b)
+	{
+		return _mm_sub_ps(_mm_mul_ps(a, swizzle<3, 0, 3, 0>(b)),
+			_mm_mul_ps(swizzle<1, 0, 3, 2>(a), swizzle<2, 1, 2, 1>(b)));
+	}
+
+	// Block-wise inverse: the matrix is split into four 2x2 blocks A, B, C, D
+	// and the inverse is assembled from their adjugates and determinants.
+	bool inverseSSE2(const float* p_mat, float* p_out)
+	{
+		const __m128 r0 = _mm_loadu_ps(p_mat + 0);
+		const __m128 r1 = _mm_loadu_ps(p_mat + 4);
+		const __m128 r2 = _mm_loadu_ps(p_mat + 8);
+		const __m128 r3 = _mm_loadu_ps(p_mat + 12);
+
+		const __m128 a = _mm_movelh_ps(r0, r1);
+		const __m128 b = _mm_movehl_ps(r1, r0);
+		const __m128 c = _mm_movelh_ps(r2, r3);
+		const __m128 d = _mm_movehl_ps(r3, r2);
+
+		// (|A|, |B|, |C|, |D|)
+		const __m128 det_sub = _mm_sub_ps(
+			_mm_mul_ps(shuffle<0, 2, 0, 2>(r0, r2), shuffle<1, 3, 1, 3>(r1, r3)),
+			_mm_mul_ps(shuffle<1, 3, 1, 3>(r0, r2), shuffle<0, 2, 0, 2>(r1, r3)));
+		const __m128 det_a = swizzle<0, 0, 0, 0>(det_sub);
+		const __m128 det_b = swizzle<1, 1, 1, 1>(det_sub);
+		const __m128 det_c = swizzle<2, 2, 2, 2>(det_sub);
+		const __m128 det_d = swizzle<3, 3, 3, 3>(det_sub);
+
+		const __m128 d_c = mat2AdjMul(d, c);
+		const __m128 a_b = mat2AdjMul(a, b);
+
+		__m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), mat2Mul(b, d_c));
+		__m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), mat2Mul(c, a_b));
+		__m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), mat2MulAdj(d, a_b));
+		__m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), mat2MulAdj(a, d_c));
+
+		// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+		__m128 tr = _mm_mul_ps(a_b, swizzle<0, 2, 1, 3>(d_c));
+		tr = _mm_add_ps(tr, swizzle<2, 3, 0, 1>(tr));
+		tr = _mm_add_ps(tr, swizzle<1, 0, 3, 2>(tr));
+		const __m128 det_m = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), tr);
+
+		if (_mm_cvtss_f32(det_m) == 0.0f)
+		{
+			return false;
+		}
+
+		const __m128 r_det_m = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det_m);
+		x = _mm_mul_ps(x, r_det_m);
+		y = _mm_mul_ps(y, r_det_m);
+		z = _mm_mul_ps(z, r_det_m);
+		w = _mm_mul_ps(w, r_det_m);
+
+		// Adjugate shuffle and store shuffle combined.
+		_mm_storeu_ps(p_out + 0, shuffle<3, 1, 3, 1>(x, y));
+		_mm_storeu_ps(p_out + 4, shuffle<2, 0, 2, 0>(x, y));
+		_mm_storeu_ps(p_out + 8, shuffle<3, 1, 3, 1>(z, w));
+		_mm_storeu_ps(p_out + 12, shuffle<2, 0, 2, 0>(z, w));
+		return true;
+	}
+
+	// Four vectors per iteration, the rest is handled by the scalar kernel.
+	void transformStreamsSSE2(const float* p_mat, const float* const* pp_in,
+		float* const* pp_out, size_t count)
+	{
+		__m128 m[16];
+		for (int i = 0; i < 16; i++)
+		{
+			m[i] = _mm_set1_ps(p_mat[i]);
+		}
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(pp_in[0] + i);
+			const __m128 y = _mm_loadu_ps(pp_in[1] + i);
+			const __m128 z = _mm_loadu_ps(pp_in[2] + i);
+			const __m128 w = _mm_loadu_ps(pp_in[3] + i);
+			for (int row = 0; row < 4; row++)
+			{
+				__m128 r = _mm_mul_ps(m[row * 4 + 0], x);
+				r = _mm_add_ps(r, _mm_mul_ps(m[row * 4 + 1], y));
+				r = _mm_add_ps(r, _mm_mul_ps(m[row * 4 + 2], z));
+				r = _mm_add_ps(r, _mm_mul_ps(m[row * 4 + 3], w));
+				_mm_storeu_ps(pp_out[row] + i, r);
+			}
+		}
+
+		const float* in_tail[4] = { pp_in[0] + i, pp_in[1] + i, pp_in[2] + i, pp_in[3] + i };
+		float* out_tail[4] = { pp_out[0] + i, pp_out[1] + i, pp_out[2] + i, pp_out[3] + i };
+		transformStreamsScalar(p_mat, in_tail, out_tail, count - i);
+	}
+
+	void mulBatchSSE2(const float* p_lhs, const float* p_rhs, float* p_out, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			mulSSE2(p_lhs + i * 16, p_rhs + i * 16, p_out + i * 16);
+		}
+	}
+
+	const Kernels sse2_kernels{ mulSSE2, transposeSSE2, mulVecSSE2, inverseSSE2,
+		transformStreamsSSE2, mulBatchSSE2, InstructionSet::SSE2, "SSE2" };
+
+	/// ------------------------------- /// AVX2 /// ------------------------------- ///
+
+	CORENGINE_TARGET_AVX2 inline __m256 broadcastRow(const float* p_row)
+	{
+		const __m128 row = _mm_loadu_ps(p_row);
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(row), row, 1);
+	}
+
+	// Computes two rows of the product at once, one per 128-bit lane.
+	CORENGINE_TARGET_AVX2 void mulAVX2(const float* p_lhs, const float* p_rhs, float* p_out)
+	{
+		const __m256 b0 = broadcastRow(p_rhs + 0);
+		const __m256 b1 = broadcastRow(p_rhs + 4);
+		const __m256 b2 = broadcastRow(p_rhs + 8);
+		const __m256 b3 = broadcastRow(p_rhs + 12);
+
+		const __m256 a01 = _mm256_loadu_ps(p_lhs + 0);
+		const __m256 a23 = _mm256_loadu_ps(p_lhs + 8);
+
+		__m256 r01 = _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, 0x00), b0);
+		r01 = _mm256_fmadd_ps(_mm256_shuffle_ps(a01, a01, 0x55), b1, r01);
+		r01 = _mm256_fmadd_ps(_mm256_shuffle_ps(a01, a01, 0xAA), b2, r01);
+		r01 = _mm256_fmadd_ps(_mm256_shuffle_ps(a01, a01, 0xFF), b3, r01);
+
+		__m256 r23 = _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, 0x00), b0);
+		r23 = _mm256_fmadd_ps(_mm256_shuffle_ps(a23, a23, 0x55), b1, r23);
+		r23 = _mm256_fmadd_ps(_mm256_shuffle_ps(a23, a23, 0xAA), b2, r23);
+		r23 = _mm256_fmadd_ps(_mm256_shuffle_ps(a23, a23, 0xFF), b3, r23);
+
+		_mm256_storeu_ps(p_out + 0, r01);
+		_mm256_storeu_ps(p_out + 8, r23);
+	}
+
+	CORENGINE_TARGET_AVX2 void mulVecAVX2(const float* p_mat, const float* p_vec, float* p_out)
+	{
+		const __m256 v = broadcastRow(p_vec);
+		const __m256 p01 = _mm256_mul_ps(_mm256_loadu_ps(p_mat + 0), v);
+		const __m256 p23 = _mm256_mul_ps(_mm256_loadu_ps(p_mat + 8), v);
+
+		// Lane 0 ends up as (r0, r2, r0, r2), lane 1 as (r1, r3, r1, r3).
+		__m256 sums = _mm256_hadd_ps(p01, p23);
+		sums = _mm256_hadd_ps(sums, sums);
+
+		const __m128 lo = _mm256_castps256_ps128(sums);
+		const __m128 hi = _mm256_extractf128_ps(sums, 1);
+		_mm_storeu_ps(p_out, _mm_unpacklo_ps(lo, hi));
+	}
+
+	// Eight vectors per iteration, the rest is handled by the scalar kernel.
+	CORENGINE_TARGET_AVX2 void transformStreamsAVX2(const float* p_mat, const float* const* pp_in,
+		float* const* pp_out, size_t count)
+	{
+		__m256 m[16];
+		for (int i = 0; i < 16; i++)
+		{
+			m[i] = _mm256_set1_ps(p_mat[i]);
+		}
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(pp_in[0] + i);
+			const __m256 y = _mm256_loadu_ps(pp_in[1] + i);
+			const __m256 z = _mm256_loadu_ps(pp_in[2] + i);
+			const __m256 w = _mm256_loadu_ps(pp_in[3] + i);
+			for (int row = 0; row < 4; row++)
+			{
+				__m256 r = _mm256_mul_ps(m[row * 4 + 0], x);
+				r = _mm256_fmadd_ps(m[row * 4 + 1], y, r);
+				r = _mm256_fmadd_ps(m[row * 4 + 2], z, r);
+				r = _mm256_fmadd_ps(m[row * 4 + 3], w, r);
+				_mm256_storeu_ps(pp_out[row] + i, r);
+			}
+		}
+
+		const float* in_tail[4] = { pp_in[0] + i, pp_in[1] + i, pp_in[2] + i, pp_in[3] + i };
+		float* out_tail[4] = { pp_out[0] + i, pp_out[1] + i, pp_out[2] + i, pp_out[3] + i };
+		transformStreamsScalar(p_mat, in_tail, out_tail, count - i);
+	}
+
+	CORENGINE_TARGET_AVX2 void mulBatchAVX2(const float* p_lhs, const float* p_rhs, float* p_out, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			mulAVX2(p_lhs + i * 16, p_rhs + i * 16, p_out + i * 16);
+		}
+	}
+
+	// Transpose and inverse gain nothing from wider registers on a single 4x4 matrix.
+	const Kernels avx2_kernels{ mulAVX2, transposeSSE2, mulVecAVX2, inverseSSE2,
+		transformStreamsAVX2, mulBatchAVX2, InstructionSet::AVX2, "AVX2" };
+
+	bool cpuHasAVX2()
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		int regs[4];
+		__cpuid(regs, 1);
+		const bool os_xsave = (regs[2] & (1 << 27)) != 0;
+		const bool avx = (regs[2] & (1 << 28)) != 0;
+		const bool fma = (regs[2] & (1 << 12)) != 0;
+		if (!(os_xsave && avx && fma))
+		{
+			return false;
+		}
+		// OS must save YMM registers on context switch.
+		if ((_xgetbv(0) & 0x6) != 0x6)
+		{
+			return false;
+		}
+		__cpuidex(regs, 7, 0);
+		return (regs[1] & (1 << 5)) != 0;
+#else
+		// Also checks that OS saves YMM registers.
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+
+#elif defined(CORENGINE_SIMD_NEON)
+
+	/// ------------------------------- /// NEON /// ------------------------------- ///
+
+	void mulNEON(const float* p_lhs, const float* p_rhs, float* p_out)
+	{
+		const float32x4_t b0 = vld1q_f32(p_rhs + 0);
+		const float32x4_t b1 = vld1q_f32(p_rhs + 4);
+		const float32x4_t b2 = vld1q_f32(p_rhs + 8);
+		const float32x4_t b3 = vld1q_f32(p_rhs + 12);
+
+		float32x4_t rows[4];
+		for (int i = 0; i < 4; i++)
+		{
+			const float32x4_t a = vld1q_f32(p_lhs + i * 4);
+			float32x4_t r = vmulq_n_f32(b0, vgetq_lane_f32(a, 0));
+			r = vmlaq_n_f32(r, b1, vgetq_lane_f32(a, 1));
+			r = vmlaq_n_f32(r, b2, vgetq_lane_f32(a, 2));
+			r = vmlaq_n_f32(r, b3, vgetq_lane_f32(a, 3));
+			rows[i] = r;
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			vst1q_f32(p_out + i * 4, rows[i]);
+		}
+	}
+
+	// De-interleaving load reads the matrix column by column.
+	void transposeNEON(const float* p_mat, float* p_out)
+	{
+		const float32x4x4_t columns = vld4q_f32(p_mat);
+		vst1q_f32(p_out + 0, columns.val[0]);
+		vst1q_f32(p_out + 4, columns.val[1]);
+		vst1q_f32(p_out + 8, columns.val[2]);
+		vst1q_f32(p_out + 12, columns.val[3]);
+	}
+
+	void mulVecNEON(const float* p_mat, const float* p_vec, float* p_out)
+	{
+		const float32x4x4_t columns = vld4q_f32(p_mat);
+		const float32x4_t v = vld1q_f32(p_vec);
+		float32x4_t r = vmulq_n_f32(columns.val[0], vgetq_lane_f32(v, 0));
+		r = vmlaq_n_f32(r, columns.val[1], vgetq_lane_f32(v, 1));
+		r = vmlaq_n_f32(r, columns.val[2], vgetq_lane_f32(v, 2));
+		r = vmlaq_n_f32(r, columns.val[3], vgetq_lane_f32(v, 3));
+		vst1q_f32(p_out, r);
+	}
+
+	// Four vectors per iteration, the rest is handled by the scalar kernel.
+	void transformStreamsNEON(const float* p_mat, const float* const* pp_in,
+		float* const* pp_out, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const float32x4_t x = vld1q_f32(pp_in[0] + i);
+			const float32x4_t y = vld1q_f32(pp_in[1] + i);
+			const float32x4_t z = vld1q_f32(pp_in[2] + i);
+			const float32x4_t w = vld1q_f32(pp_in[3] + i);
+			for (int row = 0; row < 4; row++)
+			{
+				float32x4_t r = vmulq_n_f32(x, p_mat[row * 4 + 0]);
+				r = vmlaq_n_f32(r, y, p_mat[row * 4 + 1]);
+				r = vmlaq_n_f32(r, z, p_mat[row * 4 + 2]);
+				r = vmlaq_n_f32(r, w, p_mat[row * 4 + 3]);
+				vst1q_f32(pp_out[row] + i, r);
+			}
+		}
+
+		const float* in_tail[4] = { pp_in[0] + i, pp_in[1] + i, pp_in[2] + i, pp_in[3] + i };
+		float* out_tail[4] = { pp_out[0] + i, pp_out[1] + i, pp_out[2] + i, pp_out[3] + i };
+		transformStreamsScalar(p_mat, in_tail, out_tail, count - i);
+	}
+
+	void mulBatchNEON(const float* p_lhs, const float* p_rhs, float* p_out, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			mulNEON(p_lhs + i * 16, p_rhs + i * 16, p_out + i * 16);
+		}
+	}
+
+	// Picks lanes X, Y from a and Z, W from b. NEON has no general shuffle on ARMv7,
+	// lane moves compile to single INS / VMOV instructions instead.
+	template <int X, int Y, int Z, int W>
+	inline float32x4_t shuffle(float32x4_t a, float32x4_t b)
+	{
+		float32x4_t r = vdupq_n_f32(vgetq_lane_f32(a, X));
+		r = vsetq_lane_f32(vgetq_lane_f32(a, Y), r, 1);
+		r = vsetq_lane_f32(vgetq_lane_f32(b, Z), r, 2);
+		return vsetq_lane_f32(vgetq_lane_f32(b, W), r, 3);
+	}
+
+	template <int X, int Y, int Z, int W>
+	inline float32x4_t swizzle(float32x4_t v)
+	{
+		return shuffle<X, Y, Z, W>(v, v);
+	}
+
+	// 2x2 row-major matrix product A * B.
+	inline float32x4_t mat2Mul(float32x4_t a, float32x4_t b)
+	{
+		return vmlaq_f32(vmulq_f32(a, swizzle<0, 3, 0, 3>(b)), vrev64q_f32(a), swizzle<2, 1, 2, 1>(b));
+	}
+
+	// 2x2 row-major adjugate product adj(A) * B.
+	inline float32x4_t mat2AdjMul(float32x4_t a, float32x4_t b)
+	{
+		return vmlsq_f32(vmulq_f32(swizzle<3, 3, 0, 0>(a), b), swizzle<1, 1, 2, 2>(a), swizzle<2, 3, 0, 1>(b));
+	}
+
+	// 2x2 row-major product with adjugate A * adj(B).
+	inline float32x4_t mat2MulAdj(float32x4_t a, float32x4_t b)
+	{
+		return vmlsq_f32(vmulq_f32(a, swizzle<3, 0, 3, 0>(b)), vrev64q_f32(a), swizzle<2, 1, 2, 1>(b));
+	}
+
+	// Same block-wise inverse as inverseSSE2().
+	bool inverseNEON(const float* p_mat, float* p_out)
+	{
+		const float32x4_t r0 = vld1q_f32(p_mat + 0);
+		const float32x4_t r1 = vld1q_f32(p_mat + 4);
+		const float32x4_t r2 = vld1q_f32(p_mat + 8);
+		const float32x4_t r3 = vld1q_f32(p_mat + 12);
+
+		const float32x4_t a = vcombine_f32(vget_low_f32(r0), vget_low_f32(r1));
+		const float32x4_t b = vcombine_f32(vget_high_f32(r0), vget_high_f32(r1));
+		const float32x4_t c = vcombine_f32(vget_low_f32(r2), vget_low_f32(r3));
+		const float32x4_t d = vcombine_f32(vget_high_f32(r2), vget_high_f32(r3));
+
+		// (|A|, |B|, |C|, |D|)
+		const float32x4_t det_sub = vmlsq_f32(
+			vmulq_f32(shuffle<0, 2, 0, 2>(r0, r2), shuffle<1, 3, 1, 3>(r1, r3)),
+			shuffle<1, 3, 1, 3>(r0, r2), shuffle<0, 2, 0, 2>(r1, r3));
+		const float det_a = vgetq_lane_f32(det_sub, 0);
+		const float det_b = vgetq_lane_f32(det_sub, 1);
+		const float det_c = vgetq_lane_f32(det_sub, 2);
+		const float det_d = vgetq_lane_f32(det_sub, 3);
+
+		const float32x4_t d_c = mat2AdjMul(d, c);
+		const float32x4_t a_b = mat2AdjMul(a, b);
+
+		const float32x4_t x = vsubq_f32(vmulq_n_f32(a, det_d), mat2Mul(b, d_c));
+		const float32x4_t w = vsubq_f32(vmulq_n_f32(d, det_a), mat2Mul(c, a_b));
+		const float32x4_t y = vsubq_f32(vmulq_n_f32(c, det_b), mat2MulAdj(d, a_b));
+		const float32x4_t z = vsubq_f32(vmulq_n_f32(b, det_c), mat2MulAdj(a, d_c));
+
+		// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+		const float32x4_t tr = vmulq_f32(a_b, swizzle<0, 2, 1, 3>(d_c));
+		const float32x2_t tr_pairs = vadd_f32(vget_low_f32(tr), vget_high_f32(tr));
+		const float det_m = det_a * det_d + det_b * det_c
+			- (vget_lane_f32(tr_pairs, 0) + vget_lane_f32(tr_pairs, 1));
+
+		if (det_m == 0.0f)
+		{
+			return false;
+		}
+
+		// ARMv7 has no vector division, and the determinant is the same in every lane anyway.
+		static const float signs[4] = { 1.0f, -1.0f, -1.0f, 1.0f };
+		const float32x4_t r_det_m = vmulq_n_f32(vld1q_f32(signs), 1.0f / det_m);
+		const float32x4_t xs = vmulq_f32(x, r_det_m);
+		const float32x4_t ys = vmulq_f32(y, r_det_m);
+		const float32x4_t zs = vmulq_f32(z, r_det_m);
+		const float32x4_t ws = vmulq_f32(w, r_det_m);
+
+		// Adjugate shuffle and store shuffle combined.
+		vst1q_f32(p_out + 0, shuffle<3, 1, 3, 1>(xs, ys));
+		vst1q_f32(p_out + 4, shuffle<2, 0, 2, 0>(xs, ys));
+		vst1q_f32(p_out + 8, shuffle<3, 1, 3, 1>(zs, ws));
+		vst1q_f32(p_out + 12, shuffle<2, 0, 2, 0>(zs, ws));
+		return true;
+	}
+
+	const Kernels neon_kernels{ mulNEON, transposeNEON, mulVecNEON, inverseNEON,
+		transformStreamsNEON, mulBatchNEON, InstructionSet::NEON, "NEON" };
+
+#endif
+} // anonymous namespace
+
+CorE::math::simd::InstructionSet CorE::math::simd::detect()
+{
+#if defined(CORENGINE_SIMD_X86)
+	return cpuHasAVX2() ? InstructionSet::AVX2 : InstructionSet::SSE2;
+#elif defined(CORENGINE_SIMD_NEON)
+	return InstructionSet::NEON;
+#else
+	return InstructionSet::Scalar;
+#endif
+} // InstructionSet simd::detect()
+
+bool CorE::math::simd::isSupported(InstructionSet set)
+{
+	switch (set)
+	{
+	case InstructionSet::Scalar:
+		return true;
+#if defined(CORENGINE_SIMD_X86)
+	case InstructionSet::SSE2:
+		return true;
+	case InstructionSet::AVX2:
+		return cpuHasAVX2();
+#elif defined(CORENGINE_SIMD_NEON)
+	case InstructionSet::NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+} // bool simd::isSupported()
+
+const CorE::math::simd::Kernels& CorE::math::simd::getKernels(InstructionSet set)
+{
+	if (!isSupported(set))
+	{
+		return scalar_kernels;
+	}
+	switch (set)
+	{
+#if defined(CORENGINE_SIMD_X86)
+	case InstructionSet::SSE2:
+		return sse2_kernels;
+	case InstructionSet::AVX2:
+		return avx2_kernels;
+#elif defined(CORENGINE_SIMD_NEON)
+	case InstructionSet::NEON:
+		return neon_kernels;
+#endif
+	default:
+		return scalar_kernels;
+	}
+} // const Kernels& simd::getKernels()
+
+const CorE::math::simd::Kernels& CorE::math::simd::active()
+{
+	static const Kernels& kernels = getKernels(detect());
+	return kernels;
+} // const Kernels& simd::active()
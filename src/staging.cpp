@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "CorE/staging.hpp"
+
+namespace
+{
+	// Ring sizes need not be powers of two, so no masks here.
+	VkDeviceSize roundUp(VkDeviceSize value, VkDeviceSize multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+} // anonymous namespace
+
+CorE::StagingUploader::StagingUploader(LogicalDevice* p_device, DeviceMemoryAllocator* p_memory, Queue* p_transfer_queue,
+	Queue* p_graphics_queue, const StagingProperties& props)
+	: p_device(p_device), p_memory(p_memory), p_transfer_queue(p_transfer_queue), p_graphics_queue(p_graphics_queue),
+	props(props), timeline(p_device, VK_SEMAPHORE_TYPE_TIMELINE, 0),
+	pools(p_device, p_transfer_queue->p_parent, props.batches_in_flight, p_device->getAllocator()),
+	slot_values(std::max(1u, props.batches_in_flight), 0)
+{
+	VkPhysicalDeviceProperties device_props;
+	vkGetPhysicalDeviceProperties(p_device->p_parent->vk_handle, &device_props);
+	// Also covers texel blocks of every format, which image copies must be aligned to.
+	copy_alignment = std::max<VkDeviceSize>(device_props.limits.optimalBufferCopyOffsetAlignment, 16);
+	this->props.ring_size = roundUp(std::max(props.ring_size, copy_alignment), copy_alignment);
+	ownership_transfer = p_transfer_queue->p_parent->index != p_graphics_queue->p_parent->index;
+
+	VkBufferCreateInfo buffer_info{};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = this->props.ring_size;
+	buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	ensureVkSuccess(vkCreateBuffer(p_device->vk_handle, &buffer_info, p_device->getAllocator(), &ring_buffer),
+		"Failed to create staging ring.");
+
+	// Dedicated, so that defragmentation never moves the ring.
+	DeviceAllocationInfo alloc_info{};
+	vkGetBufferMemoryRequirements(p_device->vk_handle, ring_buffer, &alloc_info.requirements);
+	alloc_info.required_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	alloc_info.preferred_flags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	alloc_info.dedicated = true;
+	try
+	{
+		p_ring_allocation = p_memory->allocate(alloc_info);
+	}
+	catch (...)
+	{
+		vkDestroyBuffer(p_device->vk_handle, ring_buffer, p_device->getAllocator());
+		throw;
+	}
+	ensureVkSuccess(vkBindBufferMemory(p_device->vk_handle, ring_buffer, p_ring_allocation->memory, p_ring_allocation->offset),
+		"Failed to bind staging ring memory.");
+	p_ring = static_cast<char*>(p_ring_allocation->p_mapped);
+} // StagingUploader::StagingUploader()
+
+CorE::StagingUploader::~StagingUploader()
+{
+	vkDestroyBuffer(p_device->vk_handle, ring_buffer, p_device->getAllocator());
+	p_memory->free(p_ring_allocation);
+	vkDestroySemaphore(p_device->vk_handle, timeline.vk_handle, nullptr);
+} // StagingUploader::~StagingUploader()
+
+CorE::QueueFamily* CorE::StagingUploader::findTransferFamily(PhysicalDevice* p_device)
+{
+	for (QueueFamily& family : p_device->queue_families)
+	{
+		const VkQueueFlags flags = family.props.queueFlags;
+		if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			return &family;
+		}
+	}
+	return nullptr;
+} // QueueFamily* StagingUploader::findTransferFamily()
+
+void CorE::StagingUploader::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* p_data, VkDeviceSize size)
+{
+	const char* p_bytes = static_cast<const char*>(p_data);
+	const VkDeviceSize first_offset = offset;
+	const VkDeviceSize total_size = size;
+	// Halves of the ring, so that one chunk is copied while the next one is staged.
+	const VkDeviceSize max_chunk = roundUp(props.ring_size / 2, copy_alignment);
+	while (size > 0)
+	{
+		const VkDeviceSize chunk = std::min(size, max_chunk);
+		const VkDeviceSize ring_offset = reserve(chunk, copy_alignment);
+		copyToRing(ring_offset, p_bytes, chunk);
+		beginBatch();
+
+		const VkBufferCopy region{ ring_offset % props.ring_size, offset, chunk };
+		vkCmdCopyBuffer(p_recording->vk_handle, ring_buffer, buffer, 1, &region);
+		p_bytes += chunk;
+		offset += chunk;
+		size -= chunk;
+	}
+
+	if (ownership_transfer && total_size > 0)
+	{
+		VkBufferMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = p_transfer_queue->p_parent->index;
+		barrier.dstQueueFamilyIndex = p_graphics_queue->p_parent->index;
+		barrier.buffer = buffer;
+		barrier.offset = first_offset;
+		barrier.size = total_size;
+		buffer_releases.push_back(barrier);
+	}
+	stats.uploads++;
+	stats.bytes += total_size;
+} // void StagingUploader::uploadBuffer()
+
+void CorE::StagingUploader::uploadImage(VkImage image, const VkImageSubresourceLayers& subresource, VkExtent3D extent,
+	const void* p_data, VkDeviceSize size, VkImageLayout final_layout)
+{
+	if (size > props.ring_size)
+	{
+		throw std::runtime_error("Image upload does not fit the staging ring.");
+	}
+	const VkDeviceSize ring_offset = reserve(size, copy_alignment);
+	copyToRing(ring_offset, p_data, size);
+	beginBatch();
+
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = { subresource.aspectMask, subresource.mipLevel, 1, subresource.baseArrayLayer, subresource.layerCount };
+	VkDependencyInfo dependency{};
+	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency.imageMemoryBarrierCount = 1;
+	dependency.pImageMemoryBarriers = &barrier;
+	vkCmdPipelineBarrier2(p_recording->vk_handle, &dependency);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = ring_offset % props.ring_size;
+	region.imageSubresource = subresource;
+	region.imageExtent = extent;
+	vkCmdCopyBufferToImage(p_recording->vk_handle, ring_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	// Moves the image to its final layout, and to the graphics family if it differs.
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.dstStageMask = ownership_transfer ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	barrier.dstAccessMask = ownership_transfer ? VK_ACCESS_2_NONE : VK_ACCESS_2_MEMORY_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = final_layout;
+	if (ownership_transfer)
+	{
+		barrier.srcQueueFamilyIndex = p_transfer_queue->p_parent->index;
+		barrier.dstQueueFamilyIndex = p_graphics_queue->p_parent->index;
+	}
+	image_releases.push_back(barrier);
+	stats.uploads++;
+	stats.bytes += size;
+} // void StagingUploader::uploadImage()
+
+void CorE::StagingUploader::uploadModel(const Dim3::Model_3D& model, VkBuffer vertex_buffer, VkBuffer index_buffer)
+{
+	if (model.vertices.empty())
+	{
+		throw std::runtime_error("Model must be indexed with indexModel() before it is uploaded.");
+	}
+	uploadBuffer(vertex_buffer, 0, model.vertices.data(), sizeof(Dim3::Vertex_3D) * model.vertices.size());
+	uploadBuffer(index_buffer, 0, model.indices.getData(), model.indices.getStride() * model.indices.size());
+} // void StagingUploader::uploadModel()
+
+uint64_t CorE::StagingUploader::submit()
+{
+	if (!p_recording)
+	{
+		return next_value - 1;
+	}
+
+	if (!buffer_releases.empty() || !image_releases.empty())
+	{
+		VkDependencyInfo dependency{};
+		dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependency.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_releases.size());
+		dependency.pBufferMemoryBarriers = buffer_releases.data();
+		dependency.imageMemoryBarrierCount = static_cast<uint32_t>(image_releases.size());
+		dependency.pImageMemoryBarriers = image_releases.data();
+		vkCmdPipelineBarrier2(p_recording->vk_handle, &dependency);
+	}
+	p_recording->end();
+
+	const uint64_t value = next_value++;
+	p_transfer_queue->submitBuffers({ p_recording });
+	p_transfer_queue->signal(&timeline, value);
+	// A shared queue is flushed with the rest of the frame.
+	if (!isSharedQueue())
+	{
+		p_transfer_queue->flush();
+	}
+	slot_values[pools.getFrameIndex()] = value;
+	pools.endFrame(&timeline, value);
+	ring_retirements.push_back({ value, ring_head });
+
+	if (ownership_transfer)
+	{
+		// Acquires repeat releases, with the other half of the dependency.
+		PendingAcquire acquire{ value, std::move(buffer_releases), std::move(image_releases) };
+		for (VkBufferMemoryBarrier2& barrier : acquire.buffers)
+		{
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+		}
+		for (VkImageMemoryBarrier2& barrier : acquire.images)
+		{
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+			barrier.srcAccessMask = VK_ACCESS_2_NONE;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+		}
+		pending_acquires.push_back(std::move(acquire));
+	}
+	buffer_releases.clear();
+	image_releases.clear();
+
+	p_recording = nullptr;
+	stats.batches++;
+	return value;
+} // uint64_t StagingUploader::submit()
+
+void CorE::StagingUploader::acquire(CommandBuffer* p_buffer)
+{
+	const uint64_t completed = timeline.getValue();
+	reclaim(completed);
+	if (completed <= acquired_value)
+	{
+		return;
+	}
+
+	vec<VkBufferMemoryBarrier2> buffer_acquires;
+	vec<VkImageMemoryBarrier2> image_acquires;
+	while (!pending_acquires.empty() && pending_acquires.front().value <= completed)
+	{
+		PendingAcquire& acquire = pending_acquires.front();
+		buffer_acquires.insert(buffer_acquires.end(), acquire.buffers.begin(), acquire.buffers.end());
+		image_acquires.insert(image_acquires.end(), acquire.images.begin(), acquire.images.end());
+		pending_acquires.pop_front();
+	}
+	if (!buffer_acquires.empty() || !image_acquires.empty())
+	{
+		VkDependencyInfo dependency{};
+		dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependency.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_acquires.size());
+		dependency.pBufferMemoryBarriers = buffer_acquires.data();
+		dependency.imageMemoryBarrierCount = static_cast<uint32_t>(image_acquires.size());
+		dependency.pImageMemoryBarriers = image_acquires.data();
+		vkCmdPipelineBarrier2(p_buffer->vk_handle, &dependency);
+	}
+
+	// Already reached, but the wait is what makes the uploads visible to the graphics queue.
+	p_graphics_queue->waitFor(&timeline, completed, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+	acquired_value = completed;
+} // void StagingUploader::acquire()
+
+VkDeviceSize CorE::StagingUploader::reserve(VkDeviceSize size, VkDeviceSize alignment)
+{
+	const VkDeviceSize ring_size = props.ring_size;
+	for (bool polled = false;;)
+	{
+		VkDeviceSize start = roundUp(ring_head, alignment);
+		if (start % ring_size + size > ring_size)
+		{
+			// Ranges never wrap, the rest of the ring is skipped instead.
+			start = roundUp(start, ring_size);
+		}
+		if (start + size - ring_tail <= ring_size)
+		{
+			ring_head = start + size;
+			return start;
+		}
+
+		if (!polled)
+		{
+			reclaim(timeline.getValue());
+			polled = true;
+		}
+		else if (!ring_retirements.empty())
+		{
+			if (isSharedQueue())
+			{
+				p_transfer_queue->flush();
+			}
+			const uint64_t value = ring_retirements.front().value;
+			stats.stalls++;
+			timeline.wait(value);
+			reclaim(value);
+		}
+		else if (p_recording)
+		{
+			// The batch being recorded fills the ring, it has to go first.
+			submit();
+		}
+		else
+		{
+			throw std::runtime_error("Upload does not fit the staging ring.");
+		}
+	}
+} // VkDeviceSize StagingUploader::reserve()
+
+void CorE::StagingUploader::reclaim(uint64_t completed_value)
+{
+	while (!ring_retirements.empty() && ring_retirements.front().value <= completed_value)
+	{
+		ring_tail = ring_retirements.front().ring_end;
+		ring_retirements.pop_front();
+	}
+} // void StagingUploader::reclaim()
+
+void CorE::StagingUploader::copyToRing(VkDeviceSize ring_offset, const void* p_data, VkDeviceSize size)
+{
+	const VkDeviceSize offset = ring_offset % props.ring_size;
+	std::memcpy(p_ring + offset, p_data, size);
+	p_memory->flush(p_ring_allocation, offset, size);
+} // void StagingUploader::copyToRing()
+
+void CorE::StagingUploader::beginBatch()
+{
+	if (p_recording)
+	{
+		return;
+	}
+
+	const uint32_t slot = pools.getFrameIndex();
+	if (slot_values[slot] > timeline.getValue())
+	{
+		if (isSharedQueue())
+		{
+			p_transfer_queue->flush();
+		}
+		stats.stalls++;
+	}
+	pools.beginFrame();
+	p_recording = pools.acquireBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	p_recording->begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr);
+} // void StagingUploader::beginBatch()
@@ -116,11 +116,9 @@ void initQNXSurface();
 #endif
 
 
-// THIS METHOD IS NOT WORKING, Mat4x4::projection() HAS EMPTY DEFINITION!!!
-// TODO
 void CorE::Windowing::Window::refreshProjMat()
 {
-	proj_mat = CorE::math::Mat4x4::projection(fov, static_cast<float>(width / height), z_near, z_far);
+	proj_mat = CorE::math::Mat4x4::projection(fov, static_cast<float>(width) / static_cast<float>(height), z_near, z_far);
 }
 
 void CorE::Windowing::Window::centralize()
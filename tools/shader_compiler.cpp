@@ -0,0 +1,33 @@
+// Build stage of CorEngine shaders: compiles every entry point of Slang
+// sources into the shader cache, see shader_cache.hpp.
+//
+// Usage: CorEngineShaderCompiler <cache_dir> <file.slang>...
+
+#include <cstdio>
+#include <stdexcept>
+
+#include "CorE/shader_cache.hpp"
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::fprintf(stderr, "Usage: CorEngineShaderCompiler <cache_dir> <file.slang>...\n");
+		return 2;
+	}
+
+	for (int i = 2; i < argc; i++)
+	{
+		try
+		{
+			const uint32_t entry_points = CorE::Graphics::compileSlangToCache(argv[i], argv[1]);
+			std::printf("%s: %u entry points\n", argv[i], entry_points);
+		}
+		catch (const std::exception& error)
+		{
+			std::fprintf(stderr, "%s: %s\n", argv[i], error.what());
+			return 1;
+		}
+	}
+	return 0;
+}